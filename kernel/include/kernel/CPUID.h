@@ -78,6 +78,7 @@ namespace CPUID
 	void get_features(uint32_t& ecx, uint32_t& edx);
 	bool is_64_bit();
 	bool has_nxe();
+	bool has_invariant_tsc();
 	bool has_pge();
 
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <BAN/Function.h>
 #include <kernel/FS/TmpFS/Inode.h>
 #include <kernel/Memory/MemoryRegion.h>
 
@@ -28,10 +29,36 @@ namespace Kernel
 
 	class BlockDevice : public Device
 	{
+	public:
+		using completion_callback_t = BAN::Function<void(BAN::ErrorOr<void>)>;
+
 	public:
 		virtual BAN::ErrorOr<void> read_blocks(uint64_t first_block, size_t block_count, BAN::ByteSpan) = 0;
 		virtual BAN::ErrorOr<void> write_blocks(uint64_t first_block, size_t block_count, BAN::ConstByteSpan) = 0;
 
+		// Asynchronous versions of read_blocks and write_blocks. Callback is called with the
+		// result once the request has completed, buffer must stay valid until then.
+		// By default requests are executed synchronously.
+		virtual BAN::ErrorOr<void> submit_read_blocks(uint64_t first_block, size_t block_count, BAN::ByteSpan buffer, completion_callback_t callback)
+		{
+			callback(read_blocks(first_block, block_count, buffer));
+			return {};
+		}
+		virtual BAN::ErrorOr<void> submit_write_blocks(uint64_t first_block, size_t block_count, BAN::ConstByteSpan buffer, completion_callback_t callback)
+		{
+			callback(write_blocks(first_block, block_count, buffer));
+			return {};
+		}
+
+		// Versions of read_blocks and write_blocks that transfer straight between the
+		// buffer and the device, without populating the device's cache. Cached copies
+		// of the blocks are kept coherent. By default devices have no cache.
+		virtual BAN::ErrorOr<void> read_blocks_direct(uint64_t first_block, size_t block_count, BAN::ByteSpan buffer)		{ return read_blocks(first_block, block_count, buffer); }
+		virtual BAN::ErrorOr<void> write_blocks_direct(uint64_t first_block, size_t block_count, BAN::ConstByteSpan buffer)	{ return write_blocks(first_block, block_count, buffer); }
+
+		// Writes cached dirty blocks of the range to the device
+		virtual BAN::ErrorOr<void> sync_blocks(uint64_t first_block, size_t block_count) { (void)first_block; (void)block_count; return {}; }
+
 		virtual blksize_t blksize() const = 0;
 
 	protected:
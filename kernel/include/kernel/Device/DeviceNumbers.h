@@ -19,6 +19,8 @@ namespace Kernel
 		NVMeNamespace,
 		Ethernet,
 		TmpFS,
+		VirtIOBlock,
+		RamDisk,
 	};
 
 }
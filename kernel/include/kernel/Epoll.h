@@ -0,0 +1,108 @@
+#pragma once
+
+#include <BAN/HashMap.h>
+#include <BAN/Span.h>
+#include <BAN/UniqPtr.h>
+#include <kernel/FS/Inode.h>
+#include <kernel/Semaphore.h>
+
+#include <sys/epoll.h>
+
+namespace Kernel
+{
+
+	// Interest set of an epoll file descriptor. Every watched inode has a waiter that
+	// queues its interest to the ready list when the inode notifies a readiness change,
+	// so waiting only has to look at interests that may have become ready.
+	//
+	// Interests are keyed by file descriptor and keep a reference to their inode.
+	// Closing a file descriptor removes its interests from the epolls open in the
+	// same descriptor set. An interest left behind by a close in another set is
+	// replaced when a different file is added with the same file descriptor.
+	//
+	// Epolls can watch other epolls. Adding an interest that would create a cycle
+	// or nest epolls too deep fails with ELOOP.
+	class Epoll final : public Inode
+	{
+	public:
+		static BAN::ErrorOr<BAN::RefPtr<Epoll>> create();
+		~Epoll();
+
+		// inode is not used for EPOLL_CTL_DEL and may be null
+		BAN::ErrorOr<void> ctl(int op, int fd, BAN::RefPtr<Inode> inode, epoll_event event);
+		// Removes the interest of fd if it watches inode
+		void remove_closed_fd(int fd, Inode& inode);
+
+		// Fills events with ready interests, does not block
+		BAN::ErrorOr<size_t> collect_events(BAN::Span<epoll_event> events);
+		// Blocks until an interest may have become ready, wake_time_ms passes or a signal arrives
+		BAN::ErrorOr<void> wait_for_events(uint64_t wake_time_ms);
+
+		virtual bool is_epoll() const override { return true; }
+
+		virtual ino_t ino() const override { return 0; }
+		virtual Mode mode() const override { return { Mode::IRUSR | Mode::IWUSR }; }
+		virtual nlink_t nlink() const override { return 0; }
+		virtual uid_t uid() const override { return 0; }
+		virtual gid_t gid() const override { return 0; }
+		virtual off_t size() const override { return 0; }
+		virtual timespec atime() const override { return {}; }
+		virtual timespec mtime() const override { return {}; }
+		virtual timespec ctime() const override { return {}; }
+		virtual blksize_t blksize() const override { return PAGE_SIZE; }
+		virtual blkcnt_t blocks() const override { return 0; }
+		virtual dev_t dev() const override { return 0; }
+		virtual dev_t rdev() const override { return 0; }
+
+	protected:
+		virtual bool can_read_impl() const override;
+		virtual bool can_write_impl() const override { return false; }
+		virtual bool has_error_impl() const override { return false; }
+
+	private:
+		Epoll() = default;
+
+		struct Interest final : public Inode::Waiter
+		{
+			virtual void notify() override { epoll->queue_ready(*this, true); }
+
+			Epoll* epoll { nullptr };
+			BAN::RefPtr<Inode> inode;
+			epoll_event event {};
+
+			// Protected by m_ready_lock
+			bool disabled { false };
+			bool queued { false };
+			Interest* ready_prev { nullptr };
+			Interest* ready_next { nullptr };
+		};
+
+		void queue_ready(Interest&, bool wake_up);
+		// m_ready_lock has to be locked
+		void unlink_ready(Interest&);
+		void remove_interest(Interest&);
+
+		// These must be called with s_nesting_mutex locked
+		void unlink_nesting(Epoll& child);
+		BAN::ErrorOr<void> check_nesting(const Epoll& child) const;
+		bool watches_transitively(const Epoll&) const;
+		size_t nesting_depth_above() const;
+		size_t nesting_depth_below() const;
+		static uint32_t ready_events_of(Interest&);
+
+	private:
+		BAN::HashMap<int, BAN::UniqPtr<Interest>> m_interests;
+
+		SpinLock m_ready_lock;
+		Interest* m_ready_head { nullptr };
+		Interest* m_ready_tail { nullptr };
+		size_t m_ready_count { 0 };
+
+		Semaphore m_semaphore;
+
+		// Epolls watching this and epolls watched by this, protected by s_nesting_mutex
+		BAN::Vector<Epoll*> m_parent_epolls;
+		BAN::Vector<Epoll*> m_child_epolls;
+	};
+
+}
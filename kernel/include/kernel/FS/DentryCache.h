@@ -0,0 +1,69 @@
+#pragma once
+
+#include <BAN/Hash.h>
+#include <BAN/Optional.h>
+#include <BAN/RefPtr.h>
+#include <BAN/String.h>
+#include <kernel/Lock/Mutex.h>
+
+#include <sys/types.h>
+
+namespace Kernel
+{
+
+	class Inode;
+
+	// Cache of directory lookups keyed by (parent inode, name). Entries without an
+	// inode remember that the name does not exist. Only directories that return true
+	// from Inode::has_dentry_cache() are cached. Inode::create_file, create_directory
+	// and unlink invalidate the entries of the names they modify.
+	class DentryCache
+	{
+		BAN_NON_COPYABLE(DentryCache);
+		BAN_NON_MOVABLE(DentryCache);
+
+	public:
+		static void initialize();
+		static DentryCache& get();
+
+		// Returns empty optional on a miss and null inode on a negative entry
+		BAN::Optional<BAN::RefPtr<Inode>> lookup(const Inode& parent, BAN::StringView name);
+		void insert(const Inode& parent, BAN::StringView name, BAN::RefPtr<Inode> inode);
+		void invalidate(const Inode& parent, BAN::StringView name);
+
+	private:
+		DentryCache() = default;
+
+		struct Entry
+		{
+			dev_t dev;
+			ino_t parent_ino;
+			BAN::hash_t hash;
+			BAN::String name;
+			BAN::RefPtr<Inode> inode;
+
+			Entry* hash_next { nullptr };
+			Entry* lru_prev { nullptr };
+			Entry* lru_next { nullptr };
+		};
+
+		static BAN::hash_t hash_of(dev_t, ino_t, BAN::StringView);
+		Entry* find_entry(dev_t, ino_t, BAN::hash_t, BAN::StringView);
+
+		// Removes entry from the hash table and the lru list without freeing it
+		void remove_entry(Entry*);
+		void lru_remove(Entry*);
+		void lru_push_front(Entry*);
+
+	private:
+		static constexpr size_t s_bucket_count = 1024;
+		static constexpr size_t s_max_entries = 4096;
+
+		Mutex m_mutex;
+		Entry* m_buckets[s_bucket_count] {};
+		Entry* m_lru_head { nullptr };
+		Entry* m_lru_tail { nullptr };
+		size_t m_entry_count { 0 };
+	};
+
+}
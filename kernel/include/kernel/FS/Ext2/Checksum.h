@@ -0,0 +1,15 @@
+#pragma once
+
+#include <BAN/ByteSpan.h>
+
+namespace Kernel::Ext2
+{
+
+	// CRC32C used by METADATA_CSUM. Like Linux's crc32c(), the crc is neither
+	// inverted on input nor on output, so results can be chained.
+	uint32_t crc32c(uint32_t crc, BAN::ConstByteSpan);
+
+	// CRC16 (ANSI) used by GDT_CSUM block group descriptor checksums
+	uint16_t crc16(uint16_t crc, BAN::ConstByteSpan);
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace Kernel::Ext2
@@ -49,7 +50,7 @@ namespace Kernel::Ext2
 		// -- Performance Hints --
 		uint8_t s_prealloc_blocks;
 		uint8_t s_prealloc_dir_blocks;
-		uint16_t __alignment;
+		uint16_t reserved_gdt_blocks;
 
 		// -- Journaling Support --
 		uint8_t  journal_uuid[16];
@@ -60,12 +61,41 @@ namespace Kernel::Ext2
 		// -- Directory Indexing Support --
 		uint32_t hash_seed[4];
 		uint8_t  def_hash_version;
-		uint8_t  __padding[3];
+		uint8_t  jnl_backup_type;
+		uint16_t desc_size;
 
 		// -- Other options --
 		uint32_t default_mount_options;
 		uint32_t first_meta_bg;
+
+		// -- Ext4 --
+		uint32_t mkfs_time;
+		uint32_t jnl_blocks[17];
+		uint32_t blocks_count_hi;
+		uint32_t r_blocks_count_hi;
+		uint32_t free_blocks_count_hi;
+		uint16_t min_extra_isize;
+		uint16_t want_extra_isize;
+		uint32_t flags;
+		uint16_t raid_stride;
+		uint16_t mmp_interval;
+		uint64_t mmp_block;
+		uint32_t raid_stripe_width;
+		uint8_t  log_groups_per_flex;
+		uint8_t  checksum_type;
+		uint16_t __reserved_pad;
+		uint64_t kbytes_written;
+		uint8_t  __unused0[0xF0];
+		uint32_t checksum_seed;
+		uint8_t  __unused1[0x188];
+		uint32_t checksum;
 	};
+	static_assert(offsetof(Superblock, desc_size) == 0xFE);
+	static_assert(offsetof(Superblock, blocks_count_hi) == 0x150);
+	static_assert(offsetof(Superblock, kbytes_written) == 0x178);
+	static_assert(offsetof(Superblock, checksum_seed) == 0x270);
+	static_assert(offsetof(Superblock, checksum) == 0x3FC);
+	static_assert(sizeof(Superblock) == 1024);
 
 	struct BlockGroupDescriptor
 	{
@@ -75,9 +105,33 @@ namespace Kernel::Ext2
 		uint16_t free_blocks_count;
 		uint16_t free_inodes_count;
 		uint16_t used_dirs_count;
-		uint8_t __padding[2];
-		uint8_t __reserved[12];
+		uint16_t flags;
+		uint32_t exclude_bitmap;
+		uint16_t block_bitmap_csum;
+		uint16_t inode_bitmap_csum;
+		uint16_t itable_unused;
+		uint16_t checksum;
+	};
+	static_assert(sizeof(BlockGroupDescriptor) == 32);
+
+	// With FEATURE_INCOMPAT_64BIT descriptors are superblock.desc_size bytes, the high
+	// halves follow the 32 byte descriptor. They are required to be zero.
+	struct BlockGroupDescriptor64
+	{
+		BlockGroupDescriptor lo;
+		uint32_t block_bitmap_hi;
+		uint32_t inode_bitmap_hi;
+		uint32_t inode_table_hi;
+		uint16_t free_blocks_count_hi;
+		uint16_t free_inodes_count_hi;
+		uint16_t used_dirs_count_hi;
+		uint16_t itable_unused_hi;
+		uint32_t exclude_bitmap_hi;
+		uint16_t block_bitmap_csum_hi;
+		uint16_t inode_bitmap_csum_hi;
+		uint32_t __reserved;
 	};
+	static_assert(sizeof(BlockGroupDescriptor64) == 64);
 
 	struct Inode
 	{
@@ -101,6 +155,81 @@ namespace Kernel::Ext2
 		uint32_t osd2[3];
 	};
 
+	// Checksum fields of inodes are outside of Inode. The low half is in osd2,
+	// the high half follows extra_isize if inode_size and extra_isize allow it.
+	constexpr size_t INODE_CHECKSUM_LO_OFFSET = 0x7C;
+	constexpr size_t INODE_EXTRA_ISIZE_OFFSET = 0x80;
+	constexpr size_t INODE_CHECKSUM_HI_OFFSET = 0x82;
+	// Size of the fields following Inode that are defined by ext4
+	constexpr uint16_t INODE_EXTRA_ISIZE = 32;
+
+	// Ext4 extent tree, stored in Inode::block when EXTENTS_FL is set
+	struct ExtentHeader
+	{
+		uint16_t magic;
+		uint16_t entries;
+		uint16_t max;
+		uint16_t depth;
+		uint32_t generation;
+	};
+
+	struct ExtentIndex
+	{
+		uint32_t block;
+		uint32_t leaf_lo;
+		uint16_t leaf_hi;
+		uint16_t __unused;
+	};
+
+	struct Extent
+	{
+		uint32_t block;
+		uint16_t len;
+		uint16_t start_hi;
+		uint32_t start_lo;
+	};
+
+	// Follows the last possible entry of extent tree blocks with METADATA_CSUM
+	struct ExtentTail
+	{
+		uint32_t checksum;
+	};
+
+	static_assert(sizeof(ExtentHeader) == 12);
+	static_assert(sizeof(ExtentIndex) == 12);
+	static_assert(sizeof(Extent) == 12);
+
+	// Hashed directory index (htree). The root is in the first directory block after
+	// the "." and ".." entries, other index nodes are in blocks that look empty.
+	struct DxRootInfo
+	{
+		uint32_t reserved_zero;
+		uint8_t hash_version;
+		uint8_t info_length;
+		uint8_t indirect_levels;
+		uint8_t unused_flags;
+	};
+
+	// Overlays the hash of the first entry in an index node
+	struct DxCountLimit
+	{
+		uint16_t limit;
+		uint16_t count;
+	};
+
+	struct DxEntry
+	{
+		uint32_t hash;
+		uint32_t block;
+	};
+
+	// Follows the last possible entry of index nodes with METADATA_CSUM
+	struct DxTail
+	{
+		uint32_t reserved;
+		uint32_t checksum;
+	};
+
 	struct LinkedDirectoryEntry
 	{
 		uint32_t inode;
@@ -110,6 +239,17 @@ namespace Kernel::Ext2
 		char name[0];
 	};
 
+	// Last 12 bytes of directory blocks with METADATA_CSUM, looks like an unused entry
+	struct DirectoryEntryTail
+	{
+		uint32_t reserved_zero1;
+		uint16_t rec_len;
+		uint8_t reserved_zero2;
+		uint8_t reserved_file_type;
+		uint32_t checksum;
+	};
+	static_assert(sizeof(DirectoryEntryTail) == 12);
+
 	namespace Enum
 	{
 
@@ -166,6 +306,16 @@ namespace Kernel::Ext2
 			FEATURE_INCOMPAT_RECOVER		= 0x0004,
 			FEATURE_INCOMPAT_JOURNAL_DEV	= 0x0008,
 			FEATURE_INCOMPAT_META_BG		= 0x0010,
+			FEATURE_INCOMPAT_EXTENTS		= 0x0040,
+			FEATURE_INCOMPAT_64BIT			= 0x0080,
+			FEATURE_INCOMPAT_MMP			= 0x0100,
+			FEATURE_INCOMPAT_FLEX_BG		= 0x0200,
+			FEATURE_INCOMPAT_EA_INODE		= 0x0400,
+			FEATURE_INCOMPAT_DIRDATA		= 0x1000,
+			FEATURE_INCOMPAT_CSUM_SEED		= 0x2000,
+			FEATURE_INCOMPAT_LARGEDIR		= 0x4000,
+			FEATURE_INCOMPAT_INLINE_DATA	= 0x8000,
+			FEATURE_INCOMPAT_ENCRYPT		= 0x10000,
 		};
 
 		enum FeaturesRoCompat
@@ -173,8 +323,45 @@ namespace Kernel::Ext2
 			FEATURE_RO_COMPAT_SPARSE_SUPER	= 0x0001,
 			FEATURE_RO_COMPAT_LARGE_FILE	= 0x0002,
 			FEATURE_RO_COMPAT_BTREE_DIR		= 0x0004,
+			FEATURE_RO_COMPAT_HUGE_FILE		= 0x0008,
+			FEATURE_RO_COMPAT_GDT_CSUM		= 0x0010,
+			FEATURE_RO_COMPAT_DIR_NLINK		= 0x0020,
+			FEATURE_RO_COMPAT_EXTRA_ISIZE	= 0x0040,
+			FEATURE_RO_COMPAT_QUOTA			= 0x0100,
+			FEATURE_RO_COMPAT_BIGALLOC		= 0x0200,
+			FEATURE_RO_COMPAT_METADATA_CSUM	= 0x0400,
+		};
+
+		constexpr uint8_t CHECKSUM_TYPE_CRC32C = 1;
+		constexpr uint8_t DIRECTORY_TAIL_FILE_TYPE = 0xDE;
+
+		enum BlockGroupFlags
+		{
+			BG_INODE_UNINIT	= 0x0001,
+			BG_BLOCK_UNINIT	= 0x0002,
+			BG_INODE_ZEROED	= 0x0004,
+		};
+
+		enum SuperblockFlags
+		{
+			FLAGS_SIGNED_HASH	= 0x0001,
+			FLAGS_UNSIGNED_HASH	= 0x0002,
+		};
+
+		enum DxHashVersion
+		{
+			DX_HASH_LEGACY				= 0,
+			DX_HASH_HALF_MD4			= 1,
+			DX_HASH_TEA					= 2,
+			DX_HASH_LEGACY_UNSIGNED		= 3,
+			DX_HASH_HALF_MD4_UNSIGNED	= 4,
+			DX_HASH_TEA_UNSIGNED		= 5,
 		};
 
+		constexpr uint16_t EXTENT_MAGIC = 0xF30A;
+		// Extents longer than this are preallocated but uninitialized, and read as zeros
+		constexpr uint16_t EXTENT_MAX_INIT_LEN = 32768;
+
 		enum AlgoBitmap
 		{
 			LZV1_ALG	= 0,
@@ -242,6 +429,9 @@ namespace Kernel::Ext2
 			INDEX_FL		= 0x00001000,
 			IMAGIC_FL		= 0x00002000,
 			JOURNAL_DATA_FL	= 0x00004000,
+			HUGE_FILE_FL	= 0x00040000,
+			EXTENTS_FL		= 0x00080000,
+			INLINE_DATA_FL	= 0x10000000,
 			RESERVED_FL		= 0x80000000,
 		};
 
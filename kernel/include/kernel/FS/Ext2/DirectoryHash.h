@@ -0,0 +1,13 @@
+#pragma once
+
+#include <BAN/Optional.h>
+#include <BAN/StringView.h>
+
+namespace Kernel::Ext2
+{
+
+	// Hash used by the htree directory index. hash_version is one of the DX_HASH_* values
+	// with unsigned variants already applied. Returned hash always has the lowest bit cleared.
+	BAN::Optional<uint32_t> directory_hash(BAN::StringView name, uint8_t hash_version, const uint32_t seed[4]);
+
+}
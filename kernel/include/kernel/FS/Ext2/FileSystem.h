@@ -1,32 +1,41 @@
 #pragma once
 
+#include <BAN/Array.h>
 #include <BAN/HashMap.h>
 #include <kernel/Device/Device.h>
 #include <kernel/FS/FileSystem.h>
 #include <kernel/FS/Ext2/Inode.h>
+#include <kernel/Semaphore.h>
 
 namespace Kernel
 {
 
 	class Ext2FS final : public FileSystem
 	{
+	private:
+		struct BlockBuffer;
+		class BlockCache;
+
 	public:
 		class BlockBufferWrapper
 		{
 			BAN_NON_COPYABLE(BlockBufferWrapper);
-			BAN_NON_MOVABLE(BlockBufferWrapper);
 
 		public:
-			BlockBufferWrapper(BAN::Span<uint8_t> buffer, bool& used)
-				: m_buffer(buffer)
-				, m_used(used)
-			{
-				ASSERT(m_used);
-			}
-			~BlockBufferWrapper()
+			BlockBufferWrapper(BlockCache& cache, BlockBuffer& block_buffer, BAN::ByteSpan buffer)
+				: m_cache(&cache)
+				, m_block_buffer(&block_buffer)
+				, m_buffer(buffer)
+			{ }
+			BlockBufferWrapper(BlockBufferWrapper&& other)
+				: m_cache(other.m_cache)
+				, m_block_buffer(other.m_block_buffer)
+				, m_buffer(other.m_buffer)
 			{
-				m_used = false;
+				other.m_block_buffer = nullptr;
 			}
+			BlockBufferWrapper& operator=(BlockBufferWrapper&&) = delete;
+			~BlockBufferWrapper();
 
 			size_t size() const { return m_buffer.size(); }
 
@@ -34,16 +43,19 @@ namespace Kernel
 			const uint8_t* data() const { return m_buffer.data(); }
 
 			BAN::ByteSpan span() { return m_buffer; }
-			BAN::ConstByteSpan span() const { return m_buffer.as_const(); }
+			BAN::ConstByteSpan span() const { return m_buffer; }
 
 			uint8_t& operator[](size_t index) { return m_buffer[index]; }
 			uint8_t operator[](size_t index) const { return m_buffer[index]; }
 
 		private:
-			BAN::Span<uint8_t> m_buffer;
-			bool& m_used;
+			BlockCache* m_cache;
+			BlockBuffer* m_block_buffer;
+			BAN::ByteSpan m_buffer;
 		};
 
+		using PreallocationWindow = Ext2PreallocationWindow;
+
 	public:
 		static BAN::ErrorOr<bool> probe(BAN::RefPtr<BlockDevice>);
 		static BAN::ErrorOr<BAN::RefPtr<Ext2FS>> create(BAN::RefPtr<BlockDevice>);
@@ -58,20 +70,46 @@ namespace Kernel
 		{}
 
 		BAN::ErrorOr<void> initialize_superblock();
+		BAN::ErrorOr<void> initialize_block_groups();
 		BAN::ErrorOr<void> initialize_root_inode();
 
-		BAN::ErrorOr<uint32_t> create_inode(const Ext2::Inode&);
+		// parent_ino is the directory the new inode will be linked to
+		BAN::ErrorOr<uint32_t> create_inode(const Ext2::Inode&, uint32_t parent_ino);
+		BAN::ErrorOr<uint32_t> allocate_inode(bool is_directory, uint32_t parent_ino);
 		void delete_inode(uint32_t ino);
 		BAN::ErrorOr<void> resize_inode(uint32_t, size_t);
 
+		// Single block transfers go through the block cache
 		void read_block(uint32_t, BlockBufferWrapper&);
 		void write_block(uint32_t, const BlockBufferWrapper&);
+		void read_block(uint32_t, BAN::ByteSpan);
+		void write_block(uint32_t, BAN::ConstByteSpan);
+
+		// Transfer physically contiguous blocks with a single device request, bypassing the block cache
+		BAN::ErrorOr<void> read_blocks(uint32_t first_block, uint32_t block_count, BAN::ByteSpan);
+		BAN::ErrorOr<void> write_blocks(uint32_t first_block, uint32_t block_count, BAN::ConstByteSpan);
+		// Same as above, but also bypassing the block device's cache
+		BAN::ErrorOr<void> read_blocks_direct(uint32_t first_block, uint32_t block_count, BAN::ByteSpan);
+		BAN::ErrorOr<void> write_blocks_direct(uint32_t first_block, uint32_t block_count, BAN::ConstByteSpan);
+		// Writes cached dirty contents of the blocks to the device
+		BAN::ErrorOr<void> sync_blocks(uint32_t first_block, uint32_t block_count);
 		void sync_superblock();
 
-		BlockBufferWrapper get_block_buffer();
+		BAN::ErrorOr<BlockBufferWrapper> get_block_buffer();
+		// For paths that cannot fail, waits for a buffer to be released when out of memory
+		BlockBufferWrapper get_block_buffer_blocking();
 
-		BAN::ErrorOr<uint32_t> reserve_free_block(uint32_t primary_bgd);
+		// Takes the next block from window if one is given. When the window runs out, a free block
+		// is searched starting from goal_block (or primary_bgd) and a new window is reserved after it.
+		BAN::ErrorOr<uint32_t> reserve_free_block(uint32_t primary_bgd, PreallocationWindow* window = nullptr, uint32_t goal_block = 0);
 		void release_block(uint32_t block);
+		void release_preallocation_window(PreallocationWindow&);
+
+		// Allocation only updates the in-memory bitmaps, block group descriptors and superblock.
+		// This writes the modified ones to disk, and must not be called with m_mutex locked.
+		void sync_metadata();
+		// Writes the superblock, block group descriptors and bitmaps from the device's cache to the device
+		BAN::ErrorOr<void> sync_metadata_blocks();
 
 		BAN::HashMap<ino_t, BAN::RefPtr<Ext2Inode>>& inode_cache() { return m_inode_cache; }
 
@@ -86,28 +124,135 @@ namespace Kernel
 		BlockLocation locate_block_group_descriptior(uint32_t);
 
 		uint32_t block_size() const { return 1024 << superblock().log_block_size; }
+		bool is_read_only() const { return m_read_only; }
+
+		bool has_metadata_checksums() const { return m_superblock.feature_ro_compat & Ext2::Enum::FEATURE_RO_COMPAT_METADATA_CSUM; }
+		bool has_group_descriptor_checksums() const { return m_superblock.feature_ro_compat & (Ext2::Enum::FEATURE_RO_COMPAT_GDT_CSUM | Ext2::Enum::FEATURE_RO_COMPAT_METADATA_CSUM); }
+
+		// Seed for the checksums of blocks owned by an inode
+		uint32_t inode_checksum_seed(uint32_t ino, uint32_t generation) const;
+		// raw_inode contains the whole on disk inode of inode_size bytes
+		void update_inode_checksum(uint32_t ino, BAN::ByteSpan raw_inode) const;
+		// These must be called with m_mutex locked
+		void update_superblock_checksum();
+		void update_block_group_descriptor_checksum(uint32_t group);
+		void update_bitmap_checksum(uint32_t group, BAN::ConstByteSpan bitmap, bool is_inode_bitmap);
+
+		struct BlockGroup
+		{
+			// empty until first needed
+			BAN::Vector<uint64_t> block_bitmap;
+			// blocks in preallocation windows
+			BAN::Vector<uint64_t> reserved_blocks;
+			// empty until first needed
+			BAN::Vector<uint64_t> inode_bitmap;
+			bool block_bitmap_dirty { false };
+			bool inode_bitmap_dirty { false };
+			bool descriptor_dirty { false };
+		};
+
+		uint32_t block_group_count() const { return m_block_groups.size(); }
+		uint32_t blocks_in_block_group(uint32_t group) const;
+		Ext2::BlockGroupDescriptor& block_group_descriptor(uint32_t group);
+		void initialize_uninit_block_bitmap(uint32_t group, BAN::Vector<uint64_t>& block_bitmap);
+		BAN::ErrorOr<BlockGroup&> load_block_bitmap(uint32_t group);
+		BAN::ErrorOr<BlockGroup&> load_inode_bitmap(uint32_t group);
+		void mark_block_group_dirty(uint32_t group);
+
+		BAN::Optional<uint32_t> find_free_block_in_group(const BlockGroup&, uint32_t first, uint32_t last, bool skip_reserved) const;
+		void mark_block_used(uint32_t group, uint32_t offset);
+		void create_preallocation_window(PreallocationWindow&, uint32_t group, uint32_t first_offset);
+
+		BAN::Optional<uint32_t> find_group_for_directory(uint32_t parent_group, bool parent_is_root);
+		BAN::Optional<uint32_t> find_group_for_file(uint32_t parent_group);
 
-		class BlockBufferManager
+		struct BlockBuffer
 		{
+			uint8_t* data { nullptr };
+			uint32_t ref_count { 0 };
+
+			// cached buffers are indexed by block and hold its contents
+			uint32_t block { 0 };
+			bool cached { false };
+			// contents are still being read from the device
+			bool loading { false };
+			// block was written while loading, contents must not be cached
+			bool stale { false };
+
+			// unreferenced cached buffers, most recently used first
+			BlockBuffer* lru_prev { nullptr };
+			BlockBuffer* lru_next { nullptr };
+		};
+
+		// Write-through cache of single blocks, indexed by block number. Scratch buffers
+		// come from the same memory, so the cache gives up blocks when memory runs out.
+		// Writes to the same block must be serialized by the caller.
+		class BlockCache
+		{
+			BAN_NON_COPYABLE(BlockCache);
+			BAN_NON_MOVABLE(BlockCache);
+
 		public:
-			BlockBufferManager() = default;
-			BlockBufferWrapper get_buffer();
+			BlockCache() = default;
+			~BlockCache();
+
+			BAN::ErrorOr<void> initialize(BlockDevice&, uint32_t block_size);
+
+			BAN::ErrorOr<BlockBufferWrapper> get_buffer();
+			BlockBufferWrapper get_buffer_blocking();
+			void release_buffer(BlockBuffer&);
+
+			BAN::ErrorOr<void> read_block(uint32_t block, BAN::ByteSpan);
+			BAN::ErrorOr<void> write_block(uint32_t block, BAN::ConstByteSpan);
 
-			BAN::ErrorOr<void> initialize(size_t block_size);
+			// Drops cached copies of blocks that were written without the cache
+			void invalidate(uint32_t first_block, uint32_t block_count);
 
 		private:
-			struct BlockBuffer
-			{
-				BAN::Vector<uint8_t> buffer;
-				bool used { false };
-			};
+			// These must be called with m_mutex locked
+			BlockBuffer* take_scratch_buffer();
+			BlockBuffer* allocate_buffer();
+			// Keeps the buffer for reuse or frees it if there are enough free buffers
+			void free_buffer(BlockBuffer*);
+			void destroy_buffer(BlockBuffer*);
+			BlockBuffer* take_cache_buffer(uint32_t block);
+			void uncache(BlockBuffer&);
+			void lru_push_front(BlockBuffer&);
+			void lru_remove(BlockBuffer&);
 
 		private:
-			BAN::Array<BlockBuffer, 10> m_buffers;
+			// NOTE: buffers come from kmalloc, which is shared by the whole kernel
+			static constexpr size_t s_max_cached_bytes = 256 * 1024;
+			static constexpr size_t s_max_free_buffers = 16;
+
+			Mutex m_mutex;
+
+			BlockDevice* m_block_device { nullptr };
+			uint32_t m_block_size { 0 };
+			uint32_t m_sectors_per_block { 0 };
+
+			BAN::HashMap<uint32_t, BlockBuffer*> m_cached_blocks;
+			size_t m_max_cached_blocks { 0 };
+			BlockBuffer* m_lru_head { nullptr };
+			BlockBuffer* m_lru_tail { nullptr };
+
+			BAN::Vector<BlockBuffer*> m_free_buffers;
+
+			// Threads in get_buffer_blocking() wait on this for buffers to be released
+			Semaphore m_buffer_semaphore;
+			size_t m_buffer_waiters { 0 };
 		};
 
+		Mutex& inode_table_lock(uint32_t ino) { return m_inode_table_locks[(ino - 1) / superblock().inodes_per_group % m_inode_table_locks.size()]; }
+
 	private:
+		// Protects allocation state: bitmaps, descriptors and the superblock
 		Mutex m_mutex;
+		// Serializes writing of dirty metadata, so older contents never overwrite newer ones
+		Mutex m_metadata_sync_mutex;
+		// Serializes read-modify-write of inode table blocks, shared by the block groups that map to the same lock
+		BAN::Array<Mutex, 16> m_inode_table_locks;
+		Mutex m_inode_cache_mutex;
 
 		BAN::RefPtr<BlockDevice> m_block_device;
 
@@ -116,9 +261,22 @@ namespace Kernel
 
 		BAN::HashMap<ino_t, BAN::RefPtr<Ext2Inode>> m_inode_cache;
 
-		BlockBufferManager m_buffer_manager;
+		BlockCache m_block_cache;
 
 		Ext2::Superblock m_superblock;
+		bool m_superblock_dirty { false };
+		bool m_read_only { false };
+		// Initial crc32c value of all metadata checksums
+		uint32_t m_checksum_seed { 0 };
+
+		// raw block group descriptor table
+		BAN::Vector<uint8_t> m_bgd_table;
+		uint32_t m_bgd_size { sizeof(Ext2::BlockGroupDescriptor) };
+		BAN::Vector<BlockGroup> m_block_groups;
+		// oldest first, limited to s_max_preallocation_windows
+		BAN::Vector<PreallocationWindow*> m_preallocation_windows;
+		// top level directories are spread starting from this group
+		uint32_t m_next_top_level_group { 0 };
 
 		friend class Ext2Inode;
 		friend class BAN::RefPtr<Ext2FS>;
@@ -2,6 +2,7 @@
 
 #include <BAN/String.h>
 #include <BAN/StringView.h>
+#include <BAN/Vector.h>
 #include <kernel/FS/Ext2/Definitions.h>
 #include <kernel/FS/Inode.h>
 
@@ -10,6 +11,14 @@ namespace Kernel
 
 	class Ext2FS;
 
+	// Blocks reserved in memory for the next allocations of an inode.
+	// Reservations are never written to disk.
+	struct Ext2PreallocationWindow
+	{
+		uint32_t first_block { 0 };
+		uint32_t block_count { 0 };
+	};
+
 	class Ext2Inode final : public Inode
 	{
 	public:
@@ -26,12 +35,16 @@ namespace Kernel
 		virtual timespec ctime() const override { return timespec { .tv_sec = m_inode.ctime, .tv_nsec = 0 }; }
 		virtual blksize_t blksize() const override;
 		virtual blkcnt_t blocks() const override;
-		virtual dev_t dev() const override { return 0; }
+		virtual dev_t dev() const override;
 		virtual dev_t rdev() const override { return 0; }
 
+		virtual bool has_dentry_cache() const override { return true; }
+		virtual bool has_page_cache() const override { return mode().ifreg(); }
+		virtual bool supports_direct_io() const override { return mode().ifreg(); }
+
 	protected:
 		virtual BAN::ErrorOr<BAN::RefPtr<Inode>> find_inode_impl(BAN::StringView) override;
-		virtual BAN::ErrorOr<size_t> list_next_inodes_impl(off_t, struct dirent*, size_t) override;
+		virtual BAN::ErrorOr<size_t> list_next_inodes_impl(off_t&, struct dirent*, size_t) override;
 		virtual BAN::ErrorOr<void> create_file_impl(BAN::StringView, mode_t, uid_t, gid_t) override;
 		virtual BAN::ErrorOr<void> create_directory_impl(BAN::StringView, mode_t, uid_t, gid_t) override;
 		virtual BAN::ErrorOr<void> unlink_impl(BAN::StringView) override;
@@ -42,6 +55,10 @@ namespace Kernel
 		virtual BAN::ErrorOr<size_t> write_impl(off_t, BAN::ConstByteSpan) override;
 		virtual BAN::ErrorOr<void> truncate_impl(size_t) override;
 		virtual BAN::ErrorOr<void> chmod_impl(mode_t) override;
+		virtual BAN::ErrorOr<size_t> read_direct_impl(off_t, BAN::ByteSpan) override;
+		virtual BAN::ErrorOr<size_t> write_direct_impl(off_t, BAN::ConstByteSpan) override;
+		virtual BAN::ErrorOr<void> fsync_impl(bool) override;
+		virtual BAN::ErrorOr<size_t> copy_file_range_impl(off_t, Inode&, off_t, size_t) override;
 
 		virtual bool can_read_impl() const override { return true; }
 		virtual bool can_write_impl() const override { return true; }
@@ -52,20 +69,91 @@ namespace Kernel
 		// NOTE: the inode might have more blocks than what this suggests if it has been shrinked
 		uint32_t max_used_data_block_count() const { return size() / blksize(); }
 
-		BAN::Optional<uint32_t> block_from_indirect_block(uint32_t block, uint32_t index, uint32_t depth);
+		// Physically contiguous run of data blocks
+		struct BlockMapping
+		{
+			uint32_t data_block;
+			uint32_t fs_block;
+			uint32_t block_count;
+		};
+
+		// Returns the mapping starting at data_block_index, empty for holes
+		BAN::Optional<BlockMapping> resolve_data_block(uint32_t data_block_index);
+		BAN::Optional<BlockMapping> resolve_from_indirect_block(uint32_t block, uint32_t data_block_index, uint32_t index, uint32_t depth);
+		BAN::Optional<BlockMapping> resolve_from_extent_tree(uint32_t data_block_index);
 		BAN::Optional<uint32_t> fs_block_of_data_block_index(uint32_t data_block_index);
 
+		BAN::Optional<BlockMapping> find_cached_mapping(uint32_t data_block_index) const;
+		void cache_block_mapping(BlockMapping);
+
 		BAN::ErrorOr<void> link_inode_to_directory(Ext2Inode&, BAN::StringView name);
 		BAN::ErrorOr<bool> is_directory_empty();
 
+		struct DirectoryEntryLocation
+		{
+			uint32_t data_block;
+			uint32_t offset;
+			uint32_t ino;
+		};
+
+		// Index nodes visited from the htree root to a leaf block
+		struct DirectoryIndexPath
+		{
+			struct Level
+			{
+				uint32_t data_block;
+				uint32_t index;
+			};
+			Level levels[3];
+			uint32_t level_count;
+			uint32_t leaf_block;
+			uint32_t hash;
+			uint8_t hash_version;
+		};
+
+		void read_directory_block(uint32_t data_block_index, BAN::ByteSpan);
+		// Updates the checksum tail of the block before writing it
+		void write_directory_block(uint32_t data_block_index, BAN::ByteSpan);
+		BAN::ErrorOr<uint32_t> append_directory_block();
+
+		// Leaf blocks end in a checksum tail with METADATA_CSUM, entries only use the space before it
+		uint32_t directory_leaf_size() const;
+		void initialize_directory_tail(BAN::ByteSpan block) const;
+		void update_directory_block_checksum(BAN::ByteSpan block) const;
+
+		BAN::ErrorOr<DirectoryEntryLocation> find_directory_entry(BAN::StringView name);
+		BAN::ErrorOr<void> add_linear_directory_entry(uint32_t entry_ino, uint8_t file_type, BAN::StringView name);
+		BAN::ErrorOr<void> add_indexed_directory_entry(uint32_t entry_ino, uint8_t file_type, BAN::StringView name);
+
+		bool uses_directory_index() const;
+		uint32_t directory_index_limit(bool is_root) const;
+		BAN::ErrorOr<bool> probe_directory_index(BAN::StringView name, DirectoryIndexPath&);
+		BAN::ErrorOr<bool> next_directory_index_leaf(DirectoryIndexPath&);
+		BAN::ErrorOr<bool> create_directory_index();
+		BAN::ErrorOr<void> split_directory_leaf(DirectoryIndexPath&);
+		BAN::ErrorOr<void> insert_directory_index_entry(DirectoryIndexPath&, uint32_t hash, uint32_t data_block_index);
+
 		void cleanup_indirect_block(uint32_t block, uint32_t depth);
 		BAN::ErrorOr<void> cleanup_default_links();
 		void cleanup_from_fs();
 
+		BAN::ErrorOr<uint32_t> reserve_block();
 		BAN::ErrorOr<uint32_t> allocate_new_block_to_indirect_block(uint32_t& block, uint32_t index, uint32_t depth);
 		BAN::ErrorOr<uint32_t> allocate_new_block(uint32_t data_block_index);
+
+		// Extent tree nodes are either the root in the inode or whole blocks, node block 0 is the root
+		void read_extent_node(uint32_t node_block, BAN::ByteSpan);
+		void write_extent_node(uint32_t node_block, BAN::ByteSpan);
+		BAN::ErrorOr<uint32_t> allocate_new_block_to_extent_tree(uint32_t data_block_index);
+		BAN::ErrorOr<void> grow_extent_tree();
+		BAN::ErrorOr<void> split_extent_node(uint32_t parent_block, uint32_t parent_index, uint32_t node_block);
+		void cleanup_extent_node(uint32_t node_block);
 		void sync();
 
+		// Write block mapping blocks of the inode from the device's cache to the device
+		BAN::ErrorOr<void> sync_indirect_block(uint32_t block, uint32_t depth);
+		BAN::ErrorOr<void> sync_extent_node(uint32_t node_block);
+
 		uint32_t block_group() const;
 
 	private:
@@ -81,6 +169,13 @@ namespace Kernel
 		Ext2::Inode m_inode;
 		const uint32_t m_ino;
 
+		// Allocation tries to continue right after the previously allocated block
+		Ext2PreallocationWindow m_preallocation;
+		uint32_t m_last_allocated_block { 0 };
+
+		// sorted by data_block, neighbouring runs are merged
+		BAN::Vector<BlockMapping> m_block_map_cache;
+
 		friend class Ext2FS;
 		friend class BAN::RefPtr<Ext2Inode>;
 	};
@@ -29,6 +29,9 @@ namespace Kernel
 
 		BAN::ErrorOr<BAN::RefPtr<FATInode>> open_inode(BAN::RefPtr<FATInode> parent, const FAT::DirectoryEntry& entry, uint32_t cluster_index, uint32_t entry_index);
 		BAN::ErrorOr<void> inode_read_cluster(BAN::RefPtr<FATInode>, size_t index, BAN::ByteSpan buffer);
+		// Reads at most count clusters starting from index, stopping at the first discontinuity.
+		// Returns the number of clusters read.
+		BAN::ErrorOr<size_t> inode_read_clusters(BAN::RefPtr<FATInode>, size_t index, size_t count, BAN::ByteSpan buffer);
 		blksize_t inode_block_size(BAN::RefPtr<const FATInode>) const;
 
 	private:
@@ -40,8 +43,20 @@ namespace Kernel
 		static bool validate_bpb(const FAT::BPB&);
 		BAN::ErrorOr<void> initialize();
 
-		BAN::ErrorOr<void> fat_cache_set_sector(uint32_t sector);
+		// Returns pointer to the cached FAT byte at offset, valid until m_mutex is released.
+		// Bytes are only guaranteed to be contiguous up to the end of the chunk.
+		BAN::ErrorOr<const uint8_t*> fat_cache_byte(uint32_t offset);
 		BAN::ErrorOr<uint32_t> get_next_cluster(uint32_t cluster);
+		BAN::ErrorOr<BAN::Vector<FATInode::ClusterRun>> read_cluster_chain(uint32_t first_cluster);
+
+		bool is_data_cluster(uint32_t cluster) const { return cluster >= 2 && cluster < cluster_count() + 2; }
+		uint32_t first_cluster_of(const FAT::DirectoryEntry& entry) const
+		{
+			uint32_t cluster = entry.first_cluster_lo;
+			if (m_type == Type::FAT32)
+				cluster |= static_cast<uint32_t>(entry.first_cluster_hi) << 16;
+			return cluster;
+		}
 
 		// TODO: These probably should be constant variables
 		uint32_t root_sector_count() const   { return BAN::Math::div_round_up<uint32_t>(m_bpb.root_entry_count * 32, m_bpb.bytes_per_sector); }
@@ -61,8 +76,18 @@ namespace Kernel
 
 		BAN::HashMap<ino_t, BAN::WeakPtr<FATInode>> m_inode_cache;
 
-		BAN::Vector<uint8_t> m_fat_two_sector_buffer;
-		uint32_t m_fat_sector_buffer_current { 0 };
+		// FAT is cached in chunks of s_fat_chunk_sectors sectors, least recently used chunk is replaced
+		struct FATCacheChunk
+		{
+			uint32_t index;
+			uint64_t last_used;
+			BAN::Vector<uint8_t> data;
+		};
+		static constexpr uint32_t s_fat_chunk_sectors = 16;
+		static constexpr size_t s_fat_cache_max_chunks = 64;
+		BAN::Vector<FATCacheChunk> m_fat_cache;
+		BAN::HashMap<uint32_t, size_t> m_fat_cache_slots;
+		uint64_t m_fat_cache_clock { 0 };
 
 		Mutex m_mutex;
 
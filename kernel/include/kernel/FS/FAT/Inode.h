@@ -2,6 +2,7 @@
 
 #include <BAN/Function.h>
 #include <BAN/Iteration.h>
+#include <BAN/Vector.h>
 #include <BAN/WeakPtr.h>
 
 #include <kernel/FS/FAT/Definitions.h>
@@ -26,14 +27,17 @@ namespace Kernel
 		virtual timespec ctime() const override;
 		virtual blksize_t blksize() const override;
 		virtual blkcnt_t blocks() const override { return m_block_count; }
-		virtual dev_t dev() const override { return 0; }
+		virtual dev_t dev() const override;
 		virtual dev_t rdev() const override { return 0; }
 
+		virtual bool has_dentry_cache() const override { return true; }
+		virtual bool has_page_cache() const override { return mode().ifreg(); }
+
 		const FAT::DirectoryEntry& entry() const { return m_entry; }
 
 	protected:
 		virtual BAN::ErrorOr<BAN::RefPtr<Inode>> find_inode_impl(BAN::StringView) override;
-		virtual BAN::ErrorOr<size_t> list_next_inodes_impl(off_t, struct dirent*, size_t) override;
+		virtual BAN::ErrorOr<size_t> list_next_inodes_impl(off_t&, struct dirent*, size_t) override;
 		//virtual BAN::ErrorOr<void> create_file_impl(BAN::StringView, mode_t, uid_t, gid_t) override;
 		//virtual BAN::ErrorOr<void> create_directory_impl(BAN::StringView, mode_t, uid_t, gid_t) override;
 		//virtual BAN::ErrorOr<void> unlink_impl(BAN::StringView) override;
@@ -42,20 +46,37 @@ namespace Kernel
 		//virtual BAN::ErrorOr<size_t> write_impl(off_t, BAN::ConstByteSpan) override;
 		//virtual BAN::ErrorOr<void> truncate_impl(size_t) override;
 		//virtual BAN::ErrorOr<void> chmod_impl(mode_t) override;
+		// file system is read-only, there is never anything to write
+		virtual BAN::ErrorOr<void> fsync_impl(bool) override { return {}; }
 
 		virtual bool can_read_impl() const override { return true; }
 		virtual bool can_write_impl() const override { return true; }
 		virtual bool has_error_impl() const override { return false; }
 
 	private:
-		FATInode(FATFS& fs, const FAT::DirectoryEntry& entry, ino_t ino, uint32_t block_count)
+		// Contiguous clusters of the file, starting from cluster file_index of the file
+		struct ClusterRun
+		{
+			uint32_t file_index;
+			uint32_t first_cluster;
+			uint32_t count;
+		};
+
+	private:
+		FATInode(FATFS& fs, const FAT::DirectoryEntry& entry, ino_t ino, BAN::Vector<ClusterRun>&& cluster_runs, uint32_t block_count)
 			: m_fs(fs)
 			, m_entry(entry)
 			, m_ino(ino)
+			, m_cluster_runs(BAN::move(cluster_runs))
 			, m_block_count(block_count)
 		{ }
 		~FATInode()	{}
 
+		// Returns the cluster at index of this file, or 0 if index is out of bounds.
+		// If contiguous is given, it is set to the number of clusters starting from
+		// the returned one that are contiguous on disk.
+		uint32_t cluster_at(uint32_t index, uint32_t* contiguous = nullptr) const;
+
 		BAN::ErrorOr<void> for_each_directory_entry(BAN::ConstByteSpan, BAN::Function<BAN::Iteration(const FAT::DirectoryEntry&)>);
 		BAN::ErrorOr<void> for_each_directory_entry(BAN::ConstByteSpan, BAN::Function<BAN::Iteration(const FAT::DirectoryEntry&, BAN::String, uint32_t)>);
 
@@ -63,9 +84,10 @@ namespace Kernel
 		FATFS& m_fs;
 		FAT::DirectoryEntry m_entry;
 		const ino_t m_ino;
+		const BAN::Vector<ClusterRun> m_cluster_runs;
 		uint32_t m_block_count;
 
-		friend class Ext2FS;
+		friend class FATFS;
 		friend class BAN::RefPtr<FATInode>;
 	};
 
@@ -4,12 +4,14 @@
 #include <BAN/RefPtr.h>
 #include <BAN/String.h>
 #include <BAN/StringView.h>
+#include <BAN/UniqPtr.h>
 #include <BAN/Vector.h>
-#include <BAN/WeakPtr.h>
 
 #include <kernel/Credentials.h>
 #include <kernel/Debug.h>
+#include <kernel/FS/PageCache.h>
 #include <kernel/Lock/Mutex.h>
+#include <kernel/Lock/SpinLock.h>
 
 #include <dirent.h>
 #include <sys/socket.h>
@@ -20,7 +22,6 @@ namespace Kernel
 {
 
 	class FileBackedRegion;
-	class SharedFileData;
 
 	class Inode : public BAN::RefCounted<Inode>
 	{
@@ -84,11 +85,26 @@ namespace Kernel
 
 		virtual bool is_device() const { return false; }
 		virtual bool is_pipe() const { return false; }
+		virtual bool is_epoll() const { return false; }
+		virtual bool is_ioring() const { return false; }
 		virtual bool is_tty() const { return false; }
 
+		// Directory lookups are cached in DentryCache. File systems that return true
+		// must only modify directories through create_file, create_directory and unlink.
+		virtual bool has_dentry_cache() const { return false; }
+
+		// Regular file data is cached in a PageCache. Inodes that return false only
+		// get a page cache when they are memory mapped, and reads of them don't populate it.
+		virtual bool has_page_cache() const { return false; }
+
+		// Files that return true can be opened with O_DIRECT
+		virtual bool supports_direct_io() const { return false; }
+
 		// Directory API
 		BAN::ErrorOr<BAN::RefPtr<Inode>> find_inode(BAN::StringView);
-		BAN::ErrorOr<size_t> list_next_inodes(off_t, struct dirent* list, size_t list_size);
+		// Fills list with as many entries as fit, starting from the directory position offset.
+		// Positions are opaque cookies, offset is advanced past the returned entries.
+		BAN::ErrorOr<size_t> list_next_inodes(off_t& offset, struct dirent* list, size_t list_size);
 		BAN::ErrorOr<void> create_file(BAN::StringView, mode_t, uid_t, gid_t);
 		BAN::ErrorOr<void> create_directory(BAN::StringView, mode_t, uid_t, gid_t);
 		BAN::ErrorOr<void> unlink(BAN::StringView);
@@ -103,26 +119,70 @@ namespace Kernel
 		BAN::ErrorOr<void> listen(int backlog);
 		BAN::ErrorOr<size_t> sendto(BAN::ConstByteSpan message, const sockaddr* address, socklen_t address_len);
 		BAN::ErrorOr<size_t> recvfrom(BAN::ByteSpan buffer, sockaddr* address, socklen_t* address_len);
+		BAN::ErrorOr<size_t> sendmsg(BAN::Span<const BAN::ConstByteSpan> message, const sockaddr* address, socklen_t address_len);
+		BAN::ErrorOr<size_t> recvmsg(BAN::Span<BAN::ByteSpan> buffers, sockaddr* address, socklen_t* address_len);
 		BAN::ErrorOr<void> getsockname(sockaddr* address, socklen_t* address_len);
 
 		// General API
 		BAN::ErrorOr<size_t> read(off_t, BAN::ByteSpan buffer);
 		BAN::ErrorOr<size_t> write(off_t, BAN::ConstByteSpan buffer);
+		// Transfers the buffers in order without releasing the inode in between,
+		// stops at the first short transfer
+		BAN::ErrorOr<size_t> readv(off_t, BAN::Span<BAN::ByteSpan> buffers, bool direct = false);
+		BAN::ErrorOr<size_t> writev(off_t, BAN::Span<const BAN::ConstByteSpan> buffers, bool direct = false);
+		// Transfers straight between the buffer and storage, bypassing all caches.
+		// Offset and size have to be multiples of blksize().
+		BAN::ErrorOr<size_t> read_direct(off_t, BAN::ByteSpan buffer);
+		BAN::ErrorOr<size_t> write_direct(off_t, BAN::ConstByteSpan buffer);
+		// Writes the file's data and the metadata needed to read it back to storage.
+		// If data_only is not set, rest of the metadata touched by the file is written too.
+		BAN::ErrorOr<void> fsync(bool data_only);
+		// Copies data to out, a regular file on the same file system, without going through
+		// the page caches. Both inodes are locked for the whole copy. May copy less than count,
+		// returns ENOTSUP if the file system can't do better than a read and write loop.
+		BAN::ErrorOr<size_t> copy_file_range(off_t, Inode& out, off_t out_offset, size_t count);
 		BAN::ErrorOr<void> truncate(size_t);
 		BAN::ErrorOr<void> chmod(mode_t);
 		BAN::ErrorOr<void> chown(uid_t, gid_t);
 
+		// Page cache API, only supported by regular files that have a page cache.
+		// Pinned pages are not dropped, every successful pin has to be paired with unpin_page.
+		BAN::ErrorOr<paddr_t> pin_page(size_t page_index);
+		void unpin_page(size_t page_index);
+
 		// Select/Non blocking API
 		bool can_read() const;
 		bool can_write() const;
 		bool has_error() const;
+		// Peer or every writer has closed, reported even if not requested
+		bool has_hungup() const;
+
+		// Threads in select and poll, and epoll instances, register a waiter to every
+		// inode they are waiting on. Waiters are notified whenever the inode's readiness
+		// may have changed. notify() is called with a spinlock held, possibly from an
+		// interrupt handler, so it must not block.
+		class Waiter
+		{
+		public:
+			virtual void notify() = 0;
+
+		private:
+			Waiter* m_prev { nullptr };
+			Waiter* m_next { nullptr };
+			friend class Inode;
+		};
+		void add_waiter(Waiter&);
+		void remove_waiter(Waiter&);
+
+		// Has to be called whenever can_read, can_write or has_error may have changed
+		void notify_waiters();
 
 		BAN::ErrorOr<long> ioctl(int request, void* arg);
 
 	protected:
 		// Directory API
 		virtual BAN::ErrorOr<BAN::RefPtr<Inode>> find_inode_impl(BAN::StringView)				{ return BAN::Error::from_errno(ENOTSUP); }
-		virtual BAN::ErrorOr<size_t> list_next_inodes_impl(off_t, struct dirent*, size_t)		{ return BAN::Error::from_errno(ENOTSUP); }
+		virtual BAN::ErrorOr<size_t> list_next_inodes_impl(off_t&, struct dirent*, size_t)		{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<void> create_file_impl(BAN::StringView, mode_t, uid_t, gid_t)		{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<void> create_directory_impl(BAN::StringView, mode_t, uid_t, gid_t)	{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<void> unlink_impl(BAN::StringView)									{ return BAN::Error::from_errno(ENOTSUP); }
@@ -138,6 +198,9 @@ namespace Kernel
 		virtual BAN::ErrorOr<size_t> sendto_impl(BAN::ConstByteSpan, const sockaddr*, socklen_t)	{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<size_t> recvfrom_impl(BAN::ByteSpan, sockaddr*, socklen_t*)			{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<void> getsockname_impl(sockaddr*, socklen_t*)							{ return BAN::Error::from_errno(ENOTSUP); }
+		// Default implementations gather the message to and scatter it from one kernel buffer
+		virtual BAN::ErrorOr<size_t> sendmsg_impl(BAN::Span<const BAN::ConstByteSpan>, const sockaddr*, socklen_t);
+		virtual BAN::ErrorOr<size_t> recvmsg_impl(BAN::Span<BAN::ByteSpan>, sockaddr*, socklen_t*);
 
 		// General API
 		virtual BAN::ErrorOr<size_t> read_impl(off_t, BAN::ByteSpan)		{ return BAN::Error::from_errno(ENOTSUP); }
@@ -145,11 +208,16 @@ namespace Kernel
 		virtual BAN::ErrorOr<void> truncate_impl(size_t)					{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<void> chmod_impl(mode_t)						{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<void> chown_impl(uid_t, gid_t)					{ return BAN::Error::from_errno(ENOTSUP); }
+		virtual BAN::ErrorOr<size_t> read_direct_impl(off_t, BAN::ByteSpan)			{ return BAN::Error::from_errno(EINVAL); }
+		virtual BAN::ErrorOr<size_t> write_direct_impl(off_t, BAN::ConstByteSpan)	{ return BAN::Error::from_errno(EINVAL); }
+		virtual BAN::ErrorOr<void> fsync_impl(bool)									{ return BAN::Error::from_errno(EINVAL); }
+		virtual BAN::ErrorOr<size_t> copy_file_range_impl(off_t, Inode&, off_t, size_t)	{ return BAN::Error::from_errno(ENOTSUP); }
 
 		// Select/Non blocking API
 		virtual bool can_read_impl() const = 0;
 		virtual bool can_write_impl() const = 0;
 		virtual bool has_error_impl() const = 0;
+		virtual bool has_hungup_impl() const { return false; }
 
 		virtual BAN::ErrorOr<long> ioctl_impl(int, void*) { return BAN::Error::from_errno(ENOTSUP); }
 
@@ -157,8 +225,18 @@ namespace Kernel
 		mutable PriorityMutex m_mutex;
 
 	private:
-		BAN::WeakPtr<SharedFileData> m_shared_region;
+		bool use_dentry_cache(BAN::StringView name) const;
+
+		// Creates the page cache if it does not exist, m_mutex has to be locked
+		BAN::ErrorOr<PageCache*> page_cache();
+
+	private:
+		SpinLock m_waiter_lock;
+		Waiter* m_waiters { nullptr };
+
+		BAN::UniqPtr<PageCache> m_page_cache;
 		friend class FileBackedRegion;
+		friend class PageCache;
 	};
 
 }
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <BAN/ByteSpan.h>
+#include <BAN/UniqPtr.h>
+#include <BAN/Vector.h>
+#include <kernel/Memory/Types.h>
+
+#include <sys/types.h>
+
+namespace Kernel
+{
+
+	class Inode;
+
+	// Pages of a single inode, shared by read, write and file backed memory
+	// mappings. Every function has to be called with the inode's mutex locked.
+	//
+	// Writes go through to the inode, so unmapped pages are always clean and
+	// can be dropped under memory pressure. Pages that are mapped are never
+	// dropped, file backed regions write them back on msync and unmap.
+	class PageCache
+	{
+		BAN_NON_COPYABLE(PageCache);
+		BAN_NON_MOVABLE(PageCache);
+
+	public:
+		static BAN::ErrorOr<BAN::UniqPtr<PageCache>> create(Inode&);
+		~PageCache();
+
+		// Reads through the cache. If populate is false, missing pages are read
+		// directly from the inode without caching them.
+		BAN::ErrorOr<size_t> read(off_t offset, BAN::ByteSpan buffer, bool populate);
+
+		// Updates cached pages after data has been written to the inode
+		void update(off_t offset, BAN::ConstByteSpan buffer);
+		// Drops pages past new_size and zeroes the tail of the last page
+		void truncate(size_t new_size);
+
+		// Returns the page, reading it from the inode if needed, and increments its
+		// map count. Every successful call has to be paired with unmap_page.
+		BAN::ErrorOr<paddr_t> map_page(size_t page_index);
+		void unmap_page(size_t page_index);
+
+		// Writes a (possibly modified) mapped page back to the inode
+		BAN::ErrorOr<void> sync_page(size_t page_index);
+		// Writes back every mapped page overlapping the range, so the inode's
+		// contents can be accessed without going through the cache
+		BAN::ErrorOr<void> sync_mapped_pages(off_t offset, size_t length);
+
+	private:
+		PageCache(Inode& inode)
+			: m_inode(inode)
+		{ }
+
+		struct Leaf
+		{
+			static constexpr size_t page_count = PAGE_SIZE / sizeof(paddr_t);
+			paddr_t paddr[page_count] {};
+			uint32_t map_count[page_count] {};
+			size_t used { 0 };
+		};
+
+		paddr_t find_page(size_t page_index) const;
+		BAN::ErrorOr<void> insert_page(size_t page_index, paddr_t paddr);
+		void remove_page(size_t page_index);
+
+		// Reads pages starting from page_index to the cache, stopping at
+		// the first cached page, the end of file or after max_pages pages
+		BAN::ErrorOr<void> read_pages_to_cache(size_t page_index, size_t max_pages);
+
+		// Drops at most page_count unmapped pages, returns the number of pages dropped
+		size_t evict_unmapped_pages(size_t page_count);
+
+		void mark_used();
+		static void reclaim_if_needed();
+
+	private:
+		static constexpr size_t s_read_batch_pages = 16;
+
+		Inode& m_inode;
+
+		BAN::Vector<BAN::UniqPtr<Leaf>> m_leaves;
+		size_t m_page_count { 0 };
+
+		// All page caches in least recently used order
+		PageCache* m_lru_prev { nullptr };
+		PageCache* m_lru_next { nullptr };
+	};
+
+}
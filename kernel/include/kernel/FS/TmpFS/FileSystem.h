@@ -64,6 +64,8 @@ namespace Kernel
 		void with_block_buffer(size_t index, F callback);
 		void free_block(size_t index);
 		BAN::ErrorOr<size_t> allocate_block();
+		// Physical address of a data block is stable until the block is freed
+		paddr_t block_paddr(size_t index);
 
 		template<TmpFuncs::for_each_inode_callback F>
 		void for_each_inode(F callback);
@@ -114,6 +116,9 @@ namespace Kernel
 		BAN::ErrorOr<BAN::Iteration> for_each_indirect_paddr_allocating_internal(PageInfo page_info, F callback, size_t depth);
 
 		paddr_t find_indirect(PageInfo root, size_t index, size_t depth);
+		BAN::ErrorOr<paddr_t> find_indirect_allocating(PageInfo root, size_t index, size_t depth);
+
+		BAN::ErrorOr<paddr_t> allocate_zeroed_page();
 
 	private:
 		const dev_t m_rdev;
@@ -130,6 +135,7 @@ namespace Kernel
 		// number of pages for this file system.
 		PageInfo m_data_pages {};
 		static constexpr size_t first_data_page = 1;
+		size_t m_free_block_hint { first_data_page };
 		static constexpr size_t max_data_pages =
 			(PAGE_SIZE / sizeof(PageInfo)) *
 			(PAGE_SIZE / sizeof(PageInfo)) *
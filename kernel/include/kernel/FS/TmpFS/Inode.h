@@ -2,6 +2,8 @@
 
 #include <BAN/Iteration.h>
 #include <BAN/Optional.h>
+#include <BAN/UniqPtr.h>
+#include <BAN/Vector.h>
 #include <kernel/FS/Inode.h>
 #include <kernel/FS/TmpFS/Definitions.h>
 
@@ -47,16 +49,38 @@ namespace Kernel
 
 		void sync();
 		void free_all_blocks();
+		void free_blocks_from(size_t first_data_block_index);
 		virtual BAN::ErrorOr<void> prepare_unlink() { return {}; };
 
 		BAN::Optional<size_t> block_index(size_t data_block_index);
 		BAN::ErrorOr<size_t> block_index_with_allocation(size_t data_block_index);
 
+		// Physical address of a data block, or 0 if it is not allocated
+		paddr_t block_paddr(size_t data_block_index);
+		BAN::ErrorOr<paddr_t> block_paddr_with_allocation(size_t data_block_index);
+
+	private:
+		// Returns 0 if the block is not allocated and allocate is false
+		BAN::ErrorOr<size_t> find_block_index(size_t data_block_index, bool allocate);
+		// Frees data blocks starting from first_data_block_index from the subtree of block,
+		// which maps data blocks starting from first_index. Returns 0 if block itself was freed.
+		size_t free_indirect_blocks(size_t block, size_t depth, size_t first_index, size_t first_data_block_index);
+
+		void cache_block_paddr(size_t data_block_index, paddr_t);
+
 	protected:
 		TmpFileSystem& m_fs;
 		TmpInodeInfo m_inode_info;
 		const ino_t m_ino;
 
+		// Two level radix tree of data block physical addresses, so hot
+		// accesses skip both our indirect blocks and the file system page table
+		struct BlockPaddrCacheLeaf
+		{
+			paddr_t paddr[PAGE_SIZE / sizeof(paddr_t)] {};
+		};
+		BAN::Vector<BAN::UniqPtr<BlockPaddrCacheLeaf>> m_block_paddr_cache;
+
 		// has to be able to increase link count
 		friend class TmpDirectoryInode;
 	};
@@ -72,6 +96,8 @@ namespace Kernel
 		virtual BAN::ErrorOr<size_t> write_impl(off_t, BAN::ConstByteSpan) override;
 		virtual BAN::ErrorOr<void> truncate_impl(size_t) override;
 		virtual BAN::ErrorOr<void> chmod_impl(mode_t) override;
+		virtual BAN::ErrorOr<void> fsync_impl(bool) override { return {}; }
+		virtual BAN::ErrorOr<size_t> copy_file_range_impl(off_t, Inode&, off_t, size_t) override;
 
 		virtual bool can_read_impl() const override { return true; }
 		virtual bool can_write_impl() const override { return true; }
@@ -141,10 +167,11 @@ namespace Kernel
 
 	protected:
 		virtual BAN::ErrorOr<BAN::RefPtr<Inode>> find_inode_impl(BAN::StringView) override final;
-		virtual BAN::ErrorOr<size_t> list_next_inodes_impl(off_t, struct dirent*, size_t) override final;
+		virtual BAN::ErrorOr<size_t> list_next_inodes_impl(off_t&, struct dirent*, size_t) override final;
 		virtual BAN::ErrorOr<void> create_file_impl(BAN::StringView, mode_t, uid_t, gid_t) override final;
 		virtual BAN::ErrorOr<void> create_directory_impl(BAN::StringView, mode_t, uid_t, gid_t) override final;
 		virtual BAN::ErrorOr<void> unlink_impl(BAN::StringView) override;
+		virtual BAN::ErrorOr<void> fsync_impl(bool) override { return {}; }
 
 		virtual bool can_read_impl() const override { return false; }
 		virtual bool can_write_impl() const override { return false; }
@@ -21,6 +21,8 @@ namespace Kernel
 
 		BAN::ErrorOr<void> mount(const Credentials&, BAN::StringView, BAN::StringView);
 		BAN::ErrorOr<void> mount(const Credentials&, BAN::RefPtr<FileSystem>, BAN::StringView);
+		// Returns true if a mounted file system is backed by device dev
+		bool is_mounted(dev_t dev);
 
 		struct File
 		{
@@ -28,6 +30,9 @@ namespace Kernel
 			BAN::String canonical_path;
 		};
 		BAN::ErrorOr<File> file_from_absolute_path(const Credentials&, BAN::StringView, int);
+		// Resolves path starting from parent, which has to be a directory with canonical path parent_path.
+		// Absolute paths start from the root like in file_from_absolute_path.
+		BAN::ErrorOr<File> file_from_relative_path(const Credentials&, BAN::RefPtr<Inode> parent, BAN::StringView parent_path, BAN::StringView, int);
 
 	private:
 		VirtualFileSystem() = default;
@@ -37,8 +42,10 @@ namespace Kernel
 			BAN::RefPtr<FileSystem> target;
 			File host;
 		};
-		MountPoint* mount_from_host_inode(BAN::RefPtr<Inode>);
-		MountPoint* mount_from_root_inode(BAN::RefPtr<Inode>);
+		// Root inode of the file system mounted on inode, or null
+		BAN::RefPtr<Inode> mount_target_of(BAN::RefPtr<Inode>);
+		// Inode that the file system rooted at inode is mounted on, or null
+		BAN::RefPtr<Inode> mount_host_of(BAN::RefPtr<Inode>);
 
 	private:
 		Mutex					m_mutex;
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <BAN/Atomic.h>
+#include <BAN/UniqPtr.h>
+#include <BAN/Vector.h>
+#include <kernel/FS/Inode.h>
+#include <kernel/Memory/VirtualRange.h>
+#include <kernel/Semaphore.h>
+
+#include <sys/ioring.h>
+
+namespace Kernel
+{
+
+	// Kernel side of a submission/completion ring. The queues live in the owning
+	// process' memory and are only accessed from its ioring_enter syscalls, which
+	// are serialized by the process lock.
+	//
+	// Operations that cannot complete immediately are kept in flight. They register
+	// a waiter on the inode they are waiting for, and are retried when it notifies
+	// a readiness change, or when their timeout expires.
+	//
+	// Reads and writes of files at an explicit offset run on worker threads through a
+	// kernel buffer, so a slow disk does not hold up ioring_enter. The buffer is copied
+	// to the owning process when the completion is posted.
+	class IORing final : public Inode
+	{
+	public:
+		struct Operation final : public Inode::Waiter
+		{
+			virtual void notify() override
+			{
+				notified = true;
+				ring->wake_up();
+			}
+
+			IORing* ring { nullptr };
+			ioring_sqe sqe {};
+
+			// Inode this operation has registered a waiter to
+			BAN::RefPtr<Inode> waiting_on;
+			uint64_t wake_time_ms { ~(uint64_t)0 };
+			BAN::Atomic<bool> notified { true };
+
+			// Negative errno if the submission was invalid, completes without executing
+			int32_t submit_error { 0 };
+
+			// Set when the operation runs on a worker, which sets async_done once finished
+			bool async { false };
+			BAN::Atomic<bool> async_done { false };
+			int32_t async_result { 0 };
+			BAN::UniqPtr<VirtualRange> async_buffer;
+		};
+
+	public:
+		static BAN::ErrorOr<BAN::RefPtr<IORing>> create(pid_t owner, const ioring& ring);
+		~IORing();
+
+		pid_t owner() const { return m_owner; }
+
+		// User memory of the ring, has to be validated by the owning process before use
+		const ioring* ring_memory() const { return m_ring; }
+		const ioring_sqe* sqes_memory() const { return m_sqes; }
+		const ioring_cqe* cqes_memory() const { return m_cqes; }
+		uint32_t sq_entries() const { return m_sq_entries; }
+		uint32_t cq_entries() const { return m_cq_entries; }
+
+		// Returns false if the submission queue is empty. The entry stays in
+		// the queue until it is consumed with pop_submission.
+		bool peek_submission(ioring_sqe& out);
+		void pop_submission();
+		// Completion queue must not be full
+		void post_completion(uint64_t user_data, int32_t res);
+		// Reads the completion queue head from the ring memory
+		void sync_completion_head();
+		// Uses the completion queue head from the last sync_completion_head
+		size_t completion_count() const { return m_cq_tail - m_cq_head; }
+		bool completion_queue_full() const { return completion_count() >= m_cq_entries; }
+
+		BAN::ErrorOr<Operation*> add_operation(const ioring_sqe& sqe, uint64_t wake_time_ms);
+		void remove_operation(Operation*);
+		void start_waiting(Operation&, BAN::RefPtr<Inode>);
+		// Reads to or writes from operation's async_buffer on a worker thread
+		BAN::ErrorOr<void> start_async_io(Operation&, BAN::RefPtr<Inode>, bool is_write, bool direct, off_t offset, size_t len);
+		BAN::Vector<BAN::UniqPtr<Operation>>& operations() { return m_operations; }
+		size_t max_operations() const { return m_cq_entries; }
+
+		// Notified flag has to be cleared before retrying operations,
+		// so notifications during the retry are not missed
+		void clear_notified()
+		{
+			m_wake_count = m_semaphore.wake_count();
+			m_notified = false;
+		}
+		BAN::ErrorOr<void> wait(uint64_t wake_time_ms);
+		void wake_up();
+
+		virtual bool is_ioring() const override { return true; }
+
+		virtual ino_t ino() const override { return 0; }
+		virtual Mode mode() const override { return { Mode::IRUSR | Mode::IWUSR }; }
+		virtual nlink_t nlink() const override { return 0; }
+		virtual uid_t uid() const override { return 0; }
+		virtual gid_t gid() const override { return 0; }
+		virtual off_t size() const override { return 0; }
+		virtual timespec atime() const override { return {}; }
+		virtual timespec mtime() const override { return {}; }
+		virtual timespec ctime() const override { return {}; }
+		virtual blksize_t blksize() const override { return PAGE_SIZE; }
+		virtual blkcnt_t blocks() const override { return 0; }
+		virtual dev_t dev() const override { return 0; }
+		virtual dev_t rdev() const override { return 0; }
+
+	protected:
+		virtual bool can_read_impl() const override;
+		virtual bool can_write_impl() const override { return false; }
+		virtual bool has_error_impl() const override { return false; }
+
+	private:
+		IORing(pid_t owner, const ioring& ring);
+
+	private:
+		const pid_t m_owner;
+
+		ioring* const m_ring;
+		ioring_sqe* const m_sqes;
+		ioring_cqe* const m_cqes;
+		const uint32_t m_sq_entries;
+		const uint32_t m_cq_entries;
+
+		// Kernel side copies of the completion queue positions, so checking for
+		// completions never touches user memory
+		uint32_t m_cq_head { 0 };
+		uint32_t m_cq_tail { 0 };
+
+		BAN::Vector<BAN::UniqPtr<Operation>> m_operations;
+
+		Semaphore m_semaphore;
+		BAN::Atomic<bool> m_notified { false };
+		uint32_t m_wake_count { 0 };
+	};
+
+}
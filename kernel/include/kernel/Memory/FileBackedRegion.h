@@ -6,19 +6,6 @@
 namespace Kernel
 {
 
-	struct SharedFileData : public BAN::RefCounted<SharedFileData>, public BAN::Weakable<SharedFileData>
-	{
-		~SharedFileData();
-
-		void sync(size_t page_index);
-
-		// FIXME: this should probably be ordered tree like map
-		//        for fast lookup and less memory usage
-		BAN::Vector<paddr_t> pages;
-		BAN::RefPtr<Inode> inode;
-		uint8_t page_buffer[PAGE_SIZE];
-	};
-
 	class FileBackedRegion final : public MemoryRegion
 	{
 		BAN_NON_COPYABLE(FileBackedRegion);
@@ -38,12 +25,13 @@ namespace Kernel
 	private:
 		FileBackedRegion(BAN::RefPtr<Inode>, PageTable&, off_t offset, ssize_t size, Type flags, PageTable::flags_t page_flags);
 
+		// Shared and read only private regions map pages of the inode's page cache
+		bool maps_page_cache() const { return m_type == Type::SHARED || !(m_flags & PageTable::Flags::ReadWrite); }
+		size_t file_page_index(vaddr_t vaddr) const { return (m_offset + (vaddr - m_vaddr)) / PAGE_SIZE; }
+
 	private:
 		BAN::RefPtr<Inode> m_inode;
 		const off_t m_offset;
-
-		// FIXME: is this even synchronized?
-		BAN::RefPtr<SharedFileData> m_shared_data;
 	};
 
 }
@@ -61,12 +61,15 @@ namespace Kernel
 		virtual BAN::ErrorOr<void> bind_impl(const sockaddr*, socklen_t) override;
 		virtual BAN::ErrorOr<size_t> sendto_impl(BAN::ConstByteSpan, const sockaddr*, socklen_t) override;
 		virtual BAN::ErrorOr<size_t> recvfrom_impl(BAN::ByteSpan, sockaddr*, socklen_t*) override;
+		virtual BAN::ErrorOr<size_t> sendmsg_impl(BAN::Span<const BAN::ConstByteSpan>, const sockaddr*, socklen_t) override;
+		virtual BAN::ErrorOr<size_t> recvmsg_impl(BAN::Span<BAN::ByteSpan>, sockaddr*, socklen_t*) override;
 
 		virtual void receive_packet(BAN::ConstByteSpan, const sockaddr* sender, socklen_t sender_len) override;
 
 		virtual bool can_read_impl() const override;
 		virtual bool can_write_impl() const override;
 		virtual bool has_error_impl() const override { return false; }
+		virtual bool has_hungup_impl() const override { return m_has_connected && m_state != State::Established; }
 
 	private:
 		enum class State
@@ -24,16 +24,20 @@ namespace Kernel
 		virtual BAN::ErrorOr<void> bind_impl(const sockaddr*, socklen_t) override;
 		virtual BAN::ErrorOr<size_t> sendto_impl(BAN::ConstByteSpan, const sockaddr*, socklen_t) override;
 		virtual BAN::ErrorOr<size_t> recvfrom_impl(BAN::ByteSpan, sockaddr*, socklen_t*) override;
+		virtual BAN::ErrorOr<size_t> sendmsg_impl(BAN::Span<const BAN::ConstByteSpan>, const sockaddr*, socklen_t) override;
+		virtual BAN::ErrorOr<size_t> recvmsg_impl(BAN::Span<BAN::ByteSpan>, sockaddr*, socklen_t*) override;
 
 		virtual bool can_read_impl() const override;
 		virtual bool can_write_impl() const override;
 		virtual bool has_error_impl() const override { return false; }
+		virtual bool has_hungup_impl() const override;
 
 	private:
 		UnixDomainSocket(SocketType, ino_t, const TmpInodeInfo&);
 		~UnixDomainSocket();
 
-		BAN::ErrorOr<void> add_packet(BAN::ConstByteSpan);
+		// Appends the segments as a single packet
+		BAN::ErrorOr<void> add_packet(BAN::Span<const BAN::ConstByteSpan>, size_t packet_size);
 
 		bool is_bound() const { return !m_bound_path.empty(); }
 		bool is_bound_to_unused() const { return m_bound_path == "X"_sv; }
@@ -46,6 +50,7 @@ namespace Kernel
 			bool										listening { false };
 			BAN::Atomic<bool>							connection_done { false };
 			mutable BAN::Atomic<bool>					target_closed { false };
+			BAN::Atomic<bool>							has_connected { false };
 			BAN::WeakPtr<UnixDomainSocket>				connection;
 			BAN::Queue<BAN::RefPtr<UnixDomainSocket>>	pending_connections;
 			Semaphore									pending_semaphore;
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <BAN/Array.h>
+#include <BAN/Vector.h>
 #include <kernel/FS/Inode.h>
 
 #include <limits.h>
@@ -48,6 +48,16 @@ namespace Kernel
 
 		BAN::ErrorOr<size_t> read(int fd, BAN::ByteSpan);
 		BAN::ErrorOr<size_t> write(int fd, BAN::ConstByteSpan);
+		BAN::ErrorOr<size_t> readv(int fd, BAN::Span<BAN::ByteSpan>);
+		BAN::ErrorOr<size_t> writev(int fd, BAN::Span<const BAN::ConstByteSpan>);
+
+		// Moves up to count bytes from in_fd to out_fd inside the kernel. Null offsets
+		// use and advance the file offsets, given offsets are only supported for regular files.
+		// Page cache pages of the input file are mapped and handed to the output directly.
+		BAN::ErrorOr<size_t> splice(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t count);
+		// Copies up to count bytes between two regular files. Copies within a file system
+		// first try Inode::copy_file_range, the rest is spliced through the page cache.
+		BAN::ErrorOr<size_t> copy_file_range(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t count);
 
 		BAN::ErrorOr<size_t> read_dir_entries(int fd, struct dirent* list, size_t list_len);
 
@@ -74,13 +84,17 @@ namespace Kernel
 		};
 
 		BAN::ErrorOr<void> validate_fd(int) const;
-		BAN::ErrorOr<int> get_free_fd() const;
-		BAN::ErrorOr<void> get_free_fd_pair(int fds[2]) const;
+		BAN::ErrorOr<int> get_free_fd();
+		BAN::ErrorOr<void> get_free_fd_pair(int fds[2]);
+		BAN::ErrorOr<void> grow_open_files();
+
+		static constexpr size_t s_splice_window_pages = 16;
 
 	private:
 		const Credentials& m_credentials;
 
-		BAN::Array<BAN::RefPtr<OpenFileDescription>, OPEN_MAX> m_open_files;
+		// Grown on demand up to OPEN_MAX entries
+		BAN::Vector<BAN::RefPtr<OpenFileDescription>> m_open_files;
 	};
 
 }
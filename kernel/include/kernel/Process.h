@@ -7,6 +7,7 @@
 #include <BAN/Vector.h>
 #include <kernel/Credentials.h>
 #include <kernel/FS/Inode.h>
+#include <kernel/IORing.h>
 #include <kernel/Lock/Mutex.h>
 #include <kernel/Memory/Heap.h>
 #include <kernel/Memory/MemoryRegion.h>
@@ -15,10 +16,13 @@
 #include <kernel/Terminal/TTY.h>
 #include <kernel/Thread.h>
 
+#include <poll.h>
 #include <sys/banan-os.h>
+#include <sys/epoll.h>
 #include <sys/mman.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <termios.h>
 
 namespace LibELF { class LoadableELF; }
@@ -106,6 +110,13 @@ namespace Kernel
 		BAN::ErrorOr<long> sys_close(int fd);
 		BAN::ErrorOr<long> sys_read(int fd, void* buffer, size_t count);
 		BAN::ErrorOr<long> sys_write(int fd, const void* buffer, size_t count);
+		BAN::ErrorOr<long> sys_readv(int fd, const iovec* iov, int iovcnt);
+		BAN::ErrorOr<long> sys_writev(int fd, const iovec* iov, int iovcnt);
+		BAN::ErrorOr<long> sys_preadv(int fd, const iovec* iov, int iovcnt, off_t offset);
+		BAN::ErrorOr<long> sys_pwritev(int fd, const iovec* iov, int iovcnt, off_t offset);
+		BAN::ErrorOr<long> sys_sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
+		BAN::ErrorOr<long> sys_splice(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t count);
+		BAN::ErrorOr<long> sys_copy_file_range(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t count);
 		BAN::ErrorOr<long> sys_create(const char*, mode_t);
 		BAN::ErrorOr<long> sys_create_dir(const char*, mode_t);
 		BAN::ErrorOr<long> sys_unlink(const char*);
@@ -129,10 +140,20 @@ namespace Kernel
 		BAN::ErrorOr<long> sys_listen(int socket, int backlog);
 		BAN::ErrorOr<long> sys_sendto(const sys_sendto_t*);
 		BAN::ErrorOr<long> sys_recvfrom(sys_recvfrom_t*);
+		BAN::ErrorOr<long> sys_sendmsg(int socket, const msghdr* message, int flags);
+		BAN::ErrorOr<long> sys_recvmsg(int socket, msghdr* message, int flags);
 
 		BAN::ErrorOr<long> sys_ioctl(int fildes, int request, void* arg);
 
 		BAN::ErrorOr<long> sys_pselect(sys_pselect_t* arguments);
+		BAN::ErrorOr<long> sys_poll(pollfd* fds, nfds_t nfds, int timeout);
+
+		BAN::ErrorOr<long> sys_epoll_create1(int flags);
+		BAN::ErrorOr<long> sys_epoll_ctl(int epfd, int op, int fd, epoll_event* event);
+		BAN::ErrorOr<long> sys_epoll_pwait(int epfd, epoll_event* events, int maxevents, int timeout, const sigset_t* sigmask);
+
+		BAN::ErrorOr<long> sys_ioring_setup(ioring* ring);
+		BAN::ErrorOr<long> sys_ioring_enter(int fd, uint32_t to_submit, uint32_t min_complete, const timespec* timeout);
 
 		BAN::ErrorOr<long> sys_pipe(int fildes[2]);
 		BAN::ErrorOr<long> sys_dup(int fildes);
@@ -150,6 +171,7 @@ namespace Kernel
 		BAN::ErrorOr<long> sys_stat(const char* path, struct stat* buf, int flag);
 
 		BAN::ErrorOr<long> sys_sync(bool should_block);
+		BAN::ErrorOr<long> sys_fsync(int fd, bool data_only);
 
 		static BAN::ErrorOr<long> clean_poweroff(int command);
 		BAN::ErrorOr<long> sys_poweroff(int command);
@@ -214,6 +236,16 @@ namespace Kernel
 		BAN::ErrorOr<void> validate_pointer_access_check(const void*, size_t);
 		BAN::ErrorOr<void> validate_pointer_access(const void*, size_t);
 
+		// Validates user iovecs and the memory they point to
+		template<typename SpanT>
+		BAN::ErrorOr<BAN::Vector<SpanT>> spans_from_iovecs(const iovec* iov, int iovcnt);
+
+		BAN::ErrorOr<void> validate_ioring_access(const IORing&);
+		// Completes every in flight operation of the ring that is ready, until the completion queue is full
+		void ioring_process_operations(IORing&);
+		// Returns EAGAIN if the operation's file is not ready, operation is then registered to wait for it
+		BAN::ErrorOr<long> ioring_execute(IORing&, IORing::Operation&);
+
 		uint64_t signal_pending_mask() const
 		{
 			return ((uint64_t)m_signal_pending_mask[1].load() << 32) | m_signal_pending_mask[0].load();
@@ -33,6 +33,8 @@ namespace Kernel
 
 		static ProcessorID current_id() { return read_gs_sized<ProcessorID>(offsetof(Processor, m_id)); }
 
+		static uint8_t count() { return s_processor_count; }
+
 		static ProcessorID bsb_id() { return s_bsb_id; }
 		static bool current_is_bsb() { return current_id() == bsb_id(); }
 
@@ -69,6 +71,9 @@ namespace Kernel
 		static SchedulerQueue::Node* get_current_thread()				{ return reinterpret_cast<SchedulerQueue::Node*>(read_gs_ptr(offsetof(Processor, m_current_thread))); }
 		static void set_current_thread(SchedulerQueue::Node* thread)	{ write_gs_ptr(offsetof(Processor, m_current_thread), thread); }
 
+		// Kernel stack used by syscall and sysenter entries, has to be updated on thread switches
+		static void set_syscall_stack(uintptr_t sp);
+
 		static void enter_interrupt(InterruptStack*, InterruptRegisters*);
 		static void leave_interrupt();
 		static InterruptStack& get_interrupt_stack();
@@ -78,6 +83,8 @@ namespace Kernel
 		Processor() = default;
 		~Processor() { ASSERT_NOT_REACHED(); }
 
+		static void initialize_fast_syscall();
+
 		template<typename T>
 		static T read_gs_sized(uintptr_t offset) requires(sizeof(T) <= 8)
 		{
@@ -115,9 +122,14 @@ namespace Kernel
 
 	private:
 		static ProcessorID s_bsb_id;
+		static uint8_t s_processor_count;
 
 		ProcessorID m_id { PROCESSOR_NONE };
 
+		// accessed from asm_fast_syscall_handler, offsets have to match
+		uintptr_t m_syscall_stack { 0 };
+		uintptr_t m_syscall_user_sp { 0 };
+
 		static constexpr size_t s_stack_size { 4096 };
 		void* m_stack { nullptr };
 
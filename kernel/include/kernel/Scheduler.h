@@ -24,6 +24,8 @@ namespace Kernel
 		void set_current_thread_sleeping(uint64_t wake_time);
 
 		void block_current_thread(Semaphore*, uint64_t wake_time);
+		// Does not block if the semaphore's wake count differs from wake_count
+		void block_current_thread(Semaphore*, uint64_t wake_time, uint32_t wake_count);
 		void unblock_threads(Semaphore*);
 		// Makes sleeping or blocked thread with tid active.
 		void unblock_thread(pid_t tid);
@@ -37,7 +39,7 @@ namespace Kernel
 	private:
 		Scheduler() = default;
 
-		void set_current_thread_sleeping_impl(Semaphore* semaphore, uint64_t wake_time);
+		void set_current_thread_sleeping_impl(Semaphore* semaphore, uint64_t wake_time, bool check_wake_count, uint32_t wake_count);
 
 		void setup_next_thread();
 
@@ -27,6 +27,9 @@ namespace Kernel
 			uint64_t	wake_time { 0 };
 			Semaphore*	semaphore { nullptr };
 			bool		should_block { false };
+			// Set when blocking with an expected wake count of the semaphore
+			bool		check_wake_count { false };
+			uint32_t	wake_count { 0 };
 
 		private:
 			Node* next { nullptr };
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <BAN/Atomic.h>
+
+#include <stdint.h>
+
 namespace Kernel
 {
 
@@ -10,6 +14,16 @@ namespace Kernel
 		void block_with_timeout(uint64_t timeout_ms);
 		void block_with_wake_time(uint64_t wake_time_ms);
 		void unblock();
+
+		// Every unblock() advances the wake count. Blocking with a wake count read before
+		// checking the wait condition returns immediately if unblock() has been called
+		// since, so wake ups between the check and blocking are never lost.
+		uint32_t wake_count() const { return m_wake_count; }
+		void block_with_wake_time(uint64_t wake_time_ms, uint32_t wake_count);
+
+	private:
+		BAN::Atomic<uint32_t> m_wake_count { 0 };
+		friend class Scheduler;
 	};
 
 }
@@ -21,6 +21,7 @@ namespace Kernel
 		virtual void handle_irq() override;
 
 		uint32_t command_slot_count() const { return m_command_slot_count; }
+		bool supports_ncq() const { return m_supports_ncq; }
 
 	private:
 		AHCIController(PCI::Device& pci_device)
@@ -36,6 +37,7 @@ namespace Kernel
 		BAN::Array<AHCIDevice*, 32> m_devices;
 
 		uint32_t m_command_slot_count { 0 };
+		bool m_supports_ncq { false };
 
 		friend class ATAController;
 	};
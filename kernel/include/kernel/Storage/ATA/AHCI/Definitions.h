@@ -12,6 +12,7 @@
 #define FIS_TYPE_SET_DEVIVE_BITS	0xA1
 
 #define SATA_CAP_SUPPORTS64	(1 << 31)
+#define SATA_CAP_SUPPORTS_NCQ	(1 << 30)
 
 #define SATA_GHC_AHCI_ENABLE		(1 << 31)
 #define SATA_GHC_INTERRUPT_ENABLE	(1 << 1)
@@ -29,10 +30,16 @@
 #define HBA_PxCMD_FR	0x4000
 #define HBA_PxCMD_CR	0x8000
 
+#define HBA_PxIS_IFS	(1 << 27)
+#define HBA_PxIS_HBDS	(1 << 28)
+#define HBA_PxIS_HBFS	(1 << 29)
+#define HBA_PxIS_TFES	(1 << 30)
+#define HBA_PxIS_ERROR	(HBA_PxIS_IFS | HBA_PxIS_HBDS | HBA_PxIS_HBFS | HBA_PxIS_TFES)
+
 namespace Kernel
 {
 
-	static constexpr uint32_t s_hba_prdt_count { 8 };
+	static constexpr uint32_t s_hba_prdt_count { 56 };
 
 	struct FISRegisterH2D
 	{
@@ -278,6 +285,7 @@ namespace Kernel
 		uint8_t __reserved[48];
 		HBAPRDTEntry prdt_entry[s_hba_prdt_count];
 	} __attribute__((packed));
+	static_assert(sizeof(HBACommandTable) % 128 == 0);
 
 	enum class AHCIPortType
 	{
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <kernel/Lock/SpinLock.h>
 #include <kernel/Semaphore.h>
 #include <kernel/Storage/ATA/AHCI/Definitions.h>
 #include <kernel/Storage/ATA/ATADevice.h>
@@ -13,6 +14,15 @@ namespace Kernel
 		static BAN::ErrorOr<BAN::RefPtr<AHCIDevice>> create(BAN::RefPtr<AHCIController>, volatile HBAPortMemorySpace*);
 		~AHCIDevice() = default;
 
+	private:
+		struct PendingCommand
+		{
+			uint32_t slot;
+			uint64_t buffer_offset;
+			uint64_t sector_count;
+			bool bounced;
+		};
+
 	private:
 		AHCIDevice(BAN::RefPtr<AHCIController> controller, volatile HBAPortMemorySpace* port)
 			: m_controller(controller)
@@ -25,11 +35,27 @@ namespace Kernel
 
 		virtual BAN::ErrorOr<void> read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan) override;
 		virtual BAN::ErrorOr<void> write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan) override;
-		BAN::ErrorOr<void> send_command_and_block(uint64_t lba, uint64_t sector_count, Command command);
+		virtual size_t max_concurrent_requests() const override { return m_queue_depth; }
+		BAN::ErrorOr<void> transfer_sectors(uint64_t lba, uint64_t sector_count, uint8_t* buffer, Command command);
+
+		// Fills slot's PRDT with physical ranges of buffer. Returns the number of
+		// sectors described or 0 if buffer cannot be used for DMA directly.
+		uint64_t prepare_direct_prdt(uint32_t slot, vaddr_t buffer, uint64_t sector_count);
+		uint64_t prepare_bounce_prdt(uint32_t slot, uint64_t sector_count);
+		void prepare_command_fis(uint32_t slot, uint64_t lba, uint64_t sector_count, Command command);
+		void issue_command(uint32_t slot, bool queued);
 
-		BAN::Optional<uint32_t> find_free_command_slot();
+		volatile HBACommandHeader& command_header(uint32_t slot);
+		volatile HBACommandTable& command_table(uint32_t slot);
+
+		BAN::Optional<uint32_t> reserve_command_slot(bool blocking);
+		void release_command_slot(uint32_t slot);
+		vaddr_t bounce_buffer_of(uint32_t slot) const { return m_data_dma_region->vaddr() + slot * PAGE_SIZE; }
 
 		void handle_irq();
+		void update_completed_slots();
+		// Stops the command engine, failing every outstanding command, and restarts it
+		void abort_issued_commands();
 
 		BAN::ErrorOr<void> block_until_command_completed(uint32_t command_slot);
 
@@ -38,10 +64,20 @@ namespace Kernel
 		volatile HBAPortMemorySpace* const m_port;
 
 		BAN::UniqPtr<DMARegion> m_dma_region;
-		// Intermediate read/write buffer
-		// TODO: can we read straight to user buffer?
+		// One page bounce buffer per command slot, used for buffers
+		// that cannot be described with PRDT entries
 		BAN::UniqPtr<DMARegion> m_data_dma_region;
 
+		bool m_ncq_enabled { false };
+		uint32_t m_queue_depth { 1 };
+
+		SpinLock m_slot_lock;
+		Semaphore m_slot_semaphore;
+		uint32_t m_used_slots { 0 };
+		uint32_t m_issued_slots { 0 };
+		BAN::Atomic<uint32_t> m_done_slots { 0 };
+		BAN::Atomic<uint32_t> m_error_slots { 0 };
+
 		friend class AHCIController;
 	};
 
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <BAN/ByteSpan.h>
+#include <BAN/Function.h>
+#include <BAN/UniqPtr.h>
+#include <BAN/Vector.h>
+#include <kernel/Lock/Mutex.h>
+#include <kernel/Semaphore.h>
+
+namespace Kernel
+{
+
+	class StorageDevice;
+
+	struct BlockRequest
+	{
+		using Callback = BAN::Function<void(BAN::ErrorOr<void>)>;
+
+		enum class Type
+		{
+			Read,
+			Write,
+		};
+
+		Type type;
+		uint64_t lba;
+		uint64_t sector_count;
+		uint8_t* buffer;
+		Callback callback;
+		uint64_t deadline_ms;
+
+		// Requests merged after this one, sorted by lba.
+		// Only the first request of a chain is known to the scheduler.
+		BlockRequest* merged_next { nullptr };
+
+		uint64_t merged_sector_count() const;
+	};
+
+	class BlockIOScheduler
+	{
+	public:
+		virtual ~BlockIOScheduler() {}
+
+		// Takes ownership of request. Request may get merged with a queued one.
+		virtual BAN::ErrorOr<void> add_request(BlockRequest*) = 0;
+		// Returns the next request chain to dispatch or nullptr if there are none
+		virtual BlockRequest* next_request() = 0;
+
+	protected:
+		// Tries to merge request into the chain starting at queued.
+		// queued is updated if request becomes the new first request.
+		static bool try_merge(BlockRequest*& queued, BlockRequest* request, uint32_t sector_size);
+	};
+
+	// Dispatches requests in submission order. Only back to back requests are merged.
+	class FIFOBlockIOScheduler final : public BlockIOScheduler
+	{
+	public:
+		FIFOBlockIOScheduler(uint32_t sector_size)
+			: m_sector_size(sector_size)
+		{ }
+
+		virtual BAN::ErrorOr<void> add_request(BlockRequest*) override;
+		virtual BlockRequest* next_request() override;
+
+	private:
+		const uint32_t m_sector_size;
+		BAN::Vector<BlockRequest*> m_requests;
+	};
+
+	// Dispatches requests in ascending lba order, unless a request's
+	// deadline has passed. Requests are merged with any adjacent request.
+	class DeadlineBlockIOScheduler final : public BlockIOScheduler
+	{
+	public:
+		DeadlineBlockIOScheduler(uint32_t sector_size)
+			: m_sector_size(sector_size)
+		{ }
+
+		virtual BAN::ErrorOr<void> add_request(BlockRequest*) override;
+		virtual BlockRequest* next_request() override;
+
+	private:
+		const uint32_t m_sector_size;
+		uint64_t m_next_lba { 0 };
+		// sorted by lba
+		BAN::Vector<BlockRequest*> m_requests;
+	};
+
+	class BlockRequestQueue
+	{
+		BAN_NON_COPYABLE(BlockRequestQueue);
+		BAN_NON_MOVABLE(BlockRequestQueue);
+
+	public:
+		enum class SchedulerType
+		{
+			FIFO,
+			Deadline,
+		};
+
+	public:
+		static BAN::ErrorOr<BAN::UniqPtr<BlockRequestQueue>> create(StorageDevice&, SchedulerType, size_t worker_count);
+
+		// Submits request to the queue. Callback is called from a worker thread
+		// once the request has completed. buffer must be kernel memory and stay valid until then.
+		// Requests overlapping an earlier request are completed after it, if either of them is a write.
+		BAN::ErrorOr<void> submit(BlockRequest::Type, uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer, BlockRequest::Callback);
+		// Submits request and blocks until it has completed. buffer may be user memory.
+		BAN::ErrorOr<void> transfer(BlockRequest::Type, uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer);
+
+	private:
+		BlockRequestQueue(StorageDevice& device)
+			: m_device(device)
+		{ }
+
+		void worker_task();
+		BAN::ErrorOr<void> transfer_kernel_buffer(BlockRequest::Type, uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer);
+		void dispatch(BlockRequest*);
+		BAN::ErrorOr<void> execute(BlockRequest::Type, uint64_t lba, uint64_t sector_count, uint8_t* buffer);
+
+		// These must be called with m_mutex locked
+		bool conflicts_with_outstanding(const BlockRequest&, size_t deferred_count) const;
+		// Moves deferred requests that no longer conflict to the scheduler, returns true if any was moved
+		bool schedule_deferred_requests();
+		void remove_outstanding(BlockRequest*);
+
+	private:
+		StorageDevice& m_device;
+		BAN::UniqPtr<BlockIOScheduler> m_scheduler;
+
+		Mutex m_mutex;
+		// Signaled when requests become available to the workers
+		Semaphore m_semaphore;
+		// Signaled when a request started by transfer() completes
+		Semaphore m_completion_semaphore;
+
+		// Requests given to the scheduler that have not completed yet
+		BAN::Vector<BlockRequest*> m_outstanding;
+		// Requests that conflict with an earlier request, in submission order
+		BAN::Vector<BlockRequest*> m_deferred;
+	};
+
+}
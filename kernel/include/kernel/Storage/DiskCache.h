@@ -15,14 +15,24 @@ namespace Kernel
 		DiskCache(size_t sector_size, StorageDevice&);
 		~DiskCache();
 
-		bool read_from_cache(uint64_t sector, BAN::ByteSpan);
-		BAN::ErrorOr<void> write_to_cache(uint64_t sector, BAN::ConstByteSpan, bool dirty);
+		// Both functions operate on sectors within a single cache page.
+		// read_from_cache returns a mask of sectors (relative to first_sector)
+		// that were found from the cache.
+		uint8_t read_from_cache(uint64_t first_sector, size_t sector_count, BAN::ByteSpan);
+		BAN::ErrorOr<void> write_to_cache(uint64_t first_sector, size_t sector_count, BAN::ConstByteSpan, bool dirty);
+
+		BAN::ErrorOr<void> sync() { return sync(0, UINT64_MAX); }
+		// Writes dirty sectors in [first_sector, first_sector + sector_count) to the device
+		BAN::ErrorOr<void> sync(uint64_t first_sector, uint64_t sector_count);
+		// Drops cached copies of sectors that were written to the device without the cache
+		void invalidate(uint64_t first_sector, uint64_t sector_count);
 
-		BAN::ErrorOr<void> sync();
 		size_t release_clean_pages(size_t);
 		size_t release_pages(size_t);
 		void release_all_pages();
 
+		size_t sectors_per_page() const { return PAGE_SIZE / m_sector_size; }
+
 	private:
 		struct PageCache
 		{
@@ -32,11 +42,17 @@ namespace Kernel
 			uint8_t dirty_mask { 0 };
 		};
 
+		// Returns index of the first page with first_sector >= page_first_sector
+		size_t find_page_index(uint64_t page_first_sector) const;
+
 	private:
+		static constexpr size_t s_sync_cache_pages = 8;
+
 		const size_t m_sector_size;
 		StorageDevice& m_device;
+		// sorted by first_sector
 		BAN::Vector<PageCache> m_cache;
-		BAN::Array<uint8_t, PAGE_SIZE> m_sync_cache;
+		BAN::Array<uint8_t, PAGE_SIZE * s_sync_cache_pages> m_sync_cache;
 	};
 
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <kernel/Lock/Mutex.h>
 #include <kernel/Memory/DMARegion.h>
 #include <kernel/Storage/StorageDevice.h>
 
@@ -25,9 +26,11 @@ namespace Kernel
 
 		virtual BAN::ErrorOr<void> read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan) override;
 		virtual BAN::ErrorOr<void> write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan) override;
+		virtual BlockRequestQueue::SchedulerType request_scheduler_type() const override { return BlockRequestQueue::SchedulerType::FIFO; }
 
 	private:
 		NVMeController& m_controller;
+		Mutex m_dma_mutex;
 		BAN::UniqPtr<DMARegion> m_dma_region;
 
 		const uint32_t m_nsid;
@@ -23,6 +23,13 @@ namespace Kernel
 		virtual BAN::ErrorOr<void> read_blocks(uint64_t first_block, size_t block_count, BAN::ByteSpan) override;
 		virtual BAN::ErrorOr<void> write_blocks(uint64_t first_block, size_t block_count, BAN::ConstByteSpan) override;
 
+		virtual BAN::ErrorOr<void> submit_read_blocks(uint64_t first_block, size_t block_count, BAN::ByteSpan, completion_callback_t) override;
+		virtual BAN::ErrorOr<void> submit_write_blocks(uint64_t first_block, size_t block_count, BAN::ConstByteSpan, completion_callback_t) override;
+
+		virtual BAN::ErrorOr<void> read_blocks_direct(uint64_t first_block, size_t block_count, BAN::ByteSpan) override;
+		virtual BAN::ErrorOr<void> write_blocks_direct(uint64_t first_block, size_t block_count, BAN::ConstByteSpan) override;
+		virtual BAN::ErrorOr<void> sync_blocks(uint64_t first_block, size_t block_count) override;
+
 		virtual BAN::StringView name() const override { return m_name; }
 
 	private:
@@ -43,8 +50,13 @@ namespace Kernel
 
 		virtual dev_t rdev() const override { return m_rdev; }
 
+		virtual bool supports_direct_io() const override { return m_device->supports_direct_io(); }
+
 	protected:
 		virtual BAN::ErrorOr<size_t> read_impl(off_t, BAN::ByteSpan) override;
+		virtual BAN::ErrorOr<size_t> read_direct_impl(off_t, BAN::ByteSpan) override;
+		virtual BAN::ErrorOr<size_t> write_direct_impl(off_t, BAN::ConstByteSpan) override;
+		virtual BAN::ErrorOr<void> fsync_impl(bool) override { return sync_blocks(0, m_last_block - m_first_block + 1); }
 
 		virtual bool can_read_impl() const override { return true; }
 		virtual bool can_write_impl() const override { return true; }
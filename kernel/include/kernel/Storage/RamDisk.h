@@ -0,0 +1,50 @@
+#pragma once
+
+#include <BAN/Vector.h>
+#include <kernel/Lock/Mutex.h>
+#include <kernel/Storage/StorageDevice.h>
+
+namespace Kernel
+{
+
+	// Block device backed by physical pages, which are allocated when first written to
+	class RamDiskDevice final : public StorageDevice
+	{
+	public:
+		// sizes is a comma separated list of disk sizes with optional K, M or G suffix.
+		// If no sizes are given, a single empty disk is created that can be resized with ioctl.
+		static void initialize_devices(BAN::StringView sizes);
+
+		static BAN::ErrorOr<BAN::RefPtr<RamDiskDevice>> create(uint64_t size);
+		~RamDiskDevice();
+
+		virtual uint32_t sector_size() const override { return s_sector_size; }
+		virtual uint64_t total_size() const override { return m_size; }
+
+		virtual dev_t rdev() const override { return m_rdev; }
+		virtual BAN::StringView name() const override { return m_name; }
+
+	protected:
+		virtual BAN::ErrorOr<long> ioctl_impl(int request, void* arg) override;
+
+	private:
+		RamDiskDevice(dev_t minor);
+
+		BAN::ErrorOr<void> resize(uint64_t size);
+
+		virtual BAN::ErrorOr<void> read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan) override;
+		virtual BAN::ErrorOr<void> write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan) override;
+
+	private:
+		static constexpr uint32_t s_sector_size = 512;
+
+		Mutex m_mutex;
+		uint64_t m_size { 0 };
+		// zero for pages that have not been written to
+		BAN::Vector<paddr_t> m_pages;
+
+		char m_name[10] {};
+		const dev_t m_rdev;
+	};
+
+}
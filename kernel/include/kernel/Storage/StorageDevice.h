@@ -3,6 +3,7 @@
 #include <BAN/Vector.h>
 #include <kernel/Device/Device.h>
 #include <kernel/Lock/Mutex.h>
+#include <kernel/Storage/BlockRequestQueue.h>
 #include <kernel/Storage/DiskCache.h>
 #include <kernel/Storage/Partition.h>
 
@@ -19,12 +20,26 @@ namespace Kernel
 
 		BAN::ErrorOr<void> initialize_partitions(BAN::StringView name_prefix);
 
-		virtual BAN::ErrorOr<void> read_blocks(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer) override		{ return read_sectors(lba, sector_count, buffer); }
-		virtual BAN::ErrorOr<void> write_blocks(uint64_t lba, size_t sector_count, BAN::ConstByteSpan buffer) override	{ return write_sectors(lba, sector_count, buffer); }
+		virtual BAN::ErrorOr<void> read_blocks(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer) override;
+		virtual BAN::ErrorOr<void> write_blocks(uint64_t lba, size_t sector_count, BAN::ConstByteSpan buffer) override;
+
+		virtual BAN::ErrorOr<void> submit_read_blocks(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer, completion_callback_t callback) override		{ return submit_read_sectors(lba, sector_count, buffer, callback); }
+		virtual BAN::ErrorOr<void> submit_write_blocks(uint64_t lba, size_t sector_count, BAN::ConstByteSpan buffer, completion_callback_t callback) override	{ return submit_write_sectors(lba, sector_count, buffer, callback); }
+
+		virtual BAN::ErrorOr<void> read_blocks_direct(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer) override		{ return read_sectors_direct(lba, sector_count, buffer); }
+		virtual BAN::ErrorOr<void> write_blocks_direct(uint64_t lba, size_t sector_count, BAN::ConstByteSpan buffer) override	{ return write_sectors_direct(lba, sector_count, buffer); }
+		virtual BAN::ErrorOr<void> sync_blocks(uint64_t lba, size_t sector_count) override { return sync_sectors(lba, sector_count); }
 
 		BAN::ErrorOr<void> read_sectors(uint64_t lba, size_t sector_count, BAN::ByteSpan);
 		BAN::ErrorOr<void> write_sectors(uint64_t lba, size_t sector_count, BAN::ConstByteSpan);
 
+		BAN::ErrorOr<void> submit_read_sectors(uint64_t lba, size_t sector_count, BAN::ByteSpan, completion_callback_t);
+		BAN::ErrorOr<void> submit_write_sectors(uint64_t lba, size_t sector_count, BAN::ConstByteSpan, completion_callback_t);
+
+		BAN::ErrorOr<void> read_sectors_direct(uint64_t lba, size_t sector_count, BAN::ByteSpan);
+		BAN::ErrorOr<void> write_sectors_direct(uint64_t lba, size_t sector_count, BAN::ConstByteSpan);
+		BAN::ErrorOr<void> sync_sectors(uint64_t lba, size_t sector_count);
+
 		virtual blksize_t blksize() const { return sector_size(); }
 		virtual uint32_t sector_size() const = 0;
 		virtual uint64_t total_size() const = 0;
@@ -34,22 +49,35 @@ namespace Kernel
 
 		BAN::ErrorOr<void> sync_disk_cache();
 		virtual bool is_storage_device() const override { return true; }
+		virtual bool supports_direct_io() const override { return true; }
 
 	protected:
 		virtual BAN::ErrorOr<void> read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan) = 0;
 		virtual BAN::ErrorOr<void> write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan) = 0;
 		void add_disk_cache();
 
+		// Number of requests the driver can execute concurrently. read_sectors_impl and
+		// write_sectors_impl must be thread safe if this is greater than one.
+		virtual size_t max_concurrent_requests() const { return 1; }
+		virtual BlockRequestQueue::SchedulerType request_scheduler_type() const { return BlockRequestQueue::SchedulerType::Deadline; }
+
 		virtual BAN::ErrorOr<size_t> read_impl(off_t, BAN::ByteSpan) override;
 		virtual BAN::ErrorOr<size_t> write_impl(off_t, BAN::ConstByteSpan) override;
+		virtual BAN::ErrorOr<size_t> read_direct_impl(off_t, BAN::ByteSpan) override;
+		virtual BAN::ErrorOr<size_t> write_direct_impl(off_t, BAN::ConstByteSpan) override;
+		virtual BAN::ErrorOr<void> fsync_impl(bool) override { return sync_disk_cache(); }
 
 		virtual bool can_read_impl() const override { return true; }
 		virtual bool can_write_impl() const override { return true; }
 		virtual bool has_error_impl() const override { return false; }
 
+	private:
+		BAN::ErrorOr<BlockRequestQueue&> request_queue();
+
 	private:
 		Mutex								m_mutex;
 		BAN::Optional<DiskCache>			m_disk_cache;
+		BAN::UniqPtr<BlockRequestQueue>		m_request_queue;
 		BAN::Vector<BAN::RefPtr<Partition>>	m_partitions;
 
 		friend class DiskCache;
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <BAN/Array.h>
+#include <BAN/Vector.h>
+#include <kernel/Lock/Mutex.h>
+#include <kernel/PCI.h>
+#include <kernel/Storage/StorageController.h>
+#include <kernel/Storage/VirtIO/Definitions.h>
+#include <kernel/Storage/VirtIO/Device.h>
+#include <kernel/Storage/VirtIO/Queue.h>
+
+namespace Kernel
+{
+
+	// virtio-blk over the modern (virtio 1.0+) PCI transport
+	class VirtIOBlockController final : public StorageController
+	{
+		BAN_NON_COPYABLE(VirtIOBlockController);
+		BAN_NON_MOVABLE(VirtIOBlockController);
+
+	public:
+		static BAN::ErrorOr<BAN::RefPtr<StorageController>> create(PCI::Device&);
+		~VirtIOBlockController() { ASSERT_NOT_REACHED(); }
+
+		size_t queue_count() const { return m_queues.size(); }
+		// Each processor submits to its own queue when there are enough of them
+		VirtIOQueue& queue_for_current_processor();
+
+		// Resets the device so it no longer owns any buffers and fails all requests from now on
+		void reset_after_timeout();
+
+	private:
+		VirtIOBlockController(PCI::Device& pci_device)
+			: m_pci_device(pci_device)
+		{ }
+		virtual BAN::ErrorOr<void> initialize() override;
+
+		BAN::ErrorOr<void> find_capabilities();
+		BAN::ErrorOr<vaddr_t> map_capability(uint8_t capability_offset);
+
+		BAN::ErrorOr<void> reset_device();
+		BAN::ErrorOr<void> negotiate_features();
+		BAN::ErrorOr<void> read_block_config(VirtIO::BlockConfig&);
+		BAN::ErrorOr<void> create_queues(uint16_t max_queue_count);
+
+		void set_status_bit(uint8_t);
+
+	private:
+		PCI::Device& m_pci_device;
+		BAN::Array<BAN::UniqPtr<PCI::BarRegion>, 6> m_bars;
+
+		volatile VirtIO::CommonConfig* m_common_config { nullptr };
+		volatile uint8_t* m_isr { nullptr };
+		vaddr_t m_notify_base { 0 };
+		uint32_t m_notify_off_multiplier { 0 };
+		vaddr_t m_device_config { 0 };
+		bool m_has_msi_x { false };
+
+		uint64_t m_features { 0 };
+
+		Mutex m_reset_mutex;
+		bool m_failed { false };
+
+		BAN::Vector<BAN::UniqPtr<VirtIOQueue>> m_queues;
+		BAN::RefPtr<VirtIOBlockDevice> m_device;
+	};
+
+}
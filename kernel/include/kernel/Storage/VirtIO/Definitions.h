@@ -0,0 +1,174 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace Kernel::VirtIO
+{
+
+	static constexpr uint16_t PCI_VENDOR_ID						= 0x1AF4;
+	static constexpr uint16_t PCI_DEVICE_ID_BLOCK_TRANSITIONAL	= 0x1001;
+	static constexpr uint16_t PCI_DEVICE_ID_BLOCK				= 0x1042;
+
+	static constexpr uint8_t PCI_CAPABILITY_VENDOR = 0x09;
+	static constexpr uint8_t PCI_CAPABILITY_MSI_X  = 0x11;
+
+	enum PCICapabilityType : uint8_t
+	{
+		PCI_CAP_COMMON_CFG	= 1,
+		PCI_CAP_NOTIFY_CFG	= 2,
+		PCI_CAP_ISR_CFG		= 3,
+		PCI_CAP_DEVICE_CFG	= 4,
+		PCI_CAP_PCI_CFG		= 5,
+	};
+
+	struct PCICapability
+	{
+		uint8_t cap_vndr;
+		uint8_t cap_next;
+		uint8_t cap_len;
+		uint8_t cfg_type;
+		uint8_t bar;
+		uint8_t id;
+		uint8_t __padding[2];
+		uint32_t offset;
+		uint32_t length;
+	};
+	static_assert(sizeof(PCICapability) == 16);
+
+	// notify_off_multiplier follows the generic capability
+	static constexpr uint8_t PCI_NOTIFY_CAP_MULTIPLIER = sizeof(PCICapability);
+
+	enum DeviceStatus : uint8_t
+	{
+		STATUS_ACKNOWLEDGE			= 1 << 0,
+		STATUS_DRIVER				= 1 << 1,
+		STATUS_DRIVER_OK			= 1 << 2,
+		STATUS_FEATURES_OK			= 1 << 3,
+		STATUS_DEVICE_NEEDS_RESET	= 1 << 6,
+		STATUS_FAILED				= 1 << 7,
+	};
+
+	static constexpr uint64_t FEATURE_VERSION_1 = 1ull << 32;
+
+	static constexpr uint64_t BLK_FEATURE_SIZE_MAX	= 1ull << 1;
+	static constexpr uint64_t BLK_FEATURE_SEG_MAX	= 1ull << 2;
+	static constexpr uint64_t BLK_FEATURE_RO		= 1ull << 5;
+	static constexpr uint64_t BLK_FEATURE_BLK_SIZE	= 1ull << 6;
+	static constexpr uint64_t BLK_FEATURE_FLUSH		= 1ull << 9;
+	static constexpr uint64_t BLK_FEATURE_MQ		= 1ull << 12;
+
+	static constexpr uint16_t NO_VECTOR = 0xFFFF;
+
+	struct CommonConfig
+	{
+		uint32_t device_feature_select;
+		uint32_t device_feature;
+		uint32_t driver_feature_select;
+		uint32_t driver_feature;
+		uint16_t config_msix_vector;
+		uint16_t num_queues;
+		uint8_t  device_status;
+		uint8_t  config_generation;
+
+		uint16_t queue_select;
+		uint16_t queue_size;
+		uint16_t queue_msix_vector;
+		uint16_t queue_enable;
+		uint16_t queue_notify_off;
+		// 64 bit fields are accessed as two 32 bit halves
+		uint32_t queue_desc_lo;
+		uint32_t queue_desc_hi;
+		uint32_t queue_driver_lo;
+		uint32_t queue_driver_hi;
+		uint32_t queue_device_lo;
+		uint32_t queue_device_hi;
+	} __attribute__((packed));
+	static_assert(sizeof(CommonConfig) == 0x38);
+
+	enum VirtqDescriptorFlags : uint16_t
+	{
+		VIRTQ_DESC_F_NEXT	= 1 << 0,
+		VIRTQ_DESC_F_WRITE	= 1 << 1,
+	};
+
+	struct VirtqDescriptor
+	{
+		uint64_t addr;
+		uint32_t len;
+		uint16_t flags;
+		uint16_t next;
+	};
+	static_assert(sizeof(VirtqDescriptor) == 16);
+
+	struct VirtqAvail
+	{
+		uint16_t flags;
+		uint16_t idx;
+		uint16_t ring[];
+	};
+
+	struct VirtqUsedElement
+	{
+		uint32_t id;
+		uint32_t len;
+	};
+
+	struct VirtqUsed
+	{
+		uint16_t flags;
+		uint16_t idx;
+		VirtqUsedElement ring[];
+	};
+
+	struct BlockConfig
+	{
+		uint32_t capacity_lo;
+		uint32_t capacity_hi;
+		uint32_t size_max;
+		uint32_t seg_max;
+		struct
+		{
+			uint16_t cylinders;
+			uint8_t heads;
+			uint8_t sectors;
+		} geometry;
+		uint32_t blk_size;
+		struct
+		{
+			uint8_t physical_block_exp;
+			uint8_t alignment_offset;
+			uint16_t min_io_size;
+			uint32_t opt_io_size;
+		} topology;
+		uint8_t writeback;
+		uint8_t __unused0;
+		uint16_t num_queues;
+	} __attribute__((packed));
+	static_assert(sizeof(BlockConfig) == 36);
+
+	// virtio-blk always addresses the disk in 512 byte sectors
+	static constexpr uint32_t BLK_SECTOR_SIZE = 512;
+
+	enum BlockRequestType : uint32_t
+	{
+		BLK_T_IN	= 0,
+		BLK_T_OUT	= 1,
+		BLK_T_FLUSH	= 4,
+	};
+
+	enum BlockRequestStatus : uint8_t
+	{
+		BLK_S_OK		= 0,
+		BLK_S_IOERR		= 1,
+		BLK_S_UNSUPP	= 2,
+	};
+
+	struct BlockRequestHeader
+	{
+		uint32_t type;
+		uint32_t reserved;
+		uint64_t sector;
+	};
+	static_assert(sizeof(BlockRequestHeader) == 16);
+
+}
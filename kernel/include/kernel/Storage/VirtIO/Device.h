@@ -0,0 +1,46 @@
+#pragma once
+
+#include <kernel/Storage/StorageDevice.h>
+#include <kernel/Storage/VirtIO/Queue.h>
+
+namespace Kernel
+{
+
+	class VirtIOBlockController;
+
+	class VirtIOBlockDevice : public StorageDevice
+	{
+	public:
+		static BAN::ErrorOr<BAN::RefPtr<VirtIOBlockDevice>> create(VirtIOBlockController&, uint64_t capacity, uint32_t block_size);
+
+		virtual uint32_t sector_size() const override { return m_block_size; }
+		virtual uint64_t total_size() const override { return m_capacity * VirtIO::BLK_SECTOR_SIZE; }
+
+		virtual dev_t rdev() const override { return m_rdev; }
+		virtual BAN::StringView name() const { return m_name; }
+
+	private:
+		VirtIOBlockDevice(VirtIOBlockController&, uint64_t capacity, uint32_t block_size);
+		BAN::ErrorOr<void> initialize();
+
+		virtual BAN::ErrorOr<void> read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan) override;
+		virtual BAN::ErrorOr<void> write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan) override;
+		virtual size_t max_concurrent_requests() const override;
+		virtual BlockRequestQueue::SchedulerType request_scheduler_type() const override { return BlockRequestQueue::SchedulerType::FIFO; }
+
+		BAN::ErrorOr<void> transfer_sectors(VirtIO::BlockRequestType, uint64_t lba, uint64_t sector_count, uint8_t* buffer);
+		// Returns the number of sectors described by the data buffers
+		uint64_t prepare_data_buffers(BAN::Vector<VirtIOQueue::Buffer>&, vaddr_t buffer, uint64_t sector_count, bool device_writable);
+
+	private:
+		VirtIOBlockController& m_controller;
+
+		// in 512 byte sectors
+		const uint64_t m_capacity;
+		const uint32_t m_block_size;
+
+		char m_name[10] {};
+		const dev_t m_rdev;
+	};
+
+}
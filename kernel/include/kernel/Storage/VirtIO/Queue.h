@@ -0,0 +1,98 @@
+#pragma once
+
+#include <BAN/Span.h>
+#include <BAN/UniqPtr.h>
+#include <BAN/Vector.h>
+#include <kernel/Interruptable.h>
+#include <kernel/Lock/SpinLock.h>
+#include <kernel/Memory/DMARegion.h>
+#include <kernel/Semaphore.h>
+#include <kernel/Storage/VirtIO/Definitions.h>
+
+namespace Kernel
+{
+
+	// Split virtqueue, see virtio specification section 2.7
+	class VirtIOQueue : public Interruptable
+	{
+		BAN_NON_COPYABLE(VirtIOQueue);
+		BAN_NON_MOVABLE(VirtIOQueue);
+
+	public:
+		struct Buffer
+		{
+			paddr_t paddr;
+			uint32_t size;
+			bool device_writable;
+		};
+
+		// Every descriptor chain owns this many bytes of DMA memory for
+		// request headers and status bytes
+		static constexpr size_t chain_scratch_size = 32;
+
+	public:
+		static BAN::ErrorOr<BAN::UniqPtr<VirtIOQueue>> create(uint16_t queue_size);
+
+		// irq is used if it is not zero, isr is read on every interrupt if it is not null
+		void initialize(volatile uint16_t* notify, uint16_t queue_index, uint8_t irq, volatile uint8_t* isr);
+
+		uint16_t size() const { return m_size; }
+		paddr_t descriptor_area_paddr() const { return m_ring_region->paddr(); }
+		paddr_t driver_area_paddr() const { return m_ring_region->paddr() + m_driver_area_offset; }
+		paddr_t device_area_paddr() const { return m_ring_region->paddr() + m_device_area_offset; }
+
+		// Reserves a chain of descriptor_count descriptors, blocks until enough descriptors are free
+		BAN::ErrorOr<uint16_t> reserve_chain(uint16_t descriptor_count);
+		vaddr_t chain_scratch_vaddr(uint16_t head) const { return m_scratch_region->vaddr() + head * chain_scratch_size; }
+		paddr_t chain_scratch_paddr(uint16_t head) const { return m_scratch_region->paddr() + head * chain_scratch_size; }
+
+		// Fills the reserved chain with buffers, makes it available to the device and
+		// blocks until the device has used it. The chain has to be released once its
+		// scratch memory is no longer needed. On ETIMEDOUT the device still owns the
+		// chain and its buffers until the device has been reset.
+		BAN::ErrorOr<void> submit_chain(uint16_t head, BAN::Span<const Buffer> buffers);
+		void release_chain(uint16_t head);
+
+		// Called after the device has been reset, pending and future requests fail with EIO
+		void mark_dead();
+
+		virtual void handle_irq() final override;
+
+	private:
+		VirtIOQueue(uint16_t queue_size)
+			: m_size(queue_size)
+		{ }
+		BAN::ErrorOr<void> initialize_rings();
+
+		volatile VirtIO::VirtqDescriptor& descriptor(uint16_t index);
+		volatile VirtIO::VirtqAvail& avail();
+		volatile VirtIO::VirtqUsed& used();
+
+		void update_used_ring();
+
+	private:
+		const uint16_t m_size;
+		size_t m_driver_area_offset { 0 };
+		size_t m_device_area_offset { 0 };
+		BAN::UniqPtr<DMARegion> m_ring_region;
+		BAN::UniqPtr<DMARegion> m_scratch_region;
+
+		volatile uint16_t* m_notify { nullptr };
+		uint16_t m_queue_index { 0 };
+		volatile uint8_t* m_isr { nullptr };
+
+		SpinLock m_lock;
+		Semaphore m_semaphore;
+
+		uint16_t m_free_head { 0 };
+		uint16_t m_free_count { 0 };
+		uint16_t m_avail_idx { 0 };
+		uint16_t m_last_used_idx { 0 };
+		bool m_dead { false };
+
+		// indexed by the chain head
+		BAN::Vector<uint16_t> m_chain_lengths;
+		BAN::Vector<uint8_t> m_chain_done;
+	};
+
+}
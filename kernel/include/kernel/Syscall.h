@@ -1,5 +1,6 @@
 #pragma once
 
+#include <kernel/Arch.h>
 #include <kernel/Attributes.h>
 #include <stdint.h>
 #include <sys/syscall.h>
@@ -7,11 +8,45 @@
 namespace Kernel
 {
 
-	ALWAYS_INLINE long syscall(int syscall, uintptr_t arg1 = 0, uintptr_t arg2 = 0, uintptr_t arg3 = 0, uintptr_t arg4 = 0, uintptr_t arg5 = 0)
+	// Legacy entry, still supported by the kernel
+	ALWAYS_INLINE long syscall_int80(int syscall, uintptr_t arg1 = 0, uintptr_t arg2 = 0, uintptr_t arg3 = 0, uintptr_t arg4 = 0, uintptr_t arg5 = 0)
 	{
 		long ret;
 		asm volatile("int $0x80" : "=a"(ret) : "a"(syscall), "b"((uintptr_t)arg1), "c"((uintptr_t)arg2), "d"((uintptr_t)arg3), "S"((uintptr_t)arg4), "D"((uintptr_t)arg5) : "memory");
 		return ret;
 	}
 
+#if ARCH(x86_64)
+	// syscall overwrites RCX with the return address, second argument is passed in R10
+	ALWAYS_INLINE long syscall(int syscall, uintptr_t arg1 = 0, uintptr_t arg2 = 0, uintptr_t arg3 = 0, uintptr_t arg4 = 0, uintptr_t arg5 = 0)
+	{
+		long ret;
+		register uintptr_t r10 asm("r10") = arg2;
+		asm volatile("syscall" : "=a"(ret) : "a"(syscall), "b"(arg1), "r"(r10), "d"(arg3), "S"(arg4), "D"(arg5) : "rcx", "r11", "memory");
+		return ret;
+	}
+#elif ARCH(i686)
+	// sysenter does not save the return address or the stack pointer. Return address
+	// is pushed on the stack, and the kernel returns with sysexit to a ret instruction
+	// using the stack pointer passed in EBP. ECX and EDX are overwritten by sysexit.
+	ALWAYS_INLINE long syscall(int syscall, uintptr_t arg1 = 0, uintptr_t arg2 = 0, uintptr_t arg3 = 0, uintptr_t arg4 = 0, uintptr_t arg5 = 0)
+	{
+		long ret;
+		asm volatile(
+			"pushl %%ebp;"
+			"call 1f;"
+			"jmp 2f;"
+			"1: movl %%esp, %%ebp;"
+			"sysenter;"
+			"2: popl %%ebp;"
+			: "=a"(ret), "+c"(arg2), "+d"(arg3)
+			: "a"(syscall), "b"(arg1), "S"(arg4), "D"(arg5)
+			: "memory"
+		);
+		return ret;
+	}
+#else
+	#error
+#endif
+
 }
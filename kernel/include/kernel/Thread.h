@@ -51,6 +51,8 @@ namespace Kernel
 		BAN::ErrorOr<void> block_or_eintr_indefinite(Semaphore& semaphore);
 		BAN::ErrorOr<void> block_or_eintr_or_timeout(Semaphore& semaphore, uint64_t timeout_ms, bool etimedout);
 		BAN::ErrorOr<void> block_or_eintr_or_waketime(Semaphore& semaphore, uint64_t wake_time_ms, bool etimedout);
+		// returns immediately if semaphore was unblocked after wake_count was read from it
+		BAN::ErrorOr<void> block_or_eintr_or_waketime(Semaphore& semaphore, uint64_t wake_time_ms, bool etimedout, uint32_t wake_count);
 
 		pid_t tid() const { return m_tid; }
 
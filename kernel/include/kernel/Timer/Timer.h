@@ -4,6 +4,7 @@
 #include <BAN/Vector.h>
 #include <kernel/Timer/RTC.h>
 
+#include <sys/banan-os.h>
 #include <time.h>
 
 namespace Kernel
@@ -33,13 +34,28 @@ namespace Kernel
 
 		timespec real_time() const;
 
+		// Read only mapping of the clock page, shared by all processes
+		const clock_page_t* user_clock_page() const { return m_user_clock_page; }
+
+		// Called from the timer interrupt. Calibrates TSC against the system timer
+		// once a second and publishes it in the clock page.
+		void update_clock_page();
+
 	private:
 		SystemTimer() = default;
 
 		void initialize_timers(bool force_pic);
+		void initialize_clock_page();
 
 	private:
 		uint64_t m_boot_time { 0 };
+
+		clock_page_t* m_clock_page { nullptr };
+		const clock_page_t* m_user_clock_page { nullptr };
+		bool m_tsc_unusable { false };
+		uint64_t m_last_update_tsc { 0 };
+		uint64_t m_last_update_ns { 0 };
+
 		BAN::UniqPtr<RTC> m_rtc;
 		BAN::UniqPtr<Timer> m_timer;
 	};
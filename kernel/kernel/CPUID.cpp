@@ -50,6 +50,17 @@ namespace CPUID
 		return buffer[3] & (1 << 20);
 	}
 
+	bool has_invariant_tsc()
+	{
+		uint32_t buffer[4] {};
+		get_cpuid(0x80000000, buffer);
+		if (buffer[0] < 0x80000007)
+			return false;
+
+		get_cpuid(0x80000007, buffer);
+		return buffer[3] & (1 << 8);
+	}
+
 	bool has_pge()
 	{
 		uint32_t ecx, edx;
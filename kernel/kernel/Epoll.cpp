@@ -0,0 +1,331 @@
+#include <kernel/Epoll.h>
+#include <kernel/Lock/LockGuard.h>
+#include <kernel/Thread.h>
+
+namespace Kernel
+{
+
+	// Same limit as Linux's EP_MAX_NESTS
+	static constexpr size_t s_max_nesting_depth = 4;
+	// Protects nesting links between all epolls
+	static Mutex s_nesting_mutex;
+
+	BAN::ErrorOr<BAN::RefPtr<Epoll>> Epoll::create()
+	{
+		auto* epoll_ptr = new Epoll();
+		if (epoll_ptr == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		return BAN::RefPtr<Epoll>::adopt(epoll_ptr);
+	}
+
+	Epoll::~Epoll()
+	{
+		for (auto& [_, interest] : m_interests)
+			remove_interest(*interest);
+	}
+
+	BAN::ErrorOr<void> Epoll::ctl(int op, int fd, BAN::RefPtr<Inode> inode, epoll_event event)
+	{
+		if (inode.ptr() == this)
+			return BAN::Error::from_errno(EINVAL);
+		ASSERT(inode || op == EPOLL_CTL_DEL);
+
+		LockGuard _(m_mutex);
+
+		auto it = m_interests.find(fd);
+
+		// File descriptor was closed in another descriptor set and reused after it was added
+		if (op != EPOLL_CTL_DEL && it != m_interests.end() && it->value->inode.ptr() != inode.ptr())
+		{
+			remove_interest(*it->value);
+			m_interests.remove(it);
+			it = m_interests.end();
+		}
+
+		switch (op)
+		{
+			case EPOLL_CTL_ADD:
+			{
+				if (it != m_interests.end())
+					return BAN::Error::from_errno(EEXIST);
+
+				auto interest = TRY(BAN::UniqPtr<Interest>::create());
+				interest->epoll = this;
+				interest->inode = inode;
+				interest->event = event;
+
+				if (inode->is_epoll())
+				{
+					auto* child = static_cast<Epoll*>(inode.ptr());
+
+					LockGuard _(s_nesting_mutex);
+					TRY(check_nesting(*child));
+					TRY(m_child_epolls.push_back(child));
+					if (auto ret = child->m_parent_epolls.push_back(this); ret.is_error())
+					{
+						m_child_epolls.pop_back();
+						return ret.release_error();
+					}
+				}
+
+				auto* interest_ptr = interest.ptr();
+				if (auto ret = m_interests.insert(fd, BAN::move(interest)); ret.is_error())
+				{
+					if (inode->is_epoll())
+					{
+						LockGuard _(s_nesting_mutex);
+						unlink_nesting(*static_cast<Epoll*>(inode.ptr()));
+					}
+					return ret.release_error();
+				}
+				inode->add_waiter(*interest_ptr);
+
+				// Inode may already be ready
+				queue_ready(*interest_ptr, true);
+				return {};
+			}
+			case EPOLL_CTL_MOD:
+			{
+				if (it == m_interests.end())
+					return BAN::Error::from_errno(ENOENT);
+
+				auto& interest = *it->value;
+				if (interest.inode->is_epoll())
+				{
+					LockGuard _(s_nesting_mutex);
+					TRY(check_nesting(*static_cast<Epoll*>(interest.inode.ptr())));
+				}
+
+				{
+					SpinLockGuard _(m_ready_lock);
+					interest.event = event;
+					interest.disabled = false;
+				}
+
+				queue_ready(interest, true);
+				return {};
+			}
+			case EPOLL_CTL_DEL:
+			{
+				if (it == m_interests.end())
+					return BAN::Error::from_errno(ENOENT);
+				remove_interest(*it->value);
+				m_interests.remove(it);
+				return {};
+			}
+			default:
+				return BAN::Error::from_errno(EINVAL);
+		}
+	}
+
+	void Epoll::remove_closed_fd(int fd, Inode& inode)
+	{
+		LockGuard _(m_mutex);
+
+		auto it = m_interests.find(fd);
+		if (it == m_interests.end() || it->value->inode.ptr() != &inode)
+			return;
+		remove_interest(*it->value);
+		m_interests.remove(it);
+	}
+
+	void Epoll::queue_ready(Interest& interest, bool wake_up)
+	{
+		{
+			SpinLockGuard _(m_ready_lock);
+			if (interest.queued || interest.disabled)
+				return;
+
+			interest.ready_prev = m_ready_tail;
+			interest.ready_next = nullptr;
+			if (m_ready_tail)
+				m_ready_tail->ready_next = &interest;
+			else
+				m_ready_head = &interest;
+			m_ready_tail = &interest;
+
+			interest.queued = true;
+			m_ready_count++;
+		}
+
+		if (!wake_up)
+			return;
+
+		m_semaphore.unblock();
+		notify_waiters();
+	}
+
+	void Epoll::unlink_ready(Interest& interest)
+	{
+		ASSERT(interest.queued);
+
+		if (interest.ready_prev)
+			interest.ready_prev->ready_next = interest.ready_next;
+		else
+			m_ready_head = interest.ready_next;
+		if (interest.ready_next)
+			interest.ready_next->ready_prev = interest.ready_prev;
+		else
+			m_ready_tail = interest.ready_prev;
+
+		interest.ready_prev = nullptr;
+		interest.ready_next = nullptr;
+		interest.queued = false;
+		m_ready_count--;
+	}
+
+	void Epoll::remove_interest(Interest& interest)
+	{
+		// After this the inode can no longer queue the interest
+		interest.inode->remove_waiter(interest);
+
+		if (interest.inode->is_epoll())
+		{
+			LockGuard _(s_nesting_mutex);
+			unlink_nesting(*static_cast<Epoll*>(interest.inode.ptr()));
+		}
+
+		SpinLockGuard _(m_ready_lock);
+		if (interest.queued)
+			unlink_ready(interest);
+	}
+
+	void Epoll::unlink_nesting(Epoll& child)
+	{
+		ASSERT(s_nesting_mutex.is_locked());
+
+		// Same epoll can be watched through multiple file descriptors, only remove one link
+		for (size_t i = 0; i < m_child_epolls.size(); i++)
+		{
+			if (m_child_epolls[i] != &child)
+				continue;
+			m_child_epolls.remove(i);
+			break;
+		}
+		for (size_t i = 0; i < child.m_parent_epolls.size(); i++)
+		{
+			if (child.m_parent_epolls[i] != this)
+				continue;
+			child.m_parent_epolls.remove(i);
+			break;
+		}
+	}
+
+	BAN::ErrorOr<void> Epoll::check_nesting(const Epoll& child) const
+	{
+		ASSERT(s_nesting_mutex.is_locked());
+
+		// Readiness notifications propagate from child to every epoll above it,
+		// a cycle would make them recurse forever
+		if (child.watches_transitively(*this))
+			return BAN::Error::from_errno(ELOOP);
+		if (nesting_depth_above() + 1 + child.nesting_depth_below() > s_max_nesting_depth)
+			return BAN::Error::from_errno(ELOOP);
+		return {};
+	}
+
+	bool Epoll::watches_transitively(const Epoll& epoll) const
+	{
+		if (this == &epoll)
+			return true;
+		for (const auto* child : m_child_epolls)
+			if (child->watches_transitively(epoll))
+				return true;
+		return false;
+	}
+
+	size_t Epoll::nesting_depth_above() const
+	{
+		size_t depth = 0;
+		for (const auto* parent : m_parent_epolls)
+			depth = BAN::Math::max(depth, parent->nesting_depth_above() + 1);
+		return depth;
+	}
+
+	size_t Epoll::nesting_depth_below() const
+	{
+		size_t depth = 0;
+		for (const auto* child : m_child_epolls)
+			depth = BAN::Math::max(depth, child->nesting_depth_below() + 1);
+		return depth;
+	}
+
+	uint32_t Epoll::ready_events_of(Interest& interest)
+	{
+		const uint32_t requested = interest.event.events;
+
+		uint32_t ready = 0;
+		if ((requested & (EPOLLIN | EPOLLRDNORM)) && interest.inode->can_read())
+			ready |= requested & (EPOLLIN | EPOLLRDNORM);
+		if ((requested & (EPOLLOUT | EPOLLWRNORM)) && interest.inode->can_write())
+			ready |= requested & (EPOLLOUT | EPOLLWRNORM);
+		if (interest.inode->has_error())
+			ready |= EPOLLERR;
+		if (interest.inode->has_hungup())
+			ready |= EPOLLHUP;
+		return ready;
+	}
+
+	BAN::ErrorOr<size_t> Epoll::collect_events(BAN::Span<epoll_event> events)
+	{
+		LockGuard _(m_mutex);
+
+		// Level triggered interests are queued back to the tail, only check
+		// interests that were queued before this call so none is reported twice
+		size_t to_check;
+		{
+			SpinLockGuard _(m_ready_lock);
+			to_check = m_ready_count;
+		}
+
+		size_t count = 0;
+		for (; to_check > 0 && count < events.size(); to_check--)
+		{
+			Interest* interest;
+			{
+				SpinLockGuard _(m_ready_lock);
+				interest = m_ready_head;
+				if (interest == nullptr)
+					break;
+				unlink_ready(*interest);
+			}
+
+			const uint32_t ready = ready_events_of(*interest);
+			if (ready == 0)
+				continue;
+
+			events[count].events = ready;
+			events[count].data = interest->event.data;
+			count++;
+
+			if (interest->event.events & EPOLLONESHOT)
+			{
+				SpinLockGuard _(m_ready_lock);
+				interest->disabled = true;
+			}
+			else if (!(interest->event.events & EPOLLET))
+				queue_ready(*interest, false);
+		}
+
+		return count;
+	}
+
+	BAN::ErrorOr<void> Epoll::wait_for_events(uint64_t wake_time_ms)
+	{
+		// Interests are queued before the semaphore is unblocked, so reading the wake
+		// count first makes sure an interest queued after the check wakes us up
+		const uint32_t wake_count = m_semaphore.wake_count();
+		{
+			SpinLockGuard _(m_ready_lock);
+			if (m_ready_count > 0)
+				return {};
+		}
+		return Thread::current().block_or_eintr_or_waketime(m_semaphore, wake_time_ms, false, wake_count);
+	}
+
+	bool Epoll::can_read_impl() const
+	{
+		return m_ready_count > 0;
+	}
+
+}
@@ -0,0 +1,177 @@
+#include <kernel/FS/DentryCache.h>
+#include <kernel/FS/Inode.h>
+#include <kernel/Lock/LockGuard.h>
+
+namespace Kernel
+{
+
+	static DentryCache* s_instance = nullptr;
+
+	void DentryCache::initialize()
+	{
+		ASSERT(s_instance == nullptr);
+		s_instance = new DentryCache();
+		ASSERT(s_instance);
+	}
+
+	DentryCache& DentryCache::get()
+	{
+		ASSERT(s_instance);
+		return *s_instance;
+	}
+
+	BAN::hash_t DentryCache::hash_of(dev_t dev, ino_t parent_ino, BAN::StringView name)
+	{
+		constexpr BAN::hash_t FNV_prime = 0x01000193;
+
+		BAN::hash_t hash = BAN::u64_hash(dev) ^ BAN::u64_hash(parent_ino);
+		for (char c : name)
+		{
+			hash *= FNV_prime;
+			hash ^= static_cast<uint8_t>(c);
+		}
+		return hash;
+	}
+
+	DentryCache::Entry* DentryCache::find_entry(dev_t dev, ino_t parent_ino, BAN::hash_t hash, BAN::StringView name)
+	{
+		for (Entry* entry = m_buckets[hash % s_bucket_count]; entry; entry = entry->hash_next)
+			if (entry->hash == hash && entry->dev == dev && entry->parent_ino == parent_ino && entry->name == name)
+				return entry;
+		return nullptr;
+	}
+
+	void DentryCache::lru_remove(Entry* entry)
+	{
+		if (entry->lru_prev)
+			entry->lru_prev->lru_next = entry->lru_next;
+		else
+			m_lru_head = entry->lru_next;
+		if (entry->lru_next)
+			entry->lru_next->lru_prev = entry->lru_prev;
+		else
+			m_lru_tail = entry->lru_prev;
+		entry->lru_prev = nullptr;
+		entry->lru_next = nullptr;
+	}
+
+	void DentryCache::lru_push_front(Entry* entry)
+	{
+		entry->lru_prev = nullptr;
+		entry->lru_next = m_lru_head;
+		if (m_lru_head)
+			m_lru_head->lru_prev = entry;
+		else
+			m_lru_tail = entry;
+		m_lru_head = entry;
+	}
+
+	void DentryCache::remove_entry(Entry* entry)
+	{
+		Entry** link = &m_buckets[entry->hash % s_bucket_count];
+		while (*link != entry)
+			link = &(*link)->hash_next;
+		*link = entry->hash_next;
+		entry->hash_next = nullptr;
+
+		lru_remove(entry);
+		m_entry_count--;
+	}
+
+	BAN::Optional<BAN::RefPtr<Inode>> DentryCache::lookup(const Inode& parent, BAN::StringView name)
+	{
+		const dev_t dev = parent.dev();
+		const ino_t parent_ino = parent.ino();
+		const BAN::hash_t hash = hash_of(dev, parent_ino, name);
+
+		LockGuard _(m_mutex);
+
+		Entry* entry = find_entry(dev, parent_ino, hash, name);
+		if (entry == nullptr)
+			return {};
+
+		if (entry != m_lru_head)
+		{
+			lru_remove(entry);
+			lru_push_front(entry);
+		}
+
+		return entry->inode;
+	}
+
+	void DentryCache::insert(const Inode& parent, BAN::StringView name, BAN::RefPtr<Inode> inode)
+	{
+		const dev_t dev = parent.dev();
+		const ino_t parent_ino = parent.ino();
+		const BAN::hash_t hash = hash_of(dev, parent_ino, name);
+
+		// Evicted entry is freed after unlocking, dropping the last
+		// reference to an inode may have to write it back to disk
+		Entry* evicted = nullptr;
+
+		{
+			LockGuard _(m_mutex);
+
+			if (Entry* entry = find_entry(dev, parent_ino, hash, name))
+			{
+				// Previous inode is released with the argument, after unlocking
+				auto previous = BAN::move(entry->inode);
+				entry->inode = BAN::move(inode);
+				inode = BAN::move(previous);
+				if (entry != m_lru_head)
+				{
+					lru_remove(entry);
+					lru_push_front(entry);
+				}
+				return;
+			}
+
+			Entry* entry = new Entry();
+			if (entry == nullptr)
+				return;
+			if (entry->name.append(name).is_error())
+			{
+				delete entry;
+				return;
+			}
+			entry->dev = dev;
+			entry->parent_ino = parent_ino;
+			entry->hash = hash;
+			entry->inode = BAN::move(inode);
+
+			if (m_entry_count >= s_max_entries)
+			{
+				evicted = m_lru_tail;
+				remove_entry(evicted);
+			}
+
+			Entry*& bucket = m_buckets[hash % s_bucket_count];
+			entry->hash_next = bucket;
+			bucket = entry;
+			lru_push_front(entry);
+			m_entry_count++;
+		}
+
+		delete evicted;
+	}
+
+	void DentryCache::invalidate(const Inode& parent, BAN::StringView name)
+	{
+		const dev_t dev = parent.dev();
+		const ino_t parent_ino = parent.ino();
+		const BAN::hash_t hash = hash_of(dev, parent_ino, name);
+
+		Entry* entry = nullptr;
+
+		{
+			LockGuard _(m_mutex);
+			entry = find_entry(dev, parent_ino, hash, name);
+			if (entry == nullptr)
+				return;
+			remove_entry(entry);
+		}
+
+		delete entry;
+	}
+
+}
@@ -0,0 +1,41 @@
+#include <kernel/FS/Ext2/Checksum.h>
+
+namespace Kernel::Ext2
+{
+
+	template<typename T>
+	struct CRCTable
+	{
+		// polynomial is bit reversed
+		constexpr CRCTable(T polynomial)
+		{
+			for (size_t i = 0; i < 256; i++)
+			{
+				T crc = i;
+				for (size_t j = 0; j < 8; j++)
+					crc = (crc & 1) ? (crc >> 1) ^ polynomial : crc >> 1;
+				entries[i] = crc;
+			}
+		}
+
+		T entries[256] {};
+	};
+
+	static constexpr CRCTable<uint32_t> s_crc32c_table(0x82F63B78);
+	static constexpr CRCTable<uint16_t> s_crc16_table(0xA001);
+
+	uint32_t crc32c(uint32_t crc, BAN::ConstByteSpan data)
+	{
+		for (size_t i = 0; i < data.size(); i++)
+			crc = (crc >> 8) ^ s_crc32c_table.entries[(crc ^ data[i]) & 0xFF];
+		return crc;
+	}
+
+	uint16_t crc16(uint16_t crc, BAN::ConstByteSpan data)
+	{
+		for (size_t i = 0; i < data.size(); i++)
+			crc = (crc >> 8) ^ s_crc16_table.entries[(crc ^ data[i]) & 0xFF];
+		return crc;
+	}
+
+}
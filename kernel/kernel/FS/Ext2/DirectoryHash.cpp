@@ -0,0 +1,177 @@
+#include <BAN/Optional.h>
+#include <kernel/FS/Ext2/Definitions.h>
+#include <kernel/FS/Ext2/DirectoryHash.h>
+
+#include <string.h>
+
+namespace Kernel::Ext2
+{
+
+	static constexpr uint32_t rotate_left(uint32_t value, uint32_t count)
+	{
+		return (value << count) | (value >> (32 - count));
+	}
+
+	static void tea_transform(uint32_t buf[4], const uint32_t in[4])
+	{
+		constexpr uint32_t delta = 0x9E3779B9;
+
+		uint32_t sum = 0;
+		uint32_t b0 = buf[0], b1 = buf[1];
+		const uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+
+		for (int i = 0; i < 16; i++)
+		{
+			sum += delta;
+			b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+			b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+		}
+
+		buf[0] += b0;
+		buf[1] += b1;
+	}
+
+	static void half_md4_transform(uint32_t buf[4], const uint32_t in[8])
+	{
+		constexpr uint32_t K1 = 0;
+		constexpr uint32_t K2 = 013240474631;
+		constexpr uint32_t K3 = 015666365641;
+
+		const auto F = [](uint32_t x, uint32_t y, uint32_t z) { return z ^ (x & (y ^ z)); };
+		const auto G = [](uint32_t x, uint32_t y, uint32_t z) { return (x & y) + ((x ^ y) & z); };
+		const auto H = [](uint32_t x, uint32_t y, uint32_t z) { return x ^ y ^ z; };
+
+		uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+#define ROUND(f, a, b, c, d, x, s) (a += f(b, c, d) + x, a = rotate_left(a, s))
+		ROUND(F, a, b, c, d, in[0] + K1,  3);
+		ROUND(F, d, a, b, c, in[1] + K1,  7);
+		ROUND(F, c, d, a, b, in[2] + K1, 11);
+		ROUND(F, b, c, d, a, in[3] + K1, 19);
+		ROUND(F, a, b, c, d, in[4] + K1,  3);
+		ROUND(F, d, a, b, c, in[5] + K1,  7);
+		ROUND(F, c, d, a, b, in[6] + K1, 11);
+		ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+		ROUND(G, a, b, c, d, in[1] + K2,  3);
+		ROUND(G, d, a, b, c, in[3] + K2,  5);
+		ROUND(G, c, d, a, b, in[5] + K2,  9);
+		ROUND(G, b, c, d, a, in[7] + K2, 13);
+		ROUND(G, a, b, c, d, in[0] + K2,  3);
+		ROUND(G, d, a, b, c, in[2] + K2,  5);
+		ROUND(G, c, d, a, b, in[4] + K2,  9);
+		ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+		ROUND(H, a, b, c, d, in[3] + K3,  3);
+		ROUND(H, d, a, b, c, in[7] + K3,  9);
+		ROUND(H, c, d, a, b, in[2] + K3, 11);
+		ROUND(H, b, c, d, a, in[6] + K3, 15);
+		ROUND(H, a, b, c, d, in[1] + K3,  3);
+		ROUND(H, d, a, b, c, in[5] + K3,  9);
+		ROUND(H, c, d, a, b, in[0] + K3, 11);
+		ROUND(H, b, c, d, a, in[4] + K3, 15);
+#undef ROUND
+
+		buf[0] += a;
+		buf[1] += b;
+		buf[2] += c;
+		buf[3] += d;
+	}
+
+	template<typename CharT>
+	static uint32_t legacy_hash(BAN::StringView name)
+	{
+		uint32_t hash0 = 0x12A3FE2D;
+		uint32_t hash1 = 0x37ABE8F9;
+
+		for (char ch : name)
+		{
+			uint32_t hash = hash1 + (hash0 ^ (static_cast<int>(static_cast<CharT>(ch)) * 7152373));
+			if (hash & 0x80000000)
+				hash -= 0x7FFFFFFF;
+			hash1 = hash0;
+			hash0 = hash;
+		}
+
+		return hash0 << 1;
+	}
+
+	// Packs the string to num words, padding with the string length
+	template<typename CharT>
+	static void string_to_hash_buffer(const char* message, size_t length, uint32_t* buffer, int num)
+	{
+		uint32_t pad = static_cast<uint32_t>(length) | (static_cast<uint32_t>(length) << 8);
+		pad |= pad << 16;
+
+		uint32_t value = pad;
+		if (length > static_cast<size_t>(num) * 4)
+			length = num * 4;
+
+		for (size_t i = 0; i < length; i++)
+		{
+			value = static_cast<int>(static_cast<CharT>(message[i])) + (value << 8);
+			if (i % 4 == 3)
+			{
+				*buffer++ = value;
+				value = pad;
+				num--;
+			}
+		}
+
+		if (--num >= 0)
+			*buffer++ = value;
+		while (--num >= 0)
+			*buffer++ = pad;
+	}
+
+	template<typename CharT>
+	static uint32_t half_md4_hash(BAN::StringView name, uint32_t buffer[4])
+	{
+		uint32_t in[8];
+		for (size_t offset = 0; offset < name.size(); offset += 32)
+		{
+			string_to_hash_buffer<CharT>(name.data() + offset, name.size() - offset, in, 8);
+			half_md4_transform(buffer, in);
+		}
+		return buffer[1];
+	}
+
+	template<typename CharT>
+	static uint32_t tea_hash(BAN::StringView name, uint32_t buffer[4])
+	{
+		uint32_t in[4];
+		for (size_t offset = 0; offset < name.size(); offset += 16)
+		{
+			string_to_hash_buffer<CharT>(name.data() + offset, name.size() - offset, in, 4);
+			tea_transform(buffer, in);
+		}
+		return buffer[0];
+	}
+
+	BAN::Optional<uint32_t> directory_hash(BAN::StringView name, uint8_t hash_version, const uint32_t seed[4])
+	{
+		uint32_t buffer[4] { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476 };
+		if (seed[0] || seed[1] || seed[2] || seed[3])
+			memcpy(buffer, seed, sizeof(buffer));
+
+		uint32_t hash;
+		switch (hash_version)
+		{
+			case Enum::DX_HASH_LEGACY:				hash = legacy_hash<signed char>(name); break;
+			case Enum::DX_HASH_LEGACY_UNSIGNED:		hash = legacy_hash<unsigned char>(name); break;
+			case Enum::DX_HASH_HALF_MD4:			hash = half_md4_hash<signed char>(name, buffer); break;
+			case Enum::DX_HASH_HALF_MD4_UNSIGNED:	hash = half_md4_hash<unsigned char>(name, buffer); break;
+			case Enum::DX_HASH_TEA:					hash = tea_hash<signed char>(name, buffer); break;
+			case Enum::DX_HASH_TEA_UNSIGNED:		hash = tea_hash<unsigned char>(name, buffer); break;
+			default:
+				return {};
+		}
+
+		// 0xFFFFFFFE is reserved for end of directory
+		hash &= ~1u;
+		if (hash == 0xFFFFFFFE)
+			hash = 0xFFFFFFFC;
+		return hash;
+	}
+
+}
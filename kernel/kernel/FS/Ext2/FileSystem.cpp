@@ -1,6 +1,8 @@
 #include <BAN/ScopeGuard.h>
+#include <kernel/FS/Ext2/Checksum.h>
 #include <kernel/FS/Ext2/FileSystem.h>
 #include <kernel/Lock/LockGuard.h>
+#include <kernel/Memory/kmalloc.h>
 
 #define EXT2_DEBUG_PRINT 0
 #define EXT2_VERIFY_INODE 0
@@ -9,6 +11,43 @@
 namespace Kernel
 {
 
+	static constexpr uint32_t s_preallocation_window_blocks = 32;
+	static constexpr size_t s_max_preallocation_windows = 32;
+
+	// Bits past the end of a group are marked used in bitmaps, fsck expects this padding
+	static void mark_bitmap_end(BAN::Span<uint64_t> bitmap, uint32_t first_bit)
+	{
+		for (uint32_t bit = first_bit; bit < bitmap.size() * 64; bit++)
+			bitmap[bit / 64] |= 1ull << (bit % 64);
+	}
+
+	// Returns the index of the first bit in [first, last) that is clear in both bitmap and mask.
+	// Bitmaps are little endian, so bit n of a word is bit n % 8 of byte n / 8
+	static BAN::Optional<uint32_t> find_zero_bit(BAN::Span<const uint64_t> bitmap, BAN::Span<const uint64_t> mask, uint32_t first, uint32_t last)
+	{
+		for (uint32_t offset = first; offset < last;)
+		{
+			const uint32_t word_index = offset / 64;
+
+			uint64_t used = bitmap[word_index];
+			if (!mask.empty())
+				used |= mask[word_index];
+			used |= (1ull << (offset % 64)) - 1;
+
+			if (~used)
+			{
+				const uint32_t result = word_index * 64 + __builtin_ctzll(~used);
+				if (result >= last)
+					return {};
+				return result;
+			}
+
+			offset = (word_index + 1) * 64;
+		}
+
+		return {};
+	}
+
 	BAN::ErrorOr<bool> Ext2FS::probe(BAN::RefPtr<BlockDevice> block_device)
 	{
 		Ext2::Superblock superblock;
@@ -36,6 +75,7 @@ namespace Kernel
 	{
 		auto ext2fs = TRY(BAN::RefPtr<Ext2FS>::create(block_device));
 		TRY(ext2fs->initialize_superblock());
+		TRY(ext2fs->initialize_block_groups());
 		TRY(ext2fs->initialize_root_inode());
 		return ext2fs;
 	}
@@ -98,6 +138,49 @@ namespace Kernel
 			dwarnln("Required FEATURE_INCOMPAT_RECOVER");
 			return BAN::Error::from_errno(ENOTSUP);
 		}
+		if (m_superblock.feature_incompat & Ext2::Enum::FEATURE_INCOMPAT_INLINE_DATA)
+		{
+			dwarnln("Required FEATURE_INCOMPAT_INLINE_DATA");
+			return BAN::Error::from_errno(ENOTSUP);
+		}
+		if (m_superblock.feature_incompat & Ext2::Enum::FEATURE_INCOMPAT_ENCRYPT)
+		{
+			dwarnln("Required FEATURE_INCOMPAT_ENCRYPT");
+			return BAN::Error::from_errno(ENOTSUP);
+		}
+		if (m_superblock.feature_ro_compat & Ext2::Enum::FEATURE_RO_COMPAT_BIGALLOC)
+		{
+			dwarnln("Required FEATURE_RO_COMPAT_BIGALLOC");
+			return BAN::Error::from_errno(ENOTSUP);
+		}
+
+		if (m_superblock.feature_incompat & Ext2::Enum::FEATURE_INCOMPAT_64BIT)
+		{
+			// block numbers are 32 bit everywhere, so only file systems small enough are supported
+			if (m_superblock.blocks_count_hi)
+			{
+				dwarnln("File systems with more than 2^32 blocks are not supported");
+				return BAN::Error::from_errno(ENOTSUP);
+			}
+			if (m_superblock.desc_size < sizeof(Ext2::BlockGroupDescriptor64) || (m_superblock.desc_size & (m_superblock.desc_size - 1)))
+				return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+			m_bgd_size = m_superblock.desc_size;
+		}
+
+		if (m_superblock.feature_ro_compat & Ext2::Enum::FEATURE_RO_COMPAT_METADATA_CSUM)
+		{
+			// Checksums could not be maintained, writing would leave the file system corrupted
+			if (m_superblock.checksum_type != Ext2::Enum::CHECKSUM_TYPE_CRC32C)
+			{
+				dwarnln("Metadata checksum type {} is not supported, mounting read-only", m_superblock.checksum_type);
+				m_read_only = true;
+			}
+
+			if (m_superblock.feature_incompat & Ext2::Enum::FEATURE_INCOMPAT_CSUM_SEED)
+				m_checksum_seed = m_superblock.checksum_seed;
+			else
+				m_checksum_seed = Ext2::crc32c(0xFFFFFFFF, BAN::ConstByteSpan(m_superblock.uuid, sizeof(m_superblock.uuid)));
+		}
 
 #if EXT2_DEBUG_PRINT
 		dprintln("EXT2");
@@ -110,10 +193,10 @@ namespace Kernel
 		dprintln("  inodes/group  {}", m_superblock.inodes_per_group);
 #endif
 
-		TRY(m_buffer_manager.initialize(block_size()));
+		TRY(m_block_cache.initialize(*m_block_device, block_size()));
 
 		{
-			auto block_buffer = m_buffer_manager.get_buffer();
+			auto block_buffer = TRY(get_block_buffer());
 
 			if (superblock().rev_level == Ext2::Enum::GOOD_OLD_REV)
 			{
@@ -150,174 +233,350 @@ namespace Kernel
 		return {};
 	}
 
+	BAN::ErrorOr<void> Ext2FS::initialize_block_groups()
+	{
+		const uint32_t block_size = this->block_size();
+		const uint32_t group_count = BAN::Math::div_round_up(superblock().blocks_count, superblock().blocks_per_group);
+		const uint32_t table_block_count = BAN::Math::div_round_up<uint32_t>(group_count * m_bgd_size, block_size);
+
+		TRY(m_bgd_table.resize(table_block_count * block_size));
+		TRY(m_block_groups.resize(group_count));
+
+		auto block_buffer = TRY(get_block_buffer());
+
+		const uint32_t first_table_block = locate_block_group_descriptior(0).block;
+		for (uint32_t i = 0; i < table_block_count; i++)
+		{
+			read_block(first_table_block + i, block_buffer);
+			memcpy(m_bgd_table.data() + i * block_size, block_buffer.data(), block_size);
+		}
+
+		if (m_bgd_size >= sizeof(Ext2::BlockGroupDescriptor64))
+		{
+			for (uint32_t group = 0; group < group_count; group++)
+			{
+				const auto& bgd = *reinterpret_cast<const Ext2::BlockGroupDescriptor64*>(m_bgd_table.data() + group * m_bgd_size);
+				if (bgd.block_bitmap_hi || bgd.inode_bitmap_hi || bgd.inode_table_hi)
+					return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+			}
+		}
+
+		return {};
+	}
+
 	BAN::ErrorOr<void> Ext2FS::initialize_root_inode()
 	{
 		m_root_inode = TRY(Ext2Inode::create(*this, Ext2::Enum::ROOT_INO));
 		return {};
 	}
 
-	BAN::ErrorOr<uint32_t> Ext2FS::create_inode(const Ext2::Inode& ext2_inode)
+	BAN::Optional<uint32_t> Ext2FS::find_group_for_directory(uint32_t parent_group, bool parent_is_root)
 	{
-		LockGuard _(m_mutex);
+		// Orlov allocator: top level directories are spread to groups with few directories
+		// and plenty of free space, subdirectories stay close to their parent when possible.
+		const uint32_t group_count = block_group_count();
+		const uint32_t avg_free_inodes = m_superblock.free_inodes_count / group_count;
+		const uint32_t avg_free_blocks = m_superblock.free_blocks_count / group_count;
+
+		const auto has_room =
+			[&](const Ext2::BlockGroupDescriptor& bgd)
+			{
+				return bgd.free_inodes_count > 0 && bgd.free_inodes_count >= avg_free_inodes && bgd.free_blocks_count >= avg_free_blocks;
+			};
 
-		ASSERT(ext2_inode.size == 0);
+		if (!parent_is_root && has_room(block_group_descriptor(parent_group)))
+			return parent_group;
+
+		const uint32_t start_group = parent_is_root ? m_next_top_level_group++ % group_count : parent_group;
+
+		BAN::Optional<uint32_t> best_group;
+		for (uint32_t i = 0; i < group_count; i++)
+		{
+			const uint32_t group = (start_group + i) % group_count;
+			const auto& bgd = block_group_descriptor(group);
+			if (!has_room(bgd))
+				continue;
+			if (!best_group.has_value() || bgd.used_dirs_count < block_group_descriptor(best_group.value()).used_dirs_count)
+				best_group = group;
+		}
+		if (best_group.has_value())
+			return best_group;
+
+		// No group has above average free space, just pick the one with most free inodes
+		for (uint32_t group = 0; group < group_count; group++)
+		{
+			const auto& bgd = block_group_descriptor(group);
+			if (bgd.free_inodes_count == 0)
+				continue;
+			if (!best_group.has_value() || bgd.free_inodes_count > block_group_descriptor(best_group.value()).free_inodes_count)
+				best_group = group;
+		}
+		return best_group;
+	}
+
+	BAN::Optional<uint32_t> Ext2FS::find_group_for_file(uint32_t parent_group)
+	{
+		const uint32_t group_count = block_group_count();
+
+		const auto& parent_bgd = block_group_descriptor(parent_group);
+		if (parent_bgd.free_inodes_count > 0 && parent_bgd.free_blocks_count > 0)
+			return parent_group;
+
+		// Quadratic probing finds a group with both free inodes and blocks quickly
+		uint32_t group = parent_group;
+		for (uint32_t step = 1; step < group_count; step <<= 1)
+		{
+			group = (group + step) % group_count;
+			const auto& bgd = block_group_descriptor(group);
+			if (bgd.free_inodes_count > 0 && bgd.free_blocks_count > 0)
+				return group;
+		}
+
+		for (uint32_t i = 1; i <= group_count; i++)
+		{
+			group = (parent_group + i) % group_count;
+			if (block_group_descriptor(group).free_inodes_count > 0)
+				return group;
+		}
+
+		return {};
+	}
+
+	BAN::ErrorOr<uint32_t> Ext2FS::allocate_inode(bool is_directory, uint32_t parent_ino)
+	{
+		LockGuard _(m_mutex);
 
 		if (m_superblock.free_inodes_count == 0)
 			return BAN::Error::from_errno(ENOSPC);
 
-		const uint32_t block_size = this->block_size();
+		const uint32_t parent_group = (parent_ino - 1) / superblock().inodes_per_group;
 
-		auto bgd_buffer = m_buffer_manager.get_buffer();
-		auto inode_bitmap = m_buffer_manager.get_buffer();
+		auto group = is_directory
+			? find_group_for_directory(parent_group, parent_ino == Ext2::Enum::ROOT_INO)
+			: find_group_for_file(parent_group);
+		if (!group.has_value())
+		{
+			derrorln("Corrupted file system. Superblock indicates free inodes but none were found.");
+			return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+		}
+
+		auto& block_group = TRY_REF(load_inode_bitmap(group.value()));
 
-		uint32_t current_group = -1;
-		BlockLocation bgd_location {};
-		Ext2::BlockGroupDescriptor* bgd = nullptr;
+		// inodes before first_ino are reserved
+		const uint32_t first_ino = superblock().first_ino;
+		const uint32_t group_first_ino = group.value() * superblock().inodes_per_group + 1;
+		const uint32_t first_index = (first_ino > group_first_ino) ? first_ino - group_first_ino : 0;
+		const uint32_t last_index = BAN::Math::min(superblock().inodes_per_group, superblock().inodes_count - group_first_ino + 1);
 
-		for (uint32_t ino = superblock().first_ino; ino <= superblock().inodes_count; ino++)
+		auto ino_index = find_zero_bit(block_group.inode_bitmap.span(), {}, first_index, last_index);
+		if (!ino_index.has_value())
 		{
-			const uint32_t ino_group = (ino - 1) / superblock().inodes_per_group;
-			const uint32_t ino_index = (ino - 1) % superblock().inodes_per_group;
+			derrorln("Corrupted file system. Block group {} indicates free inodes but none were found.", group.value());
+			return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+		}
 
-			if (ino_group != current_group)
-			{
-				current_group = ino_group;
+		block_group.inode_bitmap[ino_index.value() / 64] |= 1ull << (ino_index.value() % 64);
+		block_group.inode_bitmap_dirty = true;
 
-				bgd_location = locate_block_group_descriptior(current_group);
-				read_block(bgd_location.block, bgd_buffer);
+		auto& bgd = block_group_descriptor(group.value());
+		bgd.free_inodes_count--;
+		if (is_directory)
+			bgd.used_dirs_count++;
+		if (m_superblock.feature_ro_compat & (Ext2::Enum::FEATURE_RO_COMPAT_GDT_CSUM | Ext2::Enum::FEATURE_RO_COMPAT_METADATA_CSUM))
+		{
+			// inodes past the last used one are not initialized in the inode table
+			const uint32_t used_inodes = ino_index.value() + 1;
+			if (superblock().inodes_per_group - bgd.itable_unused < used_inodes)
+				bgd.itable_unused = superblock().inodes_per_group - used_inodes;
+		}
+		mark_block_group_dirty(group.value());
 
-				bgd = (Ext2::BlockGroupDescriptor*)(bgd_buffer.data() + bgd_location.offset);
-				if (bgd->free_inodes_count == 0)
-				{
-					ino = superblock().first_ino + (current_group + 1) * superblock().inodes_per_group - 1;
-					continue;
-				}
+		m_superblock.free_inodes_count--;
+		m_superblock_dirty = true;
 
-				read_block(bgd->inode_bitmap, inode_bitmap);
-			}
+		return group_first_ino + ino_index.value();
+	}
 
-			const uint32_t ino_bitmap_byte = ino_index / 8;
-			const uint32_t ino_bitmap_bit  = ino_index % 8;
-			if (inode_bitmap[ino_bitmap_byte] & (1 << ino_bitmap_bit))
-				continue;
+	BAN::ErrorOr<uint32_t> Ext2FS::create_inode(const Ext2::Inode& ext2_inode, uint32_t parent_ino)
+	{
+		ASSERT(ext2_inode.size == 0);
+		ASSERT(parent_ino >= 1 && parent_ino <= superblock().inodes_count);
 
-			inode_bitmap[ino_bitmap_byte] |= 1 << ino_bitmap_bit;
-			write_block(bgd->inode_bitmap, inode_bitmap);
+		const bool is_directory = Inode::Mode(ext2_inode.mode).ifdir();
+		const uint32_t ino = TRY(allocate_inode(is_directory, parent_ino));
 
-			bgd->free_inodes_count--;
-			if (Inode::Mode(ext2_inode.mode).ifdir())
-				bgd->used_dirs_count++;
-			write_block(bgd_location.block, bgd_buffer);
+		Ext2::Inode new_inode = ext2_inode;
+		if ((m_superblock.feature_incompat & Ext2::Enum::FEATURE_INCOMPAT_EXTENTS) && (is_directory || Inode::Mode(ext2_inode.mode).ifreg()))
+		{
+			new_inode.flags |= Ext2::Enum::EXTENTS_FL;
+			memset(new_inode.block, 0, sizeof(new_inode.block));
+			auto& header = *reinterpret_cast<Ext2::ExtentHeader*>(new_inode.block);
+			header.magic = Ext2::Enum::EXTENT_MAGIC;
+			header.entries = 0;
+			header.max = (sizeof(new_inode.block) - sizeof(Ext2::ExtentHeader)) / sizeof(Ext2::Extent);
+			header.depth = 0;
+		}
 
-			const uint32_t inode_table_offset = ino_index * superblock().inode_size;
-			const BlockLocation inode_location
-			{
-				.block  = inode_table_offset / block_size + bgd->inode_table,
-				.offset = inode_table_offset % block_size
-			};
+		{
+			const auto inode_location = locate_inode(ino);
 
-			// NOTE: we don't need inode bitmap anymore, so we can reuse it
-			auto& inode_buffer = inode_bitmap;
+			LockGuard _(inode_table_lock(ino));
 
+			auto inode_buffer = TRY(get_block_buffer());
 			read_block(inode_location.block, inode_buffer);
-			memcpy(inode_buffer.data() + inode_location.offset, &ext2_inode, sizeof(Ext2::Inode));
+			auto raw_inode = inode_buffer.span().slice(inode_location.offset, superblock().inode_size);
+			memcpy(raw_inode.data(), &new_inode, sizeof(Ext2::Inode));
 			if (superblock().inode_size > sizeof(Ext2::Inode))
-				memset(inode_buffer.data() + inode_location.offset + sizeof(Ext2::Inode), 0, superblock().inode_size - sizeof(Ext2::Inode));
+			{
+				memset(raw_inode.data() + sizeof(Ext2::Inode), 0, superblock().inode_size - sizeof(Ext2::Inode));
+				// extra fields have to exist for the high half of the checksum
+				if (superblock().inode_size >= Ext2::INODE_EXTRA_ISIZE_OFFSET + Ext2::INODE_EXTRA_ISIZE)
+					raw_inode.slice(Ext2::INODE_EXTRA_ISIZE_OFFSET).as<uint16_t>() = Ext2::INODE_EXTRA_ISIZE;
+			}
+			update_inode_checksum(ino, raw_inode);
 			write_block(inode_location.block, inode_buffer);
-
-			m_superblock.free_inodes_count--;
-			sync_superblock();
-
-			return ino;
 		}
 
-		derrorln("Corrupted file system. Superblock indicates free inodes but none were found.");
-		return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+		sync_metadata();
+
+		return ino;
 	}
 
 	void Ext2FS::delete_inode(uint32_t ino)
 	{
-		LockGuard _(m_mutex);
-
 		ASSERT(ino >= superblock().first_ino);
 		ASSERT(ino <= superblock().inodes_count);
 
-		auto bgd_buffer = get_block_buffer();
-		auto bitmap_buffer = get_block_buffer();
-		auto inode_buffer = get_block_buffer();
-
 		const uint32_t inode_group = (ino - 1) / superblock().inodes_per_group;
 		const uint32_t inode_index = (ino - 1) % superblock().inodes_per_group;
 
-		auto bgd_location = locate_block_group_descriptior(inode_group);
-		read_block(bgd_location.block, bgd_buffer);
-		auto& bgd = bgd_buffer.span().slice(bgd_location.offset).as<Ext2::BlockGroupDescriptor>();
+		// memset inode to zero or fsck will complain
+		bool is_directory;
+		{
+			const auto inode_location = locate_inode(ino);
 
-		// update inode bitmap
-		read_block(bgd.inode_bitmap, bitmap_buffer);
-		const uint32_t byte = inode_index / 8;
-		const uint32_t bit  = inode_index % 8;
-		ASSERT(bitmap_buffer[byte] & (1 << bit));
-		bitmap_buffer[byte] &= ~(1 << bit);
-		write_block(bgd.inode_bitmap, bitmap_buffer);
+			LockGuard _(inode_table_lock(ino));
 
-		// memset inode to zero or fsck will complain
-		auto inode_location = locate_inode(ino);
-		read_block(inode_location.block, inode_buffer);
-		auto& inode = inode_buffer.span().slice(inode_location.offset).as<Ext2::Inode>();
+			auto inode_buffer = get_block_buffer_blocking();
+			read_block(inode_location.block, inode_buffer);
+			auto& inode = inode_buffer.span().slice(inode_location.offset).as<Ext2::Inode>();
 #if EXT2_VERIFY_NO_BLOCKS
-		static const char zero_buffer[sizeof(inode.block)] {};
-		ASSERT(memcmp(inode.block, zero_buffer, sizeof(inode.block)) == 0);
+			static const char zero_buffer[sizeof(inode.block)] {};
+			ASSERT(memcmp(inode.block, zero_buffer, sizeof(inode.block)) == 0);
 #endif
-		bool is_directory = Inode::Mode(inode.mode).ifdir();
-		memset(&inode, 0x00, m_superblock.inode_size);
-		write_block(inode_location.block, inode_buffer);
+			is_directory = Inode::Mode(inode.mode).ifdir();
+			memset(&inode, 0x00, m_superblock.inode_size);
+			write_block(inode_location.block, inode_buffer);
+		}
 
-		// update bgd counts
-		bgd.free_inodes_count++;
-		if (is_directory)
-			bgd.used_dirs_count--;
-		write_block(bgd_location.block, bgd_buffer);
+		{
+			LockGuard _(m_mutex);
+
+			// update inode bitmap
+			auto& block_group = MUST_REF(load_inode_bitmap(inode_group));
+			const uint64_t mask = 1ull << (inode_index % 64);
+			ASSERT(block_group.inode_bitmap[inode_index / 64] & mask);
+			block_group.inode_bitmap[inode_index / 64] &= ~mask;
+			block_group.inode_bitmap_dirty = true;
+
+			// update bgd counts
+			auto& bgd = block_group_descriptor(inode_group);
+			bgd.free_inodes_count++;
+			if (is_directory)
+				bgd.used_dirs_count--;
+			mark_block_group_dirty(inode_group);
+
+			// update superblock inode count
+			m_superblock.free_inodes_count++;
+			m_superblock_dirty = true;
+		}
 
-		// update superblock inode count
-		m_superblock.free_inodes_count++;
-		sync_superblock();
+		sync_metadata();
 
 		// remove inode from cache
+		LockGuard _(m_inode_cache_mutex);
 		if (m_inode_cache.contains(ino))
 			m_inode_cache.remove(ino);
 	}
 
 	void Ext2FS::read_block(uint32_t block, BlockBufferWrapper& buffer)
 	{
-		LockGuard _(m_mutex);
+		read_block(block, buffer.span());
+	}
 
-		const uint32_t sector_size = m_block_device->blksize();
-		const uint32_t block_size = this->block_size();
-		const uint32_t sectors_per_block = block_size / sector_size;
+	void Ext2FS::write_block(uint32_t block, const BlockBufferWrapper& buffer)
+	{
+		write_block(block, buffer.span());
+	}
 
+	void Ext2FS::read_block(uint32_t block, BAN::ByteSpan buffer)
+	{
 		ASSERT(block >= superblock().first_data_block + 1);
-		ASSERT(buffer.size() >= block_size);
-		MUST(m_block_device->read_blocks(block * sectors_per_block, sectors_per_block, buffer.span()));
+		ASSERT(buffer.size() >= block_size());
+		MUST(m_block_cache.read_block(block, buffer));
 	}
 
-	void Ext2FS::write_block(uint32_t block, const BlockBufferWrapper& buffer)
+	void Ext2FS::write_block(uint32_t block, BAN::ConstByteSpan buffer)
 	{
-		LockGuard _(m_mutex);
+		ASSERT(block >= superblock().first_data_block + 1);
+		ASSERT(buffer.size() >= block_size());
+		MUST(m_block_cache.write_block(block, buffer));
+	}
 
-		const uint32_t sector_size = m_block_device->blksize();
-		const uint32_t block_size = this->block_size();
-		const uint32_t sectors_per_block = block_size / sector_size;
+	BAN::ErrorOr<void> Ext2FS::read_blocks(uint32_t first_block, uint32_t block_count, BAN::ByteSpan buffer)
+	{
+		const uint32_t sectors_per_block = block_size() / m_block_device->blksize();
 
-		ASSERT(block >= superblock().first_data_block + 1);
-		ASSERT(buffer.size() >= block_size);
-		MUST(m_block_device->write_blocks(block * sectors_per_block, sectors_per_block, buffer.span()));
+		ASSERT(first_block >= superblock().first_data_block + 1);
+		ASSERT(first_block + block_count <= superblock().blocks_count);
+		ASSERT(buffer.size() >= block_count * block_size());
+		return m_block_device->read_blocks(first_block * sectors_per_block, block_count * sectors_per_block, buffer);
 	}
 
-	void Ext2FS::sync_superblock()
+	BAN::ErrorOr<void> Ext2FS::write_blocks(uint32_t first_block, uint32_t block_count, BAN::ConstByteSpan buffer)
 	{
-		LockGuard _(m_mutex);
+		const uint32_t sectors_per_block = block_size() / m_block_device->blksize();
+
+		ASSERT(first_block >= superblock().first_data_block + 1);
+		ASSERT(first_block + block_count <= superblock().blocks_count);
+		ASSERT(buffer.size() >= block_count * block_size());
+		auto result = m_block_device->write_blocks(first_block * sectors_per_block, block_count * sectors_per_block, buffer);
+		m_block_cache.invalidate(first_block, block_count);
+		return result;
+	}
+
+	BAN::ErrorOr<void> Ext2FS::read_blocks_direct(uint32_t first_block, uint32_t block_count, BAN::ByteSpan buffer)
+	{
+		const uint32_t sectors_per_block = block_size() / m_block_device->blksize();
 
+		ASSERT(first_block >= superblock().first_data_block + 1);
+		ASSERT(first_block + block_count <= superblock().blocks_count);
+		ASSERT(buffer.size() >= block_count * block_size());
+		return m_block_device->read_blocks_direct(first_block * sectors_per_block, block_count * sectors_per_block, buffer);
+	}
+
+	BAN::ErrorOr<void> Ext2FS::write_blocks_direct(uint32_t first_block, uint32_t block_count, BAN::ConstByteSpan buffer)
+	{
+		const uint32_t sectors_per_block = block_size() / m_block_device->blksize();
+
+		ASSERT(first_block >= superblock().first_data_block + 1);
+		ASSERT(first_block + block_count <= superblock().blocks_count);
+		ASSERT(buffer.size() >= block_count * block_size());
+		auto result = m_block_device->write_blocks_direct(first_block * sectors_per_block, block_count * sectors_per_block, buffer);
+		m_block_cache.invalidate(first_block, block_count);
+		return result;
+	}
+
+	BAN::ErrorOr<void> Ext2FS::sync_blocks(uint32_t first_block, uint32_t block_count)
+	{
+		const uint32_t sectors_per_block = block_size() / m_block_device->blksize();
+
+		ASSERT(first_block + block_count <= superblock().blocks_count);
+		return m_block_device->sync_blocks(first_block * sectors_per_block, block_count * sectors_per_block);
+	}
+
+	void Ext2FS::sync_superblock()
+	{
 		const uint32_t sector_size = m_block_device->blksize();
 		ASSERT(1024 % sector_size == 0);
 
@@ -329,78 +588,390 @@ namespace Kernel
 		const uint32_t lba = 1024 / sector_size;
 		const uint32_t sector_count = BAN::Math::div_round_up<uint32_t>(superblock_bytes, sector_size);
 
-		auto superblock_buffer = get_block_buffer();
+		auto superblock_buffer = get_block_buffer_blocking();
 
 		MUST(m_block_device->read_blocks(lba, sector_count, superblock_buffer.span()));
-		if (memcmp(superblock_buffer.data(), &m_superblock, superblock_bytes))
+
 		{
+			LockGuard _(m_mutex);
+			update_superblock_checksum();
+			if (memcmp(superblock_buffer.data(), &m_superblock, superblock_bytes) == 0)
+				return;
 			memcpy(superblock_buffer.data(), &m_superblock, superblock_bytes);
-			MUST(m_block_device->write_blocks(lba, sector_count, superblock_buffer.span()));
+		}
+
+		MUST(m_block_device->write_blocks(lba, sector_count, superblock_buffer.span()));
+	}
+
+	BAN::ErrorOr<Ext2FS::BlockBufferWrapper> Ext2FS::get_block_buffer()
+	{
+		return m_block_cache.get_buffer();
+	}
+
+	Ext2FS::BlockBufferWrapper Ext2FS::get_block_buffer_blocking()
+	{
+		return m_block_cache.get_buffer_blocking();
+	}
+
+	uint32_t Ext2FS::blocks_in_block_group(uint32_t group) const
+	{
+		const uint32_t first_block = m_superblock.first_data_block + m_superblock.blocks_per_group * group;
+		return BAN::Math::min(m_superblock.blocks_per_group, m_superblock.blocks_count - first_block);
+	}
+
+	Ext2::BlockGroupDescriptor& Ext2FS::block_group_descriptor(uint32_t group)
+	{
+		ASSERT(group < block_group_count());
+		return *reinterpret_cast<Ext2::BlockGroupDescriptor*>(m_bgd_table.data() + group * m_bgd_size);
+	}
+
+	void Ext2FS::mark_block_group_dirty(uint32_t group)
+	{
+		m_block_groups[group].descriptor_dirty = true;
+	}
+
+	uint32_t Ext2FS::inode_checksum_seed(uint32_t ino, uint32_t generation) const
+	{
+		const uint32_t seed = Ext2::crc32c(m_checksum_seed, BAN::ConstByteSpan::from(ino));
+		return Ext2::crc32c(seed, BAN::ConstByteSpan::from(generation));
+	}
+
+	void Ext2FS::update_inode_checksum(uint32_t ino, BAN::ByteSpan raw_inode) const
+	{
+		if (!has_metadata_checksums())
+			return;
+
+		ASSERT(raw_inode.size() == superblock().inode_size);
+
+		const auto& inode = raw_inode.as<const Ext2::Inode>();
+
+		// high half of the checksum is only present if extra_isize covers it
+		bool has_checksum_hi = false;
+		if (raw_inode.size() > Ext2::INODE_CHECKSUM_HI_OFFSET)
+			has_checksum_hi = raw_inode.slice(Ext2::INODE_EXTRA_ISIZE_OFFSET).as<const uint16_t>() >= 4;
+
+		raw_inode.slice(Ext2::INODE_CHECKSUM_LO_OFFSET).as<uint16_t>() = 0;
+		if (has_checksum_hi)
+			raw_inode.slice(Ext2::INODE_CHECKSUM_HI_OFFSET).as<uint16_t>() = 0;
+
+		const uint32_t checksum = Ext2::crc32c(inode_checksum_seed(ino, inode.generation), raw_inode);
+
+		raw_inode.slice(Ext2::INODE_CHECKSUM_LO_OFFSET).as<uint16_t>() = checksum & 0xFFFF;
+		if (has_checksum_hi)
+			raw_inode.slice(Ext2::INODE_CHECKSUM_HI_OFFSET).as<uint16_t>() = checksum >> 16;
+	}
+
+	void Ext2FS::update_superblock_checksum()
+	{
+		if (!has_metadata_checksums())
+			return;
+		auto superblock_bytes = BAN::ConstByteSpan::from(m_superblock);
+		m_superblock.checksum = Ext2::crc32c(0xFFFFFFFF, superblock_bytes.slice(0, offsetof(Ext2::Superblock, checksum)));
+	}
+
+	void Ext2FS::update_block_group_descriptor_checksum(uint32_t group)
+	{
+		if (!has_group_descriptor_checksums())
+			return;
+
+		auto& bgd = block_group_descriptor(group);
+
+		// the checksum covers the descriptor with its own field skipped
+		const uint32_t checksum_offset = offsetof(Ext2::BlockGroupDescriptor, checksum);
+		auto descriptor = BAN::ConstByteSpan(m_bgd_table.data() + group * m_bgd_size, m_bgd_size);
+
+		if (has_metadata_checksums())
+		{
+			const uint16_t zero = 0;
+			uint32_t checksum = Ext2::crc32c(m_checksum_seed, BAN::ConstByteSpan::from(group));
+			checksum = Ext2::crc32c(checksum, descriptor.slice(0, checksum_offset));
+			checksum = Ext2::crc32c(checksum, BAN::ConstByteSpan::from(zero));
+			if (m_bgd_size > sizeof(Ext2::BlockGroupDescriptor))
+				checksum = Ext2::crc32c(checksum, descriptor.slice(sizeof(Ext2::BlockGroupDescriptor)));
+			bgd.checksum = checksum & 0xFFFF;
+		}
+		else
+		{
+			uint16_t checksum = Ext2::crc16(0xFFFF, BAN::ConstByteSpan(m_superblock.uuid, sizeof(m_superblock.uuid)));
+			checksum = Ext2::crc16(checksum, BAN::ConstByteSpan::from(group));
+			checksum = Ext2::crc16(checksum, descriptor.slice(0, checksum_offset));
+			if (m_bgd_size > sizeof(Ext2::BlockGroupDescriptor))
+				checksum = Ext2::crc16(checksum, descriptor.slice(sizeof(Ext2::BlockGroupDescriptor)));
+			bgd.checksum = checksum;
+		}
+	}
+
+	void Ext2FS::update_bitmap_checksum(uint32_t group, BAN::ConstByteSpan bitmap, bool is_inode_bitmap)
+	{
+		if (!has_metadata_checksums())
+			return;
+
+		// only bits of the group's blocks or inodes are covered, not the padding
+		const uint32_t bitmap_bytes = is_inode_bitmap
+			? superblock().inodes_per_group / 8
+			: superblock().blocks_per_group / 8;
+		const uint32_t checksum = Ext2::crc32c(m_checksum_seed, bitmap.slice(0, bitmap_bytes));
+
+		auto& bgd = block_group_descriptor(group);
+		auto* bgd64 = (m_bgd_size >= sizeof(Ext2::BlockGroupDescriptor64))
+			? reinterpret_cast<Ext2::BlockGroupDescriptor64*>(&bgd)
+			: nullptr;
+
+		if (is_inode_bitmap)
+		{
+			bgd.inode_bitmap_csum = checksum & 0xFFFF;
+			if (bgd64)
+				bgd64->inode_bitmap_csum_hi = checksum >> 16;
+		}
+		else
+		{
+			bgd.block_bitmap_csum = checksum & 0xFFFF;
+			if (bgd64)
+				bgd64->block_bitmap_csum_hi = checksum >> 16;
+		}
+
+		mark_block_group_dirty(group);
+	}
+
+	BAN::ErrorOr<Ext2FS::BlockGroup&> Ext2FS::load_inode_bitmap(uint32_t group)
+	{
+		LockGuard _(m_mutex);
+
+		auto& block_group = m_block_groups[group];
+		if (!block_group.inode_bitmap.empty())
+			return block_group;
+
+		BAN::Vector<uint64_t> inode_bitmap;
+		TRY(inode_bitmap.resize(block_size() / sizeof(uint64_t)));
+
+		// uninitialized inode bitmap means no inodes are used
+		if (block_group_descriptor(group).flags & Ext2::Enum::BG_INODE_UNINIT)
+		{
+			memset(inode_bitmap.data(), 0, block_size());
+			mark_bitmap_end(inode_bitmap.span(), superblock().inodes_per_group);
+		}
+		else
+		{
+			auto block_buffer = TRY(get_block_buffer());
+			read_block(block_group_descriptor(group).inode_bitmap, block_buffer);
+			memcpy(inode_bitmap.data(), block_buffer.data(), block_size());
+		}
+
+		block_group.inode_bitmap = BAN::move(inode_bitmap);
+		return block_group;
+	}
+
+	void Ext2FS::initialize_uninit_block_bitmap(uint32_t group, BAN::Vector<uint64_t>& block_bitmap)
+	{
+		// Uninitialized block bitmap only contains metadata. With flex_bg metadata of
+		// other groups can also be located in this group.
+		memset(block_bitmap.data(), 0, block_bitmap.size() * sizeof(uint64_t));
+		mark_bitmap_end(block_bitmap.span(), blocks_in_block_group(group));
+
+		const auto mark_used =
+			[&](uint32_t block)
+			{
+				if (block < m_superblock.first_data_block)
+					return;
+				if ((block - m_superblock.first_data_block) / m_superblock.blocks_per_group != group)
+					return;
+				const uint32_t offset = (block - m_superblock.first_data_block) % m_superblock.blocks_per_group;
+				block_bitmap[offset / 64] |= 1ull << (offset % 64);
+			};
+
+		const uint32_t group_first_block = m_superblock.first_data_block + m_superblock.blocks_per_group * group;
+		if (group == 0 || m_superblock_backups.contains(group))
+		{
+			const uint32_t table_blocks = BAN::Math::div_round_up<uint32_t>(block_group_count() * m_bgd_size, block_size());
+			for (uint32_t i = 0; i < 1 + table_blocks + m_superblock.reserved_gdt_blocks; i++)
+				mark_used(group_first_block + i);
+		}
+
+		const uint32_t inode_table_blocks = BAN::Math::div_round_up<uint32_t>(m_superblock.inodes_per_group * m_superblock.inode_size, block_size());
+		for (uint32_t i = 0; i < block_group_count(); i++)
+		{
+			const auto& bgd = block_group_descriptor(i);
+			mark_used(bgd.block_bitmap);
+			mark_used(bgd.inode_bitmap);
+			for (uint32_t j = 0; j < inode_table_blocks; j++)
+				mark_used(bgd.inode_table + j);
 		}
 	}
 
-	Ext2FS::BlockBufferWrapper Ext2FS::get_block_buffer()
+	BAN::ErrorOr<Ext2FS::BlockGroup&> Ext2FS::load_block_bitmap(uint32_t group)
 	{
 		LockGuard _(m_mutex);
-		return m_buffer_manager.get_buffer();
+
+		auto& block_group = m_block_groups[group];
+		if (!block_group.block_bitmap.empty())
+			return block_group;
+
+		const uint32_t words = block_size() / sizeof(uint64_t);
+
+		BAN::Vector<uint64_t> block_bitmap;
+		BAN::Vector<uint64_t> reserved_blocks;
+		TRY(block_bitmap.resize(words));
+		TRY(reserved_blocks.resize(words, 0));
+
+		if (block_group_descriptor(group).flags & Ext2::Enum::BG_BLOCK_UNINIT)
+			initialize_uninit_block_bitmap(group, block_bitmap);
+		else
+		{
+			auto block_buffer = TRY(get_block_buffer());
+			read_block(block_group_descriptor(group).block_bitmap, block_buffer);
+			memcpy(block_bitmap.data(), block_buffer.data(), block_size());
+		}
+
+		block_group.block_bitmap = BAN::move(block_bitmap);
+		block_group.reserved_blocks = BAN::move(reserved_blocks);
+		return block_group;
+	}
+
+	BAN::Optional<uint32_t> Ext2FS::find_free_block_in_group(const BlockGroup& block_group, uint32_t first, uint32_t last, bool skip_reserved) const
+	{
+		if (skip_reserved)
+			return find_zero_bit(block_group.block_bitmap.span(), block_group.reserved_blocks.span(), first, last);
+		return find_zero_bit(block_group.block_bitmap.span(), {}, first, last);
+	}
+
+	void Ext2FS::mark_block_used(uint32_t group, uint32_t offset)
+	{
+		auto& block_group = m_block_groups[group];
+
+		const uint64_t mask = 1ull << (offset % 64);
+		ASSERT(!(block_group.block_bitmap[offset / 64] & mask));
+		block_group.block_bitmap[offset / 64] |= mask;
+		block_group.block_bitmap_dirty = true;
+
+		block_group_descriptor(group).free_blocks_count--;
+		mark_block_group_dirty(group);
+
+		m_superblock.free_blocks_count--;
+		m_superblock_dirty = true;
 	}
 
-	BAN::ErrorOr<uint32_t> Ext2FS::reserve_free_block(uint32_t primary_bgd)
+	void Ext2FS::create_preallocation_window(PreallocationWindow& window, uint32_t group, uint32_t first_offset)
+	{
+		ASSERT(window.block_count == 0);
+
+		auto& block_group = m_block_groups[group];
+		const uint32_t last_offset = BAN::Math::min(first_offset + s_preallocation_window_blocks, blocks_in_block_group(group));
+
+		uint32_t count = 0;
+		for (uint32_t offset = first_offset; offset < last_offset; offset++, count++)
+		{
+			const uint64_t mask = 1ull << (offset % 64);
+			if ((block_group.block_bitmap[offset / 64] | block_group.reserved_blocks[offset / 64]) & mask)
+				break;
+			block_group.reserved_blocks[offset / 64] |= mask;
+		}
+
+		if (count == 0)
+			return;
+
+		window.first_block = m_superblock.first_data_block + m_superblock.blocks_per_group * group + first_offset;
+		window.block_count = count;
+
+		for (auto* other : m_preallocation_windows)
+			if (other == &window)
+				return;
+
+		if (m_preallocation_windows.size() >= s_max_preallocation_windows)
+			release_preallocation_window(*m_preallocation_windows.front());
+		if (m_preallocation_windows.push_back(&window).is_error())
+			release_preallocation_window(window);
+	}
+
+	void Ext2FS::release_preallocation_window(PreallocationWindow& window)
+	{
+		LockGuard _(m_mutex);
+
+		for (uint32_t i = 0; i < window.block_count; i++)
+		{
+			const uint32_t block = window.first_block + i;
+			const uint32_t group  = (block - m_superblock.first_data_block) / m_superblock.blocks_per_group;
+			const uint32_t offset = (block - m_superblock.first_data_block) % m_superblock.blocks_per_group;
+			m_block_groups[group].reserved_blocks[offset / 64] &= ~(1ull << (offset % 64));
+		}
+		window.block_count = 0;
+
+		for (size_t i = 0; i < m_preallocation_windows.size(); i++)
+		{
+			if (m_preallocation_windows[i] != &window)
+				continue;
+			m_preallocation_windows.remove(i);
+			break;
+		}
+	}
+
+	BAN::ErrorOr<uint32_t> Ext2FS::reserve_free_block(uint32_t primary_bgd, PreallocationWindow* window, uint32_t goal_block)
 	{
 		LockGuard _(m_mutex);
 
 		if (m_superblock.r_blocks_count >= m_superblock.free_blocks_count)
 			return BAN::Error::from_errno(ENOSPC);
 
-		auto bgd_buffer = m_buffer_manager.get_buffer();
-		auto block_bitmap = m_buffer_manager.get_buffer();
-
-		auto check_block_group =
-			[&](uint32_t block_group) -> uint32_t
-			{
-				auto bgd_location = locate_block_group_descriptior(block_group);
-				read_block(bgd_location.block, bgd_buffer);
+		if (window && window->block_count > 0)
+		{
+			const uint32_t block = window->first_block;
+			const uint32_t group  = (block - m_superblock.first_data_block) / m_superblock.blocks_per_group;
+			const uint32_t offset = (block - m_superblock.first_data_block) % m_superblock.blocks_per_group;
 
-				auto& bgd = *(Ext2::BlockGroupDescriptor*)(bgd_buffer.data() + bgd_location.offset);
-				if (bgd.free_blocks_count == 0)
-					return 0;
+			auto& block_group = m_block_groups[group];
+			const uint64_t mask = 1ull << (offset % 64);
 
-				read_block(bgd.block_bitmap, block_bitmap);
-				for (uint32_t block_offset = 0; block_offset < m_superblock.blocks_per_group; block_offset++)
-				{
-					const uint32_t fs_block_index = m_superblock.first_data_block + m_superblock.blocks_per_group * block_group + block_offset;
-					if (fs_block_index >= m_superblock.blocks_count)
-						break;
+			// Reserved blocks are only taken by others when there are no other free blocks left
+			if (!(block_group.block_bitmap[offset / 64] & mask))
+			{
+				block_group.reserved_blocks[offset / 64] &= ~mask;
+				window->first_block++;
+				window->block_count--;
+				mark_block_used(group, offset);
+				return block;
+			}
 
-					uint32_t byte = block_offset / 8;
-					uint32_t bit  = block_offset % 8;
-					if (block_bitmap[byte] & (1 << bit))
-						continue;
+			release_preallocation_window(*window);
+			goal_block = block;
+		}
 
-					block_bitmap[byte] |= 1 << bit;
-					write_block(bgd.block_bitmap, block_bitmap);
+		uint32_t goal_group = primary_bgd;
+		uint32_t goal_offset = 0;
+		if (goal_block >= m_superblock.first_data_block && goal_block < m_superblock.blocks_count)
+		{
+			goal_group  = (goal_block - m_superblock.first_data_block) / m_superblock.blocks_per_group;
+			goal_offset = (goal_block - m_superblock.first_data_block) % m_superblock.blocks_per_group;
+		}
+		if (goal_group >= block_group_count())
+			goal_group = 0;
 
-					bgd.free_blocks_count--;
-					write_block(bgd_location.block, bgd_buffer);
+		// First try to leave other inodes' preallocation windows untouched
+		for (int pass = 0; pass < 2; pass++)
+		{
+			const bool skip_reserved = (pass == 0);
+			for (uint32_t i = 0; i < block_group_count(); i++)
+			{
+				const uint32_t group = (goal_group + i) % block_group_count();
+				if (block_group_descriptor(group).free_blocks_count == 0)
+					continue;
 
-					m_superblock.free_blocks_count--;
-					sync_superblock();
+				auto& block_group = TRY_REF(load_block_bitmap(group));
 
-					return fs_block_index;
-				}
+				const uint32_t group_blocks = blocks_in_block_group(group);
+				const uint32_t first_offset = (i == 0) ? BAN::Math::min(goal_offset, group_blocks) : 0;
 
-				derrorln("Corrupted file system. Block group descriptor indicates free blocks but none were found");
-				return 0;
-			};
+				auto offset = find_free_block_in_group(block_group, first_offset, group_blocks, skip_reserved);
+				if (!offset.has_value() && first_offset > 0)
+					offset = find_free_block_in_group(block_group, 0, first_offset, skip_reserved);
+				if (!offset.has_value())
+					continue;
 
-		if (auto ret = check_block_group(primary_bgd))
-			return ret;
+				mark_block_used(group, offset.value());
+				if (window && skip_reserved)
+					create_preallocation_window(*window, group, offset.value() + 1);
 
-		uint32_t number_of_block_groups = BAN::Math::div_round_up(m_superblock.blocks_count, m_superblock.blocks_per_group);
-		for (uint32_t block_group = 0; block_group < number_of_block_groups; block_group++)
-			if (block_group != primary_bgd)
-				if (auto ret = check_block_group(block_group))
-					return ret;
+				return m_superblock.first_data_block + m_superblock.blocks_per_group * group + offset.value();
+			}
+		}
 
 		derrorln("Corrupted file system. Superblock indicates free blocks but none were found.");
 		return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
@@ -416,47 +987,149 @@ namespace Kernel
 		const uint32_t block_group = (block - m_superblock.first_data_block) / m_superblock.blocks_per_group;
 		const uint32_t block_offset = (block - m_superblock.first_data_block) % m_superblock.blocks_per_group;
 
-		auto bgd_buffer = get_block_buffer();
-		auto bitmap_buffer = get_block_buffer();
+		auto& group = MUST_REF(load_block_bitmap(block_group));
 
-		auto bgd_location = locate_block_group_descriptior(block_group);
-		read_block(bgd_location.block, bgd_buffer);
+		const uint64_t mask = 1ull << (block_offset % 64);
+		ASSERT(group.block_bitmap[block_offset / 64] & mask);
+		group.block_bitmap[block_offset / 64] &= ~mask;
+		group.block_bitmap_dirty = true;
 
-		auto& bgd = bgd_buffer.span().slice(bgd_location.offset).as<Ext2::BlockGroupDescriptor>();
-		read_block(bgd.block_bitmap, bitmap_buffer);
+		block_group_descriptor(block_group).free_blocks_count++;
+		mark_block_group_dirty(block_group);
 
-		const uint32_t byte = block_offset / 8;
-		const uint32_t bit  = block_offset % 8;
-		ASSERT(bitmap_buffer[byte] & (1 << bit));
+		m_superblock.free_blocks_count++;
+		m_superblock_dirty = true;
+	}
 
-		bitmap_buffer[byte] &= ~(1 << bit);
-		write_block(bgd.block_bitmap, bitmap_buffer);
+	void Ext2FS::sync_metadata()
+	{
+		// NOTE: m_mutex must not be held here, metadata is copied with it locked
+		//       and written after unlocking, so allocations are not blocked by the writes
+		LockGuard _(m_metadata_sync_mutex);
+
+		const uint32_t block_size = this->block_size();
+		const uint32_t descriptors_per_block = block_size / m_bgd_size;
+		const uint32_t first_table_block = locate_block_group_descriptior(0).block;
 
-		bgd.free_blocks_count++;
-		write_block(bgd_location.block, bgd_buffer);
+		auto block_buffer = get_block_buffer_blocking();
 
-		m_superblock.free_blocks_count++;
-		sync_superblock();
+		// Copies the next dirty bitmap or descriptor table block to block_buffer and
+		// returns where it should be written, bitmaps go first as they can dirty descriptors
+		uint32_t next_group = 0;
+		uint32_t next_table_group = 0;
+		const auto copy_next_dirty_block =
+			[&]() -> BAN::Optional<uint32_t>
+			{
+				LockGuard _(m_mutex);
+
+				for (; next_group < block_group_count(); next_group++)
+				{
+					auto& block_group = m_block_groups[next_group];
+					auto& bgd = block_group_descriptor(next_group);
+					if (block_group.block_bitmap_dirty)
+					{
+						memcpy(block_buffer.data(), block_group.block_bitmap.data(), block_size);
+						block_group.block_bitmap_dirty = false;
+						update_bitmap_checksum(next_group, block_buffer.span(), false);
+						if (bgd.flags & Ext2::Enum::BG_BLOCK_UNINIT)
+						{
+							bgd.flags &= ~Ext2::Enum::BG_BLOCK_UNINIT;
+							mark_block_group_dirty(next_group);
+						}
+						return bgd.block_bitmap;
+					}
+					if (block_group.inode_bitmap_dirty)
+					{
+						memcpy(block_buffer.data(), block_group.inode_bitmap.data(), block_size);
+						block_group.inode_bitmap_dirty = false;
+						update_bitmap_checksum(next_group, block_buffer.span(), true);
+						if (bgd.flags & Ext2::Enum::BG_INODE_UNINIT)
+						{
+							bgd.flags &= ~Ext2::Enum::BG_INODE_UNINIT;
+							mark_block_group_dirty(next_group);
+						}
+						return bgd.inode_bitmap;
+					}
+				}
+
+				// Descriptors are written one table block at a time
+				for (; next_table_group < block_group_count(); next_table_group += descriptors_per_block)
+				{
+					const uint32_t last_group = BAN::Math::min(next_table_group + descriptors_per_block, block_group_count());
+
+					bool dirty = false;
+					for (uint32_t group = next_table_group; group < last_group; group++)
+					{
+						if (!m_block_groups[group].descriptor_dirty)
+							continue;
+						update_block_group_descriptor_checksum(group);
+						m_block_groups[group].descriptor_dirty = false;
+						dirty = true;
+					}
+					if (!dirty)
+						continue;
+
+					const uint32_t table_block = next_table_group / descriptors_per_block;
+					memcpy(block_buffer.data(), m_bgd_table.data() + table_block * block_size, block_size);
+					next_table_group += descriptors_per_block;
+					return first_table_block + table_block;
+				}
+
+				return {};
+			};
+
+		for (;;)
+		{
+			const auto block = copy_next_dirty_block();
+			if (!block.has_value())
+				break;
+			write_block(block.value(), block_buffer);
+		}
+
+		bool superblock_dirty;
+		{
+			LockGuard _(m_mutex);
+			superblock_dirty = m_superblock_dirty;
+			m_superblock_dirty = false;
+		}
+		if (superblock_dirty)
+			sync_superblock();
 	}
 
-	Ext2FS::BlockLocation Ext2FS::locate_inode(uint32_t ino)
+	BAN::ErrorOr<void> Ext2FS::sync_metadata_blocks()
 	{
-		LockGuard _(m_mutex);
+		const uint32_t sector_size = m_block_device->blksize();
+		TRY(m_block_device->sync_blocks(1024 / sector_size, BAN::Math::div_round_up<uint32_t>(1024, sector_size)));
+
+		const uint32_t table_block_count = m_bgd_table.size() / block_size();
+		TRY(sync_blocks(locate_block_group_descriptior(0).block, table_block_count));
+
+		for (uint32_t group = 0; group < block_group_count(); group++)
+		{
+			uint32_t block_bitmap, inode_bitmap;
+			{
+				LockGuard _(m_mutex);
+				const auto& bgd = block_group_descriptor(group);
+				block_bitmap = bgd.block_bitmap;
+				inode_bitmap = bgd.inode_bitmap;
+			}
+			TRY(sync_blocks(block_bitmap, 1));
+			TRY(sync_blocks(inode_bitmap, 1));
+		}
+
+		return {};
+	}
 
+	Ext2FS::BlockLocation Ext2FS::locate_inode(uint32_t ino)
+	{
 		ASSERT(ino <= superblock().inodes_count);
 
 		const uint32_t block_size = this->block_size();
 
-		auto bgd_buffer = m_buffer_manager.get_buffer();
-
 		const uint32_t inode_group = (ino - 1) / superblock().inodes_per_group;
 		const uint32_t inode_index = (ino - 1) % superblock().inodes_per_group;
 
-		auto bgd_location = locate_block_group_descriptior(inode_group);
-
-		read_block(bgd_location.block, bgd_buffer);
-
-		auto& bgd = *(Ext2::BlockGroupDescriptor*)(bgd_buffer.data() + bgd_location.offset);
+		auto& bgd = block_group_descriptor(inode_group);
 
 		const uint32_t inode_byte_offset = inode_index * superblock().inode_size;
 		BlockLocation location
@@ -466,16 +1139,8 @@ namespace Kernel
 		};
 
 #if EXT2_VERIFY_INODE
-		const uint32_t inode_bitmap_block = bgd.inode_bitmap;
-
-		// NOTE: we can reuse the bgd_buffer since it is not needed anymore
-		auto& inode_bitmap = bgd_buffer;
-
-		read_block(inode_bitmap_block, inode_bitmap.span());
-
-		const uint32_t byte = inode_index / 8;
-		const uint32_t bit  = inode_index % 8;
-		ASSERT(inode_bitmap[byte] & (1 << bit));
+		auto& block_group = MUST_REF(load_inode_bitmap(inode_group));
+		ASSERT(block_group.inode_bitmap[inode_index / 64] & (1ull << (inode_index % 64)));
 #endif
 
 		return location;
@@ -483,15 +1148,13 @@ namespace Kernel
 
 	Ext2FS::BlockLocation Ext2FS::locate_block_group_descriptior(uint32_t group_index)
 	{
-		LockGuard _(m_mutex);
-
 		const uint32_t block_size = this->block_size();
 
 		const uint32_t block_group_count = BAN::Math::div_round_up(superblock().inodes_count, superblock().inodes_per_group);
 		ASSERT(group_index < block_group_count);
 
 		// Block Group Descriptor table is in the block after superblock
-		const uint32_t bgd_byte_offset = (superblock().first_data_block + 1) * block_size + sizeof(Ext2::BlockGroupDescriptor) * group_index;
+		const uint32_t bgd_byte_offset = (superblock().first_data_block + 1) * block_size + m_bgd_size * group_index;
 
 		return
 		{
@@ -500,26 +1163,328 @@ namespace Kernel
 		};
 	}
 
-	Ext2FS::BlockBufferWrapper Ext2FS::BlockBufferManager::get_buffer()
+	Ext2FS::BlockBufferWrapper::~BlockBufferWrapper()
 	{
-		for (auto& buffer : m_buffers)
+		if (m_block_buffer)
+			m_cache->release_buffer(*m_block_buffer);
+	}
+
+	Ext2FS::BlockCache::~BlockCache()
+	{
+		for (auto& entry : m_cached_blocks)
+			destroy_buffer(entry.value);
+		m_cached_blocks.clear();
+		for (auto* buffer : m_free_buffers)
+			destroy_buffer(buffer);
+		m_free_buffers.clear();
+	}
+
+	BAN::ErrorOr<void> Ext2FS::BlockCache::initialize(BlockDevice& block_device, uint32_t block_size)
+	{
+		LockGuard _(m_mutex);
+
+		m_block_device = &block_device;
+		m_block_size = block_size;
+		m_sectors_per_block = block_size / block_device.blksize();
+		m_max_cached_blocks = BAN::Math::max<size_t>(s_max_cached_bytes / block_size, 1);
+
+		// Free list never needs to allocate after this
+		TRY(m_free_buffers.reserve(s_max_free_buffers));
+		for (size_t i = 0; i < s_max_free_buffers; i++)
 		{
-			if (buffer.used)
-				continue;
-			buffer.used = true;
-			return Ext2FS::BlockBufferWrapper(buffer.buffer.span(), buffer.used);
+			auto* buffer = allocate_buffer();
+			if (buffer == nullptr)
+				return BAN::Error::from_errno(ENOMEM);
+			MUST(m_free_buffers.push_back(buffer));
 		}
-		ASSERT_NOT_REACHED();
+
+		return {};
 	}
 
-	BAN::ErrorOr<void> Ext2FS::BlockBufferManager::initialize(size_t block_size)
+	Ext2FS::BlockBuffer* Ext2FS::BlockCache::take_scratch_buffer()
 	{
-		for (auto& buffer : m_buffers)
+		ASSERT(m_mutex.is_locked());
+
+		BlockBuffer* buffer = nullptr;
+		if (!m_free_buffers.empty())
 		{
-			TRY(buffer.buffer.resize(block_size));
-			buffer.used = false;
+			buffer = m_free_buffers.back();
+			m_free_buffers.pop_back();
 		}
+		else
+		{
+			buffer = allocate_buffer();
+		}
+
+		if (buffer)
+			buffer->ref_count = 1;
+		return buffer;
+	}
+
+	Ext2FS::BlockBuffer* Ext2FS::BlockCache::allocate_buffer()
+	{
+		ASSERT(m_mutex.is_locked());
+
+		if (auto* buffer = new BlockBuffer())
+		{
+			buffer->data = static_cast<uint8_t*>(kmalloc(m_block_size));
+			if (buffer->data)
+				return buffer;
+			delete buffer;
+		}
+
+		// Out of memory, reuse the least recently used cached block
+		if (m_lru_tail == nullptr)
+			return nullptr;
+		auto* buffer = m_lru_tail;
+		uncache(*buffer);
+		return buffer;
+	}
+
+	void Ext2FS::BlockCache::free_buffer(BlockBuffer* buffer)
+	{
+		ASSERT(m_mutex.is_locked());
+		ASSERT(!buffer->cached && buffer->ref_count == 0);
+
+		buffer->loading = false;
+		buffer->stale = false;
+
+		if (m_free_buffers.size() < s_max_free_buffers)
+			MUST(m_free_buffers.push_back(buffer));
+		else
+			destroy_buffer(buffer);
+	}
+
+	void Ext2FS::BlockCache::destroy_buffer(BlockBuffer* buffer)
+	{
+		kfree(buffer->data);
+		delete buffer;
+	}
+
+	Ext2FS::BlockBuffer* Ext2FS::BlockCache::take_cache_buffer(uint32_t block)
+	{
+		ASSERT(m_mutex.is_locked());
+		ASSERT(!m_cached_blocks.contains(block));
+
+		BlockBuffer* buffer = nullptr;
+		if (m_cached_blocks.size() >= m_max_cached_blocks && m_lru_tail)
+		{
+			buffer = m_lru_tail;
+			uncache(*buffer);
+		}
+		else if (!m_free_buffers.empty())
+		{
+			buffer = m_free_buffers.back();
+			m_free_buffers.pop_back();
+		}
+		else
+		{
+			buffer = allocate_buffer();
+		}
+
+		if (buffer == nullptr)
+			return nullptr;
+
+		if (m_cached_blocks.insert(block, buffer).is_error())
+		{
+			free_buffer(buffer);
+			return nullptr;
+		}
+
+		buffer->block = block;
+		buffer->cached = true;
+		return buffer;
+	}
+
+	void Ext2FS::BlockCache::uncache(BlockBuffer& buffer)
+	{
+		ASSERT(m_mutex.is_locked());
+		ASSERT(buffer.cached);
+
+		if (buffer.ref_count == 0)
+			lru_remove(buffer);
+		m_cached_blocks.remove(buffer.block);
+		buffer.cached = false;
+	}
+
+	void Ext2FS::BlockCache::lru_push_front(BlockBuffer& buffer)
+	{
+		buffer.lru_prev = nullptr;
+		buffer.lru_next = m_lru_head;
+		if (m_lru_head)
+			m_lru_head->lru_prev = &buffer;
+		m_lru_head = &buffer;
+		if (m_lru_tail == nullptr)
+			m_lru_tail = &buffer;
+	}
+
+	void Ext2FS::BlockCache::lru_remove(BlockBuffer& buffer)
+	{
+		if (buffer.lru_prev)
+			buffer.lru_prev->lru_next = buffer.lru_next;
+		else
+			m_lru_head = buffer.lru_next;
+		if (buffer.lru_next)
+			buffer.lru_next->lru_prev = buffer.lru_prev;
+		else
+			m_lru_tail = buffer.lru_prev;
+		buffer.lru_prev = nullptr;
+		buffer.lru_next = nullptr;
+	}
+
+	BAN::ErrorOr<Ext2FS::BlockBufferWrapper> Ext2FS::BlockCache::get_buffer()
+	{
+		LockGuard _(m_mutex);
+
+		auto* buffer = take_scratch_buffer();
+		if (buffer == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		return BlockBufferWrapper(*this, *buffer, BAN::ByteSpan(buffer->data, m_block_size));
+	}
+
+	Ext2FS::BlockBufferWrapper Ext2FS::BlockCache::get_buffer_blocking()
+	{
+		for (;;)
+		{
+			uint32_t wake_count;
+
+			{
+				LockGuard _(m_mutex);
+				wake_count = m_buffer_semaphore.wake_count();
+				if (auto* buffer = take_scratch_buffer())
+					return BlockBufferWrapper(*this, *buffer, BAN::ByteSpan(buffer->data, m_block_size));
+				m_buffer_waiters++;
+			}
+
+			dwarnln_if(EXT2_DEBUG_PRINT, "out of block buffers, waiting for one to be released");
+			m_buffer_semaphore.block_with_wake_time(BAN::numeric_limits<uint64_t>::max(), wake_count);
+
+			LockGuard _(m_mutex);
+			m_buffer_waiters--;
+		}
+	}
+
+	void Ext2FS::BlockCache::release_buffer(BlockBuffer& buffer)
+	{
+		LockGuard _(m_mutex);
+
+		ASSERT(buffer.ref_count > 0);
+		if (--buffer.ref_count > 0)
+			return;
+
+		if (buffer.cached)
+			lru_push_front(buffer);
+		else
+			free_buffer(&buffer);
+
+		if (m_buffer_waiters > 0)
+			m_buffer_semaphore.unblock();
+	}
+
+	BAN::ErrorOr<void> Ext2FS::BlockCache::read_block(uint32_t block, BAN::ByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= m_block_size);
+
+		BlockBuffer* cache_buffer = nullptr;
+
+		{
+			LockGuard _(m_mutex);
+
+			auto it = m_cached_blocks.find(block);
+			if (it == m_cached_blocks.end())
+			{
+				cache_buffer = take_cache_buffer(block);
+				if (cache_buffer)
+				{
+					cache_buffer->ref_count = 1;
+					cache_buffer->loading = true;
+				}
+			}
+			else if (!it->value->loading)
+			{
+				auto& cached = *it->value;
+				memcpy(buffer.data(), cached.data, m_block_size);
+				lru_remove(cached);
+				lru_push_front(cached);
+				return {};
+			}
+
+			// NOTE: if another thread is loading the block, it is read directly from the device
+		}
+
+		if (cache_buffer == nullptr)
+			return m_block_device->read_blocks(block * m_sectors_per_block, m_sectors_per_block, buffer);
+
+		auto result = m_block_device->read_blocks(block * m_sectors_per_block, m_sectors_per_block, BAN::ByteSpan(cache_buffer->data, m_block_size));
+
+		LockGuard _(m_mutex);
+
+		cache_buffer->loading = false;
+		if (!result.is_error())
+			memcpy(buffer.data(), cache_buffer->data, m_block_size);
+		if (result.is_error() || cache_buffer->stale)
+			uncache(*cache_buffer);
+		release_buffer(*cache_buffer);
+
+		return result;
+	}
+
+	BAN::ErrorOr<void> Ext2FS::BlockCache::write_block(uint32_t block, BAN::ConstByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= m_block_size);
+
+		if (auto result = m_block_device->write_blocks(block * m_sectors_per_block, m_sectors_per_block, buffer); result.is_error())
+		{
+			invalidate(block, 1);
+			return result;
+		}
+
+		LockGuard _(m_mutex);
+
+		auto it = m_cached_blocks.find(block);
+		if (it == m_cached_blocks.end())
+		{
+			if (auto* cache_buffer = take_cache_buffer(block))
+			{
+				memcpy(cache_buffer->data, buffer.data(), m_block_size);
+				lru_push_front(*cache_buffer);
+			}
+		}
+		else if (it->value->loading)
+		{
+			it->value->stale = true;
+		}
+		else
+		{
+			auto& cached = *it->value;
+			memcpy(cached.data, buffer.data(), m_block_size);
+			lru_remove(cached);
+			lru_push_front(cached);
+		}
+
 		return {};
 	}
 
+	void Ext2FS::BlockCache::invalidate(uint32_t first_block, uint32_t block_count)
+	{
+		LockGuard _(m_mutex);
+
+		for (uint32_t block = first_block; block < first_block + block_count && !m_cached_blocks.empty(); block++)
+		{
+			auto it = m_cached_blocks.find(block);
+			if (it == m_cached_blocks.end())
+				continue;
+
+			auto* cached = it->value;
+			if (cached->loading)
+			{
+				cached->stale = true;
+				continue;
+			}
+
+			uncache(*cached);
+			free_buffer(cached);
+		}
+	}
+
 }
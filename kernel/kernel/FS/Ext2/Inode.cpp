@@ -1,7 +1,11 @@
 #include <BAN/Function.h>
 #include <BAN/ScopeGuard.h>
+#include <BAN/Sort.h>
+#include <kernel/FS/Ext2/Checksum.h>
+#include <kernel/FS/Ext2/DirectoryHash.h>
 #include <kernel/FS/Ext2/FileSystem.h>
 #include <kernel/FS/Ext2/Inode.h>
+#include <kernel/Lock/LockGuard.h>
 #include <kernel/Timer/Timer.h>
 
 namespace Kernel
@@ -17,19 +21,26 @@ namespace Kernel
 		return m_inode.blocks / (2 << m_fs.superblock().log_block_size);
 	}
 
+	dev_t Ext2Inode::dev() const
+	{
+		return m_fs.dev();
+	}
+
 	uint32_t Ext2Inode::block_group() const
 	{
-		return (m_ino - 1) / m_fs.superblock().blocks_per_group;
+		return (m_ino - 1) / m_fs.superblock().inodes_per_group;
 	}
 
 	BAN::ErrorOr<BAN::RefPtr<Ext2Inode>> Ext2Inode::create(Ext2FS& fs, uint32_t inode_ino)
 	{
+		LockGuard _(fs.m_inode_cache_mutex);
+
 		if (fs.inode_cache().contains(inode_ino))
 			return fs.inode_cache()[inode_ino];
 
 		auto inode_location = fs.locate_inode(inode_ino);
 
-		auto block_buffer = fs.get_block_buffer();
+		auto block_buffer = TRY(fs.get_block_buffer());
 		fs.read_block(inode_location.block, block_buffer);
 
 		auto& inode = block_buffer.span().slice(inode_location.offset).as<Ext2::Inode>();
@@ -41,56 +52,296 @@ namespace Kernel
 
 	Ext2Inode::~Ext2Inode()
 	{
-		if (m_inode.links_count == 0)
+		m_fs.release_preallocation_window(m_preallocation);
+		if (m_inode.links_count == 0 && !m_fs.is_read_only())
 			cleanup_from_fs();
 	}
 
-	BAN::Optional<uint32_t> Ext2Inode::block_from_indirect_block(uint32_t block, uint32_t index, uint32_t depth)
+	BAN::Optional<Ext2Inode::BlockMapping> Ext2Inode::find_cached_mapping(uint32_t data_block_index) const
+	{
+		size_t l = 0, r = m_block_map_cache.size();
+		while (l < r)
+		{
+			const size_t mid = (l + r) / 2;
+			const auto& mapping = m_block_map_cache[mid];
+			if (data_block_index < mapping.data_block)
+				r = mid;
+			else if (data_block_index >= mapping.data_block + mapping.block_count)
+				l = mid + 1;
+			else
+			{
+				const uint32_t skip = data_block_index - mapping.data_block;
+				return BlockMapping {
+					.data_block = data_block_index,
+					.fs_block = mapping.fs_block + skip,
+					.block_count = mapping.block_count - skip,
+				};
+			}
+		}
+		return {};
+	}
+
+	void Ext2Inode::cache_block_mapping(BlockMapping mapping)
+	{
+		static constexpr size_t max_cached_mappings = 128;
+
+		size_t index = 0;
+		while (index < m_block_map_cache.size() && m_block_map_cache[index].data_block < mapping.data_block)
+			index++;
+
+		// overlapping mappings are always the same, so just drop the new one
+		if (index > 0)
+		{
+			const auto& prev = m_block_map_cache[index - 1];
+			if (prev.data_block + prev.block_count > mapping.data_block)
+				return;
+		}
+		if (index < m_block_map_cache.size() && m_block_map_cache[index].data_block < mapping.data_block + mapping.block_count)
+			return;
+
+		const auto is_contiguous =
+			[](const BlockMapping& a, const BlockMapping& b)
+			{
+				return a.data_block + a.block_count == b.data_block && a.fs_block + a.block_count == b.fs_block;
+			};
+
+		if (index > 0 && is_contiguous(m_block_map_cache[index - 1], mapping))
+		{
+			auto& prev = m_block_map_cache[index - 1];
+			prev.block_count += mapping.block_count;
+			if (index < m_block_map_cache.size() && is_contiguous(prev, m_block_map_cache[index]))
+			{
+				prev.block_count += m_block_map_cache[index].block_count;
+				m_block_map_cache.remove(index);
+			}
+			return;
+		}
+
+		if (index < m_block_map_cache.size() && is_contiguous(mapping, m_block_map_cache[index]))
+		{
+			auto& next = m_block_map_cache[index];
+			next.data_block = mapping.data_block;
+			next.fs_block = mapping.fs_block;
+			next.block_count += mapping.block_count;
+			return;
+		}
+
+		if (m_block_map_cache.size() >= max_cached_mappings)
+		{
+			m_block_map_cache.clear();
+			index = 0;
+		}
+
+		// cache is only an optimization
+		if (m_block_map_cache.insert(index, mapping).is_error())
+			m_block_map_cache.clear();
+	}
+
+	BAN::Optional<Ext2Inode::BlockMapping> Ext2Inode::resolve_from_indirect_block(uint32_t block, uint32_t data_block_index, uint32_t index, uint32_t depth)
 	{
 		if (block == 0)
 			return {};
 		ASSERT(depth >= 1);
 
-		auto block_buffer = m_fs.get_block_buffer();
-		m_fs.read_block(block, block_buffer);
-
 		const uint32_t indices_per_block = blksize() / sizeof(uint32_t);
 
-		const uint32_t divisor = (depth > 1) ? indices_per_block * (depth - 1) : 1;
+		uint32_t divisor = 1;
+		for (uint32_t i = 1; i < depth; i++)
+			divisor *= indices_per_block;
+
+		uint32_t next_block;
+		uint32_t block_count = 1;
+
+		// NOTE: buffer is released before recursing, so at most one is held at a time
+		{
+			auto block_buffer = m_fs.get_block_buffer_blocking();
+			m_fs.read_block(block, block_buffer);
+
+			const auto entries = block_buffer.span().as_span<uint32_t>();
+			const uint32_t entry_index = (index / divisor) % indices_per_block;
+
+			next_block = entries[entry_index];
+
+			// The whole indirect block is already in memory, so find the contiguous run
+			if (next_block != 0 && depth == 1)
+				while (entry_index + block_count < indices_per_block && entries[entry_index + block_count] == next_block + block_count)
+					block_count++;
+		}
 
-		const uint32_t next_block = block_buffer.span().as_span<uint32_t>()[(index / divisor) % indices_per_block];
 		if (next_block == 0)
 			return {};
-		if (depth == 1)
-			return next_block;
+		if (depth > 1)
+			return resolve_from_indirect_block(next_block, data_block_index, index, depth - 1);
 
-		return block_from_indirect_block(next_block, index, depth - 1);
+		return BlockMapping {
+			.data_block = data_block_index,
+			.fs_block = next_block,
+			.block_count = block_count,
+		};
 	}
 
-	BAN::Optional<uint32_t> Ext2Inode::fs_block_of_data_block_index(uint32_t data_block_index)
+	static Ext2::ExtentHeader& extent_header(BAN::ByteSpan node)
 	{
-		const uint32_t indices_per_block = blksize() / sizeof(uint32_t);
+		return node.as<Ext2::ExtentHeader>();
+	}
+
+	template<typename T>
+	static T* extent_entries(BAN::ByteSpan node)
+	{
+		return reinterpret_cast<T*>(node.data() + sizeof(Ext2::ExtentHeader));
+	}
+
+	// Both extents and indices start with the first logical block they cover
+	static uint32_t& extent_entry_key(BAN::ByteSpan node, uint32_t index)
+	{
+		static_assert(offsetof(Ext2::Extent, block) == 0 && offsetof(Ext2::ExtentIndex, block) == 0);
+		return *reinterpret_cast<uint32_t*>(node.data() + sizeof(Ext2::ExtentHeader) + index * sizeof(Ext2::Extent));
+	}
+
+	// Returns the last entry starting at or before data_block_index
+	static BAN::Optional<uint32_t> find_extent_entry(BAN::ByteSpan node, uint32_t data_block_index)
+	{
+		uint32_t l = 0, r = extent_header(node).entries;
+		while (l < r)
+		{
+			const uint32_t mid = (l + r) / 2;
+			if (extent_entry_key(node, mid) <= data_block_index)
+				l = mid + 1;
+			else
+				r = mid;
+		}
+		if (l == 0)
+			return {};
+		return l - 1;
+	}
+
+	static uint32_t extent_length(const Ext2::Extent& extent)
+	{
+		if (extent.len > Ext2::Enum::EXTENT_MAX_INIT_LEN)
+			return extent.len - Ext2::Enum::EXTENT_MAX_INIT_LEN;
+		return extent.len;
+	}
+
+	void Ext2Inode::read_extent_node(uint32_t node_block, BAN::ByteSpan buffer)
+	{
+		if (node_block == 0)
+			memcpy(buffer.data(), m_inode.block, sizeof(m_inode.block));
+		else
+			m_fs.read_block(node_block, buffer);
+	}
+
+	void Ext2Inode::write_extent_node(uint32_t node_block, BAN::ByteSpan buffer)
+	{
+		if (node_block == 0)
+		{
+			memcpy(m_inode.block, buffer.data(), sizeof(m_inode.block));
+			return;
+		}
+
+		// Tail follows the last possible entry, root in the inode is covered by the inode checksum
+		if (m_fs.has_metadata_checksums())
+		{
+			const uint32_t tail_offset = sizeof(Ext2::ExtentHeader) + extent_header(buffer).max * sizeof(Ext2::Extent);
+			ASSERT(tail_offset + sizeof(Ext2::ExtentTail) <= m_fs.block_size());
+			const uint32_t checksum = Ext2::crc32c(m_fs.inode_checksum_seed(ino(), m_inode.generation), buffer.slice(0, tail_offset));
+			buffer.slice(tail_offset).as<Ext2::ExtentTail>().checksum = checksum;
+		}
 
-		if (data_block_index < 12)
+		m_fs.write_block(node_block, buffer);
+	}
+
+	BAN::Optional<Ext2Inode::BlockMapping> Ext2Inode::resolve_from_extent_tree(uint32_t data_block_index)
+	{
+		auto block_buffer = m_fs.get_block_buffer_blocking();
+		auto node = block_buffer.span();
+
+		read_extent_node(0, node);
+		for (;;)
 		{
-			if (m_inode.block[data_block_index] == 0)
+			const auto& header = extent_header(node);
+			if (header.magic != Ext2::Enum::EXTENT_MAGIC)
+			{
+				dwarnln("Invalid extent tree in inode {}", ino());
+				return {};
+			}
+
+			const auto index = find_extent_entry(node, data_block_index);
+			if (!index.has_value())
 				return {};
-			return m_inode.block[data_block_index];
+
+			if (header.depth > 0)
+			{
+				read_extent_node(extent_entries<Ext2::ExtentIndex>(node)[index.value()].leaf_lo, node);
+				continue;
+			}
+
+			// uninitialized extents read as zeros, just like holes
+			const auto& extent = extent_entries<Ext2::Extent>(node)[index.value()];
+			if (extent.len > Ext2::Enum::EXTENT_MAX_INIT_LEN)
+				return {};
+			if (data_block_index >= extent.block + extent.len)
+				return {};
+
+			const uint32_t skip = data_block_index - extent.block;
+			return BlockMapping {
+				.data_block = data_block_index,
+				.fs_block = extent.start_lo + skip,
+				.block_count = extent.len - skip,
+			};
+		}
+	}
+
+	BAN::Optional<Ext2Inode::BlockMapping> Ext2Inode::resolve_data_block(uint32_t data_block_index)
+	{
+		if (auto mapping = find_cached_mapping(data_block_index); mapping.has_value())
+			return mapping;
+
+		if (m_inode.flags & Ext2::Enum::EXTENTS_FL)
+		{
+			auto mapping = resolve_from_extent_tree(data_block_index);
+			if (mapping.has_value())
+				cache_block_mapping(mapping.value());
+			return mapping;
 		}
-		data_block_index -= 12;
 
-		if (data_block_index < indices_per_block)
-			return block_from_indirect_block(m_inode.block[12], data_block_index, 1);
-		data_block_index -= indices_per_block;
+		const uint32_t indices_per_block = blksize() / sizeof(uint32_t);
 
-		if (data_block_index < indices_per_block * indices_per_block)
-			return block_from_indirect_block(m_inode.block[13], data_block_index, 2);
-		data_block_index -= indices_per_block * indices_per_block;
+		BAN::Optional<BlockMapping> mapping;
 
-		if (data_block_index < indices_per_block * indices_per_block * indices_per_block)
-			return block_from_indirect_block(m_inode.block[14], data_block_index, 3);
+		uint32_t index = data_block_index;
+		if (index < 12)
+		{
+			if (m_inode.block[index] == 0)
+				return {};
+			uint32_t block_count = 1;
+			while (index + block_count < 12 && m_inode.block[index + block_count] == m_inode.block[index] + block_count)
+				block_count++;
+			mapping = BlockMapping {
+				.data_block = data_block_index,
+				.fs_block = m_inode.block[index],
+				.block_count = block_count,
+			};
+		}
+		else if ((index -= 12) < indices_per_block)
+			mapping = resolve_from_indirect_block(m_inode.block[12], data_block_index, index, 1);
+		else if ((index -= indices_per_block) < indices_per_block * indices_per_block)
+			mapping = resolve_from_indirect_block(m_inode.block[13], data_block_index, index, 2);
+		else if ((index -= indices_per_block * indices_per_block) < indices_per_block * indices_per_block * indices_per_block)
+			mapping = resolve_from_indirect_block(m_inode.block[14], data_block_index, index, 3);
+		else
+			ASSERT_NOT_REACHED();
+
+		if (mapping.has_value())
+			cache_block_mapping(mapping.value());
+		return mapping;
+	}
 
-		ASSERT_NOT_REACHED();
+	BAN::Optional<uint32_t> Ext2Inode::fs_block_of_data_block_index(uint32_t data_block_index)
+	{
+		auto mapping = resolve_data_block(data_block_index);
+		if (!mapping.has_value())
+			return {};
+		return mapping->fs_block;
 	}
 
 	BAN::ErrorOr<BAN::String> Ext2Inode::link_target_impl()
@@ -101,6 +352,9 @@ namespace Kernel
 		return BAN::Error::from_errno(ENOTSUP);
 	}
 
+	// Upper limit for staging whole block runs of user buffers
+	static constexpr size_t s_max_staging_bytes = 64 * 1024;
+
 	BAN::ErrorOr<size_t> Ext2Inode::read_impl(off_t offset, BAN::ByteSpan buffer)
 	{
 		// FIXME: update atime if needed
@@ -120,24 +374,44 @@ namespace Kernel
 
 		const uint32_t block_size = blksize();
 
-		auto block_buffer = m_fs.get_block_buffer();
-
-		const uint32_t first_block = offset / block_size;
-		const uint32_t last_block = BAN::Math::div_round_up<uint32_t>(offset + count, block_size);
+		const bool is_user_buffer = reinterpret_cast<vaddr_t>(buffer.data()) < KERNEL_OFFSET;
+		BAN::Vector<uint8_t> staging_buffer;
 
 		size_t n_read = 0;
-
-		for (uint32_t data_block_index = first_block; data_block_index < last_block; data_block_index++)
+		while (n_read < count)
 		{
-			auto block_index = fs_block_of_data_block_index(data_block_index);
-			if (block_index.has_value())
-				m_fs.read_block(block_index.value(), block_buffer);
-			else
-				memset(block_buffer.data(), 0x00, block_buffer.size());
+			const uint32_t data_block_index = (offset + n_read) / block_size;
+			const uint32_t block_offset = (offset + n_read) % block_size;
+			const auto mapping = resolve_data_block(data_block_index);
+
+			// Whole blocks are read straight to the buffer, one request per contiguous run.
+			// User buffers are staged through kernel memory, block I/O may be done by another thread.
+			if (block_offset == 0 && count - n_read >= block_size && mapping.has_value())
+			{
+				uint32_t block_count = BAN::Math::min<uint32_t>(mapping->block_count, (count - n_read) / block_size);
+				if (!is_user_buffer)
+					TRY(m_fs.read_blocks(mapping->fs_block, block_count, buffer.slice(n_read, block_count * block_size)));
+				else
+				{
+					block_count = BAN::Math::min<uint32_t>(block_count, BAN::Math::max<uint32_t>(s_max_staging_bytes / block_size, 1));
+					TRY(staging_buffer.resize(block_count * block_size));
+					TRY(m_fs.read_blocks(mapping->fs_block, block_count, staging_buffer.span()));
+					memcpy(buffer.data() + n_read, staging_buffer.data(), block_count * block_size);
+				}
+				n_read += block_count * block_size;
+				continue;
+			}
+
+			const uint32_t to_copy = BAN::Math::min<uint32_t>(block_size - block_offset, count - n_read);
 
-			uint32_t copy_offset = (offset + n_read) % block_size;
-			uint32_t to_copy = BAN::Math::min<uint32_t>(block_size - copy_offset, count - n_read);
-			memcpy(buffer.data() + n_read, block_buffer.data() + copy_offset, to_copy);
+			if (!mapping.has_value())
+				memset(buffer.data() + n_read, 0x00, to_copy);
+			else
+			{
+				auto block_buffer = TRY(m_fs.get_block_buffer());
+				m_fs.read_block(mapping->fs_block, block_buffer);
+				memcpy(buffer.data() + n_read, block_buffer.data() + block_offset, to_copy);
+			}
 
 			n_read += to_copy;
 		}
@@ -147,6 +421,8 @@ namespace Kernel
 
 	BAN::ErrorOr<size_t> Ext2Inode::write_impl(off_t offset, BAN::ConstByteSpan buffer)
 	{
+		if (m_fs.is_read_only())
+			return BAN::Error::from_errno(EROFS);
 		// FIXME: update atime if needed
 
 		ASSERT(!mode().ifdir());
@@ -158,70 +434,241 @@ namespace Kernel
 		if (m_inode.size < offset + buffer.size())
 			TRY(truncate_impl(offset + buffer.size()));
 
+		// Block allocations only update the in-memory inode and fs metadata
+		BAN::ScopeGuard syncer([&] { sync(); m_fs.sync_metadata(); });
+
 		const uint32_t block_size = blksize();
 
-		auto block_buffer = m_fs.get_block_buffer();
+		// Allocate missing whole blocks first, so they can be written in contiguous runs
+		const uint32_t first_full_block = BAN::Math::div_round_up<uint32_t>(offset, block_size);
+		const uint32_t last_full_block = (offset + buffer.size()) / block_size;
+		for (uint32_t data_block_index = first_full_block; data_block_index < last_full_block; data_block_index++)
+			if (!resolve_data_block(data_block_index).has_value())
+				TRY(allocate_new_block(data_block_index));
 
-		size_t written = 0;
-		size_t to_write = buffer.size();
+		const bool is_user_buffer = reinterpret_cast<vaddr_t>(buffer.data()) < KERNEL_OFFSET;
+		BAN::Vector<uint8_t> staging_buffer;
 
-		// Write partial block
-		if (offset % block_size)
+		size_t written = 0;
+		while (written < buffer.size())
 		{
-			auto block_index = fs_block_of_data_block_index(offset / block_size);
-			if (block_index.has_value())
-				m_fs.read_block(block_index.value(), block_buffer);
+			const uint32_t data_block_index = (offset + written) / block_size;
+			const uint32_t block_offset = (offset + written) % block_size;
+			const auto mapping = resolve_data_block(data_block_index);
+
+			if (block_offset == 0 && buffer.size() - written >= block_size)
+			{
+				ASSERT(mapping.has_value());
+				uint32_t block_count = BAN::Math::min<uint32_t>(mapping->block_count, (buffer.size() - written) / block_size);
+				if (!is_user_buffer)
+					TRY(m_fs.write_blocks(mapping->fs_block, block_count, buffer.slice(written, block_count * block_size)));
+				else
+				{
+					block_count = BAN::Math::min<uint32_t>(block_count, BAN::Math::max<uint32_t>(s_max_staging_bytes / block_size, 1));
+					TRY(staging_buffer.resize(block_count * block_size));
+					memcpy(staging_buffer.data(), buffer.data() + written, block_count * block_size);
+					TRY(m_fs.write_blocks(mapping->fs_block, block_count, staging_buffer.span()));
+				}
+				written += block_count * block_size;
+				continue;
+			}
+
+			// Partial block, read-modify-write through a block buffer
+			auto block_buffer = TRY(m_fs.get_block_buffer());
+
+			uint32_t fs_block;
+			if (mapping.has_value())
+			{
+				fs_block = mapping->fs_block;
+				m_fs.read_block(fs_block, block_buffer);
+			}
 			else
 			{
-				block_index = TRY(allocate_new_block(offset / block_size));;
+				fs_block = TRY(allocate_new_block(data_block_index));
 				memset(block_buffer.data(), 0x00, block_buffer.size());
 			}
 
-			uint32_t block_offset = offset % block_size;
-			uint32_t to_copy = BAN::Math::min<uint32_t>(block_size - block_offset, to_write);
-
-			memcpy(block_buffer.data() + block_offset, buffer.data(), to_copy);
-			m_fs.write_block(block_index.value(), block_buffer);
+			const uint32_t to_copy = BAN::Math::min<uint32_t>(block_size - block_offset, buffer.size() - written);
+			memcpy(block_buffer.data() + block_offset, buffer.data() + written, to_copy);
+			m_fs.write_block(fs_block, block_buffer);
 
 			written += to_copy;
-			offset += to_copy;
-			to_write -= to_copy;
 		}
 
-		while (to_write >= block_size)
+		return buffer.size();
+	}
+
+	BAN::ErrorOr<size_t> Ext2Inode::read_direct_impl(off_t offset, BAN::ByteSpan buffer)
+	{
+		ASSERT(!mode().ifdir());
+		ASSERT(offset >= 0);
+
+		const uint32_t block_size = blksize();
+		if (offset % block_size || buffer.size() % block_size)
+			return BAN::Error::from_errno(EINVAL);
+
+		if (static_cast<BAN::make_unsigned_t<decltype(offset)>>(offset) >= UINT32_MAX || buffer.size() >= UINT32_MAX || buffer.size() >= (size_t)(UINT32_MAX - offset))
+			return BAN::Error::from_errno(EOVERFLOW);
+
+		if (static_cast<BAN::make_unsigned_t<decltype(offset)>>(offset) >= m_inode.size)
+			return 0;
+
+		// Last block is read whole, its tail past the end of file is cleared
+		const size_t file_bytes = BAN::Math::min<size_t>(buffer.size(), m_inode.size - offset);
+		const size_t count = BAN::Math::div_round_up<size_t>(file_bytes, block_size) * block_size;
+
+		size_t n_read = 0;
+		while (n_read < count)
+		{
+			const uint32_t data_block_index = (offset + n_read) / block_size;
+			const auto mapping = resolve_data_block(data_block_index);
+			if (!mapping.has_value())
+			{
+				memset(buffer.data() + n_read, 0x00, block_size);
+				n_read += block_size;
+				continue;
+			}
+
+			const uint32_t block_count = BAN::Math::min<uint32_t>(mapping->block_count, (count - n_read) / block_size);
+			TRY(m_fs.read_blocks_direct(mapping->fs_block, block_count, buffer.slice(n_read, block_count * block_size)));
+			n_read += block_count * block_size;
+		}
+
+		memset(buffer.data() + file_bytes, 0x00, count - file_bytes);
+
+		return file_bytes;
+	}
+
+	BAN::ErrorOr<size_t> Ext2Inode::write_direct_impl(off_t offset, BAN::ConstByteSpan buffer)
+	{
+		if (m_fs.is_read_only())
+			return BAN::Error::from_errno(EROFS);
+		ASSERT(!mode().ifdir());
+		ASSERT(offset >= 0);
+
+		const uint32_t block_size = blksize();
+		if (offset % block_size || buffer.size() % block_size)
+			return BAN::Error::from_errno(EINVAL);
+
+		if (static_cast<BAN::make_unsigned_t<decltype(offset)>>(offset) >= UINT32_MAX || buffer.size() >= UINT32_MAX || buffer.size() >= (size_t)(UINT32_MAX - offset))
+			return BAN::Error::from_errno(EOVERFLOW);
+
+		if (m_inode.size < offset + buffer.size())
+			TRY(truncate_impl(offset + buffer.size()));
+
+		// Block allocations only update the in-memory inode and fs metadata
+		BAN::ScopeGuard syncer([&] { sync(); m_fs.sync_metadata(); });
+
+		// Whole blocks only, so new blocks never need zeroing
+		const uint32_t first_block = offset / block_size;
+		const uint32_t last_block = (offset + buffer.size()) / block_size;
+		for (uint32_t data_block_index = first_block; data_block_index < last_block; data_block_index++)
+			if (!resolve_data_block(data_block_index).has_value())
+				TRY(allocate_new_block(data_block_index));
+
+		size_t written = 0;
+		while (written < buffer.size())
+		{
+			const auto mapping = resolve_data_block((offset + written) / block_size);
+			ASSERT(mapping.has_value());
+
+			const uint32_t block_count = BAN::Math::min<uint32_t>(mapping->block_count, (buffer.size() - written) / block_size);
+			TRY(m_fs.write_blocks_direct(mapping->fs_block, block_count, buffer.slice(written, block_count * block_size)));
+			written += block_count * block_size;
+		}
+
+		return buffer.size();
+	}
+
+	BAN::ErrorOr<size_t> Ext2Inode::copy_file_range_impl(off_t offset, Inode& out, off_t out_offset, size_t count)
+	{
+		if (m_fs.is_read_only())
+			return BAN::Error::from_errno(EROFS);
+		// Whole block runs are read from the disk and written to out's newly allocated
+		// blocks directly, so neither the page caches nor the block cache get polluted.
+		// Unaligned ranges and the partial last block are left to the caller.
+		const uint32_t block_size = blksize();
+		if (offset % block_size || out_offset % block_size)
+			return BAN::Error::from_errno(ENOTSUP);
+		if (offset >= size())
+			return 0;
+
+		const size_t to_copy = BAN::Math::min<size_t>(count, size() - offset) / block_size * block_size;
+		if (to_copy == 0)
+			return 0;
+
+		constexpr size_t max_chunk_size = 64 * 1024;
+		BAN::Vector<uint8_t> buffer;
+		TRY(buffer.resize(BAN::Math::min<size_t>(to_copy, BAN::Math::max<size_t>(max_chunk_size / block_size, 1) * block_size)));
+
+		size_t ncopied = 0;
+		while (ncopied < to_copy)
 		{
-			auto block_index = fs_block_of_data_block_index(offset / block_size);
-			if (!block_index.has_value())
-				block_index = TRY(allocate_new_block(offset / block_size));
+			auto chunk = buffer.span().slice(0, BAN::Math::min<size_t>(to_copy - ncopied, buffer.size()));
 
-			memcpy(block_buffer.data(), buffer.data() + written, block_buffer.size());
-			m_fs.write_block(block_index.value(), block_buffer);
+			auto result = read_direct_impl(offset + ncopied, chunk);
+			if (!result.is_error())
+				result = out.write_direct(out_offset + ncopied, chunk);
+			if (result.is_error())
+			{
+				if (ncopied > 0)
+					break;
+				return result.release_error();
+			}
 
-			written += block_size;
-			offset += block_size;
-			to_write -= block_size;
+			ncopied += chunk.size();
 		}
 
-		if (to_write > 0)
+		return ncopied;
+	}
+
+	BAN::ErrorOr<void> Ext2Inode::fsync_impl(bool data_only)
+	{
+		// Data blocks and the blocks mapping them are written first,
+		// so the inode never points to blocks that are not on disk
+		const bool has_data_blocks = !(mode().iflnk() && (size_t)size() < sizeof(m_inode.block));
+		if (has_data_blocks)
 		{
-			auto block_index = fs_block_of_data_block_index(offset / block_size);
-			if (block_index.has_value())
-				m_fs.read_block(block_index.value(), block_buffer);
-			else
+			const uint32_t block_size = blksize();
+			const uint32_t data_block_count = BAN::Math::div_round_up<uint32_t>(m_inode.size, block_size);
+			for (uint32_t data_block_index = 0; data_block_index < data_block_count;)
 			{
-				block_index = TRY(allocate_new_block(offset / block_size));
-				memset(block_buffer.data(), 0x00, block_buffer.size());
+				const auto mapping = resolve_data_block(data_block_index);
+				if (!mapping.has_value())
+				{
+					data_block_index++;
+					continue;
+				}
+
+				const uint32_t block_count = BAN::Math::min<uint32_t>(mapping->block_count, data_block_count - data_block_index);
+				TRY(m_fs.sync_blocks(mapping->fs_block, block_count));
+				data_block_index += block_count;
 			}
 
-			memcpy(block_buffer.data(), buffer.data() + written, to_write);
-			m_fs.write_block(block_index.value(), block_buffer);
+			if (m_inode.flags & Ext2::Enum::EXTENTS_FL)
+				TRY(sync_extent_node(0));
+			else for (uint32_t i = 12; i < 15; i++)
+				if (m_inode.block[i])
+					TRY(sync_indirect_block(m_inode.block[i], i - 11));
 		}
 
-		return buffer.size();
+		sync();
+		TRY(m_fs.sync_blocks(m_fs.locate_inode(ino()).block, 1));
+
+		// Allocation bitmaps and counters are not needed to read the data back
+		if (!data_only)
+		{
+			m_fs.sync_metadata();
+			TRY(m_fs.sync_metadata_blocks());
+		}
+
+		return {};
 	}
 
 	BAN::ErrorOr<void> Ext2Inode::truncate_impl(size_t new_size)
 	{
+		if (m_fs.is_read_only())
+			return BAN::Error::from_errno(EROFS);
 		if (m_inode.size == new_size)
 			return {};
 
@@ -235,6 +682,8 @@ namespace Kernel
 
 	BAN::ErrorOr<void> Ext2Inode::chmod_impl(mode_t mode)
 	{
+		if (m_fs.is_read_only())
+			return BAN::Error::from_errno(EROFS);
 		ASSERT((mode & Inode::Mode::TYPE_MASK) == 0);
 		if (m_inode.mode == mode)
 			return {};
@@ -253,7 +702,7 @@ namespace Kernel
 			return;
 		}
 
-		auto block_buffer = m_fs.get_block_buffer();
+		auto block_buffer = m_fs.get_block_buffer_blocking();
 		m_fs.read_block(block, block_buffer);
 
 		const uint32_t ids_per_block = blksize() / sizeof(uint32_t);
@@ -272,9 +721,18 @@ namespace Kernel
 	{
 		ASSERT(m_inode.links_count == 0);
 
+		m_fs.release_preallocation_window(m_preallocation);
+		m_block_map_cache.clear();
+
 		if (mode().iflnk() && (size_t)size() < sizeof(m_inode.block))
 			goto done;
 
+		if (m_inode.flags & Ext2::Enum::EXTENTS_FL)
+		{
+			cleanup_extent_node(0);
+			goto done;
+		}
+
 		// cleanup direct blocks
 		for (uint32_t i = 0; i < 12; i++)
 			if (m_inode.block[i])
@@ -299,55 +757,57 @@ done:
 		m_fs.delete_inode(ino());
 	}
 
-	BAN::ErrorOr<size_t> Ext2Inode::list_next_inodes_impl(off_t offset, struct dirent* list, size_t list_size)
+	BAN::ErrorOr<size_t> Ext2Inode::list_next_inodes_impl(off_t& offset, struct dirent* list, size_t list_size)
 	{
 		ASSERT(mode().ifdir());
 		ASSERT(offset >= 0);
 
-		if (static_cast<BAN::make_unsigned_t<decltype(offset)>>(offset) >= max_used_data_block_count())
-			return 0;
-
-		// FIXME: can we actually assume directories have all their blocks allocated
-		const uint32_t block_index = fs_block_of_data_block_index(offset).value();
+		// Offset is the byte position of the next entry in the directory
 
-		auto block_buffer = m_fs.get_block_buffer();
+		const uint32_t block_size = blksize();
 
-		m_fs.read_block(block_index, block_buffer);
+		auto block_buffer = TRY(m_fs.get_block_buffer());
 
-		// First determine if we have big enough list
 		size_t entry_count = 0;
+		while (entry_count < list_size)
 		{
-			BAN::ConstByteSpan entry_span = block_buffer.span();
-
-			while (entry_span.size() >= sizeof(Ext2::LinkedDirectoryEntry))
-			{
-				auto& entry = entry_span.as<const Ext2::LinkedDirectoryEntry>();
-				if (entry.inode)
-					entry_count++;
-				entry_span = entry_span.slice(entry.rec_len);
-			}
+			const uint64_t data_block_index = offset / block_size;
+			if (data_block_index >= max_used_data_block_count())
+				break;
 
-			if (entry_count > list_size)
-				return BAN::Error::from_errno(ENOBUFS);
-		}
+			// FIXME: can we actually assume directories have all their blocks allocated
+			const uint32_t block_index = fs_block_of_data_block_index(data_block_index).value();
+			m_fs.read_block(block_index, block_buffer);
 
-		// Second fill the list
-		{
-			dirent* dirp = list;
+			const uint64_t block_start = data_block_index * block_size;
+			uint64_t next_offset = block_start + block_size;
 
-			BAN::ConstByteSpan entry_span = block_buffer.span();
-			while (entry_span.size() >= sizeof(Ext2::LinkedDirectoryEntry))
+			for (uint32_t entry_offset = 0; entry_offset + sizeof(Ext2::LinkedDirectoryEntry) <= block_size;)
 			{
-				auto& entry = entry_span.as<const Ext2::LinkedDirectoryEntry>();
-				if (entry.inode)
+				auto& entry = block_buffer.span().slice(entry_offset).as<const Ext2::LinkedDirectoryEntry>();
+				if (entry.rec_len == 0)
+					break;
+
+				// Entries before offset were returned by earlier calls
+				if (entry.inode && block_start + entry_offset >= static_cast<uint64_t>(offset))
 				{
-					dirp->d_ino = entry.inode;
-					dirp->d_type = entry.file_type;
-					strncpy(dirp->d_name, entry.name, entry.name_len);
-					dirp++;
+					if (entry_count >= list_size)
+					{
+						next_offset = block_start + entry_offset;
+						break;
+					}
+
+					auto& dirent = list[entry_count++];
+					dirent.d_ino = entry.inode;
+					dirent.d_type = entry.file_type;
+					memcpy(dirent.d_name, entry.name, entry.name_len);
+					dirent.d_name[entry.name_len] = '\0';
 				}
-				entry_span = entry_span.slice(entry.rec_len);
+
+				entry_offset += entry.rec_len;
 			}
+
+			offset = next_offset;
 		}
 
 		return entry_count;
@@ -398,12 +858,14 @@ done:
 
 	BAN::ErrorOr<void> Ext2Inode::create_file_impl(BAN::StringView name, mode_t mode, uid_t uid, gid_t gid)
 	{
+		if (m_fs.is_read_only())
+			return BAN::Error::from_errno(EROFS);
 		ASSERT(this->mode().ifdir());
 
 		if (!(Mode(mode).ifreg()))
 			return BAN::Error::from_errno(ENOTSUP);
 
-		const uint32_t new_ino = TRY(m_fs.create_inode(initialize_new_inode_info(mode, uid, gid)));
+		const uint32_t new_ino = TRY(m_fs.create_inode(initialize_new_inode_info(mode, uid, gid), ino()));
 
 		auto inode_or_error = Ext2Inode::create(m_fs, new_ino);
 		if (inode_or_error.is_error())
@@ -421,10 +883,12 @@ done:
 
 	BAN::ErrorOr<void> Ext2Inode::create_directory_impl(BAN::StringView name, mode_t mode, uid_t uid, gid_t gid)
 	{
+		if (m_fs.is_read_only())
+			return BAN::Error::from_errno(EROFS);
 		ASSERT(this->mode().ifdir());
 		ASSERT(Mode(mode).ifdir());
 
-		const uint32_t new_ino = TRY(m_fs.create_inode(initialize_new_inode_info(mode, uid, gid)));
+		const uint32_t new_ino = TRY(m_fs.create_inode(initialize_new_inode_info(mode, uid, gid), ino()));
 
 		auto inode_or_error = Ext2Inode::create(m_fs, new_ino);
 		if (inode_or_error.is_error())
@@ -446,104 +910,729 @@ done:
 		return {};
 	}
 
-	BAN::ErrorOr<void> Ext2Inode::link_inode_to_directory(Ext2Inode& inode, BAN::StringView name)
+	static uint8_t directory_entry_file_type(const Ext2::Superblock& superblock, Inode::Mode mode)
 	{
-		if (!this->mode().ifdir())
-			return BAN::Error::from_errno(ENOTDIR);
+		if (superblock.rev_level == Ext2::Enum::GOOD_OLD_REV)
+			return 0;
+		return mode.ifreg()  ? Ext2::Enum::REG_FILE
+			: mode.ifdir()  ? Ext2::Enum::DIR
+			: mode.ifchr()  ? Ext2::Enum::CHRDEV
+			: mode.ifblk()  ? Ext2::Enum::BLKDEV
+			: mode.ififo()  ? Ext2::Enum::FIFO
+			: mode.ifsock() ? Ext2::Enum::SOCK
+			: mode.iflnk()  ? Ext2::Enum::SYMLINK
+			: 0;
+	}
 
-		if (name.size() > 255)
-			return BAN::Error::from_errno(ENAMETOOLONG);
+	static uint32_t directory_entry_rec_len(uint32_t name_len)
+	{
+		uint32_t rec_len = sizeof(Ext2::LinkedDirectoryEntry) + name_len;
+		if (auto rem = rec_len % 4)
+			rec_len += 4 - rem;
+		return rec_len;
+	}
 
-		if (m_inode.flags & Ext2::Enum::INDEX_FL)
+	static BAN::Optional<uint32_t> find_entry_in_directory_block(BAN::ConstByteSpan block, BAN::StringView name)
+	{
+		uint32_t offset = 0;
+		while (offset + sizeof(Ext2::LinkedDirectoryEntry) <= block.size())
 		{
-			dwarnln("file creation to indexed directory not supported");
-			return BAN::Error::from_errno(ENOTSUP);
+			auto& entry = block.slice(offset).as<const Ext2::LinkedDirectoryEntry>();
+			if (entry.rec_len < sizeof(Ext2::LinkedDirectoryEntry))
+				break;
+			if (entry.inode && name == BAN::StringView(entry.name, entry.name_len))
+				return offset;
+			offset += entry.rec_len;
 		}
+		return {};
+	}
 
-		auto error_or = find_inode_impl(name);
-		if (!error_or.is_error())
+	// Returns false if the block does not have room for the entry
+	static bool insert_entry_to_directory_block(BAN::ByteSpan block, uint32_t ino, uint8_t file_type, BAN::StringView name)
+	{
+		const uint32_t needed_rec_len = directory_entry_rec_len(name.size());
+
+		auto write_entry = [&](uint32_t offset, uint32_t rec_len)
+		{
+			auto& new_entry = block.slice(offset).as<Ext2::LinkedDirectoryEntry>();
+			new_entry.inode = ino;
+			new_entry.rec_len = rec_len;
+			new_entry.name_len = name.size();
+			new_entry.file_type = file_type;
+			memcpy(new_entry.name, name.data(), name.size());
+		};
+
+		uint32_t offset = 0;
+		while (offset + sizeof(Ext2::LinkedDirectoryEntry) <= block.size())
+		{
+			auto& entry = block.slice(offset).as<Ext2::LinkedDirectoryEntry>();
+			if (entry.rec_len < sizeof(Ext2::LinkedDirectoryEntry))
+				break;
+
+			const uint32_t entry_rec_len = directory_entry_rec_len(entry.name_len);
+
+			if (entry.inode == 0 && needed_rec_len <= entry.rec_len)
+			{
+				write_entry(offset, entry.rec_len);
+				return true;
+			}
+			else if (entry_rec_len + needed_rec_len <= entry.rec_len)
+			{
+				const uint32_t new_rec_len = entry.rec_len - entry_rec_len;
+				entry.rec_len = entry_rec_len;
+				write_entry(offset + entry_rec_len, new_rec_len);
+				return true;
+			}
+
+			offset += entry.rec_len;
+		}
+
+		return false;
+	}
+
+	// Directory index root is stored after the "." and ".." entries of the first block,
+	// ".." must span the rest of the block for the index to be invisible to linear readers
+	static constexpr uint32_t s_dx_root_info_offset = 24;
+
+	static Ext2::DxEntry* directory_index_entries(BAN::ByteSpan block, bool is_root)
+	{
+		if (!is_root)
+			return &block.slice(sizeof(Ext2::LinkedDirectoryEntry)).as<Ext2::DxEntry>();
+		const auto& root_info = block.slice(s_dx_root_info_offset).as<const Ext2::DxRootInfo>();
+		return &block.slice(s_dx_root_info_offset + root_info.info_length).as<Ext2::DxEntry>();
+	}
+
+	static Ext2::DxCountLimit& directory_index_count_limit(Ext2::DxEntry* entries)
+	{
+		return *reinterpret_cast<Ext2::DxCountLimit*>(entries);
+	}
+
+	static bool is_valid_directory_index_node(BAN::ConstByteSpan block, Ext2::DxEntry* entries)
+	{
+		const auto& count_limit = directory_index_count_limit(entries);
+		const size_t offset = reinterpret_cast<const uint8_t*>(entries) - block.data();
+		if (count_limit.count == 0 || count_limit.count > count_limit.limit)
+			return false;
+		return offset + count_limit.limit * sizeof(Ext2::DxEntry) <= block.size();
+	}
+
+	BAN::ErrorOr<void> Ext2Inode::link_inode_to_directory(Ext2Inode& inode, BAN::StringView name)
+	{
+		if (!this->mode().ifdir())
+			return BAN::Error::from_errno(ENOTDIR);
+
+		if (name.size() > 255)
+			return BAN::Error::from_errno(ENAMETOOLONG);
+
+		auto error_or = find_directory_entry(name);
+		if (!error_or.is_error())
 			return BAN::Error::from_errno(EEXISTS);
 		if (error_or.error().get_error_code() != ENOENT)
 			return error_or.error();
 
-		const uint32_t block_size = m_fs.block_size();
+		BAN::ScopeGuard syncer([&] { sync(); m_fs.sync_metadata(); });
+
+		const uint8_t file_type = directory_entry_file_type(m_fs.superblock(), inode.mode());
+		if (uses_directory_index())
+			TRY(add_indexed_directory_entry(inode.ino(), file_type, name));
+		else
+			TRY(add_linear_directory_entry(inode.ino(), file_type, name));
+
+		inode.m_inode.links_count++;
+		inode.sync();
+
+		return {};
+	}
 
-		auto block_buffer = m_fs.get_block_buffer();
+	void Ext2Inode::read_directory_block(uint32_t data_block_index, BAN::ByteSpan buffer)
+	{
+		// FIXME: can we actually assume directories have all their blocks allocated
+		const uint32_t block_index = fs_block_of_data_block_index(data_block_index).value();
+		m_fs.read_block(block_index, buffer);
+	}
 
-		auto write_inode = [&](uint32_t entry_offset, uint32_t entry_rec_len)
+	void Ext2Inode::write_directory_block(uint32_t data_block_index, BAN::ByteSpan buffer)
+	{
+		if (m_fs.has_metadata_checksums())
+			update_directory_block_checksum(buffer);
+
+		const uint32_t block_index = fs_block_of_data_block_index(data_block_index).value();
+		m_fs.write_block(block_index, buffer);
+	}
+
+	uint32_t Ext2Inode::directory_leaf_size() const
+	{
+		if (!m_fs.has_metadata_checksums())
+			return blksize();
+		return blksize() - sizeof(Ext2::DirectoryEntryTail);
+	}
+
+	void Ext2Inode::initialize_directory_tail(BAN::ByteSpan block) const
+	{
+		if (!m_fs.has_metadata_checksums())
+			return;
+		auto& tail = block.slice(directory_leaf_size()).as<Ext2::DirectoryEntryTail>();
+		memset(&tail, 0x00, sizeof(Ext2::DirectoryEntryTail));
+		tail.rec_len = sizeof(Ext2::DirectoryEntryTail);
+		tail.reserved_file_type = Ext2::Enum::DIRECTORY_TAIL_FILE_TYPE;
+	}
+
+	void Ext2Inode::update_directory_block_checksum(BAN::ByteSpan block) const
+	{
+		const uint32_t block_size = blksize();
+		const uint32_t seed = m_fs.inode_checksum_seed(ino(), m_inode.generation);
+
+		// Index nodes look like a single unused entry spanning the block, the root
+		// looks like "." and ".." with ".." spanning the rest of the block
+		if (m_inode.flags & Ext2::Enum::INDEX_FL)
 		{
-			auto typed_mode = inode.mode();
-			uint8_t file_type = (m_fs.superblock().rev_level == Ext2::Enum::GOOD_OLD_REV) ? 0
-				: typed_mode.ifreg()  ? Ext2::Enum::REG_FILE
-				: typed_mode.ifdir()  ? Ext2::Enum::DIR
-				: typed_mode.ifchr()  ? Ext2::Enum::CHRDEV
-				: typed_mode.ifblk()  ? Ext2::Enum::BLKDEV
-				: typed_mode.ififo()  ? Ext2::Enum::FIFO
-				: typed_mode.ifsock() ? Ext2::Enum::SOCK
-				: typed_mode.iflnk()  ? Ext2::Enum::SYMLINK
-				: 0;
+			uint32_t count_offset = 0;
+			const auto& first = block.as<const Ext2::LinkedDirectoryEntry>();
+			if (first.inode == 0 && first.rec_len == block_size)
+				count_offset = sizeof(Ext2::LinkedDirectoryEntry);
+			else if (first.rec_len == 12 && block.slice(12).as<const Ext2::LinkedDirectoryEntry>().rec_len == block_size - 12)
+			{
+				const auto& root_info = block.slice(s_dx_root_info_offset).as<const Ext2::DxRootInfo>();
+				if (root_info.reserved_zero == 0 && root_info.info_length == sizeof(Ext2::DxRootInfo))
+					count_offset = s_dx_root_info_offset + sizeof(Ext2::DxRootInfo);
+			}
 
-			auto& new_entry = block_buffer.span().slice(entry_offset).as<Ext2::LinkedDirectoryEntry>();
-			new_entry.inode = inode.ino();
-			new_entry.rec_len = entry_rec_len;
-			new_entry.name_len = name.size();
-			new_entry.file_type = file_type;
-			memcpy(new_entry.name, name.data(), name.size());
+			if (count_offset)
+			{
+				const auto& count_limit = block.slice(count_offset).as<const Ext2::DxCountLimit>();
+				const uint32_t tail_offset = count_offset + count_limit.limit * sizeof(Ext2::DxEntry);
+				if (count_limit.count > count_limit.limit || tail_offset + sizeof(Ext2::DxTail) > block_size)
+				{
+					dwarnln("No space for directory index checksum in inode {}", ino());
+					return;
+				}
 
-			inode.m_inode.links_count++;
-			inode.sync();
-		};
+				auto& tail = block.slice(tail_offset).as<Ext2::DxTail>();
+				uint32_t checksum = Ext2::crc32c(seed, block.slice(0, count_offset + count_limit.count * sizeof(Ext2::DxEntry)));
+				checksum = Ext2::crc32c(checksum, BAN::ConstByteSpan::from(tail.reserved));
+				tail.checksum = checksum;
+				return;
+			}
+		}
 
-		uint32_t block_index = 0;
-		uint32_t entry_offset = 0;
+		auto& tail = block.slice(directory_leaf_size()).as<Ext2::DirectoryEntryTail>();
+		if (tail.reserved_zero1 != 0 || tail.rec_len != sizeof(Ext2::DirectoryEntryTail) || tail.reserved_zero2 != 0 || tail.reserved_file_type != Ext2::Enum::DIRECTORY_TAIL_FILE_TYPE)
+		{
+			dwarnln("No space for directory leaf checksum in inode {}", ino());
+			return;
+		}
+		tail.checksum = Ext2::crc32c(seed, block.slice(0, directory_leaf_size()));
+	}
 
-		uint32_t needed_entry_len = sizeof(Ext2::LinkedDirectoryEntry) + name.size();
-		if (auto rem = needed_entry_len % 4)
-			needed_entry_len += 4 - rem;
+	BAN::ErrorOr<uint32_t> Ext2Inode::append_directory_block()
+	{
+		const uint32_t data_block_index = max_used_data_block_count();
+		TRY(allocate_new_block(data_block_index));
+		m_inode.size += blksize();
+		return data_block_index;
+	}
 
-		// FIXME: can we actually assume directories have all their blocks allocated
-		const uint32_t data_block_count = max_used_data_block_count();
-		if (data_block_count == 0)
-			goto needs_new_block;
+	BAN::ErrorOr<Ext2Inode::DirectoryEntryLocation> Ext2Inode::find_directory_entry(BAN::StringView name)
+	{
+		ASSERT(mode().ifdir());
 
-		// Try to insert inode to last data block
-		block_index = fs_block_of_data_block_index(data_block_count - 1).value();
-		m_fs.read_block(block_index, block_buffer);
+		auto block_buffer = TRY(m_fs.get_block_buffer());
+		auto block = block_buffer.span();
+
+		if (uses_directory_index())
+		{
+			DirectoryIndexPath path;
+			if (TRY(probe_directory_index(name, path)))
+			{
+				do
+				{
+					read_directory_block(path.leaf_block, block);
+					if (auto offset = find_entry_in_directory_block(block, name); offset.has_value())
+					{
+						return DirectoryEntryLocation {
+							.data_block = path.leaf_block,
+							.offset = offset.value(),
+							.ino = block.slice(offset.value()).as<const Ext2::LinkedDirectoryEntry>().inode,
+						};
+					}
+				} while (TRY(next_directory_index_leaf(path)));
+
+				return BAN::Error::from_errno(ENOENT);
+			}
 
-		while (entry_offset < block_size)
+			dwarnln("Invalid directory index in inode {}, falling back to linear search", ino());
+		}
+
+		for (uint32_t i = 0; i < max_used_data_block_count(); i++)
 		{
-			auto& entry = block_buffer.span().slice(entry_offset).as<Ext2::LinkedDirectoryEntry>();
+			read_directory_block(i, block);
+			if (auto offset = find_entry_in_directory_block(block, name); offset.has_value())
+			{
+				return DirectoryEntryLocation {
+					.data_block = i,
+					.offset = offset.value(),
+					.ino = block.slice(offset.value()).as<const Ext2::LinkedDirectoryEntry>().inode,
+				};
+			}
+		}
 
-			uint32_t entry_min_rec_len = sizeof(Ext2::LinkedDirectoryEntry) + entry.name_len;
-			if (auto rem = entry_min_rec_len % 4)
-				entry_min_rec_len += 4 - rem;
+		return BAN::Error::from_errno(ENOENT);
+	}
+
+	BAN::ErrorOr<void> Ext2Inode::add_linear_directory_entry(uint32_t entry_ino, uint8_t file_type, BAN::StringView name)
+	{
+		// Linear insertion can overwrite index nodes, so a possibly invalid index is dropped
+		m_inode.flags &= ~Ext2::Enum::INDEX_FL;
 
-			if (entry.inode == 0 && needed_entry_len <= entry.rec_len)
+		auto block_buffer = TRY(m_fs.get_block_buffer());
+		auto block = block_buffer.span();
+
+		// Try to insert inode to last data block
+		const uint32_t data_block_count = max_used_data_block_count();
+		if (data_block_count > 0)
+		{
+			read_directory_block(data_block_count - 1, block);
+			if (insert_entry_to_directory_block(block.slice(0, directory_leaf_size()), entry_ino, file_type, name))
 			{
-				write_inode(entry_offset, entry.rec_len);
-				m_fs.write_block(block_index, block_buffer);
+				write_directory_block(data_block_count - 1, block);
 				return {};
 			}
-			else if (needed_entry_len <= entry.rec_len - entry_min_rec_len)
+
+			// Directory outgrows its first block, switch to a hashed index
+			if (data_block_count == 1 && (m_fs.superblock().feature_compat & Ext2::Enum::FEATURE_COMPAT_DIR_INDEX))
+				if (TRY(create_directory_index()))
+					return add_indexed_directory_entry(entry_ino, file_type, name);
+		}
+
+		const uint32_t data_block_index = TRY(append_directory_block());
+
+		memset(block.data(), 0x00, block.size());
+		block.as<Ext2::LinkedDirectoryEntry>().rec_len = directory_leaf_size();
+		initialize_directory_tail(block);
+		const bool inserted = insert_entry_to_directory_block(block.slice(0, directory_leaf_size()), entry_ino, file_type, name);
+		ASSERT(inserted);
+		write_directory_block(data_block_index, block);
+
+		return {};
+	}
+
+	BAN::ErrorOr<void> Ext2Inode::add_indexed_directory_entry(uint32_t entry_ino, uint8_t file_type, BAN::StringView name)
+	{
+		for (;;)
+		{
+			DirectoryIndexPath path;
+			if (!TRY(probe_directory_index(name, path)))
+			{
+				dwarnln("Invalid directory index in inode {}, dropping the index", ino());
+				return add_linear_directory_entry(entry_ino, file_type, name);
+			}
+
 			{
-				uint32_t new_rec_len = entry.rec_len - entry_min_rec_len;
-				entry.rec_len = entry_min_rec_len;
+				auto block_buffer = TRY(m_fs.get_block_buffer());
+				auto block = block_buffer.span();
 
-				write_inode(entry_offset + entry.rec_len, new_rec_len);
-				m_fs.write_block(block_index, block_buffer);
-				return {};
+				read_directory_block(path.leaf_block, block);
+				if (insert_entry_to_directory_block(block.slice(0, directory_leaf_size()), entry_ino, file_type, name))
+				{
+					write_directory_block(path.leaf_block, block);
+					return {};
+				}
 			}
 
-			entry_offset += entry.rec_len;
+			TRY(split_directory_leaf(path));
 		}
+	}
 
-needs_new_block:
-		block_index = TRY(allocate_new_block(data_block_count));
-		m_inode.size += blksize();
+	bool Ext2Inode::uses_directory_index() const
+	{
+		if (!(m_inode.flags & Ext2::Enum::INDEX_FL))
+			return false;
+		return m_fs.superblock().feature_compat & Ext2::Enum::FEATURE_COMPAT_DIR_INDEX;
+	}
+
+	uint32_t Ext2Inode::directory_index_limit(bool is_root) const
+	{
+		uint32_t entry_space = blksize() - (is_root ? s_dx_root_info_offset + sizeof(Ext2::DxRootInfo) : sizeof(Ext2::LinkedDirectoryEntry));
+		// leave room for the checksum tail so the directory stays valid if checksums are enabled later
+		if (m_fs.superblock().feature_ro_compat & Ext2::Enum::FEATURE_RO_COMPAT_METADATA_CSUM)
+			entry_space -= sizeof(Ext2::DxEntry);
+		return entry_space / sizeof(Ext2::DxEntry);
+	}
+
+	BAN::ErrorOr<bool> Ext2Inode::probe_directory_index(BAN::StringView name, DirectoryIndexPath& path)
+	{
+		auto block_buffer = TRY(m_fs.get_block_buffer());
+		auto block = block_buffer.span();
+
+		read_directory_block(0, block);
+
+		const auto& root_info = block.slice(s_dx_root_info_offset).as<const Ext2::DxRootInfo>();
+		if (root_info.reserved_zero != 0 || root_info.info_length != sizeof(Ext2::DxRootInfo))
+			return false;
+		if (root_info.indirect_levels >= sizeof(path.levels) / sizeof(*path.levels))
+			return false;
+		if (root_info.hash_version > Ext2::Enum::DX_HASH_TEA)
+			return false;
+
+		path.hash_version = root_info.hash_version;
+		if (m_fs.superblock().flags & Ext2::Enum::FLAGS_UNSIGNED_HASH)
+			path.hash_version += Ext2::Enum::DX_HASH_LEGACY_UNSIGNED;
+
+		const auto hash = Ext2::directory_hash(name, path.hash_version, m_fs.superblock().hash_seed);
+		if (!hash.has_value())
+			return false;
+		path.hash = hash.value();
+		path.level_count = root_info.indirect_levels + 1;
+
+		uint32_t data_block_index = 0;
+		for (uint32_t level = 0; level < path.level_count; level++)
+		{
+			if (level > 0)
+			{
+				if (data_block_index == 0 || data_block_index >= max_used_data_block_count())
+					return false;
+				read_directory_block(data_block_index, block);
+			}
+
+			auto* entries = directory_index_entries(block, level == 0);
+			if (!is_valid_directory_index_node(block, entries))
+				return false;
+
+			// First entry has no hash, it covers everything below the second entry.
+			// Find the last entry with hash less than or equal to ours.
+			uint32_t left = 1;
+			uint32_t right = directory_index_count_limit(entries).count;
+			while (left < right)
+			{
+				const uint32_t mid = (left + right) / 2;
+				if (entries[mid].hash <= path.hash)
+					left = mid + 1;
+				else
+					right = mid;
+			}
+
+			path.levels[level] = { .data_block = data_block_index, .index = left - 1 };
+			data_block_index = entries[left - 1].block;
+		}
+
+		if (data_block_index == 0 || data_block_index >= max_used_data_block_count())
+			return false;
+		path.leaf_block = data_block_index;
+
+		return true;
+	}
+
+	BAN::ErrorOr<bool> Ext2Inode::next_directory_index_leaf(DirectoryIndexPath& path)
+	{
+		auto block_buffer = TRY(m_fs.get_block_buffer());
+		auto block = block_buffer.span();
+
+		// Find the deepest index node that has entries left
+		uint32_t level = path.level_count - 1;
+		Ext2::DxEntry* entries = nullptr;
+		for (;;)
+		{
+			read_directory_block(path.levels[level].data_block, block);
+			entries = directory_index_entries(block, level == 0);
+			if (path.levels[level].index + 1 < directory_index_count_limit(entries).count)
+				break;
+			if (level == 0)
+				return false;
+			level--;
+		}
+
+		path.levels[level].index++;
+
+		// Following blocks only matter if the hash continues in them
+		const auto& entry = entries[path.levels[level].index];
+		if ((entry.hash & ~1u) != path.hash)
+			return false;
+
+		uint32_t data_block_index = entry.block;
+		for (level++; level < path.level_count; level++)
+		{
+			if (data_block_index == 0 || data_block_index >= max_used_data_block_count())
+				return false;
+			read_directory_block(data_block_index, block);
+			entries = directory_index_entries(block, false);
+			if (!is_valid_directory_index_node(block, entries))
+				return false;
+			path.levels[level] = { .data_block = data_block_index, .index = 0 };
+			data_block_index = entries[0].block;
+		}
+
+		if (data_block_index == 0 || data_block_index >= max_used_data_block_count())
+			return false;
+		path.leaf_block = data_block_index;
+
+		return true;
+	}
+
+	BAN::ErrorOr<bool> Ext2Inode::create_directory_index()
+	{
+		ASSERT(max_used_data_block_count() == 1);
+
+		const uint32_t block_size = blksize();
+
+		auto root_buffer = TRY(m_fs.get_block_buffer());
+		auto root = root_buffer.span();
+		read_directory_block(0, root);
+
+		// Index root only fits if "." and ".." are the first entries
+		auto& dot = root.as<Ext2::LinkedDirectoryEntry>();
+		if (dot.rec_len != 12 || dot.name_len != 1 || dot.name[0] != '.')
+			return false;
+		auto& dotdot = root.slice(12).as<Ext2::LinkedDirectoryEntry>();
+		if (dotdot.name_len != 2 || dotdot.name[0] != '.' || dotdot.name[1] != '.')
+			return false;
+		if (dotdot.rec_len < 12 || 12u + dotdot.rec_len > block_size)
+			return false;
+
+		// Move rest of the entries to a new leaf block
+		auto leaf_buffer = TRY(m_fs.get_block_buffer());
+		auto leaf = leaf_buffer.span();
+		memset(leaf.data(), 0x00, leaf.size());
+
+		// Checksum tail of the root is not moved, entries end where the leaf's tail starts
+		const uint32_t leaf_size = directory_leaf_size();
+		const uint32_t entries_offset = 12 + dotdot.rec_len;
+		if (entries_offset >= leaf_size)
+			leaf.as<Ext2::LinkedDirectoryEntry>().rec_len = leaf_size;
+		else
+		{
+			memcpy(leaf.data(), root.data() + entries_offset, leaf_size - entries_offset);
+
+			uint32_t offset = 0;
+			for (;;)
+			{
+				auto& entry = leaf.slice(offset).as<Ext2::LinkedDirectoryEntry>();
+				if (entry.rec_len < sizeof(Ext2::LinkedDirectoryEntry))
+					return false;
+				if (offset + entry.rec_len >= leaf_size - entries_offset)
+				{
+					entry.rec_len = leaf_size - offset;
+					break;
+				}
+				offset += entry.rec_len;
+			}
+		}
+		initialize_directory_tail(leaf);
+
+		const uint32_t leaf_block = TRY(append_directory_block());
+		write_directory_block(leaf_block, leaf);
+
+		// Hash signedness has to be recorded before the first index is created
+		if (!(m_fs.superblock().flags & (Ext2::Enum::FLAGS_SIGNED_HASH | Ext2::Enum::FLAGS_UNSIGNED_HASH)))
+		{
+			m_fs.m_superblock.flags |= Ext2::Enum::FLAGS_SIGNED_HASH;
+			m_fs.m_superblock_dirty = true;
+		}
+
+		uint8_t hash_version = m_fs.superblock().def_hash_version;
+		if (hash_version > Ext2::Enum::DX_HASH_TEA)
+			hash_version = Ext2::Enum::DX_HASH_HALF_MD4;
+
+		dotdot.rec_len = block_size - 12;
+		memset(root.data() + s_dx_root_info_offset, 0x00, block_size - s_dx_root_info_offset);
+
+		auto& root_info = root.slice(s_dx_root_info_offset).as<Ext2::DxRootInfo>();
+		root_info.hash_version = hash_version;
+		root_info.info_length = sizeof(Ext2::DxRootInfo);
+
+		auto* entries = directory_index_entries(root, true);
+		entries[0].block = leaf_block;
+		directory_index_count_limit(entries) = {
+			.limit = static_cast<uint16_t>(directory_index_limit(true)),
+			.count = 1,
+		};
+
+		// Flag has to be set before writing, the root is checksummed as an index node
+		m_inode.flags |= Ext2::Enum::INDEX_FL;
+
+		write_directory_block(0, root);
+
+		return true;
+	}
+
+	BAN::ErrorOr<void> Ext2Inode::split_directory_leaf(DirectoryIndexPath& path)
+	{
+		const uint32_t block_size = blksize();
+
+		auto old_buffer = TRY(m_fs.get_block_buffer());
+		auto old_block = old_buffer.span();
+		read_directory_block(path.leaf_block, old_block);
+
+		struct EntryInfo
+		{
+			uint32_t hash;
+			uint32_t offset;
+		};
 
-		memset(block_buffer.data(), 0x00, block_buffer.size());
-		write_inode(0, block_size);
-		m_fs.write_block(block_index, block_buffer);
+		BAN::Vector<EntryInfo> entries;
+		for (uint32_t offset = 0; offset + sizeof(Ext2::LinkedDirectoryEntry) <= block_size;)
+		{
+			auto& entry = old_block.slice(offset).as<const Ext2::LinkedDirectoryEntry>();
+			if (entry.rec_len < sizeof(Ext2::LinkedDirectoryEntry))
+				return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+			if (entry.inode)
+			{
+				const auto hash = Ext2::directory_hash(BAN::StringView(entry.name, entry.name_len), path.hash_version, m_fs.superblock().hash_seed);
+				if (!hash.has_value())
+					return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+				TRY(entries.push_back({ .hash = hash.value(), .offset = offset }));
+			}
+			offset += entry.rec_len;
+		}
+
+		// A full block always has multiple entries, names are shorter than half a block
+		if (entries.size() < 2)
+			return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+
+		BAN::sort::intro_sort(entries.begin(), entries.end(),
+			[](const EntryInfo& a, const EntryInfo& b) { return a.hash < b.hash; }
+		);
+
+		// Entries with the same hash as the split point are marked as continuing in the new block
+		const size_t split_index = entries.size() / 2;
+		const uint32_t split_hash = entries[split_index].hash;
+		const bool continued = (entries[split_index - 1].hash == split_hash);
+
+		const uint32_t new_block_index = TRY(append_directory_block());
+
+		auto pack_entries = [&](BAN::ByteSpan block, size_t first, size_t last)
+		{
+			memset(block.data(), 0x00, block.size());
+
+			uint32_t offset = 0;
+			Ext2::LinkedDirectoryEntry* previous = nullptr;
+			for (size_t i = first; i < last; i++)
+			{
+				const auto& entry = old_block.slice(entries[i].offset).as<const Ext2::LinkedDirectoryEntry>();
+				auto& new_entry = block.slice(offset).as<Ext2::LinkedDirectoryEntry>();
+				memcpy(&new_entry, &entry, sizeof(Ext2::LinkedDirectoryEntry) + entry.name_len);
+				new_entry.rec_len = directory_entry_rec_len(entry.name_len);
+				offset += new_entry.rec_len;
+				previous = &new_entry;
+			}
+			previous->rec_len += directory_leaf_size() - offset;
+			initialize_directory_tail(block);
+		};
+
+		{
+			auto new_buffer = TRY(m_fs.get_block_buffer());
+
+			pack_entries(new_buffer.span(), split_index, entries.size());
+			write_directory_block(new_block_index, new_buffer.span());
+
+			pack_entries(new_buffer.span(), 0, split_index);
+			write_directory_block(path.leaf_block, new_buffer.span());
+		}
+
+		TRY(insert_directory_index_entry(path, split_hash | continued, new_block_index));
+
+		return {};
+	}
+
+	BAN::ErrorOr<void> Ext2Inode::insert_directory_index_entry(DirectoryIndexPath& path, uint32_t hash, uint32_t data_block_index)
+	{
+		const uint32_t block_size = blksize();
+
+		auto node_buffer = TRY(m_fs.get_block_buffer());
+		auto node = node_buffer.span();
+
+		uint32_t level = path.level_count - 1;
+		read_directory_block(path.levels[level].data_block, node);
+
+		auto* entries = directory_index_entries(node, level == 0);
+		if (directory_index_count_limit(entries).count >= directory_index_count_limit(entries).limit)
+		{
+			auto new_buffer = TRY(m_fs.get_block_buffer());
+			auto new_node = new_buffer.span();
+			memset(new_node.data(), 0x00, new_node.size());
+			new_node.as<Ext2::LinkedDirectoryEntry>().rec_len = block_size;
+			auto* new_entries = directory_index_entries(new_node, false);
+
+			if (level == 0)
+			{
+				// Root is full, move its entries to a new index node below it
+				const uint32_t count = directory_index_count_limit(entries).count;
+				const uint32_t new_node_block = TRY(append_directory_block());
+
+				memcpy(new_entries, entries, count * sizeof(Ext2::DxEntry));
+				directory_index_count_limit(new_entries) = {
+					.limit = static_cast<uint16_t>(directory_index_limit(false)),
+					.count = static_cast<uint16_t>(count),
+				};
+				write_directory_block(new_node_block, new_node);
+
+				directory_index_count_limit(entries).count = 1;
+				entries[0].block = new_node_block;
+				node.slice(s_dx_root_info_offset).as<Ext2::DxRootInfo>().indirect_levels = 1;
+				write_directory_block(0, node);
+
+				path.levels[1] = { .data_block = new_node_block, .index = path.levels[0].index };
+				path.levels[0].index = 0;
+				path.level_count = 2;
+				level = 1;
+
+				memcpy(node.data(), new_node.data(), block_size);
+				entries = directory_index_entries(node, false);
+			}
+			else
+			{
+				// Split the index node in half, parent needs room for the new node
+				auto parent_buffer = TRY(m_fs.get_block_buffer());
+				auto parent = parent_buffer.span();
+				read_directory_block(path.levels[level - 1].data_block, parent);
+
+				auto* parent_entries = directory_index_entries(parent, level - 1 == 0);
+				auto& parent_count_limit = directory_index_count_limit(parent_entries);
+				if (parent_count_limit.count >= parent_count_limit.limit)
+				{
+					dwarnln("Directory index of inode {} is full", ino());
+					return BAN::Error::from_errno(ENOSPC);
+				}
+
+				const uint32_t count = directory_index_count_limit(entries).count;
+				const uint32_t keep_count = count / 2;
+				const uint32_t new_node_block = TRY(append_directory_block());
+				const uint32_t new_node_hash = entries[keep_count].hash;
+
+				memcpy(new_entries, entries + keep_count, (count - keep_count) * sizeof(Ext2::DxEntry));
+				directory_index_count_limit(new_entries) = {
+					.limit = static_cast<uint16_t>(directory_index_limit(false)),
+					.count = static_cast<uint16_t>(count - keep_count),
+				};
+				write_directory_block(new_node_block, new_node);
+
+				directory_index_count_limit(entries).count = keep_count;
+
+				const uint32_t parent_index = path.levels[level - 1].index + 1;
+				memmove(parent_entries + parent_index + 1, parent_entries + parent_index, (parent_count_limit.count - parent_index) * sizeof(Ext2::DxEntry));
+				parent_entries[parent_index] = { .hash = new_node_hash, .block = new_node_block };
+				parent_count_limit.count++;
+				write_directory_block(path.levels[level - 1].data_block, parent);
+
+				// Continue in the half the new entry belongs to
+				if (path.levels[level].index + 1 > keep_count)
+				{
+					write_directory_block(path.levels[level].data_block, node);
+
+					path.levels[level - 1].index = parent_index;
+					path.levels[level] = { .data_block = new_node_block, .index = path.levels[level].index - keep_count };
+
+					memcpy(node.data(), new_node.data(), block_size);
+					entries = directory_index_entries(node, false);
+				}
+			}
+		}
+
+		auto& count_limit = directory_index_count_limit(entries);
+		const uint32_t index = path.levels[level].index + 1;
+		memmove(entries + index + 1, entries + index, (count_limit.count - index) * sizeof(Ext2::DxEntry));
+		entries[index] = { .hash = hash, .block = data_block_index };
+		count_limit.count++;
+		write_directory_block(path.levels[level].data_block, node);
 
 		return {};
 	}
@@ -552,7 +1641,7 @@ needs_new_block:
 	{
 		ASSERT(mode().ifdir());
 
-		auto block_buffer = m_fs.get_block_buffer();
+		auto block_buffer = TRY(m_fs.get_block_buffer());
 
 		// Confirm that this doesn't contain anything else than '.' or '..'
 		for (uint32_t i = 0; i < max_used_data_block_count(); i++)
@@ -583,13 +1672,8 @@ needs_new_block:
 	BAN::ErrorOr<void> Ext2Inode::cleanup_default_links()
 	{
 		ASSERT(mode().ifdir());
-		if (m_inode.flags & Ext2::Enum::INDEX_FL)
-		{
-			dwarnln("deletion of indexed directory is not supported");
-			return BAN::Error::from_errno(ENOTSUP);
-		}
 
-		auto block_buffer = m_fs.get_block_buffer();
+		auto block_buffer = TRY(m_fs.get_block_buffer());
 
 		for (uint32_t i = 0; i < max_used_data_block_count(); i++)
 		{
@@ -630,7 +1714,7 @@ needs_new_block:
 			}
 
 			if (modified)
-				m_fs.write_block(block_index, block_buffer);
+				write_directory_block(i, block_buffer.span());
 		}
 
 		return {};
@@ -638,62 +1722,54 @@ needs_new_block:
 
 	BAN::ErrorOr<void> Ext2Inode::unlink_impl(BAN::StringView name)
 	{
+		if (m_fs.is_read_only())
+			return BAN::Error::from_errno(EROFS);
 		ASSERT(mode().ifdir());
-		if (m_inode.flags & Ext2::Enum::INDEX_FL)
-		{
-			dwarnln("deletion from indexed directory is not supported");
-			return BAN::Error::from_errno(ENOTSUP);
-		}
 
-		auto block_buffer = m_fs.get_block_buffer();
+		const auto location = TRY(find_directory_entry(name));
 
-		for (uint32_t i = 0; i < max_used_data_block_count(); i++)
+		auto inode = TRY(Ext2Inode::create(m_fs, location.ino));
+		if (inode->mode().ifdir())
 		{
-			// FIXME: can we actually assume directories have all their blocks allocated
-			const uint32_t block_index = fs_block_of_data_block_index(i).value();
-			m_fs.read_block(block_index, block_buffer);
+			if (!TRY(inode->is_directory_empty()))
+				return BAN::Error::from_errno(ENOTEMPTY);
+			TRY(inode->cleanup_default_links());
+		}
 
-			blksize_t offset = 0;
-			while (offset < blksize())
-			{
-				auto& entry = block_buffer.span().slice(offset).as<Ext2::LinkedDirectoryEntry>();
-				if (entry.inode && name == BAN::StringView(entry.name, entry.name_len))
-				{
-					auto inode = TRY(Ext2Inode::create(m_fs, entry.inode));
-					if (inode->mode().ifdir())
-					{
-						if (!TRY(inode->is_directory_empty()))
-							return BAN::Error::from_errno(ENOTEMPTY);
-						TRY(inode->cleanup_default_links());
-					}
+		if (inode->nlink() == 0)
+			dprintln("Corrupted filesystem. Deleting inode with 0 links");
+		else
+			inode->m_inode.links_count--;
 
-					if (inode->nlink() == 0)
-						dprintln("Corrupted filesystem. Deleting inode with 0 links");
-					else
-						inode->m_inode.links_count--;
+		sync();
 
-					sync();
+		// NOTE: If this was the last link to inode we must
+		//       remove it from inode cache to trigger cleanup
+		if (inode->nlink() == 0)
+		{
+			LockGuard _(m_fs.m_inode_cache_mutex);
+			auto& cache = m_fs.inode_cache();
+			if (cache.contains(inode->ino()))
+				cache.remove(inode->ino());
+		}
 
-					// NOTE: If this was the last link to inode we must
-					//       remove it from inode cache to trigger cleanup
-					if (inode->nlink() == 0)
-					{
-						auto& cache = m_fs.inode_cache();
-						if (cache.contains(inode->ino()))
-							cache.remove(inode->ino());
-					}
+		auto block_buffer = TRY(m_fs.get_block_buffer());
+		read_directory_block(location.data_block, block_buffer.span());
 
-					// FIXME: This should expand the last inode if exists
-					entry.inode = 0;
-					m_fs.write_block(block_index, block_buffer);
-				}
-				offset += entry.rec_len;
-			}
-		}
+		// FIXME: This should expand the last inode if exists
+		block_buffer.span().slice(location.offset).as<Ext2::LinkedDirectoryEntry>().inode = 0;
+		write_directory_block(location.data_block, block_buffer.span());
 
 		return {};
 	}
 
+	BAN::ErrorOr<uint32_t> Ext2Inode::reserve_block()
+	{
+		const uint32_t goal_block = m_last_allocated_block ? m_last_allocated_block + 1 : 0;
+		m_last_allocated_block = TRY(m_fs.reserve_free_block(block_group(), &m_preallocation, goal_block));
+		return m_last_allocated_block;
+	}
+
 	BAN::ErrorOr<uint32_t> Ext2Inode::allocate_new_block_to_indirect_block(uint32_t& block, uint32_t index, uint32_t depth)
 	{
 		const uint32_t inode_blocks_per_fs_block = blksize() / 512;
@@ -704,10 +1780,10 @@ needs_new_block:
 
 		if (block == 0)
 		{
-			block = TRY(m_fs.reserve_free_block(block_group()));
+			block = TRY(reserve_block());
 			m_inode.blocks += inode_blocks_per_fs_block;
 
-			auto block_buffer = m_fs.get_block_buffer();
+			auto block_buffer = TRY(m_fs.get_block_buffer());
 			memset(block_buffer.data(), 0x00, block_buffer.size());
 			m_fs.write_block(block, block_buffer);
 		}
@@ -715,7 +1791,7 @@ needs_new_block:
 		if (depth == 0)
 			return block;
 
-		auto block_buffer = m_fs.get_block_buffer();
+		auto block_buffer = TRY(m_fs.get_block_buffer());
 		m_fs.read_block(block, block_buffer);
 
 		uint32_t divisor = 1;
@@ -730,73 +1806,353 @@ needs_new_block:
 		return allocated_block;
 	}
 
-	BAN::ErrorOr<uint32_t> Ext2Inode::allocate_new_block(uint32_t data_block_index)
+	BAN::ErrorOr<uint32_t> Ext2Inode::allocate_new_block_to_extent_tree(uint32_t data_block_index)
 	{
+		static constexpr uint32_t max_depth = 5;
+
 		const uint32_t inode_blocks_per_fs_block = blksize() / 512;
-		const uint32_t indices_per_fs_block = blksize() / sizeof(uint32_t);
 
-		BAN::ScopeGuard syncer([&] { sync(); });
+		BAN::Optional<uint32_t> new_block;
+		BAN::ScopeGuard block_releaser([&] { if (new_block.has_value()) m_fs.release_block(new_block.value()); });
 
-		if (data_block_index < 12)
+		for (;;)
 		{
-			ASSERT(m_inode.block[data_block_index] == 0);
-			m_inode.block[data_block_index] = TRY(m_fs.reserve_free_block(block_group()));
-			m_inode.blocks += inode_blocks_per_fs_block;
-			return m_inode.block[data_block_index];
+			auto block_buffer = TRY(m_fs.get_block_buffer());
+			auto node = block_buffer.span();
+
+			struct PathEntry
+			{
+				uint32_t node_block;
+				uint32_t index;
+				bool full;
+			};
+			PathEntry path[max_depth + 1];
+
+			// Walk to the leaf that should contain data_block_index
+			read_extent_node(0, node);
+			const uint32_t tree_depth = extent_header(node).depth;
+			if (tree_depth > max_depth)
+				return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+
+			uint32_t node_block = 0;
+			for (uint32_t level = 0;; level++)
+			{
+				auto& header = extent_header(node);
+				if (header.magic != Ext2::Enum::EXTENT_MAGIC || header.depth != tree_depth - level)
+					return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+
+				path[level].node_block = node_block;
+				path[level].full = (header.entries >= header.max);
+				if (header.depth == 0)
+					break;
+
+				if (header.entries == 0)
+					return BAN::Error::from_error_code(ErrorCode::Ext2_Corrupted);
+
+				auto index = find_extent_entry(node, data_block_index);
+				if (!index.has_value())
+				{
+					// new first block of this subtree
+					index = 0;
+					extent_entry_key(node, 0) = data_block_index;
+					write_extent_node(node_block, node);
+				}
+
+				path[level].index = index.value();
+				node_block = extent_entries<Ext2::ExtentIndex>(node)[index.value()].leaf_lo;
+				read_extent_node(node_block, node);
+			}
+
+			auto& header = extent_header(node);
+			auto* extents = extent_entries<Ext2::Extent>(node);
+			const auto index = find_extent_entry(node, data_block_index);
+
+			if (index.has_value())
+			{
+				auto& extent = extents[index.value()];
+				ASSERT(data_block_index >= extent.block + extent.len || extent.len > Ext2::Enum::EXTENT_MAX_INIT_LEN);
+
+				if (data_block_index < extent.block + extent_length(extent))
+				{
+					// Blocks of uninitialized extents are already allocated, zero them and mark the extent initialized
+					auto zero_buffer = TRY(m_fs.get_block_buffer());
+					memset(zero_buffer.data(), 0x00, zero_buffer.size());
+					for (uint32_t i = 0; i < extent_length(extent); i++)
+						m_fs.write_block(extent.start_lo + i, zero_buffer);
+
+					extent.len = extent_length(extent);
+					write_extent_node(node_block, node);
+
+					return extent.start_lo + (data_block_index - extent.block);
+				}
+			}
+
+			if (!new_block.has_value())
+				new_block = TRY(reserve_block());
+
+			// Extend the previous extent if the new block continues it
+			if (index.has_value())
+			{
+				auto& extent = extents[index.value()];
+				if (extent.len < Ext2::Enum::EXTENT_MAX_INIT_LEN && extent.block + extent.len == data_block_index && extent.start_lo + extent.len == new_block.value())
+				{
+					extent.len++;
+					write_extent_node(node_block, node);
+					break;
+				}
+			}
+
+			if (header.entries < header.max)
+			{
+				const uint32_t insert_index = index.has_value() ? index.value() + 1 : 0;
+				memmove(&extents[insert_index + 1], &extents[insert_index], (header.entries - insert_index) * sizeof(Ext2::Extent));
+				extents[insert_index] = {
+					.block = data_block_index,
+					.len = 1,
+					.start_hi = 0,
+					.start_lo = new_block.value(),
+				};
+				header.entries++;
+				write_extent_node(node_block, node);
+				break;
+			}
+
+			// Leaf is full, split the lowest full node whose parent has room and try again
+			uint32_t level = tree_depth;
+			while (level > 0 && path[level - 1].full)
+				level--;
+			if (level == 0)
+				TRY(grow_extent_tree());
+			else
+				TRY(split_extent_node(path[level - 1].node_block, path[level - 1].index, path[level].node_block));
 		}
-		data_block_index -= 12;
 
-		if (data_block_index < indices_per_fs_block)
-			return TRY(allocate_new_block_to_indirect_block(m_inode.block[12], data_block_index, 1));
-		data_block_index -= indices_per_fs_block;
+		m_inode.blocks += inode_blocks_per_fs_block;
+
+		const uint32_t block = new_block.value();
+		new_block.clear();
+		return block;
+	}
 
-		if (data_block_index < indices_per_fs_block * indices_per_fs_block)
-			return TRY(allocate_new_block_to_indirect_block(m_inode.block[13], data_block_index, 2));
-		data_block_index -= indices_per_fs_block * indices_per_fs_block;
+	BAN::ErrorOr<void> Ext2Inode::grow_extent_tree()
+	{
+		// Root in the inode is full, move its entries to a new block and point the root to it
+		auto root_buffer = TRY(m_fs.get_block_buffer());
+		auto child_buffer = TRY(m_fs.get_block_buffer());
+		auto root = root_buffer.span();
+		auto child = child_buffer.span();
+
+		read_extent_node(0, root);
+
+		const uint32_t child_block = TRY(m_fs.reserve_free_block(block_group(), nullptr, m_last_allocated_block));
+
+		memset(child.data(), 0x00, child.size());
+		memcpy(child.data(), root.data(), sizeof(m_inode.block));
+		extent_header(child).max = (blksize() - sizeof(Ext2::ExtentHeader)) / sizeof(Ext2::Extent);
+		write_extent_node(child_block, child);
+
+		auto& root_header = extent_header(root);
+		root_header.depth++;
+		root_header.entries = 1;
+		extent_entries<Ext2::ExtentIndex>(root)[0] = {
+			.block = extent_entry_key(child, 0),
+			.leaf_lo = child_block,
+			.leaf_hi = 0,
+			.__unused = 0,
+		};
+		write_extent_node(0, root);
 
-		if (data_block_index < indices_per_fs_block * indices_per_fs_block * indices_per_fs_block)
-			return TRY(allocate_new_block_to_indirect_block(m_inode.block[14], data_block_index, 3));
+		m_inode.blocks += blksize() / 512;
 
-		ASSERT_NOT_REACHED();
+		return {};
+	}
+
+	BAN::ErrorOr<void> Ext2Inode::split_extent_node(uint32_t parent_block, uint32_t parent_index, uint32_t node_block)
+	{
+		ASSERT(node_block != 0);
+
+		auto parent_buffer = TRY(m_fs.get_block_buffer());
+		auto node_buffer = TRY(m_fs.get_block_buffer());
+		auto sibling_buffer = TRY(m_fs.get_block_buffer());
+		auto parent = parent_buffer.span();
+		auto node = node_buffer.span();
+		auto sibling = sibling_buffer.span();
+
+		read_extent_node(parent_block, parent);
+		read_extent_node(node_block, node);
+
+		auto& parent_header = extent_header(parent);
+		auto& node_header = extent_header(node);
+		ASSERT(parent_header.entries < parent_header.max);
+
+		const uint32_t sibling_block = TRY(m_fs.reserve_free_block(block_group(), nullptr, node_block));
+
+		// Move the upper half of the entries to the new sibling
+		const uint32_t keep_count = node_header.entries / 2;
+		const uint32_t move_count = node_header.entries - keep_count;
+
+		memset(sibling.data(), 0x00, sibling.size());
+		extent_header(sibling) = {
+			.magic = Ext2::Enum::EXTENT_MAGIC,
+			.entries = static_cast<uint16_t>(move_count),
+			.max = node_header.max,
+			.depth = node_header.depth,
+			.generation = 0,
+		};
+		memcpy(extent_entries<uint8_t>(sibling), extent_entries<uint8_t>(node) + keep_count * sizeof(Ext2::Extent), move_count * sizeof(Ext2::Extent));
+		node_header.entries = keep_count;
+
+		write_extent_node(sibling_block, sibling);
+		write_extent_node(node_block, node);
+
+		auto* indices = extent_entries<Ext2::ExtentIndex>(parent);
+		memmove(&indices[parent_index + 2], &indices[parent_index + 1], (parent_header.entries - parent_index - 1) * sizeof(Ext2::ExtentIndex));
+		indices[parent_index + 1] = {
+			.block = extent_entry_key(sibling, 0),
+			.leaf_lo = sibling_block,
+			.leaf_hi = 0,
+			.__unused = 0,
+		};
+		parent_header.entries++;
+		write_extent_node(parent_block, parent);
+
+		m_inode.blocks += blksize() / 512;
+
+		return {};
+	}
+
+	void Ext2Inode::cleanup_extent_node(uint32_t node_block)
+	{
+		auto block_buffer = m_fs.get_block_buffer_blocking();
+		auto node = block_buffer.span();
+
+		read_extent_node(node_block, node);
+
+		const auto& header = extent_header(node);
+		if (header.magic != Ext2::Enum::EXTENT_MAGIC)
+		{
+			dwarnln("Invalid extent tree in inode {}", ino());
+			return;
+		}
+
+		for (uint32_t i = 0; i < header.entries; i++)
+		{
+			if (header.depth > 0)
+			{
+				cleanup_extent_node(extent_entries<Ext2::ExtentIndex>(node)[i].leaf_lo);
+				continue;
+			}
+			const auto& extent = extent_entries<Ext2::Extent>(node)[i];
+			for (uint32_t j = 0; j < extent_length(extent); j++)
+				m_fs.release_block(extent.start_lo + j);
+		}
+
+		if (node_block != 0)
+			m_fs.release_block(node_block);
+	}
+
+	BAN::ErrorOr<uint32_t> Ext2Inode::allocate_new_block(uint32_t data_block_index)
+	{
+		const uint32_t inode_blocks_per_fs_block = blksize() / 512;
+		const uint32_t indices_per_fs_block = blksize() / sizeof(uint32_t);
+
+		uint32_t index = data_block_index;
+		uint32_t block;
+
+		if (m_inode.flags & Ext2::Enum::EXTENTS_FL)
+			block = TRY(allocate_new_block_to_extent_tree(data_block_index));
+		else if (index < 12)
+		{
+			ASSERT(m_inode.block[index] == 0);
+			m_inode.block[index] = TRY(reserve_block());
+			m_inode.blocks += inode_blocks_per_fs_block;
+			block = m_inode.block[index];
+		}
+		else if ((index -= 12) < indices_per_fs_block)
+			block = TRY(allocate_new_block_to_indirect_block(m_inode.block[12], index, 1));
+		else if ((index -= indices_per_fs_block) < indices_per_fs_block * indices_per_fs_block)
+			block = TRY(allocate_new_block_to_indirect_block(m_inode.block[13], index, 2));
+		else if ((index -= indices_per_fs_block * indices_per_fs_block) < indices_per_fs_block * indices_per_fs_block * indices_per_fs_block)
+			block = TRY(allocate_new_block_to_indirect_block(m_inode.block[14], index, 3));
+		else
+			ASSERT_NOT_REACHED();
+
+		cache_block_mapping({
+			.data_block = data_block_index,
+			.fs_block = block,
+			.block_count = 1,
+		});
+
+		return block;
 	}
 
 	void Ext2Inode::sync()
 	{
 		auto inode_location = m_fs.locate_inode(ino());
-		auto block_buffer = m_fs.get_block_buffer();
+
+		// inode table blocks are shared with other inodes
+		LockGuard _(m_fs.inode_table_lock(ino()));
+
+		auto block_buffer = m_fs.get_block_buffer_blocking();
 
 		m_fs.read_block(inode_location.block, block_buffer);
 		if (memcmp(block_buffer.data() + inode_location.offset, &m_inode, sizeof(Ext2::Inode)))
 		{
-			memcpy(block_buffer.data() + inode_location.offset, &m_inode, sizeof(Ext2::Inode));
+			auto raw_inode = block_buffer.span().slice(inode_location.offset, m_fs.superblock().inode_size);
+			memcpy(raw_inode.data(), &m_inode, sizeof(Ext2::Inode));
+			m_fs.update_inode_checksum(ino(), raw_inode);
 			m_fs.write_block(inode_location.block, block_buffer);
 		}
 	}
 
-	BAN::ErrorOr<BAN::RefPtr<Inode>> Ext2Inode::find_inode_impl(BAN::StringView file_name)
+	BAN::ErrorOr<void> Ext2Inode::sync_indirect_block(uint32_t block, uint32_t depth)
 	{
-		ASSERT(mode().ifdir());
+		ASSERT(block);
+		ASSERT(depth >= 1);
 
-		auto block_buffer = m_fs.get_block_buffer();
+		TRY(m_fs.sync_blocks(block, 1));
+		if (depth == 1)
+			return {};
 
-		for (uint32_t i = 0; i < max_used_data_block_count(); i++)
-		{
-			// FIXME: can we actually assume directories have all their blocks allocated
-			const uint32_t block_index = fs_block_of_data_block_index(i).value();
-			m_fs.read_block(block_index, block_buffer);
+		auto block_buffer = TRY(m_fs.get_block_buffer());
+		m_fs.read_block(block, block_buffer);
 
-			BAN::ConstByteSpan entry_span = block_buffer.span();
-			while (entry_span.size() >= sizeof(Ext2::LinkedDirectoryEntry))
-			{
-				auto& entry = entry_span.as<const Ext2::LinkedDirectoryEntry>();
-				BAN::StringView entry_name(entry.name, entry.name_len);
-				if (entry.inode && entry_name == file_name)
-					return BAN::RefPtr<Inode>(TRY(Ext2Inode::create(m_fs, entry.inode)));
-				entry_span = entry_span.slice(entry.rec_len);
-			}
+		const uint32_t ids_per_block = blksize() / sizeof(uint32_t);
+		for (uint32_t i = 0; i < ids_per_block; i++)
+		{
+			const uint32_t next_block = block_buffer.span().as_span<uint32_t>()[i];
+			if (next_block == 0)
+				continue;
+			TRY(sync_indirect_block(next_block, depth - 1));
 		}
 
-		return BAN::Error::from_errno(ENOENT);
+		return {};
+	}
+
+	BAN::ErrorOr<void> Ext2Inode::sync_extent_node(uint32_t node_block)
+	{
+		if (node_block != 0)
+			TRY(m_fs.sync_blocks(node_block, 1));
+
+		auto block_buffer = TRY(m_fs.get_block_buffer());
+		auto node = block_buffer.span();
+
+		read_extent_node(node_block, node);
+
+		const auto& header = extent_header(node);
+		if (header.magic != Ext2::Enum::EXTENT_MAGIC || header.depth == 0)
+			return {};
+
+		for (uint32_t i = 0; i < header.entries; i++)
+			TRY(sync_extent_node(extent_entries<Ext2::ExtentIndex>(node)[i].leaf_lo));
+
+		return {};
+	}
+
+	BAN::ErrorOr<BAN::RefPtr<Inode>> Ext2Inode::find_inode_impl(BAN::StringView file_name)
+	{
+		const auto location = TRY(find_directory_entry(file_name));
+		return BAN::RefPtr<Inode>(TRY(Ext2Inode::create(m_fs, location.ino)));
 	}
 
 }
@@ -95,9 +95,7 @@ namespace Kernel
 			return BAN::Error::from_errno(ENOTSUP);
 		}
 
-		TRY(m_fat_two_sector_buffer.resize(m_bpb.bytes_per_sector * 2));
-		TRY(m_block_device->read_blocks(first_fat_sector(), 2, BAN::ByteSpan(m_fat_two_sector_buffer.span())));
-		m_fat_sector_buffer_current = 0;
+		TRY(m_fat_cache.reserve(s_fat_cache_max_chunks));
 
 		FAT::DirectoryEntry root_entry {};
 		root_entry.attr = FAT::FileAttr::DIRECTORY;
@@ -110,42 +108,26 @@ namespace Kernel
 	{
 		LockGuard _(m_mutex);
 
+		BAN::Vector<FATInode::ClusterRun> cluster_runs;
+		if (parent)
+			cluster_runs = TRY(read_cluster_chain(first_cluster_of(entry)));
+		else if (m_type == Type::FAT32)
+			cluster_runs = TRY(read_cluster_chain(m_bpb.ext_32.root_cluster));
+
 		uint32_t block_count = 0;
-		{
-			uint32_t cluster = entry.first_cluster_lo;
-			if (m_type == Type::FAT32)
-				cluster |= static_cast<uint32_t>(entry.first_cluster_hi) << 16;
-			while (cluster >= 2 && cluster < cluster_count())
-			{
-				block_count++;
-				cluster = TRY(get_next_cluster(cluster));
-			}
-		}
+		if (!cluster_runs.empty())
+			block_count = cluster_runs.back().file_index + cluster_runs.back().count;
 
 		uint32_t entry_cluster;
-		switch (m_type)
+		if (!parent)
+			entry_cluster = (m_type == Type::FAT32) ? m_bpb.ext_32.root_cluster : 1;
+		else if (parent == m_root_inode && m_type != Type::FAT32)
+			entry_cluster = 1;
+		else
 		{
-			case Type::FAT12:
-			case Type::FAT16:
-				if (parent == m_root_inode)
-					entry_cluster = 1;
-				else
-				{
-					entry_cluster = parent->entry().first_cluster_lo;
-					for (uint32_t i = 0; i < cluster_index; i++)
-						entry_cluster = TRY(get_next_cluster(entry_cluster));
-				}
-				break;
-			case Type::FAT32:
-				if (parent == m_root_inode)
-					entry_cluster = m_bpb.ext_32.root_cluster;
-				else
-					entry_cluster = (static_cast<uint32_t>(parent->entry().first_cluster_hi) << 16) | parent->entry().first_cluster_lo;
-				for (uint32_t i = 0; i < cluster_index; i++)
-					entry_cluster = TRY(get_next_cluster(entry_cluster));
-				break;
-			default:
-				ASSERT_NOT_REACHED();
+			entry_cluster = parent->cluster_at(cluster_index);
+			if (entry_cluster == 0)
+				return BAN::Error::from_errno(EINVAL);
 		}
 
 		const ino_t ino = (static_cast<ino_t>(entry_cluster) << 32) | entry_index;
@@ -157,52 +139,125 @@ namespace Kernel
 			m_inode_cache.remove(it);
 		}
 
-		auto inode = TRY(BAN::RefPtr<FATInode>::create(*this, entry, ino, block_count));
+		auto inode = TRY(BAN::RefPtr<FATInode>::create(*this, entry, ino, BAN::move(cluster_runs), block_count));
 		TRY(m_inode_cache.insert(ino, TRY(inode->get_weak_ptr())));
 		return inode;
 	}
 
-	BAN::ErrorOr<void> FATFS::fat_cache_set_sector(uint32_t sector)
+	BAN::ErrorOr<BAN::Vector<FATInode::ClusterRun>> FATFS::read_cluster_chain(uint32_t first_cluster)
 	{
-		if (m_fat_sector_buffer_current != sector)
+		BAN::Vector<FATInode::ClusterRun> cluster_runs;
+
+		uint32_t cluster = first_cluster;
+		uint32_t file_index = 0;
+		while (is_data_cluster(cluster))
 		{
-			TRY(m_block_device->read_blocks(first_fat_sector() + sector, 2, BAN::ByteSpan(m_fat_two_sector_buffer.span())));
-			m_fat_sector_buffer_current = sector;
+			// Chain longer than the number of clusters must contain a loop
+			if (file_index >= cluster_count())
+			{
+				dwarnln("FAT cluster chain starting from {} contains a loop", first_cluster);
+				return BAN::Error::from_errno(EINVAL);
+			}
+
+			if (!cluster_runs.empty() && cluster_runs.back().first_cluster + cluster_runs.back().count == cluster)
+				cluster_runs.back().count++;
+			else
+			{
+				TRY(cluster_runs.push_back({
+					.file_index = file_index,
+					.first_cluster = cluster,
+					.count = 1,
+				}));
+			}
+
+			file_index++;
+			cluster = TRY(get_next_cluster(cluster));
 		}
-		return {};
+
+		return cluster_runs;
+	}
+
+	BAN::ErrorOr<const uint8_t*> FATFS::fat_cache_byte(uint32_t offset)
+	{
+		const uint32_t chunk_bytes = s_fat_chunk_sectors * m_bpb.bytes_per_sector;
+		const uint32_t chunk_index = offset / chunk_bytes;
+		const uint32_t chunk_offset = offset % chunk_bytes;
+
+		auto it = m_fat_cache_slots.find(chunk_index);
+		if (it != m_fat_cache_slots.end())
+		{
+			auto& chunk = m_fat_cache[it->value];
+			chunk.last_used = ++m_fat_cache_clock;
+			return chunk.data.data() + chunk_offset;
+		}
+
+		const uint32_t first_sector = chunk_index * s_fat_chunk_sectors;
+		if (first_sector >= fat_sector_count())
+			return BAN::Error::from_errno(EINVAL);
+		const uint32_t sector_count = BAN::Math::min(s_fat_chunk_sectors, fat_sector_count() - first_sector);
+
+		size_t slot;
+		if (m_fat_cache.size() < s_fat_cache_max_chunks)
+		{
+			BAN::Vector<uint8_t> data;
+			TRY(data.resize(chunk_bytes));
+			TRY(m_fat_cache.push_back({
+				.index = chunk_index,
+				.last_used = 0,
+				.data = BAN::move(data),
+			}));
+			slot = m_fat_cache.size() - 1;
+		}
+		else
+		{
+			slot = 0;
+			for (size_t i = 1; i < m_fat_cache.size(); i++)
+				if (m_fat_cache[i].last_used < m_fat_cache[slot].last_used)
+					slot = i;
+			m_fat_cache_slots.remove(m_fat_cache[slot].index);
+		}
+
+		auto& chunk = m_fat_cache[slot];
+		// Unmapped chunk is the first to be replaced if anything below fails
+		chunk.index = chunk_index;
+		chunk.last_used = 0;
+
+		TRY(m_block_device->read_blocks(first_fat_sector() + first_sector, sector_count, BAN::ByteSpan(chunk.data.span())));
+		TRY(m_fat_cache_slots.insert(chunk_index, slot));
+		chunk.last_used = ++m_fat_cache_clock;
+
+		return chunk.data.data() + chunk_offset;
 	}
 
 	BAN::ErrorOr<uint32_t> FATFS::get_next_cluster(uint32_t cluster)
 	{
 		LockGuard _(m_mutex);
 
-		ASSERT(cluster >= 2 && cluster < cluster_count());
-
-		auto fat_span = BAN::ByteSpan(m_fat_two_sector_buffer.span());
+		ASSERT(is_data_cluster(cluster));
 
 		switch (m_type)
 		{
 			case Type::FAT12:
 			{
+				// Entry may be split between two chunks
 				const uint32_t fat_byte_offset = cluster + (cluster / 2);
-				const uint32_t ent_offset = fat_byte_offset % m_bpb.bytes_per_sector;
-				TRY(fat_cache_set_sector(fat_byte_offset / m_bpb.bytes_per_sector));
-				uint16_t next = (fat_span[ent_offset + 1] << 8) | fat_span[ent_offset];
+				const uint8_t low = *TRY(fat_cache_byte(fat_byte_offset));
+				const uint8_t high = *TRY(fat_cache_byte(fat_byte_offset + 1));
+				const uint16_t next = (high << 8) | low;
 				return cluster % 2 ? next >> 4 : next & 0xFFF;
 			}
 			case Type::FAT16:
 			{
-				const uint32_t fat_byte_offset = cluster * sizeof(uint16_t);
-				const uint32_t ent_offset = (fat_byte_offset % m_bpb.bytes_per_sector) / sizeof(uint16_t);
-				TRY(fat_cache_set_sector(fat_byte_offset / m_bpb.bytes_per_sector));
-				return fat_span.as_span<uint16_t>()[ent_offset];
+				uint16_t next;
+				memcpy(&next, TRY(fat_cache_byte(cluster * sizeof(uint16_t))), sizeof(uint16_t));
+				return next;
 			}
 			case Type::FAT32:
 			{
-				const uint32_t fat_byte_offset = cluster * sizeof(uint32_t);
-				const uint32_t ent_offset = (fat_byte_offset % m_bpb.bytes_per_sector) / sizeof(uint32_t);
-				TRY(fat_cache_set_sector(fat_byte_offset / m_bpb.bytes_per_sector));
-				return fat_span.as_span<uint32_t>()[ent_offset];
+				uint32_t next;
+				memcpy(&next, TRY(fat_cache_byte(cluster * sizeof(uint32_t))), sizeof(uint32_t));
+				// High 4 bits are reserved
+				return next & 0x0FFFFFFF;
 			}
 		}
 
@@ -211,51 +266,43 @@ namespace Kernel
 
 	BAN::ErrorOr<void> FATFS::inode_read_cluster(BAN::RefPtr<FATInode> file, size_t index, BAN::ByteSpan buffer)
 	{
-		LockGuard _(m_mutex);
+		TRY(inode_read_clusters(file, index, 1, buffer));
+		return {};
+	}
+
+	BAN::ErrorOr<size_t> FATFS::inode_read_clusters(BAN::RefPtr<FATInode> file, size_t index, size_t count, BAN::ByteSpan buffer)
+	{
+		// Cluster chains are immutable after the inode has been opened,
+		// so reads do not need to lock the file system
 
-		if (buffer.size() < static_cast<BAN::make_unsigned_t<decltype(file->blksize())>>(file->blksize()))
+		ASSERT(count > 0);
+
+		const size_t block_size = inode_block_size(file);
+		if (buffer.size() < count * block_size)
 			return BAN::Error::from_errno(ENOBUFS);
 
-		uint32_t cluster;
-		switch (m_type)
+		if (m_type != Type::FAT32 && file == m_root_inode)
 		{
-			case Type::FAT12:
-			case Type::FAT16:
-			{
-				if (file == m_root_inode)
-				{
-					if (index >= root_sector_count())
-						return BAN::Error::from_errno(ENOENT);
-					const uint32_t first_root_sector = m_bpb.reserved_sector_count + (m_bpb.number_of_fats * fat_sector_count());
-					TRY(m_block_device->read_blocks(first_root_sector + index, 1, buffer));
-					return {};
-				}
-				cluster = file->entry().first_cluster_lo;
-				break;
-			}
-			case Type::FAT32:
-				if (file == m_root_inode)
-					cluster = m_bpb.ext_32.root_cluster;
-				else
-					cluster = (static_cast<uint32_t>(file->entry().first_cluster_hi) << 16) | file->entry().first_cluster_lo;
-				break;
-			default:
-				ASSERT_NOT_REACHED();
+			if (index >= root_sector_count())
+				return BAN::Error::from_errno(ENOENT);
+			const uint32_t first_root_sector = m_bpb.reserved_sector_count + (m_bpb.number_of_fats * fat_sector_count());
+			const size_t sector_count = BAN::Math::min<size_t>(count, root_sector_count() - index);
+			TRY(m_block_device->read_blocks(first_root_sector + index, sector_count, buffer));
+			return sector_count;
 		}
 
-		if (cluster < 2 || cluster >= cluster_count())
+		if (index >= UINT32_MAX)
 			return BAN::Error::from_errno(ENOENT);
 
-		for (uint32_t i = 0; i < index; i++)
-		{
-			cluster = TRY(get_next_cluster(cluster));
-			if (cluster < 2 || cluster >= cluster_count())
-				return BAN::Error::from_errno(ENOENT);
-		}
+		uint32_t contiguous;
+		const uint32_t cluster = file->cluster_at(index, &contiguous);
+		if (cluster == 0)
+			return BAN::Error::from_errno(ENOENT);
+		count = BAN::Math::min<size_t>(count, contiguous);
 
 		const uint32_t cluster_start_sector = ((cluster - 2) * m_bpb.sectors_per_cluster) + first_data_sector();
-		TRY(m_block_device->read_blocks(cluster_start_sector, m_bpb.sectors_per_cluster, buffer));
-		return {};
+		TRY(m_block_device->read_blocks(cluster_start_sector, count * m_bpb.sectors_per_cluster, buffer));
+		return count;
 	}
 
 	blksize_t FATFS::inode_block_size(BAN::RefPtr<const FATInode> file) const
@@ -23,11 +23,38 @@ namespace Kernel
 		return BAN::to_unix_time(ban_time);
 	}
 
+	uint32_t FATInode::cluster_at(uint32_t index, uint32_t* contiguous) const
+	{
+		size_t l = 0;
+		size_t r = m_cluster_runs.size();
+		while (l < r)
+		{
+			const size_t mid = (l + r) / 2;
+			const auto& run = m_cluster_runs[mid];
+			if (index < run.file_index)
+				r = mid;
+			else if (index >= run.file_index + run.count)
+				l = mid + 1;
+			else
+			{
+				if (contiguous)
+					*contiguous = run.count - (index - run.file_index);
+				return run.first_cluster + (index - run.file_index);
+			}
+		}
+		return 0;
+	}
+
 	blksize_t FATInode::blksize() const
 	{
 		return m_fs.inode_block_size(this);
 	}
 
+	dev_t FATInode::dev() const
+	{
+		return m_fs.dev();
+	}
+
 	timespec FATInode::atime() const
 	{
 		uint64_t epoch = fat_date_to_epoch(m_entry.last_access_date, {});
@@ -166,50 +193,64 @@ namespace Kernel
 		return BAN::Error::from_errno(ENOENT);
 	}
 
-	BAN::ErrorOr<size_t> FATInode::list_next_inodes_impl(off_t offset, struct dirent* list, size_t list_size)
+	BAN::ErrorOr<size_t> FATInode::list_next_inodes_impl(off_t& offset, struct dirent* list, size_t list_size)
 	{
 		ASSERT(mode().ifdir());
 		ASSERT(offset >= 0);
 
+		// Offset is the index of the next directory entry to return, counted from the first cluster.
+		// Long names are stored before their entry, so listing always resumes right after a returned entry.
+
+		const uint32_t entries_per_cluster = blksize() / sizeof(FAT::DirectoryEntry);
+
 		BAN::Vector<uint8_t> cluster_buffer;
 		TRY(cluster_buffer.resize(blksize()));
 		auto cluster_span = BAN::ByteSpan(cluster_buffer.span());
 
+		size_t entry_count = 0;
+		bool list_full = false;
+		while (!list_full)
 		{
-			auto maybe_error = m_fs.inode_read_cluster(this, offset, cluster_span);
-			if (maybe_error.is_error())
-			{
-				if (maybe_error.error().get_error_code() == ENOENT)
-					return 0;
-				return maybe_error.release_error();
-			}
-		}
+			const uint32_t cluster_index = offset / entries_per_cluster;
+			const uint32_t first_entry_index = offset % entries_per_cluster;
 
-		size_t valid_entry_count = 0;
-		TRY(for_each_directory_entry(cluster_span,
-			[&](const FAT::DirectoryEntry&)
 			{
-				valid_entry_count++;
-				return BAN::Iteration::Continue;
+				auto maybe_error = m_fs.inode_read_cluster(this, cluster_index, cluster_span);
+				if (maybe_error.is_error())
+				{
+					if (maybe_error.error().get_error_code() == ENOENT)
+						break;
+					return maybe_error.release_error();
+				}
 			}
-		));
 
-		if (valid_entry_count > list_size)
-			return BAN::Error::from_errno(ENOBUFS);
+			uint32_t resume_entry_index = first_entry_index;
+			TRY(for_each_directory_entry(cluster_span,
+				[&](const FAT::DirectoryEntry& entry, BAN::String long_name, uint32_t entry_index)
+				{
+					if (entry_index < first_entry_index)
+						return BAN::Iteration::Continue;
 
-		TRY(for_each_directory_entry(cluster_span,
-			[&](const FAT::DirectoryEntry& entry, const BAN::String& long_name, uint32_t)
-			{
-				BAN::String name = long_name.empty() ? entry.name_as_string() : BAN::move(long_name);
-				list->d_ino = 0;
-				list->d_type = (entry.attr & FAT::FileAttr::DIRECTORY) ? DT_DIR : DT_REG;
-				strncpy(list->d_name, name.data(), sizeof(list->d_name));
-				list++;
-				return BAN::Iteration::Continue;
-			}
-		));
+					if (entry_count >= list_size)
+					{
+						list_full = true;
+						return BAN::Iteration::Break;
+					}
+
+					BAN::String name = long_name.empty() ? entry.name_as_string() : BAN::move(long_name);
+					auto& dirent = list[entry_count++];
+					dirent.d_ino = 0;
+					dirent.d_type = (entry.attr & FAT::FileAttr::DIRECTORY) ? DT_DIR : DT_REG;
+					strncpy(dirent.d_name, name.data(), sizeof(dirent.d_name));
+					resume_entry_index = entry_index + 1;
+					return BAN::Iteration::Continue;
+				}
+			));
+
+			offset = (off_t)cluster_index * entries_per_cluster + (list_full ? resume_entry_index : entries_per_cluster);
+		}
 
-		return valid_entry_count;
+		return entry_count;
 	}
 
 	BAN::ErrorOr<size_t> FATInode::read_impl(off_t s_offset, BAN::ByteSpan buffer)
@@ -248,16 +289,18 @@ namespace Kernel
 
 		while (buffer.size() >= block_size)
 		{
-			if (auto ret = m_fs.inode_read_cluster(this, offset / block_size, buffer); ret.is_error())
+			auto ret = m_fs.inode_read_clusters(this, offset / block_size, buffer.size() / block_size, buffer);
+			if (ret.is_error())
 			{
 				if (ret.error().get_error_code() == ENOENT)
 					return nread;
 				return ret.release_error();
 			}
 
-			nread += block_size;
-			offset += block_size;
-			buffer = buffer.slice(block_size);
+			const size_t bytes = ret.value() * block_size;
+			nread += bytes;
+			offset += bytes;
+			buffer = buffer.slice(bytes);
 		}
 
 		if (buffer.size() > 0)
@@ -1,3 +1,4 @@
+#include <kernel/FS/DentryCache.h>
 #include <kernel/FS/Inode.h>
 #include <kernel/Lock/LockGuard.h>
 
@@ -56,19 +57,51 @@ namespace Kernel
 		return true;
 	}
 
+	bool Inode::use_dentry_cache(BAN::StringView name) const
+	{
+		// "." and ".." would go stale when a directory is removed and its inode reused
+		return has_dentry_cache() && name != "."_sv && name != ".."_sv;
+	}
+
 	BAN::ErrorOr<BAN::RefPtr<Inode>> Inode::find_inode(BAN::StringView name)
 	{
+		const bool use_cache = use_dentry_cache(name);
+
+		// Cache is only filled and invalidated while holding m_mutex,
+		// so a hit can be returned without locking the directory
+		if (use_cache && mode().ifdir())
+		{
+			auto cached = DentryCache::get().lookup(*this, name);
+			if (cached.has_value())
+			{
+				if (!cached.value())
+					return BAN::Error::from_errno(ENOENT);
+				return cached.release_value();
+			}
+		}
+
 		LockGuard _(m_mutex);
 		if (!mode().ifdir())
 			return BAN::Error::from_errno(ENOTDIR);
-		return find_inode_impl(name);
+
+		auto result = find_inode_impl(name);
+		if (use_cache)
+		{
+			if (!result.is_error())
+				DentryCache::get().insert(*this, name, result.value());
+			else if (result.error().get_error_code() == ENOENT)
+				DentryCache::get().insert(*this, name, {});
+		}
+		return result;
 	}
 
-	BAN::ErrorOr<size_t> Inode::list_next_inodes(off_t offset, struct dirent* list, size_t list_len)
+	BAN::ErrorOr<size_t> Inode::list_next_inodes(off_t& offset, struct dirent* list, size_t list_len)
 	{
 		LockGuard _(m_mutex);
 		if (!mode().ifdir())
 			return BAN::Error::from_errno(ENOTDIR);
+		if (list_len == 0)
+			return BAN::Error::from_errno(EINVAL);
 		return list_next_inodes_impl(offset, list, list_len);
 	}
 
@@ -79,7 +112,11 @@ namespace Kernel
 			return BAN::Error::from_errno(ENOTDIR);
 		if (Mode(mode).ifdir())
 			return BAN::Error::from_errno(EINVAL);
-		return create_file_impl(name, mode, uid, gid);
+		auto result = create_file_impl(name, mode, uid, gid);
+		// Invalidate even on failure, directory may have been partially modified
+		if (use_dentry_cache(name))
+			DentryCache::get().invalidate(*this, name);
+		return result;
 	}
 
 	BAN::ErrorOr<void> Inode::create_directory(BAN::StringView name, mode_t mode, uid_t uid, gid_t gid)
@@ -89,7 +126,10 @@ namespace Kernel
 			return BAN::Error::from_errno(ENOTDIR);
 		if (!Mode(mode).ifdir())
 			return BAN::Error::from_errno(EINVAL);
-		return create_directory_impl(name, mode, uid, gid);
+		auto result = create_directory_impl(name, mode, uid, gid);
+		if (use_dentry_cache(name))
+			DentryCache::get().invalidate(*this, name);
+		return result;
 	}
 
 	BAN::ErrorOr<void> Inode::unlink(BAN::StringView name)
@@ -99,7 +139,10 @@ namespace Kernel
 			return BAN::Error::from_errno(ENOTDIR);
 		if (name == "."_sv || name == ".."_sv)
 			return BAN::Error::from_errno(EINVAL);
-		return unlink_impl(name);
+		auto result = unlink_impl(name);
+		if (use_dentry_cache(name))
+			DentryCache::get().invalidate(*this, name);
+		return result;
 	}
 
 	BAN::ErrorOr<BAN::String> Inode::link_target()
@@ -158,6 +201,69 @@ namespace Kernel
 		return recvfrom_impl(buffer, address, address_len);
 	};
 
+	BAN::ErrorOr<size_t> Inode::sendmsg(BAN::Span<const BAN::ConstByteSpan> message, const sockaddr* address, socklen_t address_len)
+	{
+		LockGuard _(m_mutex);
+		if (!mode().ifsock())
+			return BAN::Error::from_errno(ENOTSOCK);
+		return sendmsg_impl(message, address, address_len);
+	}
+
+	BAN::ErrorOr<size_t> Inode::recvmsg(BAN::Span<BAN::ByteSpan> buffers, sockaddr* address, socklen_t* address_len)
+	{
+		LockGuard _(m_mutex);
+		if (!mode().ifsock())
+			return BAN::Error::from_errno(ENOTSOCK);
+		return recvmsg_impl(buffers, address, address_len);
+	}
+
+	BAN::ErrorOr<size_t> Inode::sendmsg_impl(BAN::Span<const BAN::ConstByteSpan> message, const sockaddr* address, socklen_t address_len)
+	{
+		if (message.size() == 1)
+			return sendto_impl(message[0], address, address_len);
+
+		size_t message_size = 0;
+		for (size_t i = 0; i < message.size(); i++)
+			message_size += message[i].size();
+
+		BAN::Vector<uint8_t> buffer;
+		TRY(buffer.resize(message_size));
+
+		size_t offset = 0;
+		for (size_t i = 0; i < message.size(); i++)
+		{
+			memcpy(buffer.data() + offset, message[i].data(), message[i].size());
+			offset += message[i].size();
+		}
+
+		return sendto_impl(BAN::ConstByteSpan(buffer.span()), address, address_len);
+	}
+
+	BAN::ErrorOr<size_t> Inode::recvmsg_impl(BAN::Span<BAN::ByteSpan> buffers, sockaddr* address, socklen_t* address_len)
+	{
+		if (buffers.size() == 1)
+			return recvfrom_impl(buffers[0], address, address_len);
+
+		size_t buffer_size = 0;
+		for (size_t i = 0; i < buffers.size(); i++)
+			buffer_size += buffers[i].size();
+
+		BAN::Vector<uint8_t> buffer;
+		TRY(buffer.resize(buffer_size));
+
+		const size_t nrecv = TRY(recvfrom_impl(BAN::ByteSpan(buffer.span()), address, address_len));
+
+		size_t offset = 0;
+		for (size_t i = 0; i < buffers.size() && offset < nrecv; i++)
+		{
+			const size_t to_copy = BAN::Math::min(buffers[i].size(), nrecv - offset);
+			memcpy(buffers[i].data(), buffer.data() + offset, to_copy);
+			offset += to_copy;
+		}
+
+		return nrecv;
+	}
+
 	BAN::ErrorOr<void> Inode::getsockname(sockaddr* address, socklen_t* address_len)
 	{
 		LockGuard _(m_mutex);
@@ -171,6 +277,11 @@ namespace Kernel
 		LockGuard _(m_mutex);
 		if (mode().ifdir())
 			return BAN::Error::from_errno(EISDIR);
+		if (m_page_cache || has_page_cache())
+		{
+			if (auto page_cache = this->page_cache(); !page_cache.is_error())
+				return page_cache.value()->read(offset, buffer, has_page_cache());
+		}
 		return read_impl(offset, buffer);
 	}
 
@@ -179,7 +290,106 @@ namespace Kernel
 		LockGuard _(m_mutex);
 		if (mode().ifdir())
 			return BAN::Error::from_errno(EISDIR);
-		return write_impl(offset, buffer);
+		const size_t nwrite = TRY(write_impl(offset, buffer));
+		if (m_page_cache)
+			m_page_cache->update(offset, buffer.slice(0, nwrite));
+		return nwrite;
+	}
+
+	BAN::ErrorOr<size_t> Inode::readv(off_t offset, BAN::Span<BAN::ByteSpan> buffers, bool direct)
+	{
+		LockGuard _(m_mutex);
+
+		size_t nread = 0;
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			// Only the first read may block on files that are not regular
+			if (i > 0 && !mode().ifreg() && !can_read_impl())
+				break;
+
+			auto result = direct ? read_direct(offset + nread, buffers[i]) : read(offset + nread, buffers[i]);
+			if (result.is_error())
+			{
+				if (nread > 0)
+					break;
+				return result.release_error();
+			}
+
+			nread += result.value();
+			if (result.value() < buffers[i].size())
+				break;
+		}
+
+		return nread;
+	}
+
+	BAN::ErrorOr<size_t> Inode::writev(off_t offset, BAN::Span<const BAN::ConstByteSpan> buffers, bool direct)
+	{
+		LockGuard _(m_mutex);
+
+		size_t nwrite = 0;
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			auto result = direct ? write_direct(offset + nwrite, buffers[i]) : write(offset + nwrite, buffers[i]);
+			if (result.is_error())
+			{
+				if (nwrite > 0)
+					break;
+				return result.release_error();
+			}
+
+			nwrite += result.value();
+			if (result.value() < buffers[i].size())
+				break;
+		}
+
+		return nwrite;
+	}
+
+	BAN::ErrorOr<size_t> Inode::read_direct(off_t offset, BAN::ByteSpan buffer)
+	{
+		LockGuard _(m_mutex);
+		if (mode().ifdir())
+			return BAN::Error::from_errno(EISDIR);
+		// Mapped pages may be newer than the inode's contents
+		if (m_page_cache)
+			TRY(m_page_cache->sync_mapped_pages(offset, buffer.size()));
+		return read_direct_impl(offset, buffer);
+	}
+
+	BAN::ErrorOr<size_t> Inode::write_direct(off_t offset, BAN::ConstByteSpan buffer)
+	{
+		LockGuard _(m_mutex);
+		if (mode().ifdir())
+			return BAN::Error::from_errno(EISDIR);
+		const size_t nwrite = TRY(write_direct_impl(offset, buffer));
+		if (m_page_cache)
+			m_page_cache->update(offset, buffer.slice(0, nwrite));
+		return nwrite;
+	}
+
+	BAN::ErrorOr<void> Inode::fsync(bool data_only)
+	{
+		LockGuard _(m_mutex);
+		// Modifications through shared mappings only reach the inode when written back
+		if (m_page_cache)
+			TRY(m_page_cache->sync_mapped_pages(0, size()));
+		return fsync_impl(data_only);
+	}
+
+	BAN::ErrorOr<size_t> Inode::copy_file_range(off_t offset, Inode& out, off_t out_offset, size_t count)
+	{
+		// Inodes are locked in address order, so copies in opposite directions can't deadlock
+		Inode& first = (this < &out) ? *this : out;
+		Inode& second = (this < &out) ? out : *this;
+		LockGuard _0(first.m_mutex);
+		LockGuard _1(second.m_mutex);
+		if (!mode().ifreg() || !out.mode().ifreg() || dev() != out.dev())
+			return BAN::Error::from_errno(ENOTSUP);
+		// Implementations may read the source without the page cache
+		if (m_page_cache)
+			TRY(m_page_cache->sync_mapped_pages(offset, count));
+		return copy_file_range_impl(offset, out, out_offset, count);
 	}
 
 	BAN::ErrorOr<void> Inode::truncate(size_t size)
@@ -187,7 +397,34 @@ namespace Kernel
 		LockGuard _(m_mutex);
 		if (mode().ifdir())
 			return BAN::Error::from_errno(EISDIR);
-		return truncate_impl(size);
+		TRY(truncate_impl(size));
+		if (m_page_cache)
+			m_page_cache->truncate(size);
+		return {};
+	}
+
+	BAN::ErrorOr<PageCache*> Inode::page_cache()
+	{
+		ASSERT(m_mutex.is_locked());
+		ASSERT(mode().ifreg());
+		if (!m_page_cache)
+			m_page_cache = TRY(PageCache::create(*this));
+		return m_page_cache.ptr();
+	}
+
+	BAN::ErrorOr<paddr_t> Inode::pin_page(size_t page_index)
+	{
+		LockGuard _(m_mutex);
+		if (!mode().ifreg() || !has_page_cache())
+			return BAN::Error::from_errno(ENOTSUP);
+		return TRY(page_cache())->map_page(page_index);
+	}
+
+	void Inode::unpin_page(size_t page_index)
+	{
+		LockGuard _(m_mutex);
+		ASSERT(m_page_cache);
+		m_page_cache->unmap_page(page_index);
 	}
 
 	BAN::ErrorOr<void> Inode::chmod(mode_t mode)
@@ -221,6 +458,42 @@ namespace Kernel
 		return has_error_impl();
 	}
 
+	bool Inode::has_hungup() const
+	{
+		LockGuard _(m_mutex);
+		return has_hungup_impl();
+	}
+
+	void Inode::add_waiter(Waiter& waiter)
+	{
+		SpinLockGuard _(m_waiter_lock);
+		waiter.m_prev = nullptr;
+		waiter.m_next = m_waiters;
+		if (m_waiters)
+			m_waiters->m_prev = &waiter;
+		m_waiters = &waiter;
+	}
+
+	void Inode::remove_waiter(Waiter& waiter)
+	{
+		SpinLockGuard _(m_waiter_lock);
+		if (waiter.m_prev)
+			waiter.m_prev->m_next = waiter.m_next;
+		else
+			m_waiters = waiter.m_next;
+		if (waiter.m_next)
+			waiter.m_next->m_prev = waiter.m_prev;
+		waiter.m_prev = nullptr;
+		waiter.m_next = nullptr;
+	}
+
+	void Inode::notify_waiters()
+	{
+		SpinLockGuard _(m_waiter_lock);
+		for (Waiter* waiter = m_waiters; waiter; waiter = waiter->m_next)
+			waiter->notify();
+	}
+
 	BAN::ErrorOr<long> Inode::ioctl(int request, void* arg)
 	{
 		LockGuard _(m_mutex);
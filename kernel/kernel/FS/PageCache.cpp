@@ -0,0 +1,426 @@
+#include <BAN/Atomic.h>
+#include <kernel/FS/Inode.h>
+#include <kernel/FS/PageCache.h>
+#include <kernel/Lock/SpinLock.h>
+#include <kernel/Memory/Heap.h>
+#include <kernel/Memory/PageTable.h>
+
+namespace Kernel
+{
+
+	// Unmapped pages are dropped when either limit is reached
+	static constexpr size_t s_max_cached_pages = 32768;
+	static constexpr size_t s_min_free_pages = 4096;
+	static constexpr size_t s_reclaim_batch_pages = 256;
+
+	static SpinLock s_lru_lock;
+	static PageCache* s_lru_head = nullptr;
+	static PageCache* s_lru_tail = nullptr;
+	static BAN::Atomic<size_t> s_cached_pages = 0;
+
+	BAN::ErrorOr<BAN::UniqPtr<PageCache>> PageCache::create(Inode& inode)
+	{
+		auto* page_cache_ptr = new PageCache(inode);
+		if (page_cache_ptr == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		auto page_cache = BAN::UniqPtr<PageCache>::adopt(page_cache_ptr);
+
+		SpinLockGuard _(s_lru_lock);
+		page_cache->m_lru_prev = s_lru_tail;
+		if (s_lru_tail)
+			s_lru_tail->m_lru_next = page_cache.ptr();
+		else
+			s_lru_head = page_cache.ptr();
+		s_lru_tail = page_cache.ptr();
+
+		return page_cache;
+	}
+
+	PageCache::~PageCache()
+	{
+		{
+			SpinLockGuard _(s_lru_lock);
+			if (m_lru_prev)
+				m_lru_prev->m_lru_next = m_lru_next;
+			else
+				s_lru_head = m_lru_next;
+			if (m_lru_next)
+				m_lru_next->m_lru_prev = m_lru_prev;
+			else
+				s_lru_tail = m_lru_prev;
+		}
+
+		// File backed regions keep a reference to the inode, so nothing can be mapped anymore
+		for (auto& leaf : m_leaves)
+		{
+			if (!leaf)
+				continue;
+			for (size_t i = 0; i < Leaf::page_count; i++)
+			{
+				if (leaf->paddr[i] == 0)
+					continue;
+				ASSERT(leaf->map_count[i] == 0);
+				Heap::get().release_page(leaf->paddr[i]);
+			}
+		}
+		s_cached_pages -= m_page_count;
+	}
+
+	void PageCache::mark_used()
+	{
+		SpinLockGuard _(s_lru_lock);
+		if (s_lru_tail == this)
+			return;
+
+		if (m_lru_prev)
+			m_lru_prev->m_lru_next = m_lru_next;
+		else
+			s_lru_head = m_lru_next;
+		m_lru_next->m_lru_prev = m_lru_prev;
+
+		m_lru_prev = s_lru_tail;
+		m_lru_next = nullptr;
+		s_lru_tail->m_lru_next = this;
+		s_lru_tail = this;
+	}
+
+	void PageCache::reclaim_if_needed()
+	{
+		if (s_cached_pages < s_max_cached_pages && Heap::get().free_pages() >= s_min_free_pages)
+			return;
+
+		size_t to_evict = s_reclaim_batch_pages;
+
+		// Inode mutexes are only tried, as callers already hold their own inode's mutex
+		SpinLockGuard _(s_lru_lock);
+		for (PageCache* page_cache = s_lru_head; page_cache && to_evict > 0; page_cache = page_cache->m_lru_next)
+		{
+			if (!page_cache->m_inode.m_mutex.try_lock())
+				continue;
+			to_evict -= page_cache->evict_unmapped_pages(to_evict);
+			page_cache->m_inode.m_mutex.unlock();
+		}
+	}
+
+	size_t PageCache::evict_unmapped_pages(size_t page_count)
+	{
+		size_t evicted = 0;
+		for (size_t leaf_index = 0; leaf_index < m_leaves.size() && evicted < page_count; leaf_index++)
+		{
+			if (!m_leaves[leaf_index])
+				continue;
+			for (size_t i = 0; i < Leaf::page_count && evicted < page_count; i++)
+			{
+				// Leaf is freed when its last page is removed
+				if (!m_leaves[leaf_index])
+					break;
+				auto& leaf = *m_leaves[leaf_index];
+				if (leaf.paddr[i] == 0 || leaf.map_count[i] > 0)
+					continue;
+				remove_page(leaf_index * Leaf::page_count + i);
+				evicted++;
+			}
+		}
+		return evicted;
+	}
+
+	paddr_t PageCache::find_page(size_t page_index) const
+	{
+		const size_t leaf_index = page_index / Leaf::page_count;
+		if (leaf_index >= m_leaves.size() || !m_leaves[leaf_index])
+			return 0;
+		return m_leaves[leaf_index]->paddr[page_index % Leaf::page_count];
+	}
+
+	BAN::ErrorOr<void> PageCache::insert_page(size_t page_index, paddr_t paddr)
+	{
+		const size_t leaf_index = page_index / Leaf::page_count;
+		if (leaf_index >= m_leaves.size())
+			TRY(m_leaves.resize(leaf_index + 1));
+		if (!m_leaves[leaf_index])
+			m_leaves[leaf_index] = TRY(BAN::UniqPtr<Leaf>::create());
+
+		auto& leaf = *m_leaves[leaf_index];
+		ASSERT(leaf.paddr[page_index % Leaf::page_count] == 0);
+		leaf.paddr[page_index % Leaf::page_count] = paddr;
+		leaf.map_count[page_index % Leaf::page_count] = 0;
+		leaf.used++;
+
+		m_page_count++;
+		s_cached_pages++;
+
+		return {};
+	}
+
+	void PageCache::remove_page(size_t page_index)
+	{
+		const size_t leaf_index = page_index / Leaf::page_count;
+		auto& leaf = *m_leaves[leaf_index];
+
+		auto& paddr = leaf.paddr[page_index % Leaf::page_count];
+		ASSERT(paddr != 0);
+		ASSERT(leaf.map_count[page_index % Leaf::page_count] == 0);
+		Heap::get().release_page(paddr);
+		paddr = 0;
+
+		m_page_count--;
+		s_cached_pages--;
+
+		if (--leaf.used == 0)
+			m_leaves[leaf_index].clear();
+	}
+
+	BAN::ErrorOr<void> PageCache::read_pages_to_cache(size_t page_index, size_t max_pages)
+	{
+		reclaim_if_needed();
+
+		const size_t file_size = m_inode.size();
+		const size_t file_pages = BAN::Math::div_round_up<size_t>(file_size, PAGE_SIZE);
+
+		max_pages = BAN::Math::min(max_pages, s_read_batch_pages);
+
+		size_t page_count = 0;
+		while (page_count < max_pages && page_index + page_count < file_pages && find_page(page_index + page_count) == 0)
+			page_count++;
+		if (page_count == 0)
+			return {};
+
+		paddr_t pages[s_read_batch_pages];
+		for (size_t i = 0; i < page_count; i++)
+		{
+			pages[i] = Heap::get().take_free_page();
+			if (pages[i] != 0)
+				continue;
+			if (i == 0)
+				return BAN::Error::from_errno(ENOMEM);
+			page_count = i;
+			break;
+		}
+
+		const auto release_pages =
+			[&pages](size_t first, size_t last)
+			{
+				for (size_t i = first; i < last; i++)
+					Heap::get().release_page(pages[i]);
+			};
+
+		// Read straight into the new pages through a temporary mapping
+		const vaddr_t vaddr = PageTable::kernel().reserve_free_contiguous_pages(page_count, KERNEL_OFFSET);
+		if (vaddr == 0)
+		{
+			release_pages(0, page_count);
+			return BAN::Error::from_errno(ENOMEM);
+		}
+		for (size_t i = 0; i < page_count; i++)
+			PageTable::kernel().map_page_at(pages[i], vaddr + i * PAGE_SIZE, PageTable::Flags::ReadWrite | PageTable::Flags::Present);
+
+		const size_t offset = page_index * PAGE_SIZE;
+		const size_t bytes = BAN::Math::min(page_count * PAGE_SIZE, file_size - offset);
+		auto nread = m_inode.read_impl(offset, BAN::ByteSpan(reinterpret_cast<uint8_t*>(vaddr), bytes));
+		if (!nread.is_error())
+			memset(reinterpret_cast<uint8_t*>(vaddr) + nread.value(), 0, page_count * PAGE_SIZE - nread.value());
+
+		PageTable::kernel().unmap_range(vaddr, page_count * PAGE_SIZE);
+
+		if (nread.is_error())
+		{
+			release_pages(0, page_count);
+			return nread.release_error();
+		}
+
+		for (size_t i = 0; i < page_count; i++)
+		{
+			if (auto ret = insert_page(page_index + i, pages[i]); ret.is_error())
+			{
+				release_pages(i, page_count);
+				if (i == 0)
+					return ret.release_error();
+				break;
+			}
+		}
+
+		return {};
+	}
+
+	BAN::ErrorOr<size_t> PageCache::read(off_t offset, BAN::ByteSpan buffer, bool populate)
+	{
+		ASSERT(offset >= 0);
+
+		const size_t file_size = m_inode.size();
+		if (static_cast<size_t>(offset) >= file_size)
+			return 0;
+		if (buffer.size() > file_size - offset)
+			buffer = buffer.slice(0, file_size - offset);
+
+		mark_used();
+
+		size_t nread = 0;
+		while (nread < buffer.size())
+		{
+			const size_t page_index  = (offset + nread) / PAGE_SIZE;
+			const size_t page_offset = (offset + nread) % PAGE_SIZE;
+			const size_t bytes = BAN::Math::min(PAGE_SIZE - page_offset, buffer.size() - nread);
+
+			paddr_t paddr = find_page(page_index);
+			if (paddr == 0 && populate)
+			{
+				// Pages that cannot be cached are read directly from the inode below
+				const size_t wanted_pages = BAN::Math::div_round_up<size_t>(page_offset + buffer.size() - nread, PAGE_SIZE);
+				if (!read_pages_to_cache(page_index, wanted_pages).is_error())
+					paddr = find_page(page_index);
+			}
+
+			if (paddr == 0)
+			{
+				size_t direct_bytes = bytes;
+				while (nread + direct_bytes < buffer.size() && find_page((offset + nread + direct_bytes) / PAGE_SIZE) == 0)
+					direct_bytes += BAN::Math::min(PAGE_SIZE, buffer.size() - nread - direct_bytes);
+
+				const size_t direct_nread = TRY(m_inode.read_impl(offset + nread, buffer.slice(nread, direct_bytes)));
+				nread += direct_nread;
+				if (direct_nread < direct_bytes)
+					break;
+				continue;
+			}
+
+			PageTable::with_fast_page(paddr, [&] {
+				memcpy(buffer.data() + nread, PageTable::fast_page_as_ptr(page_offset), bytes);
+			});
+			nread += bytes;
+		}
+
+		return nread;
+	}
+
+	void PageCache::update(off_t offset, BAN::ConstByteSpan buffer)
+	{
+		ASSERT(offset >= 0);
+
+		size_t done = 0;
+		while (done < buffer.size())
+		{
+			const size_t page_index  = (offset + done) / PAGE_SIZE;
+			const size_t page_offset = (offset + done) % PAGE_SIZE;
+			const size_t bytes = BAN::Math::min(PAGE_SIZE - page_offset, buffer.size() - done);
+
+			if (const paddr_t paddr = find_page(page_index))
+				PageTable::with_fast_page(paddr, [&] {
+					memcpy(PageTable::fast_page_as_ptr(page_offset), buffer.data() + done, bytes);
+				});
+
+			done += bytes;
+		}
+	}
+
+	void PageCache::truncate(size_t new_size)
+	{
+		// Mapped pages past the end are kept until they are unmapped
+		const size_t first_removed = BAN::Math::div_round_up<size_t>(new_size, PAGE_SIZE);
+		for (size_t leaf_index = first_removed / Leaf::page_count; leaf_index < m_leaves.size(); leaf_index++)
+		{
+			for (size_t i = 0; i < Leaf::page_count; i++)
+			{
+				if (!m_leaves[leaf_index])
+					break;
+				const size_t page_index = leaf_index * Leaf::page_count + i;
+				auto& leaf = *m_leaves[leaf_index];
+				if (page_index < first_removed || leaf.paddr[i] == 0 || leaf.map_count[i] > 0)
+					continue;
+				remove_page(page_index);
+			}
+		}
+
+		if (const size_t rem = new_size % PAGE_SIZE)
+		{
+			if (const paddr_t paddr = find_page(new_size / PAGE_SIZE))
+				PageTable::with_fast_page(paddr, [&] {
+					memset(PageTable::fast_page_as_ptr(rem), 0, PAGE_SIZE - rem);
+				});
+		}
+	}
+
+	BAN::ErrorOr<paddr_t> PageCache::map_page(size_t page_index)
+	{
+		if (page_index >= BAN::Math::div_round_up<size_t>(m_inode.size(), PAGE_SIZE))
+			return BAN::Error::from_errno(EFAULT);
+
+		mark_used();
+
+		if (find_page(page_index) == 0)
+			TRY(read_pages_to_cache(page_index, s_read_batch_pages));
+
+		const paddr_t paddr = find_page(page_index);
+		ASSERT(paddr);
+
+		m_leaves[page_index / Leaf::page_count]->map_count[page_index % Leaf::page_count]++;
+		return paddr;
+	}
+
+	void PageCache::unmap_page(size_t page_index)
+	{
+		const size_t leaf_index = page_index / Leaf::page_count;
+		ASSERT(leaf_index < m_leaves.size() && m_leaves[leaf_index]);
+
+		auto& map_count = m_leaves[leaf_index]->map_count[page_index % Leaf::page_count];
+		ASSERT(map_count > 0);
+		map_count--;
+	}
+
+	BAN::ErrorOr<void> PageCache::sync_page(size_t page_index)
+	{
+		const paddr_t paddr = find_page(page_index);
+		if (paddr == 0)
+			return {};
+
+		const size_t file_size = m_inode.size();
+		const size_t offset = page_index * PAGE_SIZE;
+		if (offset >= file_size)
+			return {};
+		const size_t bytes = BAN::Math::min(PAGE_SIZE, file_size - offset);
+
+		// write_impl can block, so the page is mapped instead of using the fast page
+		const vaddr_t vaddr = PageTable::kernel().reserve_free_page(KERNEL_OFFSET);
+		if (vaddr == 0)
+			return BAN::Error::from_errno(ENOMEM);
+		PageTable::kernel().map_page_at(paddr, vaddr, PageTable::Flags::Present);
+
+		auto result = m_inode.write_impl(offset, BAN::ConstByteSpan(reinterpret_cast<const uint8_t*>(vaddr), bytes));
+
+		PageTable::kernel().unmap_page(vaddr);
+
+		TRY(result);
+		return {};
+	}
+
+
+	BAN::ErrorOr<void> PageCache::sync_mapped_pages(off_t offset, size_t length)
+	{
+		ASSERT(offset >= 0);
+
+		const size_t file_size = m_inode.size();
+		if (static_cast<size_t>(offset) >= file_size || length == 0)
+			return {};
+		length = BAN::Math::min<size_t>(length, file_size - offset);
+
+		// Unmapped pages are never modified, writes go through to the inode
+		const size_t first_page = offset / PAGE_SIZE;
+		const size_t last_page = BAN::Math::div_round_up<size_t>(offset + length, PAGE_SIZE);
+		for (size_t page_index = first_page; page_index < last_page; page_index++)
+		{
+			const size_t leaf_index = page_index / Leaf::page_count;
+			if (leaf_index >= m_leaves.size())
+				break;
+			if (!m_leaves[leaf_index])
+			{
+				page_index = (leaf_index + 1) * Leaf::page_count - 1;
+				continue;
+			}
+			if (m_leaves[leaf_index]->map_count[page_index % Leaf::page_count] == 0)
+				continue;
+			TRY(sync_page(page_index));
+		}
+
+		return {};
+	}
+
+}
@@ -37,7 +37,10 @@ namespace Kernel
 		ASSERT(m_writing_count > 0);
 		m_writing_count--;
 		if (m_writing_count == 0)
+		{
 			m_semaphore.unblock();
+			notify_waiters();
+		}
 	}
 
 	BAN::ErrorOr<size_t> Pipe::read_impl(off_t, BAN::ByteSpan buffer)
@@ -78,6 +81,7 @@ namespace Kernel
 		m_ctime = current_time;
 
 		m_semaphore.unblock();
+		notify_waiters();
 
 		return buffer.size();
 	}
@@ -200,20 +200,71 @@ namespace Kernel
 			page_info.set_paddr(0);
 			page_info.set_flags(0);
 		});
+
+		m_free_block_hint = BAN::Math::min(m_free_block_hint, index);
 	}
 
 	BAN::ErrorOr<size_t> TmpFileSystem::allocate_block()
 	{
 		LockGuard _(m_mutex);
 
-		size_t result = first_data_page;
-		TRY(for_each_indirect_paddr_allocating(m_data_pages, [&] (paddr_t, bool allocated) {
-			if (allocated)
-				return BAN::Iteration::Break;
-			result++;
-			return BAN::Iteration::Continue;
-		}, 3));
-		return result;
+		constexpr size_t addresses_per_page = PAGE_SIZE / sizeof(PageInfo);
+
+		// Every block below m_free_block_hint is in use
+		size_t first_slot = (m_free_block_hint - first_data_page) % addresses_per_page;
+		for (size_t page = (m_free_block_hint - first_data_page) / addresses_per_page; page < max_data_pages / addresses_per_page; page++, first_slot = 0)
+		{
+			const paddr_t page_containing = TRY(find_indirect_allocating(m_data_pages, page, 2));
+
+			size_t slot = addresses_per_page;
+			PageTable::with_fast_page(page_containing, [&] {
+				for (size_t i = first_slot; i < addresses_per_page; i++)
+				{
+					if (PageTable::fast_page_as_sized<PageInfo>(i).flags() & PageInfo::Flags::Present)
+						continue;
+					slot = i;
+					return;
+				}
+			});
+			if (slot == addresses_per_page)
+				continue;
+
+			const paddr_t new_paddr = TRY(allocate_zeroed_page());
+			PageTable::with_fast_page(page_containing, [&] {
+				auto& page_info = PageTable::fast_page_as_sized<PageInfo>(slot);
+				page_info.set_paddr(new_paddr);
+				page_info.set_flags(PageInfo::Flags::Present);
+			});
+
+			const size_t index = first_data_page + page * addresses_per_page + slot;
+			m_free_block_hint = index + 1;
+			return index;
+		}
+
+		return BAN::Error::from_errno(ENOSPC);
+	}
+
+	paddr_t TmpFileSystem::block_paddr(size_t index)
+	{
+		return find_block(index);
+	}
+
+	BAN::ErrorOr<paddr_t> TmpFileSystem::allocate_zeroed_page()
+	{
+		LockGuard _(m_mutex);
+
+		if (m_used_pages >= m_max_pages)
+			return BAN::Error::from_errno(ENOSPC);
+		const paddr_t paddr = Heap::get().take_free_page();
+		if (paddr == 0)
+			return BAN::Error::from_errno(ENOMEM);
+		m_used_pages++;
+
+		PageTable::with_fast_page(paddr, [] {
+			memset(PageTable::fast_page_as_ptr(), 0x00, PAGE_SIZE);
+		});
+
+		return paddr;
 	}
 
 	paddr_t TmpFileSystem::find_block(size_t index)
@@ -254,6 +305,45 @@ namespace Kernel
 		return find_indirect(next, index_in_page, depth - 1);
 	}
 
+	BAN::ErrorOr<paddr_t> TmpFileSystem::find_indirect_allocating(PageInfo root, size_t index, size_t depth)
+	{
+		LockGuard _(m_mutex);
+
+		ASSERT(root.flags() & PageInfo::Flags::Present);
+		if (depth == 0)
+		{
+			ASSERT(index == 0);
+			return root.paddr();
+		}
+
+		constexpr size_t addresses_per_page = PAGE_SIZE / sizeof(PageInfo);
+
+		size_t divisor = 1;
+		for (size_t i = 1; i < depth; i++)
+			divisor *= addresses_per_page;
+
+		const size_t index_of_page = index / divisor;
+		const size_t index_in_page = index % divisor;
+
+		ASSERT(index_of_page < addresses_per_page);
+
+		PageInfo next;
+		PageTable::with_fast_page(root.paddr(), [&] {
+			next = PageTable::fast_page_as_sized<PageInfo>(index_of_page);
+		});
+
+		if (!(next.flags() & PageInfo::Flags::Present))
+		{
+			next.set_paddr(TRY(allocate_zeroed_page()));
+			next.set_flags(PageInfo::Flags::Present);
+			PageTable::with_fast_page(root.paddr(), [&] {
+				PageTable::fast_page_as_sized<PageInfo>(index_of_page) = next;
+			});
+		}
+
+		return find_indirect_allocating(next, index_in_page, depth - 1);
+	}
+
 	template<TmpFuncs::for_each_indirect_paddr_allocating_callback F>
 	BAN::ErrorOr<BAN::Iteration> TmpFileSystem::for_each_indirect_paddr_allocating_internal(PageInfo page_info, F callback, size_t depth)
 	{
@@ -92,37 +92,225 @@ namespace Kernel
 
 	void TmpInode::free_all_blocks()
 	{
-		for (size_t i = 0; i < TmpInodeInfo::direct_block_count; i++)
+		if (mode().iflnk() && static_cast<size_t>(size()) <= sizeof(TmpInodeInfo::block))
 		{
-			if (m_inode_info.block[i])
-				m_fs.free_block(m_inode_info.block[i]);
-			m_inode_info.block[i] = 0;
+			// Short symlink targets are stored in the block array itself
+			for (auto& block : m_inode_info.block)
+				block = 0;
+			return;
 		}
+
+		free_blocks_from(0);
+
 		for (auto block : m_inode_info.block)
 			ASSERT(block == 0);
 	}
 
-	BAN::Optional<size_t> TmpInode::block_index(size_t data_block_index)
+	void TmpInode::free_blocks_from(size_t first_data_block_index)
+	{
+		constexpr size_t indices_per_block = PAGE_SIZE / sizeof(size_t);
+		constexpr size_t direct_block_count = TmpInodeInfo::direct_block_count;
+
+		for (size_t i = 0; i < direct_block_count; i++)
+		{
+			if (i < first_data_block_index || m_inode_info.block[i] == 0)
+				continue;
+			m_fs.free_block(m_inode_info.block[i]);
+			m_inode_info.block[i] = 0;
+			m_inode_info.blocks--;
+			cache_block_paddr(i, 0);
+		}
+
+		size_t first_index = direct_block_count;
+		size_t span = indices_per_block;
+		for (size_t depth = 1; direct_block_count + depth - 1 < m_inode_info.block.size(); depth++)
+		{
+			auto& block = m_inode_info.block[direct_block_count + depth - 1];
+			if (first_index + span > first_data_block_index)
+				block = free_indirect_blocks(block, depth, first_index, first_data_block_index);
+			first_index += span;
+			span *= indices_per_block;
+		}
+	}
+
+	size_t TmpInode::free_indirect_blocks(size_t block, size_t depth, size_t first_index, size_t first_data_block_index)
+	{
+		constexpr size_t indices_per_block = PAGE_SIZE / sizeof(size_t);
+
+		if (block == 0)
+			return 0;
+
+		if (depth == 0)
+		{
+			if (first_index < first_data_block_index)
+				return block;
+			m_fs.free_block(block);
+			m_inode_info.blocks--;
+			cache_block_paddr(first_index, 0);
+			return 0;
+		}
+
+		size_t child_span = 1;
+		for (size_t i = 1; i < depth; i++)
+			child_span *= indices_per_block;
+
+		for (size_t i = 0; i < indices_per_block; i++)
+		{
+			const size_t child_first_index = first_index + i * child_span;
+			if (child_first_index + child_span <= first_data_block_index)
+				continue;
+
+			size_t child = 0;
+			m_fs.with_block_buffer(block, [&](BAN::ByteSpan buffer) {
+				child = buffer.as_span<size_t>()[i];
+			});
+			if (child == 0)
+				continue;
+
+			if (free_indirect_blocks(child, depth - 1, child_first_index, first_data_block_index) != 0)
+				continue;
+			m_fs.with_block_buffer(block, [&](BAN::ByteSpan buffer) {
+				buffer.as_span<size_t>()[i] = 0;
+			});
+		}
+
+		// Indirect block is kept if it still maps some data blocks
+		if (first_index < first_data_block_index)
+			return block;
+		m_fs.free_block(block);
+		m_inode_info.blocks--;
+		return 0;
+	}
+
+	BAN::ErrorOr<size_t> TmpInode::find_block_index(size_t data_block_index, bool allocate)
 	{
-		ASSERT(data_block_index < TmpInodeInfo::direct_block_count);
-		if (m_inode_info.block[data_block_index])
+		constexpr size_t indices_per_block = PAGE_SIZE / sizeof(size_t);
+		constexpr size_t direct_block_count = TmpInodeInfo::direct_block_count;
+
+		if (data_block_index < direct_block_count)
+		{
+			if (m_inode_info.block[data_block_index] == 0 && allocate)
+			{
+				m_inode_info.block[data_block_index] = TRY(m_fs.allocate_block());
+				m_inode_info.blocks++;
+			}
 			return m_inode_info.block[data_block_index];
-		return {};
+		}
+
+		size_t index = data_block_index - direct_block_count;
+		size_t depth = 1;
+		size_t span = indices_per_block;
+		while (index >= span)
+		{
+			index -= span;
+			depth++;
+			if (direct_block_count + depth - 1 >= m_inode_info.block.size())
+				return BAN::Error::from_errno(EFBIG);
+			span *= indices_per_block;
+		}
+
+		auto& root_block = m_inode_info.block[direct_block_count + depth - 1];
+		if (root_block == 0)
+		{
+			if (!allocate)
+				return 0;
+			root_block = TRY(m_fs.allocate_block());
+			m_inode_info.blocks++;
+		}
+
+		size_t block = root_block;
+		for (size_t level = depth; level > 0; level--)
+		{
+			span /= indices_per_block;
+			const size_t slot = index / span;
+			index %= span;
+
+			size_t next = 0;
+			m_fs.with_block_buffer(block, [&](BAN::ByteSpan buffer) {
+				next = buffer.as_span<size_t>()[slot];
+			});
+
+			if (next == 0)
+			{
+				if (!allocate)
+					return 0;
+				next = TRY(m_fs.allocate_block());
+				m_inode_info.blocks++;
+				m_fs.with_block_buffer(block, [&](BAN::ByteSpan buffer) {
+					buffer.as_span<size_t>()[slot] = next;
+				});
+			}
+
+			block = next;
+		}
+
+		return block;
+	}
+
+	BAN::Optional<size_t> TmpInode::block_index(size_t data_block_index)
+	{
+		auto index_or_error = find_block_index(data_block_index, false);
+		if (index_or_error.is_error() || index_or_error.value() == 0)
+			return {};
+		return index_or_error.value();
 	}
 
 	BAN::ErrorOr<size_t> TmpInode::block_index_with_allocation(size_t data_block_index)
 	{
-		if (data_block_index >= TmpInodeInfo::direct_block_count)
+		return find_block_index(data_block_index, true);
+	}
+
+	void TmpInode::cache_block_paddr(size_t data_block_index, paddr_t paddr)
+	{
+		constexpr size_t entries_per_leaf = PAGE_SIZE / sizeof(paddr_t);
+		const size_t leaf = data_block_index / entries_per_leaf;
+
+		// Cache is best effort, failing to allocate it only makes accesses slower
+		if (leaf >= m_block_paddr_cache.size())
 		{
-			dprintln("only {} blocks supported :D", TmpInodeInfo::direct_block_count);
-			return BAN::Error::from_errno(ENOSPC);
+			if (paddr == 0 || m_block_paddr_cache.resize(leaf + 1).is_error())
+				return;
 		}
-		if (m_inode_info.block[data_block_index] == 0)
+		if (!m_block_paddr_cache[leaf])
 		{
-			m_inode_info.block[data_block_index] = TRY(m_fs.allocate_block());
-			m_inode_info.blocks++;
+			if (paddr == 0)
+				return;
+			auto new_leaf = BAN::UniqPtr<BlockPaddrCacheLeaf>::create();
+			if (new_leaf.is_error())
+				return;
+			m_block_paddr_cache[leaf] = new_leaf.release_value();
 		}
-		return m_inode_info.block[data_block_index];
+
+		m_block_paddr_cache[leaf]->paddr[data_block_index % entries_per_leaf] = paddr;
+	}
+
+	paddr_t TmpInode::block_paddr(size_t data_block_index)
+	{
+		constexpr size_t entries_per_leaf = PAGE_SIZE / sizeof(paddr_t);
+		const size_t leaf = data_block_index / entries_per_leaf;
+
+		if (leaf < m_block_paddr_cache.size() && m_block_paddr_cache[leaf])
+			if (const paddr_t paddr = m_block_paddr_cache[leaf]->paddr[data_block_index % entries_per_leaf])
+				return paddr;
+
+		const auto index = block_index(data_block_index);
+		if (!index.has_value())
+			return 0;
+
+		const paddr_t paddr = m_fs.block_paddr(index.value());
+		cache_block_paddr(data_block_index, paddr);
+		return paddr;
+	}
+
+	BAN::ErrorOr<paddr_t> TmpInode::block_paddr_with_allocation(size_t data_block_index)
+	{
+		if (const paddr_t paddr = block_paddr(data_block_index))
+			return paddr;
+
+		const size_t index = TRY(block_index_with_allocation(data_block_index));
+		const paddr_t paddr = m_fs.block_paddr(index);
+		cache_block_paddr(data_block_index, paddr);
+		return paddr;
 	}
 
 	/* FILE INODE */
@@ -162,13 +350,11 @@ namespace Kernel
 			const size_t data_block_index = (read_done + offset) / blksize();
 			const size_t block_offset     = (read_done + offset) % blksize();
 
-			const auto block_index = this->block_index(data_block_index);
-
 			const size_t bytes = BAN::Math::min<size_t>(bytes_to_read - read_done, blksize() - block_offset);
 
-			if (block_index.has_value())
-				m_fs.with_block_buffer(block_index.value(), [&](BAN::ByteSpan block_buffer) {
-					memcpy(out_buffer.data() + read_done, block_buffer.data() + block_offset, bytes);
+			if (const paddr_t paddr = block_paddr(data_block_index))
+				PageTable::with_fast_page(paddr, [&] {
+					memcpy(out_buffer.data() + read_done, PageTable::fast_page_as_ptr(block_offset), bytes);
 				});
 			else
 				memset(out_buffer.data() + read_done, 0x00, bytes);
@@ -194,12 +380,12 @@ namespace Kernel
 			const size_t data_block_index = (write_done + offset) / blksize();
 			const size_t block_offset     = (write_done + offset) % blksize();
 
-			const size_t block_index = TRY(block_index_with_allocation(data_block_index));
+			const paddr_t paddr = TRY(block_paddr_with_allocation(data_block_index));
 
 			const size_t bytes = BAN::Math::min<size_t>(bytes_to_write - write_done, blksize() - block_offset);
 
-			m_fs.with_block_buffer(block_index, [&](BAN::ByteSpan block_buffer) {
-				memcpy(block_buffer.data() + block_offset, in_buffer.data() + write_done, bytes);
+			PageTable::with_fast_page(paddr, [&] {
+				memcpy(PageTable::fast_page_as_ptr(block_offset), in_buffer.data() + write_done, bytes);
 			});
 
 			write_done += bytes;
@@ -208,8 +394,96 @@ namespace Kernel
 		return write_done;
 	}
 
+	BAN::ErrorOr<size_t> TmpFileInode::copy_file_range_impl(off_t offset, Inode& out, off_t out_offset, size_t count)
+	{
+		// Runs of data blocks are mapped to the kernel and written to out straight from our pages.
+		// Holes past the end of out are skipped and left as holes, as truncate frees blocks
+		// past the end of file. Holes over out's existing data are left to the caller.
+		if (offset >= size())
+			return 0;
+
+		constexpr size_t max_run_blocks = 16;
+
+		const size_t to_copy = BAN::Math::min<size_t>(count, size() - offset);
+
+		size_t ncopied = 0;
+		while (ncopied < to_copy)
+		{
+			const size_t first_block = (offset + ncopied) / blksize();
+			const size_t block_offset = (offset + ncopied) % blksize();
+			const size_t block_limit = BAN::Math::min<size_t>(
+				BAN::Math::div_round_up<size_t>(block_offset + to_copy - ncopied, blksize()),
+				max_run_blocks
+			);
+
+			const bool is_hole = (block_paddr(first_block) == 0);
+
+			size_t block_count = 1;
+			while (block_count < block_limit && (block_paddr(first_block + block_count) == 0) == is_hole)
+				block_count++;
+
+			const size_t run_bytes = BAN::Math::min<size_t>(block_count * blksize() - block_offset, to_copy - ncopied);
+
+			if (is_hole)
+			{
+				if (static_cast<size_t>(out_offset) + ncopied < static_cast<size_t>(out.size()))
+					break;
+				ncopied += run_bytes;
+				continue;
+			}
+
+			const vaddr_t vaddr = PageTable::kernel().reserve_free_contiguous_pages(block_count, KERNEL_OFFSET);
+			if (vaddr == 0)
+			{
+				if (ncopied > 0)
+					break;
+				return BAN::Error::from_errno(ENOMEM);
+			}
+
+			for (size_t i = 0; i < block_count; i++)
+				PageTable::kernel().map_page_at(block_paddr(first_block + i), vaddr + i * PAGE_SIZE, PageTable::Flags::Present);
+
+			auto result = out.write(out_offset + ncopied, BAN::ConstByteSpan(reinterpret_cast<const uint8_t*>(vaddr + block_offset), run_bytes));
+
+			PageTable::kernel().unmap_range(vaddr, block_count * PAGE_SIZE);
+
+			if (result.is_error())
+			{
+				if (ncopied > 0)
+					break;
+				return result.release_error();
+			}
+
+			ncopied += result.value();
+			if (result.value() < run_bytes)
+				break;
+		}
+
+		if (ncopied == 0)
+			return 0;
+
+		// Skipped holes at the end still have to extend out
+		if (static_cast<size_t>(out.size()) < out_offset + ncopied)
+			TRY(out.truncate(out_offset + ncopied));
+
+		return ncopied;
+	}
+
 	BAN::ErrorOr<void> TmpFileInode::truncate_impl(size_t new_size)
 	{
+		if (new_size < static_cast<size_t>(size()))
+		{
+			// Zero the tail of the new last block, so growing the file again exposes zeros
+			if (const size_t rem = new_size % blksize())
+			{
+				if (const paddr_t paddr = block_paddr(new_size / blksize()))
+					PageTable::with_fast_page(paddr, [&] {
+						memset(PageTable::fast_page_as_ptr(rem), 0x00, blksize() - rem);
+					});
+			}
+			free_blocks_from(BAN::Math::div_round_up<size_t>(new_size, blksize()));
+		}
+
 		m_inode_info.size = new_size;
 		return {};
 	}
@@ -432,48 +706,52 @@ namespace Kernel
 		return BAN::RefPtr<Inode>(inode);
 	}
 
-	BAN::ErrorOr<size_t> TmpDirectoryInode::list_next_inodes_impl(off_t data_block_index, struct dirent* list, size_t list_len)
+	BAN::ErrorOr<size_t> TmpDirectoryInode::list_next_inodes_impl(off_t& offset, struct dirent* list, size_t list_len)
 	{
-		if (list_len == 0)
-		{
-			dprintln("buffer is too small");
-			return BAN::Error::from_errno(ENOBUFS);
-		}
-
-		auto block_index = this->block_index(data_block_index);
-
-		// if we reach a non-allocated block, it marks the end
-		if (!block_index.has_value())
-			return 0;
+		// Offset is the byte position of the next entry in the directory
 
-		dirent* dirp = list;
 		size_t entry_count = 0;
+		while (entry_count < list_len && static_cast<size_t>(offset) < static_cast<size_t>(size()))
+		{
+			const size_t data_block_index = offset / blksize();
+			auto block_index = this->block_index(data_block_index);
 
-		const size_t byte_count = BAN::Math::min<size_t>(size() - data_block_index * blksize(), blksize());
-		m_fs.with_block_buffer(block_index.value(), [&](BAN::ByteSpan bytespan) {
-			bytespan = bytespan.slice(0, byte_count);
+			// if we reach a non-allocated block, it marks the end
+			if (!block_index.has_value())
+				break;
 
-			while (bytespan.size() > 0)
-			{
-				const auto& entry = bytespan.as<TmpDirectoryEntry>();
+			const size_t block_start = data_block_index * blksize();
+			const size_t byte_count = BAN::Math::min<size_t>(size() - block_start, blksize());
+			size_t next_offset = block_start + byte_count;
 
-				if (entry.type != DT_UNKNOWN)
+			m_fs.with_block_buffer(block_index.value(), [&](BAN::ByteSpan bytespan) {
+				for (size_t entry_offset = 0; entry_offset < byte_count;)
 				{
-					// TODO: dirents should be aligned
+					const auto& entry = bytespan.slice(entry_offset).as<TmpDirectoryEntry>();
+
+					// Entries before offset were returned by earlier calls
+					if (entry.type != DT_UNKNOWN && block_start + entry_offset >= static_cast<size_t>(offset))
+					{
+						if (entry_count >= list_len)
+						{
+							next_offset = block_start + entry_offset;
+							return;
+						}
 
-					entry_count++;
-					if (entry_count > list_len)
-						return;
+						// TODO: dirents should be aligned
+						auto& dirent = list[entry_count++];
+						dirent.d_ino = entry.ino;
+						dirent.d_type = entry.type;
+						memcpy(dirent.d_name, entry.name, entry.name_len);
+						dirent.d_name[entry.name_len] = '\0';
+					}
 
-					dirp->d_ino = entry.ino;
-					dirp->d_type = entry.type;
-					strncpy(dirp->d_name, entry.name, entry.name_len);
-					dirp++;
+					entry_offset += entry.rec_len;
 				}
+			});
 
-				bytespan = bytespan.slice(entry.rec_len);
-			}
-		});
+			offset = next_offset;
+		}
 
 		return entry_count;
 	}
@@ -1,5 +1,6 @@
 #include <BAN/ScopeGuard.h>
 #include <BAN/StringView.h>
+#include <kernel/FS/DentryCache.h>
 #include <kernel/FS/DevFS/FileSystem.h>
 #include <kernel/FS/ProcFS/FileSystem.h>
 #include <kernel/FS/TmpFS/FileSystem.h>
@@ -17,6 +18,8 @@ namespace Kernel
 		ASSERT(!s_instance);
 		s_instance = MUST(BAN::RefPtr<VirtualFileSystem>::create());
 
+		DentryCache::initialize();
+
 		ASSERT(root_path.size() >= 5 && root_path.substring(0, 5) == "/dev/"_sv);;
 		root_path = root_path.substring(5);
 
@@ -65,58 +68,89 @@ namespace Kernel
 		return {};
 	}
 
-	VirtualFileSystem::MountPoint* VirtualFileSystem::mount_from_host_inode(BAN::RefPtr<Inode> inode)
+	bool VirtualFileSystem::is_mounted(dev_t dev)
+	{
+		LockGuard _(m_mutex);
+		if (m_root_fs && m_root_fs->dev() == dev)
+			return true;
+		for (const MountPoint& mount : m_mount_points)
+			if (mount.target->dev() == dev)
+				return true;
+		return false;
+	}
+
+	BAN::RefPtr<Inode> VirtualFileSystem::mount_target_of(BAN::RefPtr<Inode> inode)
 	{
 		LockGuard _(m_mutex);
 		for (MountPoint& mount : m_mount_points)
 			if (*mount.host.inode == *inode)
-				return &mount;
-		return nullptr;
+				return mount.target->root_inode();
+		return {};
 	}
 
-	VirtualFileSystem::MountPoint* VirtualFileSystem::mount_from_root_inode(BAN::RefPtr<Inode> inode)
+	BAN::RefPtr<Inode> VirtualFileSystem::mount_host_of(BAN::RefPtr<Inode> inode)
 	{
 		LockGuard _(m_mutex);
 		for (MountPoint& mount : m_mount_points)
 			if (*mount.target->root_inode() == *inode)
-				return &mount;
-		return nullptr;
+				return mount.host.inode;
+		return {};
 	}
 
 	BAN::ErrorOr<VirtualFileSystem::File> VirtualFileSystem::file_from_absolute_path(const Credentials& credentials, BAN::StringView path, int flags)
 	{
-		LockGuard _(m_mutex);
-
 		ASSERT(path.front() == '/');
+		return file_from_relative_path(credentials, root_inode(), "/"_sv, path, flags);
+	}
 
-		auto inode = root_inode();
+	BAN::ErrorOr<VirtualFileSystem::File> VirtualFileSystem::file_from_relative_path(const Credentials& credentials, BAN::RefPtr<Inode> parent, BAN::StringView parent_path, BAN::StringView path, int flags)
+	{
+		if (path.empty())
+			return BAN::Error::from_errno(ENOENT);
+
+		auto inode = (path.front() == '/') ? root_inode() : parent;
 		ASSERT(inode);
 
+		// Root is the empty path while resolving
 		BAN::String canonical_path;
+		if (path.front() != '/' && parent_path != "/"_sv)
+			TRY(canonical_path.append(parent_path));
 
-		BAN::Vector<BAN::String> path_parts;
+		// Path components are views to the remaining path. Allocation
+		// is only needed to store the path after following a symlink.
+		BAN::String link_path;
+		BAN::StringView remaining = path;
 
-		{
-			auto temp = TRY(path.split('/'));
-			for (size_t i = 0; i < temp.size(); i++)
-				TRY(path_parts.emplace_back(temp[temp.size() - i - 1]));
-		}
+		const auto skip_slashes =
+			[](BAN::StringView view)
+			{
+				size_t count = 0;
+				while (count < view.size() && view[count] == '/')
+					count++;
+				return view.substring(count);
+			};
 
 		size_t link_depth = 0;
 
-		while (!path_parts.empty())
+		remaining = skip_slashes(remaining);
+		while (!remaining.empty())
 		{
-			const auto& path_part = path_parts.back();
+			size_t part_len = 0;
+			while (part_len < remaining.size() && remaining[part_len] != '/')
+				part_len++;
+			const auto path_part = remaining.substring(0, part_len);
+			remaining = skip_slashes(remaining.substring(part_len));
+
 			auto orig = inode;
 
-			if (path_part.empty() || path_part == "."_sv)
+			if (path_part == "."_sv)
 			{
 
 			}
 			else if (path_part == ".."_sv)
 			{
-				if (auto* mount_point = mount_from_root_inode(inode))
-					inode = TRY(mount_point->host.inode->find_inode(".."_sv));
+				if (auto host = mount_host_of(inode))
+					inode = TRY(host->find_inode(".."_sv));
 				else
 					inode = TRY(inode->find_inode(".."_sv));
 
@@ -135,16 +169,14 @@ namespace Kernel
 
 				inode = TRY(inode->find_inode(path_part));
 
-				if (auto* mount_point = mount_from_host_inode(inode))
-					inode = mount_point->target->root_inode();
+				if (auto target = mount_target_of(inode))
+					inode = target;
 
 				TRY(canonical_path.push_back('/'));
 				TRY(canonical_path.append(path_part));
 			}
 
-			path_parts.pop_back();
-
-			if (inode->mode().iflnk() && (!(flags & O_NOFOLLOW) || !path_parts.empty()))
+			if (inode->mode().iflnk() && (!(flags & O_NOFOLLOW) || !remaining.empty()))
 			{
 				auto target = TRY(inode->link_target());
 				if (target.empty())
@@ -154,10 +186,6 @@ namespace Kernel
 				{
 					inode = root_inode();
 					canonical_path.clear();
-
-					auto temp = TRY(target.sv().split('/'));
-					for (size_t i = 0; i < temp.size(); i++)
-						TRY(path_parts.emplace_back(temp[temp.size() - i - 1]));
 				}
 				else
 				{
@@ -166,11 +194,18 @@ namespace Kernel
 					while (canonical_path.back() != '/')
 						canonical_path.pop_back();
 					canonical_path.pop_back();
+				}
 
-					auto new_parts = TRY(target.sv().split('/'));
-					for (size_t i = 0; i < new_parts.size(); i++)
-						TRY(path_parts.emplace_back(new_parts[new_parts.size() - i - 1]));
+				// remaining may point to link_path, so build the new path separately
+				BAN::String new_path;
+				TRY(new_path.append(target));
+				if (!remaining.empty())
+				{
+					TRY(new_path.push_back('/'));
+					TRY(new_path.append(remaining));
 				}
+				link_path = BAN::move(new_path);
+				remaining = skip_slashes(link_path.sv());
 
 				link_depth++;
 				if (link_depth > 100)
@@ -188,9 +223,6 @@ namespace Kernel
 		file.inode = inode;
 		file.canonical_path = BAN::move(canonical_path);
 
-		if (file.canonical_path.empty())
-			TRY(file.canonical_path.push_back('/'));
-
 		return file;
 	}
 
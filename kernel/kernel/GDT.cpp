@@ -22,9 +22,13 @@ namespace Kernel
 		gdt->write_entry(0x00, 0x00000000, 0x00000, 0x00, 0x0);			// null
 		gdt->write_entry(0x08, 0x00000000, 0xFFFFF, 0x9A, code_flags);	// kernel code
 		gdt->write_entry(0x10, 0x00000000, 0xFFFFF, 0x92, data_flags);	// kernel data
+#if ARCH(x86_64)
+		// sysret loads user data and code segments from consecutive entries
+		gdt->write_entry(0x18, 0x00000000, 0xFFFFF, 0xF2, data_flags);	// user data
+		gdt->write_entry(0x20, 0x00000000, 0xFFFFF, 0xFA, code_flags);	// user code
+#elif ARCH(i686)
 		gdt->write_entry(0x18, 0x00000000, 0xFFFFF, 0xFA, code_flags);	// user code
 		gdt->write_entry(0x20, 0x00000000, 0xFFFFF, 0xF2, data_flags);	// user data
-#if ARCH(i686)
 		gdt->write_entry(0x28, reinterpret_cast<uint32_t>(processor), sizeof(Processor), 0x92, 0x4); // processor data
 #endif
 		gdt->write_tss();
@@ -0,0 +1,253 @@
+#include <BAN/Limits.h>
+#include <kernel/IORing.h>
+#include <kernel/Lock/LockGuard.h>
+#include <kernel/Process.h>
+#include <kernel/Thread.h>
+
+namespace Kernel
+{
+
+	static constexpr uint32_t s_max_entries = 4096;
+	static constexpr size_t s_async_worker_count = 4;
+
+	struct AsyncIO
+	{
+		// Keeps the ring, and with it the operation, alive until the worker is done
+		BAN::RefPtr<IORing> ring;
+		IORing::Operation* operation { nullptr };
+		BAN::RefPtr<Inode> inode;
+		off_t offset { 0 };
+		size_t len { 0 };
+		bool is_write { false };
+		bool direct { false };
+	};
+
+	static Mutex s_async_mutex;
+	static Semaphore s_async_semaphore;
+	static BAN::Vector<AsyncIO> s_async_queue;
+	static bool s_async_workers_started { false };
+
+	static void async_worker_task()
+	{
+		for (;;)
+		{
+			AsyncIO async_io;
+			uint32_t wake_count;
+
+			{
+				LockGuard _(s_async_mutex);
+				wake_count = s_async_semaphore.wake_count();
+				if (!s_async_queue.empty())
+				{
+					async_io = BAN::move(s_async_queue.front());
+					s_async_queue.remove(0);
+				}
+			}
+
+			if (!async_io.operation)
+			{
+				s_async_semaphore.block_with_wake_time(BAN::numeric_limits<uint64_t>::max(), wake_count);
+				continue;
+			}
+
+			auto& operation = *async_io.operation;
+			auto* data = reinterpret_cast<uint8_t*>(operation.async_buffer->vaddr());
+
+			BAN::ErrorOr<size_t> result = 0;
+			if (async_io.is_write)
+			{
+				const BAN::ConstByteSpan buffer(data, async_io.len);
+				result = async_io.direct
+					? async_io.inode->write_direct(async_io.offset, buffer)
+					: async_io.inode->write(async_io.offset, buffer);
+			}
+			else
+			{
+				BAN::ByteSpan buffer(data, async_io.len);
+				result = async_io.direct
+					? async_io.inode->read_direct(async_io.offset, buffer)
+					: async_io.inode->read(async_io.offset, buffer);
+			}
+
+			operation.async_result = result.is_error() ? -result.error().get_error_code() : static_cast<int32_t>(result.value());
+			operation.async_done = true;
+			operation.notify();
+		}
+	}
+
+	BAN::ErrorOr<BAN::RefPtr<IORing>> IORing::create(pid_t owner, const ioring& ring)
+	{
+		const auto is_valid_entry_count =
+			[](uint32_t entries)
+			{
+				return entries > 0 && entries <= s_max_entries && (entries & (entries - 1)) == 0;
+			};
+		if (!is_valid_entry_count(ring.sq_entries) || !is_valid_entry_count(ring.cq_entries))
+			return BAN::Error::from_errno(EINVAL);
+
+		auto* ioring_ptr = new IORing(owner, ring);
+		if (ioring_ptr == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		auto result = BAN::RefPtr<IORing>::adopt(ioring_ptr);
+		TRY(result->m_operations.reserve(ring.cq_entries));
+		return result;
+	}
+
+	IORing::IORing(pid_t owner, const ioring& ring)
+		: m_owner(owner)
+		, m_ring(const_cast<ioring*>(&ring))
+		, m_sqes(ring.sqes)
+		, m_cqes(ring.cqes)
+		, m_sq_entries(ring.sq_entries)
+		, m_cq_entries(ring.cq_entries)
+		, m_cq_head(ring.cq_head)
+		, m_cq_tail(ring.cq_head)
+	{ }
+
+	IORing::~IORing()
+	{
+		for (auto& operation : m_operations)
+			if (operation->waiting_on)
+				operation->waiting_on->remove_waiter(*operation);
+	}
+
+	bool IORing::peek_submission(ioring_sqe& out)
+	{
+		const uint32_t head = m_ring->sq_head;
+		if (head == m_ring->sq_tail)
+			return false;
+		out = m_sqes[head & (m_sq_entries - 1)];
+		return true;
+	}
+
+	void IORing::pop_submission()
+	{
+		m_ring->sq_head = m_ring->sq_head + 1;
+	}
+
+	bool IORing::can_read_impl() const
+	{
+		// NOTE: completions consumed since the last ioring_enter are still counted
+		return completion_count() > 0;
+	}
+
+	void IORing::sync_completion_head()
+	{
+		// Ignore heads that would make the queue hold more than it can
+		const uint32_t head = m_ring->cq_head;
+		if (m_cq_tail - head <= m_cq_entries)
+			m_cq_head = head;
+	}
+
+	void IORing::post_completion(uint64_t user_data, int32_t res)
+	{
+		ASSERT(!completion_queue_full());
+
+		auto& cqe = m_cqes[m_cq_tail & (m_cq_entries - 1)];
+		cqe.user_data = user_data;
+		cqe.res = res;
+		cqe.flags = 0;
+		m_ring->cq_tail = ++m_cq_tail;
+
+		notify_waiters();
+	}
+
+	BAN::ErrorOr<IORing::Operation*> IORing::add_operation(const ioring_sqe& sqe, uint64_t wake_time_ms)
+	{
+		if (m_operations.size() >= max_operations())
+			return BAN::Error::from_errno(EBUSY);
+
+		auto operation = TRY(BAN::UniqPtr<Operation>::create());
+		operation->ring = this;
+		operation->sqe = sqe;
+		operation->wake_time_ms = wake_time_ms;
+
+		TRY(m_operations.push_back(BAN::move(operation)));
+		return m_operations.back().ptr();
+	}
+
+	void IORing::remove_operation(Operation* operation)
+	{
+		if (operation->waiting_on)
+			operation->waiting_on->remove_waiter(*operation);
+
+		for (size_t i = 0; i < m_operations.size(); i++)
+		{
+			if (m_operations[i].ptr() != operation)
+				continue;
+			m_operations.remove(i);
+			return;
+		}
+
+		ASSERT_NOT_REACHED();
+	}
+
+	void IORing::start_waiting(Operation& operation, BAN::RefPtr<Inode> inode)
+	{
+		operation.notified = false;
+		if (operation.waiting_on == inode)
+			return;
+		if (operation.waiting_on)
+			operation.waiting_on->remove_waiter(operation);
+		operation.waiting_on = BAN::move(inode);
+		operation.waiting_on->add_waiter(operation);
+	}
+
+	BAN::ErrorOr<void> IORing::start_async_io(Operation& operation, BAN::RefPtr<Inode> inode, bool is_write, bool direct, off_t offset, size_t len)
+	{
+		ASSERT(operation.ring == this);
+		ASSERT(operation.async_buffer && operation.async_buffer->size() >= len);
+
+		{
+			LockGuard _(s_async_mutex);
+
+			if (!s_async_workers_started)
+			{
+				auto* process = Process::create_kernel();
+				size_t started = 0;
+				for (; started < s_async_worker_count; started++)
+				{
+					auto thread = Thread::create_kernel([](void*) { async_worker_task(); }, nullptr, process);
+					if (thread.is_error())
+						break;
+					process->add_thread(thread.release_value());
+				}
+				process->register_to_scheduler();
+				if (started == 0)
+					return BAN::Error::from_errno(ENOMEM);
+				s_async_workers_started = true;
+			}
+
+			TRY(s_async_queue.push_back({
+				.ring = this,
+				.operation = &operation,
+				.inode = BAN::move(inode),
+				.offset = offset,
+				.len = len,
+				.is_write = is_write,
+				.direct = direct,
+			}));
+
+			operation.async = true;
+			operation.notified = false;
+		}
+
+		s_async_semaphore.unblock();
+		return {};
+	}
+
+	BAN::ErrorOr<void> IORing::wait(uint64_t wake_time_ms)
+	{
+		// Wake ups since clear_notified make this return immediately
+		if (m_notified)
+			return {};
+		return Thread::current().block_or_eintr_or_waketime(m_semaphore, wake_time_ms, false, m_wake_count);
+	}
+
+	void IORing::wake_up()
+	{
+		m_notified = true;
+		m_semaphore.unblock();
+	}
+
+}
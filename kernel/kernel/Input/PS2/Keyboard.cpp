@@ -177,6 +177,7 @@ namespace Kernel::Input
 		m_event_queue.push(event);
 
 		m_semaphore.unblock();
+		notify_waiters();
 	}
 
 	void PS2Keyboard::update_leds()
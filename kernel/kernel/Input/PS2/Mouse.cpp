@@ -190,6 +190,7 @@ namespace Kernel::Input
 		}
 
 		m_semaphore.unblock();
+		notify_waiters();
 	}
 
 	BAN::ErrorOr<size_t> PS2Mouse::read_impl(off_t, BAN::ByteSpan buffer)
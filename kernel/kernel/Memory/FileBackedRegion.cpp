@@ -23,19 +23,10 @@ namespace Kernel
 
 		TRY(region->initialize(address_range));
 
-		if (type == Type::SHARED)
+		if (region->maps_page_cache())
 		{
 			LockGuard _(inode->m_mutex);
-			if (inode->m_shared_region.valid())
-				region->m_shared_data = inode->m_shared_region.lock();
-			else
-			{
-				auto shared_data = TRY(BAN::RefPtr<SharedFileData>::create());
-				TRY(shared_data->pages.resize(BAN::Math::div_round_up<size_t>(inode->size(), PAGE_SIZE)));
-				shared_data->inode = inode;
-				inode->m_shared_region = TRY(shared_data->get_weak_ptr());
-				region->m_shared_data = BAN::move(shared_data);
-			}
+			TRY(inode->page_cache());
 		}
 
 		return region;
@@ -53,41 +44,37 @@ namespace Kernel
 		if (m_vaddr == 0)
 			return;
 
-		if (m_type == Type::SHARED)
-			return;
+		const size_t needed_pages = BAN::Math::div_round_up<size_t>(m_size, PAGE_SIZE);
 
-		size_t needed_pages = BAN::Math::div_round_up<size_t>(m_size, PAGE_SIZE);
-		for (size_t i = 0; i < needed_pages; i++)
+		if (!maps_page_cache())
 		{
-			paddr_t paddr = m_page_table.physical_address_of(m_vaddr + i * PAGE_SIZE);
-			if (paddr != 0)
-				Heap::get().release_page(paddr);
+			for (size_t i = 0; i < needed_pages; i++)
+			{
+				paddr_t paddr = m_page_table.physical_address_of(m_vaddr + i * PAGE_SIZE);
+				if (paddr != 0)
+					Heap::get().release_page(paddr);
+			}
+			return;
 		}
-	}
 
-	SharedFileData::~SharedFileData()
-	{
-		for (size_t i = 0; i < pages.size(); i++)
+		LockGuard _(m_inode->m_mutex);
+		auto* page_cache = m_inode->m_page_cache.ptr();
+
+		for (size_t i = 0; i < needed_pages; i++)
 		{
-			if (pages[i] == 0)
+			const vaddr_t vaddr = m_vaddr + i * PAGE_SIZE;
+			if (m_page_table.physical_address_of(vaddr) == 0)
 				continue;
-			sync(i);
-		}
-	}
 
-	void SharedFileData::sync(size_t page_index)
-	{
-		// FIXME: should this be locked?
-
-		if (pages[page_index] == 0)
-			return;
+			const size_t page_index = file_page_index(vaddr);
+			if (m_type == Type::SHARED && (m_flags & PageTable::Flags::ReadWrite))
+				if (auto ret = page_cache->sync_page(page_index); ret.is_error())
+					dwarnln("{}", ret.error());
 
-		PageTable::with_fast_page(pages[page_index], [&] {
-			memcpy(page_buffer, PageTable::fast_page_as_ptr(), PAGE_SIZE);
-		});
-
-		if (auto ret = inode->write(page_index * PAGE_SIZE, BAN::ConstByteSpan::from(page_buffer)); ret.is_error())
-			dwarnln("{}", ret.error());
+			// Page must not be accessible through this mapping after the cache may drop it
+			m_page_table.reserve_page(vaddr, false);
+			page_cache->unmap_page(page_index);
+		}
 	}
 
 	BAN::ErrorOr<void> FileBackedRegion::msync(vaddr_t address, size_t size, int flags)
@@ -100,9 +87,10 @@ namespace Kernel
 		vaddr_t first_page	= address & PAGE_ADDR_MASK;
 		vaddr_t last_page	= BAN::Math::div_round_up<vaddr_t>(address + size, PAGE_SIZE) * PAGE_SIZE;
 
+		LockGuard _(m_inode->m_mutex);
 		for (vaddr_t page_addr = first_page; page_addr < last_page; page_addr += PAGE_SIZE)
-			if (contains(page_addr))
-				m_shared_data->sync((page_addr - m_vaddr) / PAGE_SIZE);
+			if (contains(page_addr) && m_page_table.physical_address_of(page_addr) != 0)
+				TRY(m_inode->m_page_cache->sync_page(file_page_index(page_addr)));
 
 		return {};
 	}
@@ -116,7 +104,18 @@ namespace Kernel
 		if (m_page_table.physical_address_of(vaddr) != 0)
 			return false;
 
-		if (m_type == Type::PRIVATE)
+		if (maps_page_cache())
+		{
+			LockGuard _(m_inode->m_mutex);
+
+			// Another thread may have mapped the page while we waited for the lock
+			if (m_page_table.physical_address_of(vaddr) != 0)
+				return false;
+
+			paddr_t paddr = TRY(m_inode->m_page_cache->map_page(file_page_index(vaddr)));
+			m_page_table.map_page_at(paddr, vaddr, m_flags);
+		}
+		else
 		{
 			// Map new physcial page to address
 			paddr_t paddr = Heap::get().take_free_page();
@@ -127,7 +126,7 @@ namespace Kernel
 			m_page_table.map_page_at(paddr, vaddr, m_flags | PageTable::Flags::ReadWrite);
 
 			size_t file_offset = m_offset + (vaddr - m_vaddr);
-			size_t bytes = BAN::Math::min<size_t>(m_size - file_offset, PAGE_SIZE);
+			size_t bytes = BAN::Math::min<size_t>(m_size - (vaddr - m_vaddr), PAGE_SIZE);
 
 			ASSERT(&PageTable::current() == &m_page_table);
 			auto read_ret = m_inode->read(file_offset, BAN::ByteSpan((uint8_t*)vaddr, bytes));
@@ -146,44 +145,6 @@ namespace Kernel
 				m_page_table.unmap_page(vaddr);
 				return BAN::Error::from_errno(EIO);
 			}
-
-			// Disable writable if not wanted
-			if (!(m_flags & PageTable::Flags::ReadWrite))
-				m_page_table.map_page_at(paddr, vaddr, m_flags);
-		}
-		else if	(m_type == Type::SHARED)
-		{
-			LockGuard _(m_inode->m_mutex);
-			ASSERT(m_inode->m_shared_region.valid());
-			ASSERT(m_shared_data->pages.size() == BAN::Math::div_round_up<size_t>(m_inode->size(), PAGE_SIZE));
-
-			auto& pages = m_shared_data->pages;
-			size_t page_index = (vaddr - m_vaddr) / PAGE_SIZE;
-
-			if (pages[page_index] == 0)
-			{
-				pages[page_index] = Heap::get().take_free_page();
-				if (pages[page_index] == 0)
-					return BAN::Error::from_errno(ENOMEM);
-
-				size_t offset = vaddr - m_vaddr;
-				size_t bytes = BAN::Math::min<size_t>(m_size - offset, PAGE_SIZE);
-
-				TRY(m_inode->read(offset, BAN::ByteSpan(m_shared_data->page_buffer, bytes)));
-
-				PageTable::with_fast_page(pages[page_index], [&] {
-					memcpy(PageTable::fast_page_as_ptr(), m_shared_data->page_buffer, PAGE_SIZE);
-				});
-			}
-
-			paddr_t paddr = pages[page_index];
-			ASSERT(paddr);
-
-			m_page_table.map_page_at(paddr, vaddr, m_flags);
-		}
-		else
-		{
-			ASSERT_NOT_REACHED();
 		}
 
 		return true;
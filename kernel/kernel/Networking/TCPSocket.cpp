@@ -195,7 +195,12 @@ namespace Kernel
 		return m_network_layer.bind_socket_to_address(this, address, address_len);
 	}
 
-	BAN::ErrorOr<size_t> TCPSocket::recvfrom_impl(BAN::ByteSpan buffer, sockaddr*, socklen_t*)
+	BAN::ErrorOr<size_t> TCPSocket::recvfrom_impl(BAN::ByteSpan buffer, sockaddr* address, socklen_t* address_len)
+	{
+		return recvmsg_impl(BAN::Span<BAN::ByteSpan>(&buffer, 1), address, address_len);
+	}
+
+	BAN::ErrorOr<size_t> TCPSocket::recvmsg_impl(BAN::Span<BAN::ByteSpan> buffers, sockaddr*, socklen_t*)
 	{
 		if (!m_has_connected)
 			return BAN::Error::from_errno(ENOTCONN);
@@ -208,10 +213,21 @@ namespace Kernel
 			TRY(Thread::current().block_or_eintr_indefinite(m_semaphore));
 		}
 
-		const uint32_t to_recv = BAN::Math::min<uint32_t>(buffer.size(), m_recv_window.data_size);
+		size_t buffer_size = 0;
+		for (size_t i = 0; i < buffers.size(); i++)
+			buffer_size += buffers[i].size();
+
+		const uint32_t to_recv = BAN::Math::min<size_t>(buffer_size, m_recv_window.data_size);
 
 		auto* recv_buffer = reinterpret_cast<uint8_t*>(m_recv_window.buffer->vaddr());
-		memcpy(buffer.data(), recv_buffer, to_recv);
+
+		uint32_t ncopied = 0;
+		for (size_t i = 0; i < buffers.size() && ncopied < to_recv; i++)
+		{
+			const uint32_t to_copy = BAN::Math::min<size_t>(buffers[i].size(), to_recv - ncopied);
+			memcpy(buffers[i].data(), recv_buffer + ncopied, to_copy);
+			ncopied += to_copy;
+		}
 
 		m_recv_window.data_size -= to_recv;
 		m_recv_window.start_seq += to_recv;
@@ -222,20 +238,36 @@ namespace Kernel
 	}
 
 	BAN::ErrorOr<size_t> TCPSocket::sendto_impl(BAN::ConstByteSpan message, const sockaddr* address, socklen_t address_len)
+	{
+		return sendmsg_impl(BAN::Span<const BAN::ConstByteSpan>(&message, 1), address, address_len);
+	}
+
+	BAN::ErrorOr<size_t> TCPSocket::sendmsg_impl(BAN::Span<const BAN::ConstByteSpan> message, const sockaddr* address, socklen_t address_len)
 	{
 		if (address)
 			return BAN::Error::from_errno(EISCONN);
 		if (!m_has_connected)
 			return BAN::Error::from_errno(ENOTCONN);
 
-		if (message.size() > m_send_window.buffer->size())
+		size_t message_size = 0;
+		for (size_t i = 0; i < message.size(); i++)
+			message_size += message[i].size();
+
+		if (message_size > m_send_window.buffer->size())
 		{
+			// Send the segments one window sized part at a time
 			size_t nsent = 0;
-			while (nsent < message.size())
+			for (size_t i = 0; i < message.size(); i++)
 			{
-				const size_t to_send = BAN::Math::min<size_t>(message.size() - nsent, m_send_window.buffer->size());
-				TRY(sendto_impl(message.slice(nsent, to_send), address, address_len));
-				nsent += to_send;
+				BAN::ConstByteSpan segment = message[i];
+				for (size_t offset = 0; offset < segment.size();)
+				{
+					const size_t to_send = BAN::Math::min<size_t>(segment.size() - offset, m_send_window.buffer->size());
+					const BAN::ConstByteSpan part = segment.slice(offset, to_send);
+					TRY(sendmsg_impl(BAN::Span<const BAN::ConstByteSpan>(&part, 1), address, address_len));
+					offset += to_send;
+					nsent += to_send;
+				}
 			}
 			return nsent;
 		}
@@ -244,7 +276,7 @@ namespace Kernel
 		{
 			if (m_state != State::Established)
 				return return_with_maybe_zero();
-			if (m_send_window.data_size + message.size() <= m_send_window.buffer->size())
+			if (m_send_window.data_size + message_size <= m_send_window.buffer->size())
 				break;
 			LockFreeGuard free(m_mutex);
 			TRY(Thread::current().block_or_eintr_indefinite(m_semaphore));
@@ -252,8 +284,11 @@ namespace Kernel
 
 		{
 			auto* buffer = reinterpret_cast<uint8_t*>(m_send_window.buffer->vaddr());
-			memcpy(buffer + m_send_window.data_size, message.data(), message.size());
-			m_send_window.data_size += message.size();
+			for (size_t i = 0; i < message.size(); i++)
+			{
+				memcpy(buffer + m_send_window.data_size, message[i].data(), message[i].size());
+				m_send_window.data_size += message[i].size();
+			}
 		}
 
 		const uint32_t target_ack = m_send_window.start_seq + m_send_window.data_size;
@@ -267,7 +302,7 @@ namespace Kernel
 			TRY(Thread::current().block_or_eintr_indefinite(m_semaphore));
 		}
 
-		return message.size();
+		return message_size;
 	}
 
 	bool TCPSocket::can_read_impl() const
@@ -596,6 +631,7 @@ namespace Kernel
 		}
 
 		m_semaphore.unblock();
+		notify_waiters();
 	}
 
 	void TCPSocket::set_connection_as_closed()
@@ -745,10 +781,12 @@ namespace Kernel
 			}
 
 			m_semaphore.unblock();
+			notify_waiters();
 			m_semaphore.block_with_wake_time(current_ms + retransmit_timeout_ms);
 		}
 
 		m_semaphore.unblock();
+		notify_waiters();
 	}
 
 }
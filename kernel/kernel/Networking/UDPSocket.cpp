@@ -71,6 +71,7 @@ namespace Kernel
 		m_packet_total_size += payload.size();
 
 		m_packet_semaphore.unblock();
+		notify_waiters();
 	}
 
 	BAN::ErrorOr<void> UDPSocket::bind_impl(const sockaddr* address, socklen_t address_len)
@@ -61,7 +61,10 @@ namespace Kernel
 		{
 			auto& connection_info = m_info.get<ConnectionInfo>();
 			if (auto connection = connection_info.connection.lock(); connection && connection->m_info.has<ConnectionInfo>())
+			{
 				connection->m_info.get<ConnectionInfo>().target_closed = true;
+				connection->notify_waiters();
+			}
 		}
 		m_info.clear();
 	}
@@ -95,8 +98,11 @@ namespace Kernel
 
 		TRY(return_inode->m_bound_path.push_back('X'));
 		return_inode->m_info.get<ConnectionInfo>().connection = TRY(pending->get_weak_ptr());
+		return_inode->m_info.get<ConnectionInfo>().has_connected = true;
 		pending->m_info.get<ConnectionInfo>().connection = TRY(return_inode->get_weak_ptr());
+		pending->m_info.get<ConnectionInfo>().has_connected = true;
 		pending->m_info.get<ConnectionInfo>().connection_done = true;
+		pending->notify_waiters();
 
 		if (address && address_len && !is_bound_to_unused())
 		{
@@ -170,6 +176,7 @@ namespace Kernel
 			}
 			TRY(Thread::current().block_or_eintr_indefinite(target_info.pending_semaphore));
 		}
+		target->notify_waiters();
 
 		while (!connection_info.connection_done)
 			Scheduler::get().yield();
@@ -237,10 +244,10 @@ namespace Kernel
 		}
 	}
 
-	BAN::ErrorOr<void> UnixDomainSocket::add_packet(BAN::ConstByteSpan packet)
+	BAN::ErrorOr<void> UnixDomainSocket::add_packet(BAN::Span<const BAN::ConstByteSpan> segments, size_t packet_size)
 	{
 		auto state = m_packet_lock.lock();
-		while (m_packet_sizes.full() || m_packet_size_total + packet.size() > s_packet_buffer_size)
+		while (m_packet_sizes.full() || m_packet_size_total + packet_size > s_packet_buffer_size)
 		{
 			m_packet_lock.unlock(state);
 			TRY(Thread::current().block_or_eintr_indefinite(m_packet_semaphore));
@@ -248,14 +255,19 @@ namespace Kernel
 		}
 
 		uint8_t* packet_buffer = reinterpret_cast<uint8_t*>(m_packet_buffer->vaddr() + m_packet_size_total);
-		memcpy(packet_buffer, packet.data(), packet.size());
-		m_packet_size_total += packet.size();
+		for (size_t i = 0; i < segments.size(); i++)
+		{
+			memcpy(packet_buffer, segments[i].data(), segments[i].size());
+			packet_buffer += segments[i].size();
+		}
+		m_packet_size_total += packet_size;
 
 		if (!is_streaming())
-			m_packet_sizes.push(packet.size());
+			m_packet_sizes.push(packet_size);
 
 		m_packet_semaphore.unblock();
 		m_packet_lock.unlock(state);
+		notify_waiters();
 		return {};
 	}
 
@@ -275,6 +287,15 @@ namespace Kernel
 		return m_packet_size_total > 0;
 	}
 
+	bool UnixDomainSocket::has_hungup_impl() const
+	{
+		if (!m_info.has<ConnectionInfo>())
+			return false;
+		// target_closed is cleared by the first read returning end of file, but the peer stays gone
+		auto& connection_info = m_info.get<ConnectionInfo>();
+		return connection_info.target_closed || (connection_info.has_connected && !connection_info.connection.valid());
+	}
+
 	bool UnixDomainSocket::can_write_impl() const
 	{
 		if (m_info.has<ConnectionInfo>())
@@ -288,7 +309,16 @@ namespace Kernel
 
 	BAN::ErrorOr<size_t> UnixDomainSocket::sendto_impl(BAN::ConstByteSpan message, const sockaddr* address, socklen_t address_len)
 	{
-		if (message.size() > s_packet_buffer_size)
+		return sendmsg_impl(BAN::Span<const BAN::ConstByteSpan>(&message, 1), address, address_len);
+	}
+
+	BAN::ErrorOr<size_t> UnixDomainSocket::sendmsg_impl(BAN::Span<const BAN::ConstByteSpan> message, const sockaddr* address, socklen_t address_len)
+	{
+		size_t message_size = 0;
+		for (size_t i = 0; i < message.size(); i++)
+			message_size += message[i].size();
+
+		if (message_size > s_packet_buffer_size)
 			return BAN::Error::from_errno(ENOBUFS);
 
 		if (m_info.has<ConnectionInfo>())
@@ -299,8 +329,8 @@ namespace Kernel
 			auto target = connection_info.connection.lock();
 			if (!target)
 				return BAN::Error::from_errno(ENOTCONN);
-			TRY(target->add_packet(message));
-			return message.size();
+			TRY(target->add_packet(message, message_size));
+			return message_size;
 		}
 		else
 		{
@@ -338,13 +368,22 @@ namespace Kernel
 			auto target = it->value.lock();
 			if (!target)
 				return BAN::Error::from_errno(EDESTADDRREQ);
-			TRY(target->add_packet(message));
-			return message.size();
+			TRY(target->add_packet(message, message_size));
+			return message_size;
 		}
 	}
 
-	BAN::ErrorOr<size_t> UnixDomainSocket::recvfrom_impl(BAN::ByteSpan buffer, sockaddr*, socklen_t*)
+	BAN::ErrorOr<size_t> UnixDomainSocket::recvfrom_impl(BAN::ByteSpan buffer, sockaddr* address, socklen_t* address_len)
+	{
+		return recvmsg_impl(BAN::Span<BAN::ByteSpan>(&buffer, 1), address, address_len);
+	}
+
+	BAN::ErrorOr<size_t> UnixDomainSocket::recvmsg_impl(BAN::Span<BAN::ByteSpan> buffers, sockaddr*, socklen_t*)
 	{
+		size_t buffer_size = 0;
+		for (size_t i = 0; i < buffers.size(); i++)
+			buffer_size += buffers[i].size();
+
 		if (m_info.has<ConnectionInfo>())
 		{
 			auto& connection_info = m_info.get<ConnectionInfo>();
@@ -366,14 +405,21 @@ namespace Kernel
 
 		size_t nread = 0;
 		if (is_streaming())
-			nread = BAN::Math::min(buffer.size(), m_packet_size_total);
+			nread = BAN::Math::min(buffer_size, m_packet_size_total);
 		else
 		{
-			nread = BAN::Math::min(buffer.size(), m_packet_sizes.front());
+			nread = BAN::Math::min(buffer_size, m_packet_sizes.front());
 			m_packet_sizes.pop();
 		}
 
-		memcpy(buffer.data(), packet_buffer, nread);
+		size_t ncopied = 0;
+		for (size_t i = 0; i < buffers.size() && ncopied < nread; i++)
+		{
+			const size_t to_copy = BAN::Math::min(buffers[i].size(), nread - ncopied);
+			memcpy(buffers[i].data(), packet_buffer + ncopied, to_copy);
+			ncopied += to_copy;
+		}
+
 		memmove(packet_buffer, packet_buffer + nread, m_packet_size_total - nread);
 		m_packet_size_total -= nread;
 
@@ -1,5 +1,7 @@
+#include <kernel/Epoll.h>
 #include <kernel/FS/Pipe.h>
 #include <kernel/FS/VirtualFileSystem.h>
+#include <kernel/Memory/PageTable.h>
 #include <kernel/Networking/NetworkManager.h>
 #include <kernel/OpenFileDescriptorSet.h>
 
@@ -22,8 +24,7 @@ namespace Kernel
 
 	OpenFileDescriptorSet& OpenFileDescriptorSet::operator=(OpenFileDescriptorSet&& other)
 	{
-		for (size_t i = 0; i < m_open_files.size(); i++)
-			m_open_files[i] = BAN::move(other.m_open_files[i]);
+		m_open_files = BAN::move(other.m_open_files);
 		return *this;
 	}
 
@@ -31,6 +32,7 @@ namespace Kernel
 	{
 		close_all();
 
+		TRY(m_open_files.resize(other.m_open_files.size()));
 		for (int fd = 0; fd < (int)other.m_open_files.size(); fd++)
 		{
 			if (other.validate_fd(fd).is_error())
@@ -60,7 +62,7 @@ namespace Kernel
 		ASSERT(inode);
 		ASSERT(!inode->mode().ifdir());
 
-		if (flags & ~(O_RDONLY | O_WRONLY))
+		if (flags & ~(O_RDONLY | O_WRONLY | O_CLOEXEC))
 			return BAN::Error::from_errno(ENOTSUP);
 
 		int fd = TRY(get_free_fd());
@@ -72,7 +74,7 @@ namespace Kernel
 
 	BAN::ErrorOr<int> OpenFileDescriptorSet::open(BAN::StringView absolute_path, int flags)
 	{
-		if (flags & ~(O_RDONLY | O_WRONLY | O_NOFOLLOW | O_SEARCH | O_APPEND | O_TRUNC | O_CLOEXEC | O_TTY_INIT | O_DIRECTORY | O_NONBLOCK))
+		if (flags & ~(O_RDONLY | O_WRONLY | O_NOFOLLOW | O_SEARCH | O_APPEND | O_TRUNC | O_CLOEXEC | O_TTY_INIT | O_DIRECTORY | O_NONBLOCK | O_DIRECT))
 			return BAN::Error::from_errno(ENOTSUP);
 
 		int access_mask = O_EXEC | O_RDONLY | O_WRONLY | O_SEARCH;
@@ -84,6 +86,9 @@ namespace Kernel
 		if ((flags & O_DIRECTORY) && !file.inode->mode().ifdir())
 			return BAN::Error::from_errno(ENOTDIR);
 
+		if ((flags & O_DIRECT) && !file.inode->supports_direct_io())
+			return BAN::Error::from_errno(EINVAL);
+
 		if ((flags & O_TRUNC) && (flags & O_WRONLY) && file.inode->mode().ifreg())
 			TRY(file.inode->truncate(0));
 
@@ -171,13 +176,16 @@ namespace Kernel
 
 	BAN::ErrorOr<int> OpenFileDescriptorSet::dup2(int fildes, int fildes2)
 	{
-		if (fildes2 < 0 || fildes2 >= (int)m_open_files.size())
+		if (fildes2 < 0 || fildes2 >= OPEN_MAX)
 			return BAN::Error::from_errno(EBADF);
 
 		TRY(validate_fd(fildes));
 		if (fildes == fildes2)
 			return fildes;
 
+		if (fildes2 >= (int)m_open_files.size())
+			TRY(m_open_files.resize(fildes2 + 1));
+
 		(void)close(fildes2);
 
 		m_open_files[fildes2] = m_open_files[fildes];
@@ -206,6 +214,8 @@ namespace Kernel
 			case F_GETFL:
 				return m_open_files[fd]->flags & ~creation_flags;
 			case F_SETFL:
+				if ((extra & O_DIRECT) && !m_open_files[fd]->inode->supports_direct_io())
+					return BAN::Error::from_errno(EINVAL);
 				m_open_files[fd]->flags |= extra & ~(O_ACCMODE | creation_flags);
 				return 0;
 			default:
@@ -287,13 +297,13 @@ namespace Kernel
 		if (flag == AT_SYMLINK_NOFOLLOW)
 			flag = O_NOFOLLOW;
 
-		BAN::String absolute_path;
-		TRY(absolute_path.append(TRY(path_of(fd))));
-		TRY(absolute_path.push_back('/'));
-		TRY(absolute_path.append(path));
+		TRY(validate_fd(fd));
+		const auto& open_file = m_open_files[fd];
 
+		// Path is resolved from the directory's inode, so stat of every entry
+		// of a directory does not walk the whole path again
 		// FIXME: handle O_SEARCH in fd
-		auto file = TRY(VirtualFileSystem::get().file_from_absolute_path(m_credentials, absolute_path, flag));
+		auto file = TRY(VirtualFileSystem::get().file_from_relative_path(m_credentials, open_file->inode, open_file->path.sv(), path, flag));
 		read_stat_from_inode(file.inode, out);
 
 		return {};
@@ -317,6 +327,11 @@ namespace Kernel
 		if (m_open_files[fd]->flags & O_WRONLY && m_open_files[fd]->inode->is_pipe())
 			((Pipe*)m_open_files[fd]->inode.ptr())->close_writing();
 
+		// Epoll interests are keyed by file descriptor, so they go away with it
+		for (auto& open_file : m_open_files)
+			if (open_file && open_file->inode->is_epoll())
+				static_cast<Epoll*>(open_file->inode.ptr())->remove_closed_fd(fd, *m_open_files[fd]->inode);
+
 		m_open_files[fd].clear();
 
 		return {};
@@ -345,7 +360,9 @@ namespace Kernel
 		auto& open_file = m_open_files[fd];
 		if ((open_file->flags & O_NONBLOCK) && !open_file->inode->can_read())
 			return 0;
-		size_t nread = TRY(open_file->inode->read(open_file->offset, buffer));
+		size_t nread = (open_file->flags & O_DIRECT)
+			? TRY(open_file->inode->read_direct(open_file->offset, buffer))
+			: TRY(open_file->inode->read(open_file->offset, buffer));
 		open_file->offset += nread;
 		return nread;
 	}
@@ -358,18 +375,272 @@ namespace Kernel
 			return 0;
 		if (open_file->flags & O_APPEND)
 			open_file->offset = open_file->inode->size();
-		size_t nwrite = TRY(open_file->inode->write(open_file->offset, buffer));
+		size_t nwrite = (open_file->flags & O_DIRECT)
+			? TRY(open_file->inode->write_direct(open_file->offset, buffer))
+			: TRY(open_file->inode->write(open_file->offset, buffer));
 		open_file->offset += nwrite;
 		return nwrite;
 	}
 
+	BAN::ErrorOr<size_t> OpenFileDescriptorSet::readv(int fd, BAN::Span<BAN::ByteSpan> buffers)
+	{
+		TRY(validate_fd(fd));
+		auto& open_file = m_open_files[fd];
+		if ((open_file->flags & O_NONBLOCK) && !open_file->inode->can_read())
+			return 0;
+		if (open_file->inode->mode().ifsock())
+			return TRY(open_file->inode->recvmsg(buffers, nullptr, nullptr));
+		size_t nread = TRY(open_file->inode->readv(open_file->offset, buffers, open_file->flags & O_DIRECT));
+		open_file->offset += nread;
+		return nread;
+	}
+
+	BAN::ErrorOr<size_t> OpenFileDescriptorSet::writev(int fd, BAN::Span<const BAN::ConstByteSpan> buffers)
+	{
+		TRY(validate_fd(fd));
+		auto& open_file = m_open_files[fd];
+		if ((open_file->flags & O_NONBLOCK) && !open_file->inode->can_write())
+			return 0;
+		if (open_file->inode->mode().ifsock())
+			return TRY(open_file->inode->sendmsg(buffers, nullptr, 0));
+		if (open_file->flags & O_APPEND)
+			open_file->offset = open_file->inode->size();
+		size_t nwrite = TRY(open_file->inode->writev(open_file->offset, buffers, open_file->flags & O_DIRECT));
+		open_file->offset += nwrite;
+		return nwrite;
+	}
+
+	BAN::ErrorOr<size_t> OpenFileDescriptorSet::splice(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t count)
+	{
+		TRY(validate_fd(in_fd));
+		TRY(validate_fd(out_fd));
+
+		auto in_file = m_open_files[in_fd];
+		auto out_file = m_open_files[out_fd];
+		auto& in_inode = *in_file->inode;
+		auto& out_inode = *out_file->inode;
+
+		if (!(in_file->flags & O_RDONLY) || !(out_file->flags & O_WRONLY))
+			return BAN::Error::from_errno(EBADF);
+		if (in_inode.mode().ifdir() || out_inode.mode().ifdir())
+			return BAN::Error::from_errno(EISDIR);
+		if ((in_offset && !in_inode.mode().ifreg()) || (out_offset && !out_inode.mode().ifreg()))
+			return BAN::Error::from_errno(ESPIPE);
+		if (out_offset && (out_file->flags & O_APPEND))
+			return BAN::Error::from_errno(EINVAL);
+		if (in_offset && *in_offset < 0)
+			return BAN::Error::from_errno(EINVAL);
+		if (out_offset && *out_offset < 0)
+			return BAN::Error::from_errno(EINVAL);
+
+		if ((in_file->flags & O_NONBLOCK) && !in_inode.can_read())
+			return BAN::Error::from_errno(EAGAIN);
+		if ((out_file->flags & O_NONBLOCK) && !out_inode.can_write())
+			return BAN::Error::from_errno(EAGAIN);
+
+		off_t& in_off = in_offset ? *in_offset : in_file->offset;
+		off_t& out_off = out_offset ? *out_offset : out_file->offset;
+
+		const auto write_out =
+			[&](BAN::ConstByteSpan data) -> BAN::ErrorOr<size_t>
+			{
+				if (out_inode.mode().ifsock())
+					return out_inode.sendto(data, nullptr, 0);
+				if (out_file->flags & O_APPEND)
+					out_off = out_inode.size();
+				const size_t nwrite = TRY(out_inode.write(out_off, data));
+				out_off += nwrite;
+				return nwrite;
+			};
+
+		size_t ntransferred = 0;
+
+		if (in_inode.mode().ifreg() && in_inode.has_page_cache())
+		{
+			// Pin a window of cached pages, map it to the kernel and write it straight from the cache
+			while (ntransferred < count)
+			{
+				const size_t file_size = in_inode.size();
+				if (static_cast<size_t>(in_off) >= file_size)
+					break;
+
+				const size_t page_offset = in_off % PAGE_SIZE;
+				const size_t to_transfer = BAN::Math::min<size_t>(
+					BAN::Math::min<size_t>(count - ntransferred, file_size - in_off),
+					s_splice_window_pages * PAGE_SIZE - page_offset
+				);
+				const size_t first_page = in_off / PAGE_SIZE;
+				const size_t page_count = BAN::Math::div_round_up<size_t>(page_offset + to_transfer, PAGE_SIZE);
+
+				const vaddr_t vaddr = PageTable::kernel().reserve_free_contiguous_pages(page_count, KERNEL_OFFSET);
+				if (vaddr == 0)
+				{
+					if (ntransferred > 0)
+						break;
+					return BAN::Error::from_errno(ENOMEM);
+				}
+
+				BAN::ErrorOr<size_t> result = 0;
+
+				size_t pinned = 0;
+				for (; pinned < page_count; pinned++)
+				{
+					auto paddr = in_inode.pin_page(first_page + pinned);
+					if (paddr.is_error())
+					{
+						result = paddr.release_error();
+						break;
+					}
+					PageTable::kernel().map_page_at(paddr.value(), vaddr + pinned * PAGE_SIZE, PageTable::Flags::Present);
+				}
+
+				if (!result.is_error())
+					result = write_out(BAN::ConstByteSpan(reinterpret_cast<const uint8_t*>(vaddr + page_offset), to_transfer));
+
+				PageTable::kernel().unmap_range(vaddr, page_count * PAGE_SIZE);
+				for (size_t i = 0; i < pinned; i++)
+					in_inode.unpin_page(first_page + i);
+
+				if (result.is_error())
+				{
+					if (ntransferred > 0)
+						break;
+					return result.release_error();
+				}
+
+				in_off += result.value();
+				ntransferred += result.value();
+				if (result.value() < to_transfer)
+					break;
+			}
+
+			return ntransferred;
+		}
+
+		// Pipes, sockets and files without a page cache are copied through a kernel buffer
+		BAN::Vector<uint8_t> buffer;
+		TRY(buffer.resize(BAN::Math::min<size_t>(count, s_splice_window_pages * PAGE_SIZE)));
+
+		while (ntransferred < count)
+		{
+			auto read_span = buffer.span().slice(0, BAN::Math::min<size_t>(count - ntransferred, buffer.size()));
+
+			auto nread_or_error = in_inode.mode().ifsock()
+				? in_inode.recvfrom(read_span, nullptr, nullptr)
+				: in_inode.read(in_off, read_span);
+			if (nread_or_error.is_error())
+			{
+				if (ntransferred > 0)
+					break;
+				return nread_or_error.release_error();
+			}
+
+			const size_t nread = nread_or_error.value();
+			if (nread == 0)
+				break;
+			if (!in_inode.mode().ifsock())
+				in_off += nread;
+
+			// Data has already been consumed from the input, so all of it has to be written
+			for (size_t nwritten = 0; nwritten < nread;)
+			{
+				auto nwrite_or_error = write_out(read_span.slice(nwritten, nread - nwritten));
+				if (nwrite_or_error.is_error())
+				{
+					if (ntransferred + nwritten > 0)
+						return ntransferred + nwritten;
+					return nwrite_or_error.release_error();
+				}
+				if (nwrite_or_error.value() == 0)
+					return ntransferred + nwritten;
+				nwritten += nwrite_or_error.value();
+			}
+
+			ntransferred += nread;
+
+			// Short read from a pipe or a socket, don't block waiting for more
+			if (nread < read_span.size() && !in_inode.mode().ifreg())
+				break;
+		}
+
+		return ntransferred;
+	}
+
+	BAN::ErrorOr<size_t> OpenFileDescriptorSet::copy_file_range(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t count)
+	{
+		TRY(validate_fd(in_fd));
+		TRY(validate_fd(out_fd));
+
+		auto in_file = m_open_files[in_fd];
+		auto out_file = m_open_files[out_fd];
+		auto& in_inode = *in_file->inode;
+		auto& out_inode = *out_file->inode;
+
+		if (!(in_file->flags & O_RDONLY) || !(out_file->flags & O_WRONLY))
+			return BAN::Error::from_errno(EBADF);
+		if (out_file->flags & O_APPEND)
+			return BAN::Error::from_errno(EBADF);
+		if (in_inode.mode().ifdir() || out_inode.mode().ifdir())
+			return BAN::Error::from_errno(EISDIR);
+		if (!in_inode.mode().ifreg() || !out_inode.mode().ifreg())
+			return BAN::Error::from_errno(EINVAL);
+		if (in_offset && *in_offset < 0)
+			return BAN::Error::from_errno(EINVAL);
+		if (out_offset && *out_offset < 0)
+			return BAN::Error::from_errno(EINVAL);
+
+		off_t& in_off = in_offset ? *in_offset : in_file->offset;
+		off_t& out_off = out_offset ? *out_offset : out_file->offset;
+
+		if (in_off >= in_inode.size())
+			return 0;
+		count = BAN::Math::min<size_t>(count, in_inode.size() - in_off);
+
+		if (in_inode == out_inode)
+		{
+			const size_t in_start = in_off;
+			const size_t out_start = out_off;
+			if (in_start < out_start + count && out_start < in_start + count)
+				return BAN::Error::from_errno(EINVAL);
+		}
+
+		size_t ncopied = 0;
+
+		if (in_inode.dev() == out_inode.dev())
+		{
+			auto result = in_inode.copy_file_range(in_off, out_inode, out_off, count);
+			if (result.is_error() && result.error().get_error_code() != ENOTSUP)
+				return result.release_error();
+			if (!result.is_error())
+			{
+				in_off += result.value();
+				out_off += result.value();
+				ncopied += result.value();
+			}
+		}
+
+		if (ncopied < count)
+		{
+			auto result = splice(in_fd, &in_off, out_fd, &out_off, count - ncopied);
+			if (result.is_error())
+			{
+				if (ncopied > 0)
+					return ncopied;
+				return result.release_error();
+			}
+			ncopied += result.value();
+		}
+
+		return ncopied;
+	}
+
 	BAN::ErrorOr<size_t> OpenFileDescriptorSet::read_dir_entries(int fd, struct dirent* list, size_t list_len)
 	{
 		TRY(validate_fd(fd));
 		auto& open_file = m_open_files[fd];
 		if (!(open_file->flags & O_RDONLY))
 			return BAN::Error::from_errno(EACCES);
-		return TRY(open_file->inode->list_next_inodes(open_file->offset++, list, list_len));
+		return TRY(open_file->inode->list_next_inodes(open_file->offset, list, list_len));
 	}
 
 	BAN::ErrorOr<BAN::StringView> OpenFileDescriptorSet::path_of(int fd) const
@@ -399,25 +670,37 @@ namespace Kernel
 		return {};
 	}
 
-	BAN::ErrorOr<int> OpenFileDescriptorSet::get_free_fd() const
+	BAN::ErrorOr<void> OpenFileDescriptorSet::grow_open_files()
+	{
+		if (m_open_files.size() >= OPEN_MAX)
+			return BAN::Error::from_errno(EMFILE);
+		const size_t new_size = BAN::Math::clamp<size_t>(m_open_files.size() * 2, 16, OPEN_MAX);
+		TRY(m_open_files.resize(new_size));
+		return {};
+	}
+
+	BAN::ErrorOr<int> OpenFileDescriptorSet::get_free_fd()
 	{
 		for (int fd = 0; fd < (int)m_open_files.size(); fd++)
 			if (!m_open_files[fd])
 				return fd;
-		return BAN::Error::from_errno(EMFILE);
+
+		const int fd = m_open_files.size();
+		TRY(grow_open_files());
+		return fd;
 	}
 
-	BAN::ErrorOr<void> OpenFileDescriptorSet::get_free_fd_pair(int fds[2]) const
+	BAN::ErrorOr<void> OpenFileDescriptorSet::get_free_fd_pair(int fds[2])
 	{
 		size_t found = 0;
-		for (int fd = 0; fd < (int)m_open_files.size(); fd++)
+		for (int fd = 0; found < 2; fd++)
 		{
+			if (fd >= (int)m_open_files.size())
+				TRY(grow_open_files());
 			if (!m_open_files[fd])
 				fds[found++] = fd;
-			if (found == 2)
-				return {};
 		}
-		return BAN::Error::from_errno(EMFILE);
+		return {};
 	}
 
 }
@@ -8,6 +8,7 @@
 #include <kernel/Storage/ATA/AHCI/Controller.h>
 #include <kernel/Storage/ATA/ATAController.h>
 #include <kernel/Storage/NVMe/Controller.h>
+#include <kernel/Storage/VirtIO/Controller.h>
 
 #define INVALID_VENDOR 0xFFFF
 #define MULTI_FUNCTION 0x80
@@ -197,6 +198,14 @@ namespace Kernel::PCI
 								if (auto res = NVMeController::create(pci_device); res.is_error())
 									dprintln("NVMe: {}", res.error());
 								break;
+							case 0x00:
+								if (pci_device.vendor_id() == VirtIO::PCI_VENDOR_ID)
+								{
+									if (auto res = VirtIOBlockController::create(pci_device); res.is_error())
+										dprintln("VirtIO: {}", res.error());
+									break;
+								}
+								[[fallthrough]];
 							default:
 								dprintln("unsupported storage device (pci {2H}.{2H}.{2H})", pci_device.class_code(), pci_device.subclass(), pci_device.prog_if());
 								break;
@@ -1,6 +1,8 @@
+#include <BAN/Limits.h>
 #include <BAN/ScopeGuard.h>
 #include <BAN/StringView.h>
 #include <kernel/ACPI/ACPI.h>
+#include <kernel/Epoll.h>
 #include <kernel/FS/DevFS/FileSystem.h>
 #include <kernel/FS/ProcFS/FileSystem.h>
 #include <kernel/FS/VirtualFileSystem.h>
@@ -30,6 +32,9 @@ namespace Kernel
 	static BAN::Vector<Process*> s_processes;
 	static RecursiveSpinLock s_process_lock;
 
+	// Largest ioring file transfer that runs asynchronously through a kernel buffer
+	static constexpr size_t s_ioring_max_async_bytes = 1024 * 1024;
+
 	static void for_each_process(const BAN::Function<BAN::Iteration(Process&)>& callback)
 	{
 		SpinLockGuard _(s_process_lock);
@@ -790,6 +795,76 @@ namespace Kernel
 		return TRY(m_open_file_descriptors.write(fd, BAN::ByteSpan((uint8_t*)buffer, count)));
 	}
 
+	BAN::ErrorOr<long> Process::sys_readv(int fd, const iovec* iov, int iovcnt)
+	{
+		LockGuard _(m_process_lock);
+		auto buffers = TRY(spans_from_iovecs<BAN::ByteSpan>(iov, iovcnt));
+		return TRY(m_open_file_descriptors.readv(fd, buffers.span()));
+	}
+
+	BAN::ErrorOr<long> Process::sys_writev(int fd, const iovec* iov, int iovcnt)
+	{
+		LockGuard _(m_process_lock);
+		auto buffers = TRY(spans_from_iovecs<BAN::ConstByteSpan>(iov, iovcnt));
+		return TRY(m_open_file_descriptors.writev(fd, buffers.span()));
+	}
+
+	BAN::ErrorOr<long> Process::sys_preadv(int fd, const iovec* iov, int iovcnt, off_t offset)
+	{
+		if (offset < 0)
+			return BAN::Error::from_errno(EINVAL);
+
+		LockGuard _(m_process_lock);
+		auto buffers = TRY(spans_from_iovecs<BAN::ByteSpan>(iov, iovcnt));
+		auto inode = TRY(m_open_file_descriptors.inode_of(fd));
+		if (!inode->mode().ifreg() && !inode->mode().ifblk())
+			return BAN::Error::from_errno(ESPIPE);
+		const bool direct = TRY(m_open_file_descriptors.flags_of(fd)) & O_DIRECT;
+		return TRY(inode->readv(offset, buffers.span(), direct));
+	}
+
+	BAN::ErrorOr<long> Process::sys_pwritev(int fd, const iovec* iov, int iovcnt, off_t offset)
+	{
+		if (offset < 0)
+			return BAN::Error::from_errno(EINVAL);
+
+		LockGuard _(m_process_lock);
+		auto buffers = TRY(spans_from_iovecs<BAN::ConstByteSpan>(iov, iovcnt));
+		auto inode = TRY(m_open_file_descriptors.inode_of(fd));
+		if (!inode->mode().ifreg() && !inode->mode().ifblk())
+			return BAN::Error::from_errno(ESPIPE);
+		const bool direct = TRY(m_open_file_descriptors.flags_of(fd)) & O_DIRECT;
+		return TRY(inode->writev(offset, buffers.span(), direct));
+	}
+
+	BAN::ErrorOr<long> Process::sys_sendfile(int out_fd, int in_fd, off_t* offset, size_t count)
+	{
+		LockGuard _(m_process_lock);
+		if (offset)
+			TRY(validate_pointer_access(offset, sizeof(off_t)));
+		return TRY(m_open_file_descriptors.splice(in_fd, offset, out_fd, nullptr, count));
+	}
+
+	BAN::ErrorOr<long> Process::sys_splice(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t count)
+	{
+		LockGuard _(m_process_lock);
+		if (in_offset)
+			TRY(validate_pointer_access(in_offset, sizeof(off_t)));
+		if (out_offset)
+			TRY(validate_pointer_access(out_offset, sizeof(off_t)));
+		return TRY(m_open_file_descriptors.splice(in_fd, in_offset, out_fd, out_offset, count));
+	}
+
+	BAN::ErrorOr<long> Process::sys_copy_file_range(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t count)
+	{
+		LockGuard _(m_process_lock);
+		if (in_offset)
+			TRY(validate_pointer_access(in_offset, sizeof(off_t)));
+		if (out_offset)
+			TRY(validate_pointer_access(out_offset, sizeof(off_t)));
+		return TRY(m_open_file_descriptors.copy_file_range(in_fd, in_offset, out_fd, out_offset, count));
+	}
+
 	BAN::ErrorOr<long> Process::sys_create(const char* path, mode_t mode)
 	{
 		LockGuard _(m_process_lock);
@@ -875,6 +950,8 @@ namespace Kernel
 		LockGuard _(m_process_lock);
 		TRY(validate_pointer_access(buffer, count));
 		auto inode = TRY(m_open_file_descriptors.inode_of(fd));
+		if (TRY(m_open_file_descriptors.flags_of(fd)) & O_DIRECT)
+			return TRY(inode->read_direct(offset, { (uint8_t*)buffer, count }));
 		return TRY(inode->read(offset, { (uint8_t*)buffer, count }));
 	}
 
@@ -1059,6 +1136,46 @@ namespace Kernel
 		return TRY(inode->recvfrom(buffer, arguments->address, arguments->address_len));
 	}
 
+	BAN::ErrorOr<long> Process::sys_sendmsg(int socket, const msghdr* message, int)
+	{
+		LockGuard _(m_process_lock);
+		TRY(validate_pointer_access(message, sizeof(msghdr)));
+		if (message->msg_name)
+			TRY(validate_pointer_access(message->msg_name, message->msg_namelen));
+
+		auto buffers = TRY(spans_from_iovecs<BAN::ConstByteSpan>(message->msg_iov, message->msg_iovlen));
+
+		auto inode = TRY(m_open_file_descriptors.inode_of(socket));
+		if (!inode->mode().ifsock())
+			return BAN::Error::from_errno(ENOTSOCK);
+
+		const auto* address = static_cast<const sockaddr*>(message->msg_name);
+		return TRY(inode->sendmsg(buffers.span(), address, address ? message->msg_namelen : 0));
+	}
+
+	BAN::ErrorOr<long> Process::sys_recvmsg(int socket, msghdr* message, int)
+	{
+		LockGuard _(m_process_lock);
+		TRY(validate_pointer_access(message, sizeof(msghdr)));
+		if (message->msg_name)
+			TRY(validate_pointer_access(message->msg_name, message->msg_namelen));
+
+		auto buffers = TRY(spans_from_iovecs<BAN::ByteSpan>(message->msg_iov, message->msg_iovlen));
+
+		auto inode = TRY(m_open_file_descriptors.inode_of(socket));
+		if (!inode->mode().ifsock())
+			return BAN::Error::from_errno(ENOTSOCK);
+
+		auto* address = static_cast<sockaddr*>(message->msg_name);
+		const size_t nrecv = TRY(inode->recvmsg(buffers.span(), address, address ? &message->msg_namelen : nullptr));
+
+		// Ancillary data is not supported
+		message->msg_controllen = 0;
+		message->msg_flags = 0;
+
+		return nrecv;
+	}
+
 	BAN::ErrorOr<long> Process::sys_ioctl(int fildes, int request, void* arg)
 	{
 		LockGuard _(m_process_lock);
@@ -1066,6 +1183,83 @@ namespace Kernel
 		return TRY(inode->ioctl(request, arg));
 	}
 
+	// Inodes select and poll are waiting on. Waiters are registered to the
+	// inodes' wait queues for the lifetime of the list.
+	class InodeWaitList
+	{
+		BAN_NON_COPYABLE(InodeWaitList);
+		BAN_NON_MOVABLE(InodeWaitList);
+
+	public:
+		InodeWaitList() = default;
+		~InodeWaitList()
+		{
+			if (!m_registered)
+				return;
+			for (size_t i = 0; i < m_inodes.size(); i++)
+				if (m_inodes[i])
+					m_inodes[i]->remove_waiter(m_waiters[i]);
+		}
+
+		BAN::ErrorOr<void> resize(size_t count)
+		{
+			ASSERT(!m_registered);
+			TRY(m_inodes.resize(count));
+			TRY(m_waiters.resize(count));
+			return {};
+		}
+
+		BAN::RefPtr<Inode>& operator[](size_t index) { return m_inodes[index]; }
+
+		void register_waiters()
+		{
+			ASSERT(!m_registered);
+			for (size_t i = 0; i < m_inodes.size(); i++)
+			{
+				if (!m_inodes[i])
+					continue;
+				m_waiters[i].list = this;
+				m_inodes[i]->add_waiter(m_waiters[i]);
+			}
+			m_registered = true;
+		}
+
+		// Has to be called before checking readiness, so
+		// notifications during the check are not missed
+		void clear_notified()
+		{
+			m_wake_count = m_semaphore.wake_count();
+			m_notified = false;
+		}
+
+		BAN::ErrorOr<void> wait(uint64_t wake_time_ms)
+		{
+			if (m_notified)
+				return {};
+			return Thread::current().block_or_eintr_or_waketime(m_semaphore, wake_time_ms, false, m_wake_count);
+		}
+
+	private:
+		struct Waiter final : public Inode::Waiter
+		{
+			virtual void notify() override
+			{
+				list->m_notified = true;
+				list->m_semaphore.unblock();
+			}
+
+			InodeWaitList* list { nullptr };
+		};
+
+	private:
+		BAN::Vector<BAN::RefPtr<Inode>> m_inodes;
+		BAN::Vector<Waiter> m_waiters;
+		Semaphore m_semaphore;
+		uint32_t m_wake_count { 0 };
+		BAN::Atomic<bool> m_notified { false };
+		bool m_registered { false };
+	};
+
 	BAN::ErrorOr<long> Process::sys_pselect(sys_pselect_t* arguments)
 	{
 		LockGuard _(m_process_lock);
@@ -1084,21 +1278,49 @@ namespace Kernel
 
 		if (arguments->sigmask)
 			return BAN::Error::from_errno(ENOTSUP);
+		if (arguments->nfds < 0 || arguments->nfds > FD_SETSIZE)
+			return BAN::Error::from_errno(EINVAL);
 
-		uint64_t timedout_ns = SystemTimer::get().ns_since_boot();
+		uint64_t wake_time_ms = ~(uint64_t)0;
 		if (arguments->timeout)
 		{
-			timedout_ns += arguments->timeout->tv_sec * 1'000'000'000;
-			timedout_ns += arguments->timeout->tv_nsec;
+			wake_time_ms = SystemTimer::get().ms_since_boot();
+			wake_time_ms += arguments->timeout->tv_sec * 1000;
+			wake_time_ms += BAN::Math::div_round_up<uint64_t>(arguments->timeout->tv_nsec, 1'000'000);
 		}
 
-		fd_set readfds;		FD_ZERO(&readfds);
-		fd_set writefds;	FD_ZERO(&writefds);
-		fd_set errorfds;	FD_ZERO(&errorfds);
+		const auto is_fd_requested =
+			[&](int fd)
+			{
+				if (arguments->readfds && FD_ISSET(fd, arguments->readfds))
+					return true;
+				if (arguments->writefds && FD_ISSET(fd, arguments->writefds))
+					return true;
+				if (arguments->errorfds && FD_ISSET(fd, arguments->errorfds))
+					return true;
+				return false;
+			};
+
+		InodeWaitList inodes;
+		TRY(inodes.resize(arguments->nfds));
+		for (int i = 0; i < arguments->nfds; i++)
+			if (is_fd_requested(i))
+				inodes[i] = TRY(m_open_file_descriptors.inode_of(i));
+		inodes.register_waiters();
+
+		fd_set readfds;
+		fd_set writefds;
+		fd_set errorfds;
 
 		int set_bits = 0;
 		for (;;)
 		{
+			inodes.clear_notified();
+
+			FD_ZERO(&readfds);
+			FD_ZERO(&writefds);
+			FD_ZERO(&errorfds);
+
 			auto update_fds =
 				[&](int fd, fd_set* source, fd_set* dest, bool (Inode::*func)() const)
 				{
@@ -1108,12 +1330,7 @@ namespace Kernel
 					if (!FD_ISSET(fd, source))
 						return;
 
-					auto inode_or_error = m_open_file_descriptors.inode_of(fd);
-					if (inode_or_error.is_error())
-						return;
-
-					auto inode = inode_or_error.release_value();
-					if ((inode.ptr()->*func)())
+					if ((inodes[fd].ptr()->*func)())
 					{
 						FD_SET(fd, dest);
 						set_bits++;
@@ -1130,11 +1347,11 @@ namespace Kernel
 			if (set_bits > 0)
 				break;
 
-			if (arguments->timeout && SystemTimer::get().ns_since_boot() >= timedout_ns)
+			if (SystemTimer::get().ms_since_boot() >= wake_time_ms)
 				break;
 
 			LockFreeGuard free(m_process_lock);
-			SystemTimer::get().sleep(1);
+			TRY(inodes.wait(wake_time_ms));
 		}
 
 		if (arguments->readfds)
@@ -1157,6 +1374,244 @@ namespace Kernel
 		return set_bits;
 	}
 
+	BAN::ErrorOr<long> Process::sys_poll(pollfd* fds, nfds_t nfds, int timeout)
+	{
+		LockGuard _(m_process_lock);
+
+		if (nfds > OPEN_MAX)
+			return BAN::Error::from_errno(EINVAL);
+		TRY(validate_pointer_access(fds, nfds * sizeof(pollfd)));
+
+		uint64_t wake_time_ms = ~(uint64_t)0;
+		if (timeout >= 0)
+			wake_time_ms = SystemTimer::get().ms_since_boot() + timeout;
+
+		// Invalid file descriptors are reported with POLLNVAL instead of failing
+		InodeWaitList inodes;
+		TRY(inodes.resize(nfds));
+		for (nfds_t i = 0; i < nfds; i++)
+		{
+			if (fds[i].fd < 0)
+				continue;
+			if (auto inode_or_error = m_open_file_descriptors.inode_of(fds[i].fd); !inode_or_error.is_error())
+				inodes[i] = inode_or_error.release_value();
+		}
+		inodes.register_waiters();
+
+		long ready_count = 0;
+		for (;;)
+		{
+			inodes.clear_notified();
+
+			for (nfds_t i = 0; i < nfds; i++)
+			{
+				fds[i].revents = 0;
+				if (fds[i].fd < 0)
+					continue;
+
+				if (!inodes[i])
+					fds[i].revents = POLLNVAL;
+				else
+				{
+					if ((fds[i].events & (POLLIN | POLLRDNORM)) && inodes[i]->can_read())
+						fds[i].revents |= fds[i].events & (POLLIN | POLLRDNORM);
+					if ((fds[i].events & (POLLOUT | POLLWRNORM)) && inodes[i]->can_write())
+						fds[i].revents |= fds[i].events & (POLLOUT | POLLWRNORM);
+					if (inodes[i]->has_error())
+						fds[i].revents |= POLLERR;
+					if (inodes[i]->has_hungup())
+						fds[i].revents |= POLLHUP;
+				}
+
+				if (fds[i].revents)
+					ready_count++;
+			}
+
+			if (ready_count > 0)
+				break;
+
+			if (SystemTimer::get().ms_since_boot() >= wake_time_ms)
+				break;
+
+			LockFreeGuard free(m_process_lock);
+			TRY(inodes.wait(wake_time_ms));
+		}
+
+		return ready_count;
+	}
+
+	BAN::ErrorOr<long> Process::sys_epoll_create1(int flags)
+	{
+		if (flags & ~EPOLL_CLOEXEC)
+			return BAN::Error::from_errno(EINVAL);
+
+		auto epoll = TRY(Epoll::create());
+
+		LockGuard _(m_process_lock);
+		return TRY(m_open_file_descriptors.open(epoll, O_RDWR | ((flags & EPOLL_CLOEXEC) ? O_CLOEXEC : 0)));
+	}
+
+	BAN::ErrorOr<long> Process::sys_epoll_ctl(int epfd, int op, int fd, epoll_event* event)
+	{
+		LockGuard _(m_process_lock);
+
+		epoll_event event_copy {};
+		if (op != EPOLL_CTL_DEL)
+		{
+			TRY(validate_pointer_access(event, sizeof(epoll_event)));
+			event_copy = *event;
+		}
+
+		auto epoll_inode = TRY(m_open_file_descriptors.inode_of(epfd));
+		if (!epoll_inode->is_epoll())
+			return BAN::Error::from_errno(EINVAL);
+
+		// NOTE: interests of closed file descriptors can still be removed
+		BAN::RefPtr<Inode> inode;
+		if (op != EPOLL_CTL_DEL)
+			inode = TRY(m_open_file_descriptors.inode_of(fd));
+		TRY(static_cast<Epoll*>(epoll_inode.ptr())->ctl(op, fd, inode, event_copy));
+		return 0;
+	}
+
+	BAN::ErrorOr<long> Process::sys_epoll_pwait(int epfd, epoll_event* events, int maxevents, int timeout, const sigset_t* sigmask)
+	{
+		LockGuard _(m_process_lock);
+
+		if (sigmask)
+			return BAN::Error::from_errno(ENOTSUP);
+		if (maxevents <= 0)
+			return BAN::Error::from_errno(EINVAL);
+		TRY(validate_pointer_access(events, maxevents * sizeof(epoll_event)));
+
+		auto epoll_inode = TRY(m_open_file_descriptors.inode_of(epfd));
+		if (!epoll_inode->is_epoll())
+			return BAN::Error::from_errno(EINVAL);
+		auto& epoll = static_cast<Epoll&>(*epoll_inode);
+
+		uint64_t wake_time_ms = ~(uint64_t)0;
+		if (timeout >= 0)
+			wake_time_ms = SystemTimer::get().ms_since_boot() + timeout;
+
+		for (;;)
+		{
+			const size_t count = TRY(epoll.collect_events(BAN::Span<epoll_event>(events, maxevents)));
+			if (count > 0)
+				return count;
+
+			if (SystemTimer::get().ms_since_boot() >= wake_time_ms)
+				return 0;
+
+			LockFreeGuard free(m_process_lock);
+			TRY(epoll.wait_for_events(wake_time_ms));
+		}
+	}
+
+	BAN::ErrorOr<long> Process::sys_ioring_setup(ioring* ring)
+	{
+		LockGuard _(m_process_lock);
+		TRY(validate_pointer_access(ring, sizeof(ioring)));
+
+		auto ioring_inode = TRY(IORing::create(m_pid, *ring));
+		TRY(validate_ioring_access(*ioring_inode));
+
+		ring->sq_head = ring->sq_tail;
+		ring->cq_tail = ring->cq_head;
+
+		return TRY(m_open_file_descriptors.open(ioring_inode, O_RDWR | O_CLOEXEC));
+	}
+
+	BAN::ErrorOr<long> Process::sys_ioring_enter(int fd, uint32_t to_submit, uint32_t min_complete, const timespec* timeout)
+	{
+		LockGuard _(m_process_lock);
+		if (timeout)
+			TRY(validate_pointer_access(timeout, sizeof(timespec)));
+
+		auto inode = TRY(m_open_file_descriptors.inode_of(fd));
+		if (!inode->is_ioring())
+			return BAN::Error::from_errno(EINVAL);
+		auto& ring = static_cast<IORing&>(*inode);
+		if (ring.owner() != m_pid)
+			return BAN::Error::from_errno(EPERM);
+		TRY(validate_ioring_access(ring));
+
+		uint64_t wake_time_ms = ~(uint64_t)0;
+		if (timeout)
+		{
+			wake_time_ms = SystemTimer::get().ms_since_boot();
+			wake_time_ms += timeout->tv_sec * 1000;
+			wake_time_ms += BAN::Math::div_round_up<uint64_t>(timeout->tv_nsec, 1'000'000);
+		}
+
+		long submitted = 0;
+		while (static_cast<uint32_t>(submitted) < to_submit && ring.operations().size() < ring.max_operations())
+		{
+			ioring_sqe sqe;
+			if (!ring.peek_submission(sqe))
+				break;
+
+			// Entry is only consumed once it has been added, so it is not lost if adding fails
+			auto operation_or_error = ring.add_operation(sqe, ~(uint64_t)0);
+			if (operation_or_error.is_error())
+			{
+				if (submitted > 0)
+					break;
+				return operation_or_error.release_error();
+			}
+			auto* operation = operation_or_error.release_value();
+
+			ring.pop_submission();
+			submitted++;
+
+			if (sqe.opcode != IORING_OP_TIMEOUT)
+				continue;
+
+			const auto* relative = reinterpret_cast<const timespec*>(sqe.addr);
+			if (auto ret = validate_pointer_access(relative, sizeof(timespec)); ret.is_error())
+			{
+				operation->submit_error = -ret.error().get_error_code();
+				continue;
+			}
+			operation->wake_time_ms = SystemTimer::get().ms_since_boot();
+			operation->wake_time_ms += relative->tv_sec * 1000;
+			operation->wake_time_ms += BAN::Math::div_round_up<uint64_t>(relative->tv_nsec, 1'000'000);
+		}
+
+		min_complete = BAN::Math::min(min_complete, ring.cq_entries());
+
+		for (;;)
+		{
+			ring.clear_notified();
+			ring.sync_completion_head();
+			ioring_process_operations(ring);
+
+			if (ring.completion_count() >= min_complete)
+				break;
+			if (SystemTimer::get().ms_since_boot() >= wake_time_ms)
+				break;
+
+			uint64_t next_wake_ms = wake_time_ms;
+			for (auto& operation : ring.operations())
+				next_wake_ms = BAN::Math::min(next_wake_ms, operation->wake_time_ms);
+
+			{
+				LockFreeGuard free(m_process_lock);
+				if (auto ret = ring.wait(next_wake_ms); ret.is_error())
+				{
+					// Submitted entries are already consumed, so report them instead of the interrupt
+					if (submitted > 0)
+						return submitted;
+					return ret.release_error();
+				}
+			}
+
+			// Ring memory may have been unmapped while the process lock was released
+			TRY(validate_ioring_access(ring));
+		}
+
+		return submitted;
+	}
+
 	BAN::ErrorOr<long> Process::sys_pipe(int fildes[2])
 	{
 		LockGuard _(m_process_lock);
@@ -1225,8 +1680,12 @@ namespace Kernel
 	BAN::ErrorOr<long> Process::sys_fstatat(int fd, const char* path, struct stat* buf, int flag)
 	{
 		LockGuard _(m_process_lock);
+		TRY(validate_string_access(path));
 		TRY(validate_pointer_access(buf, sizeof(struct stat)));
-		TRY(m_open_file_descriptors.fstatat(fd, path, buf, flag));
+		if (fd == AT_FDCWD)
+			TRY(m_open_file_descriptors.stat(TRY(absolute_path_of(path)), buf, flag));
+		else
+			TRY(m_open_file_descriptors.fstatat(fd, path, buf, flag));
 		return 0;
 	}
 
@@ -1244,6 +1703,14 @@ namespace Kernel
 		return 0;
 	}
 
+	BAN::ErrorOr<long> Process::sys_fsync(int fd, bool data_only)
+	{
+		LockGuard _(m_process_lock);
+		auto inode = TRY(m_open_file_descriptors.inode_of(fd));
+		TRY(inode->fsync(data_only));
+		return 0;
+	}
+
 	[[noreturn]] static void reset_system()
 	{
 		ACPI::ACPI::get().reset();
@@ -2024,4 +2491,253 @@ unauthorized_access:
 		return {};
 	}
 
+	template<typename SpanT>
+	BAN::ErrorOr<BAN::Vector<SpanT>> Process::spans_from_iovecs(const iovec* iov, int iovcnt)
+	{
+		if (iovcnt < 0 || iovcnt > IOV_MAX)
+			return BAN::Error::from_errno(EINVAL);
+		TRY(validate_pointer_access(iov, iovcnt * sizeof(iovec)));
+
+		BAN::Vector<SpanT> spans;
+		TRY(spans.reserve(iovcnt));
+
+		size_t total_size = 0;
+		for (int i = 0; i < iovcnt; i++)
+		{
+			// Total size has to fit in the ssize_t return value
+			if (iov[i].iov_len > static_cast<size_t>(BAN::numeric_limits<ssize_t>::max()) - total_size)
+				return BAN::Error::from_errno(EINVAL);
+			total_size += iov[i].iov_len;
+
+			TRY(validate_pointer_access(iov[i].iov_base, iov[i].iov_len));
+			TRY(spans.push_back(SpanT(static_cast<uint8_t*>(iov[i].iov_base), iov[i].iov_len)));
+		}
+
+		return spans;
+	}
+
+	BAN::ErrorOr<void> Process::validate_ioring_access(const IORing& ring)
+	{
+		TRY(validate_pointer_access(ring.ring_memory(), sizeof(ioring)));
+		TRY(validate_pointer_access(ring.sqes_memory(), ring.sq_entries() * sizeof(ioring_sqe)));
+		TRY(validate_pointer_access(ring.cqes_memory(), ring.cq_entries() * sizeof(ioring_cqe)));
+		return {};
+	}
+
+	void Process::ioring_process_operations(IORing& ring)
+	{
+		ASSERT(m_process_lock.is_locked());
+
+		auto& operations = ring.operations();
+		const uint64_t current_ms = SystemTimer::get().ms_since_boot();
+
+		for (size_t i = 0; i < operations.size() && !ring.completion_queue_full();)
+		{
+			auto& operation = *operations[i];
+			if (!operation.notified && current_ms < operation.wake_time_ms)
+			{
+				i++;
+				continue;
+			}
+
+			int32_t result;
+			if (operation.submit_error)
+				result = operation.submit_error;
+			else if (operation.async)
+			{
+				if (!operation.async_done)
+				{
+					i++;
+					continue;
+				}
+
+				// Worker read to the kernel buffer, copy it to the process now that its memory is accessible
+				result = operation.async_result;
+				if (result > 0 && operation.sqe.opcode == IORING_OP_READ)
+				{
+					auto* buffer = reinterpret_cast<void*>(operation.sqe.addr);
+					if (validate_pointer_access(buffer, result).is_error())
+						result = -EFAULT;
+					else
+						memcpy(buffer, reinterpret_cast<void*>(operation.async_buffer->vaddr()), result);
+				}
+			}
+			else if (operation.sqe.opcode == IORING_OP_TIMEOUT)
+			{
+				if (current_ms < operation.wake_time_ms)
+				{
+					operation.notified = false;
+					i++;
+					continue;
+				}
+				result = -ETIME;
+			}
+			else if (operation.sqe.opcode == IORING_OP_CANCEL)
+			{
+				// Both the cancelled operation and this one need a completion
+				if (ring.completion_count() + 2 > ring.cq_entries())
+					break;
+
+				result = -ENOENT;
+				for (size_t j = 0; j < operations.size(); j++)
+				{
+					if (j == i || operations[j]->sqe.user_data != operation.sqe.addr)
+						continue;
+					// Operations already given to a worker run to completion
+					if (operations[j]->async)
+					{
+						result = -EALREADY;
+						break;
+					}
+					ring.post_completion(operations[j]->sqe.user_data, -ECANCELED);
+					ring.remove_operation(operations[j].ptr());
+					if (j < i)
+						i--;
+					result = 0;
+					break;
+				}
+			}
+			else
+			{
+				auto ret = ioring_execute(ring, operation);
+				if (ret.is_error() && ret.error().get_error_code() == EAGAIN && operation.waiting_on)
+				{
+					i++;
+					continue;
+				}
+				if (!ret.is_error() && operation.async)
+				{
+					i++;
+					continue;
+				}
+				result = ret.is_error() ? -ret.error().get_error_code() : ret.value();
+			}
+
+			ring.post_completion(operation.sqe.user_data, result);
+			ring.remove_operation(&operation);
+		}
+	}
+
+	BAN::ErrorOr<long> Process::ioring_execute(IORing& ring, IORing::Operation& operation)
+	{
+		const auto& sqe = operation.sqe;
+
+		// Registers the waiter before checking readiness again, so a change in between is not missed
+		const auto wait_until_ready =
+			[&](BAN::RefPtr<Inode> inode, bool for_write) -> BAN::ErrorOr<void>
+			{
+				const auto is_ready = [&] { return for_write ? inode->can_write() : inode->can_read(); };
+				if (is_ready())
+					return {};
+				ring.start_waiting(operation, inode);
+				if (is_ready())
+					return {};
+				return BAN::Error::from_errno(EAGAIN);
+			};
+
+		if (sqe.len > INT32_MAX)
+			return BAN::Error::from_errno(EINVAL);
+		auto* buffer = reinterpret_cast<uint8_t*>(sqe.addr);
+
+		switch (sqe.opcode)
+		{
+			case IORING_OP_NOP:
+				return 0;
+			case IORING_OP_READ:
+			case IORING_OP_WRITE:
+			{
+				const bool is_write = (sqe.opcode == IORING_OP_WRITE);
+				const off_t offset = static_cast<off_t>(sqe.off);
+				if (offset < -1)
+					return BAN::Error::from_errno(EINVAL);
+
+				auto inode = TRY(m_open_file_descriptors.inode_of(sqe.fd));
+				const int flags = TRY(m_open_file_descriptors.flags_of(sqe.fd));
+				if (!(flags & (is_write ? O_WRONLY : O_RDONLY)))
+					return BAN::Error::from_errno(EBADF);
+
+				TRY(wait_until_ready(inode, is_write));
+				TRY(validate_pointer_access(buffer, sqe.len));
+
+				if (offset == -1)
+				{
+					if (is_write)
+						return TRY(m_open_file_descriptors.write(sqe.fd, BAN::ConstByteSpan(buffer, sqe.len)));
+					return TRY(m_open_file_descriptors.read(sqe.fd, BAN::ByteSpan(buffer, sqe.len)));
+				}
+
+				// Files may have to wait for the disk, run them on a worker through a kernel buffer.
+				// Larger transfers would pin too much memory, they run synchronously.
+				if ((inode->mode().ifreg() || inode->mode().ifblk()) && sqe.len > 0 && sqe.len <= s_ioring_max_async_bytes)
+				{
+					operation.async_buffer = TRY(VirtualRange::create_to_vaddr_range(
+						PageTable::kernel(),
+						KERNEL_OFFSET,
+						~(uintptr_t)0,
+						BAN::Math::div_round_up<size_t>(sqe.len, PAGE_SIZE) * PAGE_SIZE,
+						PageTable::Flags::ReadWrite | PageTable::Flags::Present,
+						true
+					));
+					if (is_write)
+						memcpy(reinterpret_cast<void*>(operation.async_buffer->vaddr()), buffer, sqe.len);
+					TRY(ring.start_async_io(operation, inode, is_write, flags & O_DIRECT, offset, sqe.len));
+					return 0;
+				}
+
+				if (flags & O_DIRECT)
+				{
+					if (is_write)
+						return TRY(inode->write_direct(offset, BAN::ConstByteSpan(buffer, sqe.len)));
+					return TRY(inode->read_direct(offset, BAN::ByteSpan(buffer, sqe.len)));
+				}
+				if (is_write)
+					return TRY(inode->write(offset, BAN::ConstByteSpan(buffer, sqe.len)));
+				return TRY(inode->read(offset, BAN::ByteSpan(buffer, sqe.len)));
+			}
+			case IORING_OP_SEND:
+			case IORING_OP_RECV:
+			{
+				const bool is_send = (sqe.opcode == IORING_OP_SEND);
+				auto inode = TRY(m_open_file_descriptors.inode_of(sqe.fd));
+				if (!inode->mode().ifsock())
+					return BAN::Error::from_errno(ENOTSOCK);
+
+				TRY(wait_until_ready(inode, is_send));
+				TRY(validate_pointer_access(buffer, sqe.len));
+
+				if (is_send)
+					return TRY(inode->sendto(BAN::ConstByteSpan(buffer, sqe.len), nullptr, 0));
+				return TRY(inode->recvfrom(BAN::ByteSpan(buffer, sqe.len), nullptr, nullptr));
+			}
+			case IORING_OP_ACCEPT:
+			{
+				auto* address = reinterpret_cast<sockaddr*>(sqe.addr);
+				auto* address_len = reinterpret_cast<socklen_t*>(sqe.addr2);
+				if (!address != !address_len)
+					return BAN::Error::from_errno(EINVAL);
+
+				auto inode = TRY(m_open_file_descriptors.inode_of(sqe.fd));
+				if (!inode->mode().ifsock())
+					return BAN::Error::from_errno(ENOTSOCK);
+
+				TRY(wait_until_ready(inode, false));
+				if (address)
+				{
+					TRY(validate_pointer_access(address_len, sizeof(*address_len)));
+					TRY(validate_pointer_access(address, *address_len));
+				}
+
+				return TRY(inode->accept(address, address_len));
+			}
+			case IORING_OP_FSYNC:
+			{
+				auto inode = TRY(m_open_file_descriptors.inode_of(sqe.fd));
+				TRY(inode->fsync(sqe.op_flags & IORING_FSYNC_DATASYNC));
+				return 0;
+			}
+		}
+
+		return BAN::Error::from_errno(EINVAL);
+	}
+
 }
@@ -1,16 +1,39 @@
+#include <kernel/CPUID.h>
 #include <kernel/Memory/kmalloc.h>
 #include <kernel/Processor.h>
 #include <kernel/Thread.h>
 
+extern "C" void asm_fast_syscall_handler();
+
 namespace Kernel
 {
 
+	static constexpr uint32_t MSR_IA32_SYSENTER_CS = 0x174;
+	static constexpr uint32_t MSR_IA32_SYSENTER_ESP = 0x175;
+	static constexpr uint32_t MSR_IA32_SYSENTER_EIP = 0x176;
+	static constexpr uint32_t MSR_IA32_EFER = 0xC0000080;
+	static constexpr uint32_t MSR_IA32_STAR = 0xC0000081;
+	static constexpr uint32_t MSR_IA32_LSTAR = 0xC0000082;
+	static constexpr uint32_t MSR_IA32_FMASK = 0xC0000084;
 	static constexpr uint32_t MSR_IA32_GS_BASE = 0xC0000101;
 
 	ProcessorID Processor::s_bsb_id { PROCESSOR_NONE };
+	uint8_t Processor::s_processor_count { 0 };
 
 	static BAN::Array<Processor, 0xFF> s_processors;
 
+	static uint64_t read_msr(uint32_t msr)
+	{
+		uint32_t hi, lo;
+		asm volatile("rdmsr" : "=d"(hi), "=a"(lo) : "c"(msr));
+		return (static_cast<uint64_t>(hi) << 32) | lo;
+	}
+
+	static void write_msr(uint32_t msr, uint64_t value)
+	{
+		asm volatile("wrmsr" :: "d"(static_cast<uint32_t>(value >> 32)), "a"(static_cast<uint32_t>(value)), "c"(msr));
+	}
+
 	static ProcessorID read_processor_id()
 	{
 		uint32_t id;
@@ -34,6 +57,7 @@ namespace Kernel
 
 		ASSERT(processor.m_id == PROCESSOR_NONE);
 		processor.m_id = id;
+		s_processor_count++;
 
 		processor.m_stack = kmalloc(s_stack_size, 4096, true);
 		ASSERT(processor.m_stack);
@@ -58,10 +82,7 @@ namespace Kernel
 		// initialize GS
 #if ARCH(x86_64)
 		// set gs base to pointer to this processor
-		uint64_t ptr = reinterpret_cast<uint64_t>(&processor);
-		uint32_t ptr_hi = ptr >> 32;
-		uint32_t ptr_lo = ptr & 0xFFFFFFFF;
-		asm volatile("wrmsr" :: "d"(ptr_hi), "a"(ptr_lo), "c"(MSR_IA32_GS_BASE));
+		write_msr(MSR_IA32_GS_BASE, reinterpret_cast<uint64_t>(&processor));
 #elif ARCH(i686)
 		asm volatile("movw $0x28, %%ax; movw %%ax, %%gs" ::: "ax");
 #endif
@@ -69,9 +90,47 @@ namespace Kernel
 		ASSERT(processor.m_idt);
 		processor.idt().load();
 
+		initialize_fast_syscall();
+
 		return processor;
 	}
 
+	void Processor::initialize_fast_syscall()
+	{
+#if ARCH(x86_64)
+		static_assert(offsetof(Processor, m_syscall_stack) == 8);
+		static_assert(offsetof(Processor, m_syscall_user_sp) == 16);
+
+		// syscall loads kernel code and data segments from 0x08 and 0x10,
+		// sysret user data and code segments from 0x18 and 0x20
+		write_msr(MSR_IA32_STAR, (static_cast<uint64_t>(0x10 | 3) << 48) | (static_cast<uint64_t>(0x08) << 32));
+		write_msr(MSR_IA32_LSTAR, reinterpret_cast<uint64_t>(asm_fast_syscall_handler));
+		// clear TF, IF, DF, NT and AC on entry
+		write_msr(MSR_IA32_FMASK, 0x00044700);
+		write_msr(MSR_IA32_EFER, read_msr(MSR_IA32_EFER) | 1);
+#elif ARCH(i686)
+		uint32_t ecx, edx;
+		CPUID::get_features(ecx, edx);
+		if (!(edx & CPUID::Features::EDX_SEP))
+			Kernel::panic("Processor does not support sysenter");
+
+		// sysenter loads kernel code and data segments from 0x08 and 0x10,
+		// sysexit user code and data segments from 0x18 and 0x20
+		write_msr(MSR_IA32_SYSENTER_CS, 0x08);
+		write_msr(MSR_IA32_SYSENTER_EIP, reinterpret_cast<uintptr_t>(asm_fast_syscall_handler));
+#endif
+	}
+
+	void Processor::set_syscall_stack(uintptr_t sp)
+	{
+		if (read_gs_sized<uintptr_t>(offsetof(Processor, m_syscall_stack)) == sp)
+			return;
+		write_gs_sized<uintptr_t>(offsetof(Processor, m_syscall_stack), sp);
+#if ARCH(i686)
+		write_msr(MSR_IA32_SYSENTER_ESP, sp);
+#endif
+	}
+
 	void Processor::allocate_idle_thread()
 	{
 		ASSERT(idle_thread() == nullptr);
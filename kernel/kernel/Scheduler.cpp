@@ -76,15 +76,18 @@ namespace Kernel
 					thread->interrupt_registers() = Processor::get_interrupt_registers();
 				}
 
-				if (current->should_block)
-				{
-					current->should_block = false;
+				// The semaphore may have been unblocked after the thread
+				// released the lock, but before it got here
+				bool should_block = current->should_block;
+				if (should_block && current->check_wake_count && current->semaphore->m_wake_count != current->wake_count)
+					should_block = false;
+				current->should_block = false;
+				current->check_wake_count = false;
+
+				if (should_block)
 					m_blocking_threads.add_with_wake_time(current);
-				}
 				else
-				{
 					m_active_threads.push_back(current);
-				}
 			}
 		}
 
@@ -114,6 +117,7 @@ namespace Kernel
 			thread->m_state = Thread::State::Executing;
 
 		Processor::gdt().set_tss_stack(thread->kernel_stack_top());
+		Processor::set_syscall_stack(thread->kernel_stack_top());
 		Processor::get_interrupt_stack() = thread->interrupt_stack();
 		Processor::get_interrupt_registers() = thread->interrupt_registers();
 	}
@@ -219,14 +223,22 @@ namespace Kernel
 		Processor::set_interrupt_state(state);
 	}
 
-	void Scheduler::set_current_thread_sleeping_impl(Semaphore* semaphore, uint64_t wake_time)
+	void Scheduler::set_current_thread_sleeping_impl(Semaphore* semaphore, uint64_t wake_time, bool check_wake_count, uint32_t wake_count)
 	{
 		auto state = m_lock.lock();
 
+		if (check_wake_count && semaphore->m_wake_count != wake_count)
+		{
+			m_lock.unlock(state);
+			return;
+		}
+
 		auto* current = Processor::get_current_thread();
 		current->semaphore = semaphore;
 		current->wake_time = wake_time;
 		current->should_block = true;
+		current->check_wake_count = check_wake_count;
+		current->wake_count = wake_count;
 
 		m_lock.unlock(InterruptState::Disabled);
 
@@ -237,17 +249,23 @@ namespace Kernel
 
 	void Scheduler::set_current_thread_sleeping(uint64_t wake_time)
 	{
-		set_current_thread_sleeping_impl(nullptr, wake_time);
+		set_current_thread_sleeping_impl(nullptr, wake_time, false, 0);
 	}
 
 	void Scheduler::block_current_thread(Semaphore* semaphore, uint64_t wake_time)
 	{
-		set_current_thread_sleeping_impl(semaphore, wake_time);
+		set_current_thread_sleeping_impl(semaphore, wake_time, false, 0);
+	}
+
+	void Scheduler::block_current_thread(Semaphore* semaphore, uint64_t wake_time, uint32_t wake_count)
+	{
+		set_current_thread_sleeping_impl(semaphore, wake_time, true, wake_count);
 	}
 
 	void Scheduler::unblock_threads(Semaphore* semaphore)
 	{
 		SpinLockGuard _(m_lock);
+		semaphore->m_wake_count++;
 		m_blocking_threads.remove_with_condition(m_active_threads, [&](auto* node) { return node->semaphore == semaphore; });
 	}
 
@@ -20,6 +20,11 @@ namespace Kernel
 		Scheduler::get().block_current_thread(this, wake_time);
 	}
 
+	void Semaphore::block_with_wake_time(uint64_t wake_time, uint32_t wake_count)
+	{
+		Scheduler::get().block_current_thread(this, wake_time, wake_count);
+	}
+
 	void Semaphore::unblock()
 	{
 		Scheduler::get().unblock_threads(this);
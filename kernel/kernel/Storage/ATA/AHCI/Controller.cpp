@@ -31,6 +31,7 @@ namespace Kernel
 		abar_mem.ghc = abar_mem.ghc | SATA_GHC_INTERRUPT_ENABLE;
 
 		m_command_slot_count = ((abar_mem.cap >> 8) & 0x1F) + 1;
+		m_supports_ncq = abar_mem.cap & SATA_CAP_SUPPORTS_NCQ;
 
 		uint32_t pi = abar_mem.pi;
 		for (uint32_t i = 0; i < 32 && pi; i++, pi >>= 1)
@@ -1,3 +1,5 @@
+#include <BAN/Limits.h>
+#include <kernel/Memory/PageTable.h>
 #include <kernel/Scheduler.h>
 #include <kernel/Storage/ATA/AHCI/Controller.h>
 #include <kernel/Storage/ATA/AHCI/Device.h>
@@ -9,6 +11,7 @@ namespace Kernel
 {
 
 	static constexpr uint64_t s_ata_timeout = 1000;
+	static constexpr uint64_t s_hba_prd_max_bytes = 4 * 1024 * 1024;
 
 	static void start_cmd(volatile HBAPortMemorySpace* port)
 	{
@@ -43,7 +46,19 @@ namespace Kernel
 		m_port->ie = 0xFFFFFFFF;
 
 		TRY(read_identify_data());
-		TRY(detail::ATABaseDevice::initialize({ (const uint16_t*)m_data_dma_region->vaddr(), m_data_dma_region->size() / sizeof(uint16_t) }));
+
+		const auto* identify_data = reinterpret_cast<const uint16_t*>(m_data_dma_region->vaddr());
+		const uint16_t sata_capabilities = identify_data[ATA_IDENTIFY_SATA_CAPABILITIES];
+		if (m_controller->supports_ncq() && sata_capabilities != 0xFFFF && (sata_capabilities & ATA_SATA_CAPABILITIES_NCQ))
+		{
+			m_ncq_enabled = true;
+			m_queue_depth = BAN::Math::min<uint32_t>((identify_data[ATA_IDENTIFY_QUEUE_DEPTH] & 0x1F) + 1, m_controller->command_slot_count());
+		}
+
+		TRY(detail::ATABaseDevice::initialize({ identify_data, m_data_dma_region->size() / sizeof(uint16_t) }));
+
+		if (m_ncq_enabled)
+			dprintln("  using NCQ with queue depth {}", m_queue_depth);
 
 		return {};
 	}
@@ -56,7 +71,7 @@ namespace Kernel
 		m_dma_region = TRY(DMARegion::create(needed_bytes));
 		memset((void*)m_dma_region->vaddr(), 0x00, m_dma_region->size());
 
-		m_data_dma_region = TRY(DMARegion::create(PAGE_SIZE));
+		m_data_dma_region = TRY(DMARegion::create(command_slot_count * PAGE_SIZE));
 		memset((void*)m_data_dma_region->vaddr(), 0x00, m_data_dma_region->size());
 
 		return {};
@@ -93,23 +108,34 @@ namespace Kernel
 		return {};
 	}
 
+	volatile HBACommandHeader& AHCIDevice::command_header(uint32_t slot)
+	{
+		return reinterpret_cast<volatile HBACommandHeader*>(m_dma_region->paddr_to_vaddr(m_port->clb))[slot];
+	}
+
+	volatile HBACommandTable& AHCIDevice::command_table(uint32_t slot)
+	{
+		return *reinterpret_cast<volatile HBACommandTable*>(m_dma_region->paddr_to_vaddr(command_header(slot).ctba));
+	}
+
 	BAN::ErrorOr<void> AHCIDevice::read_identify_data()
 	{
 		ASSERT(m_data_dma_region);
 
 		m_port->is = ~(uint32_t)0;
 
-		auto slot = find_free_command_slot();
+		auto slot = reserve_command_slot(true);
 		ASSERT(slot.has_value());
 
-		volatile auto& command_header = reinterpret_cast<volatile HBACommandHeader*>(m_dma_region->paddr_to_vaddr(m_port->clb))[slot.value()];
+		volatile auto& command_header = this->command_header(slot.value());
 		command_header.cfl = sizeof(FISRegisterH2D) / sizeof(uint32_t);
 		command_header.w = 0;
 		command_header.prdtl = 1;
 
-		volatile auto& command_table = *reinterpret_cast<volatile HBACommandTable*>(m_dma_region->paddr_to_vaddr(command_header.ctba));
+		volatile auto& command_table = this->command_table(slot.value());
 		memset(const_cast<HBACommandTable*>(&command_table), 0x00, sizeof(HBACommandTable));
-		command_table.prdt_entry[0].dba = m_data_dma_region->paddr();
+		command_table.prdt_entry[0].dba = m_data_dma_region->paddr() & 0xFFFFFFFF;
+		command_table.prdt_entry[0].dbau = m_data_dma_region->paddr() >> 32;
 		command_table.prdt_entry[0].dbc = 511;
 		command_table.prdt_entry[0].i = 1;
 
@@ -120,14 +146,18 @@ namespace Kernel
 
 		uint64_t timeout = SystemTimer::get().ms_since_boot() + s_ata_timeout;
 		while (m_port->tfd & (ATA_STATUS_BSY | ATA_STATUS_DRQ))
-			if (SystemTimer::get().ms_since_boot() >= timeout)
-				return BAN::Error::from_errno(ETIMEDOUT);
-
-		m_port->ci = 1 << slot.value();
+		{
+			if (SystemTimer::get().ms_since_boot() < timeout)
+				continue;
+			release_command_slot(slot.value());
+			return BAN::Error::from_errno(ETIMEDOUT);
+		}
 
-		TRY(block_until_command_completed(slot.value()));
+		issue_command(slot.value(), false);
 
-		return {};
+		auto ret = block_until_command_completed(slot.value());
+		release_command_slot(slot.value());
+		return ret;
 	}
 
 	static void print_error(uint16_t error)
@@ -149,79 +179,244 @@ namespace Kernel
 
 	void AHCIDevice::handle_irq()
 	{
-		uint16_t err = m_port->serr & 0xFFFF;
-		if (err)
+		const uint32_t is = m_port->is;
+		m_port->is = is;
+
+		if (uint16_t err = m_port->serr & 0xFFFF)
+		{
 			print_error(err);
+			m_port->serr = m_port->serr;
+		}
+
+		if (is & HBA_PxIS_ERROR)
+		{
+			dwarnln("AHCI port error (is {8H}, tfd {8H})", is, static_cast<uint32_t>(m_port->tfd));
+
+			SpinLockGuard _(m_slot_lock);
+
+			// Commands still active on the port were aborted by the error,
+			// restart the command engine so new commands can be issued.
+			const uint32_t active = m_port->sact | m_port->ci;
+			m_error_slots |= m_issued_slots & active;
+			m_done_slots |= m_issued_slots;
+			m_issued_slots = 0;
+
+			stop_cmd(m_port);
+			m_port->is = ~(uint32_t)0;
+			start_cmd(m_port);
+		}
+		else
+		{
+			update_completed_slots();
+		}
+
+		m_slot_semaphore.unblock();
 	}
 
-	BAN::ErrorOr<void> AHCIDevice::block_until_command_completed(uint32_t command_slot)
+	void AHCIDevice::update_completed_slots()
 	{
-		static constexpr uint64_t poll_timeout_ms = 10;
+		SpinLockGuard _(m_slot_lock);
+
+		// NCQ commands are completed when their bit is cleared from SACT,
+		// non-queued commands when their bit is cleared from CI.
+		const uint32_t active = m_port->sact | m_port->ci;
+		const uint32_t completed = m_issued_slots & ~active;
+		m_issued_slots &= ~completed;
+		m_done_slots |= completed;
+	}
 
-		auto start_time = SystemTimer::get().ms_since_boot();
+	void AHCIDevice::abort_issued_commands()
+	{
+		{
+			SpinLockGuard _(m_slot_lock);
 
-		while (SystemTimer::get().ms_since_boot() < start_time + poll_timeout_ms)
-			if (!(m_port->ci & (1 << command_slot)))
-				return {};
+			// Clearing PxCMD.ST clears PxCI and PxSACT once PxCMD.CR is cleared,
+			// after that the HBA no longer accesses any of the command buffers.
+			stop_cmd(m_port);
+
+			m_error_slots |= m_issued_slots;
+			m_done_slots |= m_issued_slots;
+			m_issued_slots = 0;
+
+			m_port->serr = m_port->serr;
+			m_port->is = ~(uint32_t)0;
+			start_cmd(m_port);
+		}
+
+		m_slot_semaphore.unblock();
+	}
 
-		// FIXME: This should actually block once semaphores support blocking with timeout.
-		//        This doesn't allow scheduler to go properly idle.
-		while (SystemTimer::get().ms_since_boot() < start_time + s_ata_timeout)
+	BAN::Optional<uint32_t> AHCIDevice::reserve_command_slot(bool blocking)
+	{
+		for (;;)
 		{
-			Scheduler::get().yield();
-			if (!(m_port->ci & (1 << command_slot)))
+			const uint32_t wake_count = m_slot_semaphore.wake_count();
+
+			{
+				SpinLockGuard _(m_slot_lock);
+				for (uint32_t i = 0; i < m_queue_depth; i++)
+				{
+					if (m_used_slots & (1u << i))
+						continue;
+					m_used_slots |= 1u << i;
+					return i;
+				}
+			}
+
+			if (!blocking)
 				return {};
-		}
 
-		return BAN::Error::from_errno(ETIMEDOUT);
+			m_slot_semaphore.block_with_wake_time(BAN::numeric_limits<uint64_t>::max(), wake_count);
+		}
 	}
 
-	BAN::ErrorOr<void> AHCIDevice::read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer)
+	void AHCIDevice::release_command_slot(uint32_t slot)
 	{
-		ASSERT(buffer.size() >= sector_count * sector_size());
-		const size_t sectors_per_page = PAGE_SIZE / sector_size();
-		for (uint64_t sector_off = 0; sector_off < sector_count; sector_off += sectors_per_page)
 		{
-			uint64_t to_read = BAN::Math::min<uint64_t>(sector_count - sector_off, sectors_per_page);
+			SpinLockGuard _(m_slot_lock);
+			ASSERT(m_used_slots & (1u << slot));
+			m_used_slots &= ~(1u << slot);
+		}
+		m_slot_semaphore.unblock();
+	}
 
-			TRY(send_command_and_block(lba + sector_off, to_read, Command::Read));
-			memcpy(buffer.data() + sector_off * sector_size(), (void*)m_data_dma_region->vaddr(), to_read * sector_size());
+	void AHCIDevice::issue_command(uint32_t slot, bool queued)
+	{
+		const uint32_t slot_mask = 1u << slot;
+
+		SpinLockGuard _(m_slot_lock);
+		ASSERT(!(m_issued_slots & slot_mask));
+
+		m_done_slots &= ~slot_mask;
+		m_error_slots &= ~slot_mask;
+		m_issued_slots |= slot_mask;
+
+		if (queued)
+			m_port->sact = slot_mask;
+		m_port->ci = slot_mask;
+	}
+
+	BAN::ErrorOr<void> AHCIDevice::block_until_command_completed(uint32_t command_slot)
+	{
+		static constexpr uint64_t poll_timeout_ms = 10;
+
+		const uint32_t slot_mask = 1u << command_slot;
+
+		auto start_time = SystemTimer::get().ms_since_boot();
+
+		while (!(m_done_slots & slot_mask) && SystemTimer::get().ms_since_boot() < start_time + poll_timeout_ms)
+			update_completed_slots();
+
+		const uint64_t timeout_time = start_time + s_ata_timeout;
+		for (;;)
+		{
+			const uint32_t wake_count = m_slot_semaphore.wake_count();
+			update_completed_slots();
+			if ((m_done_slots & slot_mask) || SystemTimer::get().ms_since_boot() >= timeout_time)
+				break;
+			m_slot_semaphore.block_with_wake_time(timeout_time, wake_count);
 		}
 
+		if (!(m_done_slots & slot_mask))
+		{
+			// The slot can't be released while the HBA may still transfer to its buffer
+			dwarnln("AHCI command timed out, resetting port");
+			abort_issued_commands();
+			return BAN::Error::from_errno(ETIMEDOUT);
+		}
+		if (m_error_slots & slot_mask)
+			return BAN::Error::from_errno(EIO);
 		return {};
 	}
 
-	BAN::ErrorOr<void> AHCIDevice::write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan buffer)
+	uint64_t AHCIDevice::prepare_direct_prdt(uint32_t slot, vaddr_t buffer, uint64_t sector_count)
 	{
-		ASSERT(buffer.size() >= sector_count * sector_size());
-		const size_t sectors_per_page = PAGE_SIZE / sector_size();
-		for (uint64_t sector_off = 0; sector_off < sector_count; sector_off += sectors_per_page)
+		// Only kernel memory is guaranteed to stay mapped during the transfer
+		if (buffer < KERNEL_OFFSET || buffer % 2)
+			return 0;
+
+		volatile auto& command_table = this->command_table(slot);
+
+		const uint64_t total_bytes = sector_count * sector_size();
+
+		uint64_t bytes = 0;
+		uint32_t prdt_count = 0;
+		paddr_t prdt_end = 0;
+		while (bytes < total_bytes)
 		{
-			uint64_t to_read = BAN::Math::min<uint64_t>(sector_count - sector_off, sectors_per_page);
+			const vaddr_t vaddr = buffer + bytes;
+			const paddr_t page_paddr = PageTable::kernel().physical_address_of(vaddr & PAGE_ADDR_MASK);
+			if (page_paddr == 0)
+				break;
 
-			memcpy((void*)m_data_dma_region->vaddr(), buffer.data() + sector_off * sector_size(), to_read * sector_size());
-			TRY(send_command_and_block(lba + sector_off, to_read, Command::Write));
+			const paddr_t paddr = page_paddr + vaddr % PAGE_SIZE;
+			const uint64_t length = BAN::Math::min<uint64_t>(PAGE_SIZE - vaddr % PAGE_SIZE, total_bytes - bytes);
+
+			if (prdt_count > 0 && paddr == prdt_end && command_table.prdt_entry[prdt_count - 1].dbc + 1 + length <= s_hba_prd_max_bytes)
+				command_table.prdt_entry[prdt_count - 1].dbc = command_table.prdt_entry[prdt_count - 1].dbc + length;
+			else
+			{
+				if (prdt_count >= s_hba_prdt_count)
+					break;
+				volatile auto& prdt_entry = command_table.prdt_entry[prdt_count++];
+				prdt_entry.dba = paddr & 0xFFFFFFFF;
+				prdt_entry.dbau = static_cast<uint64_t>(paddr) >> 32;
+				prdt_entry.__reserved0 = 0;
+				prdt_entry.dbc = length - 1;
+				prdt_entry.i = 0;
+			}
+
+			prdt_end = paddr + length;
+			bytes += length;
 		}
 
-		return {};
+		// Drop partial sector from the end of the list
+		uint64_t excess = bytes % sector_size();
+		while (excess > 0)
+		{
+			volatile auto& prdt_entry = command_table.prdt_entry[prdt_count - 1];
+			const uint64_t length = prdt_entry.dbc + 1;
+			if (length > excess)
+			{
+				prdt_entry.dbc = length - excess - 1;
+				break;
+			}
+			excess -= length;
+			prdt_count--;
+		}
+
+		if (bytes < sector_size())
+			return 0;
+
+		command_table.prdt_entry[prdt_count - 1].i = 1;
+		command_header(slot).prdtl = prdt_count;
+
+		return bytes / sector_size();
 	}
 
-	BAN::ErrorOr<void> AHCIDevice::send_command_and_block(uint64_t lba, uint64_t sector_count, Command command)
+	uint64_t AHCIDevice::prepare_bounce_prdt(uint32_t slot, uint64_t sector_count)
 	{
-		ASSERT(m_dma_region);
-		ASSERT(m_data_dma_region);
-		ASSERT(0 < sector_count && sector_count <= 0xFFFF + 1);
+		const uint64_t count = BAN::Math::min<uint64_t>(sector_count, PAGE_SIZE / sector_size());
+		const paddr_t paddr = m_data_dma_region->vaddr_to_paddr(bounce_buffer_of(slot));
 
-		ASSERT(sector_count * sector_size() <= m_data_dma_region->size());
+		volatile auto& prdt_entry = command_table(slot).prdt_entry[0];
+		prdt_entry.dba = paddr & 0xFFFFFFFF;
+		prdt_entry.dbau = static_cast<uint64_t>(paddr) >> 32;
+		prdt_entry.__reserved0 = 0;
+		prdt_entry.dbc = count * sector_size() - 1;
+		prdt_entry.i = 1;
 
-		m_port->is = ~(uint32_t)0;
+		command_header(slot).prdtl = 1;
 
-		auto slot = find_free_command_slot();
-		ASSERT(slot.has_value());
+		return count;
+	}
 
-		volatile auto& command_header = reinterpret_cast<volatile HBACommandHeader*>(m_dma_region->paddr_to_vaddr(m_port->clb))[slot.value()];
+	void AHCIDevice::prepare_command_fis(uint32_t slot, uint64_t lba, uint64_t sector_count, Command command)
+	{
+		ASSERT(0 < sector_count && sector_count <= 0xFFFF + 1);
+
+		volatile auto& command_header = this->command_header(slot);
 		command_header.cfl = sizeof(FISRegisterH2D) / sizeof(uint32_t);
-		command_header.prdtl = 1;
 		switch (command)
 		{
 			case Command::Read:
@@ -234,32 +429,49 @@ namespace Kernel
 				ASSERT_NOT_REACHED();
 		}
 
-		volatile auto& command_table = *reinterpret_cast<HBACommandTable*>(m_dma_region->paddr_to_vaddr(command_header.ctba));
-		memset(const_cast<HBACommandTable*>(&command_table), 0x00, sizeof(HBACommandTable));
-		uint64_t data_dma_paddr64 = m_data_dma_region->paddr();
-		command_table.prdt_entry[0].dba = data_dma_paddr64 & 0xFFFFFFFF;
-		command_table.prdt_entry[0].dbau = data_dma_paddr64 >> 32;
-		command_table.prdt_entry[0].dbc = sector_count * sector_size() - 1;
-		command_table.prdt_entry[0].i = 1;
-
-		volatile auto& fis_command = *reinterpret_cast<volatile FISRegisterH2D*>(command_table.cfis);
+		volatile auto& fis_command = *reinterpret_cast<volatile FISRegisterH2D*>(command_table(slot).cfis);
 		memset(const_cast<FISRegisterH2D*>(&fis_command), 0x00, sizeof(FISRegisterH2D));
 		fis_command.fis_type = FIS_TYPE_REGISTER_H2D;
 		fis_command.c = 1;
 
-		bool need_extended = lba >= (1 << 28) || sector_count > 0xFF;
-		ASSERT (!need_extended || (m_command_set & ATA_COMMANDSET_LBA48_SUPPORTED));
-
-		switch (command)
+		if (m_ncq_enabled)
 		{
-			case Command::Read:
-				fis_command.command = need_extended ? ATA_COMMAND_READ_DMA_EXT : ATA_COMMAND_READ_DMA;
-				break;
-			case Command::Write:
-				fis_command.command = need_extended ? ATA_COMMAND_WRITE_DMA_EXT : ATA_COMMAND_WRITE_DMA;
-				break;
-			default:
-				ASSERT_NOT_REACHED();
+			switch (command)
+			{
+				case Command::Read:
+					fis_command.command = ATA_COMMAND_READ_FPDMA_QUEUED;
+					break;
+				case Command::Write:
+					fis_command.command = ATA_COMMAND_WRITE_FPDMA_QUEUED;
+					break;
+				default:
+					ASSERT_NOT_REACHED();
+			}
+
+			// NCQ commands take sector count in features and tag in count
+			fis_command.feature_lo = (sector_count >> 0) & 0xFF;
+			fis_command.feature_hi = (sector_count >> 8) & 0xFF;
+			fis_command.count_lo = slot << 3;
+		}
+		else
+		{
+			bool need_extended = lba >= (1 << 28) || sector_count > 0xFF;
+			ASSERT (!need_extended || (m_command_set & ATA_COMMANDSET_LBA48_SUPPORTED));
+
+			switch (command)
+			{
+				case Command::Read:
+					fis_command.command = need_extended ? ATA_COMMAND_READ_DMA_EXT : ATA_COMMAND_READ_DMA;
+					break;
+				case Command::Write:
+					fis_command.command = need_extended ? ATA_COMMAND_WRITE_DMA_EXT : ATA_COMMAND_WRITE_DMA;
+					break;
+				default:
+					ASSERT_NOT_REACHED();
+			}
+
+			fis_command.count_lo = (sector_count >> 0) & 0xFF;
+			fis_command.count_hi = (sector_count >> 8) & 0xFF;
 		}
 
 		fis_command.lba0 = (lba >>  0) & 0xFF;
@@ -270,27 +482,92 @@ namespace Kernel
 		fis_command.lba3 = (lba >> 24) & 0xFF;
 		fis_command.lba4 = (lba >> 32) & 0xFF;
 		fis_command.lba5 = (lba >> 40) & 0xFF;
+	}
 
-		fis_command.count_lo = (sector_count >> 0) & 0xFF;
-		fis_command.count_hi = (sector_count >> 8) & 0xFF;
+	BAN::ErrorOr<void> AHCIDevice::read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= sector_count * sector_size());
+		return transfer_sectors(lba, sector_count, buffer.data(), Command::Read);
+	}
 
-		while (m_port->tfd & (ATA_STATUS_BSY | ATA_STATUS_DRQ))
-			continue;
+	BAN::ErrorOr<void> AHCIDevice::write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= sector_count * sector_size());
+		return transfer_sectors(lba, sector_count, const_cast<uint8_t*>(buffer.data()), Command::Write);
+	}
 
-		m_port->ci = 1 << slot.value();
+	BAN::ErrorOr<void> AHCIDevice::transfer_sectors(uint64_t lba, uint64_t sector_count, uint8_t* buffer, Command command)
+	{
+		ASSERT(m_dma_region);
+		ASSERT(m_data_dma_region);
 
-		TRY(block_until_command_completed(slot.value()));
+		const uint64_t max_sectors_per_command = (m_ncq_enabled || (m_command_set & ATA_COMMANDSET_LBA48_SUPPORTED)) ? 0xFFFF : 0xFF;
 
-		return {};
-	}
+		// Split the transfer into commands and keep up to s_max_pending_commands
+		// of them outstanding. Without NCQ queue depth is 1 and commands are
+		// executed one at a time.
+		static constexpr size_t s_max_pending_commands = 8;
+		PendingCommand pending[s_max_pending_commands];
+		size_t pending_head = 0;
+		size_t pending_count = 0;
 
-	BAN::Optional<uint32_t> AHCIDevice::find_free_command_slot()
-	{
-		uint32_t slots = m_port->sact | m_port->ci;
-		for (uint32_t i = 0; i < m_controller->command_slot_count(); i++)
-			if (!(slots & (1 << i)))
-				return i;
-		return {};
+		BAN::ErrorOr<void> result {};
+
+		uint64_t sectors_issued = 0;
+		while (pending_count > 0 || (sectors_issued < sector_count && !result.is_error()))
+		{
+			if (sectors_issued < sector_count && !result.is_error() && pending_count < s_max_pending_commands)
+			{
+				if (auto slot = reserve_command_slot(pending_count == 0); slot.has_value())
+				{
+					const uint64_t buffer_offset = sectors_issued * sector_size();
+					const uint64_t remaining = BAN::Math::min<uint64_t>(sector_count - sectors_issued, max_sectors_per_command);
+
+					bool bounced = false;
+					uint64_t count = prepare_direct_prdt(slot.value(), reinterpret_cast<vaddr_t>(buffer + buffer_offset), remaining);
+					if (count == 0)
+					{
+						bounced = true;
+						count = prepare_bounce_prdt(slot.value(), remaining);
+						if (command == Command::Write)
+							memcpy(reinterpret_cast<void*>(bounce_buffer_of(slot.value())), buffer + buffer_offset, count * sector_size());
+					}
+
+					prepare_command_fis(slot.value(), lba + sectors_issued, count, command);
+
+					if (!m_ncq_enabled)
+						while (m_port->tfd & (ATA_STATUS_BSY | ATA_STATUS_DRQ))
+							continue;
+					issue_command(slot.value(), m_ncq_enabled);
+
+					pending[(pending_head + pending_count) % s_max_pending_commands] = {
+						.slot = slot.value(),
+						.buffer_offset = buffer_offset,
+						.sector_count = count,
+						.bounced = bounced,
+					};
+					pending_count++;
+
+					sectors_issued += count;
+					continue;
+				}
+			}
+
+			const auto& oldest = pending[pending_head];
+			auto ret = block_until_command_completed(oldest.slot);
+			if (!ret.is_error() && oldest.bounced && command == Command::Read)
+				memcpy(buffer + oldest.buffer_offset, reinterpret_cast<void*>(bounce_buffer_of(oldest.slot)), oldest.sector_count * sector_size());
+			release_command_slot(oldest.slot);
+
+			pending_head = (pending_head + 1) % s_max_pending_commands;
+			pending_count--;
+
+			// Keep waiting for outstanding commands, they may still be doing DMA to our buffer
+			if (ret.is_error() && !result.is_error())
+				result = ret.release_error();
+		}
+
+		return result;
 	}
 
 }
@@ -0,0 +1,448 @@
+#include <BAN/Limits.h>
+#include <BAN/ScopeGuard.h>
+#include <kernel/Lock/LockGuard.h>
+#include <kernel/Memory/kmalloc.h>
+#include <kernel/Process.h>
+#include <kernel/Storage/BlockRequestQueue.h>
+#include <kernel/Storage/StorageDevice.h>
+#include <kernel/Timer/Timer.h>
+
+namespace Kernel
+{
+
+	static constexpr uint64_t s_read_deadline_ms = 500;
+	static constexpr uint64_t s_write_deadline_ms = 5000;
+	static constexpr uint64_t s_max_merged_bytes = 128 * 1024;
+
+	uint64_t BlockRequest::merged_sector_count() const
+	{
+		uint64_t result = 0;
+		for (const auto* request = this; request; request = request->merged_next)
+			result += request->sector_count;
+		return result;
+	}
+
+	bool BlockIOScheduler::try_merge(BlockRequest*& queued, BlockRequest* request, uint32_t sector_size)
+	{
+		ASSERT(request->merged_next == nullptr);
+
+		if (queued->type != request->type)
+			return false;
+
+		const uint64_t queued_sectors = queued->merged_sector_count();
+		if ((queued_sectors + request->sector_count) * sector_size > s_max_merged_bytes)
+			return false;
+
+		if (queued->lba + queued_sectors == request->lba)
+		{
+			auto* last = queued;
+			while (last->merged_next)
+				last = last->merged_next;
+			last->merged_next = request;
+			queued->deadline_ms = BAN::Math::min(queued->deadline_ms, request->deadline_ms);
+			return true;
+		}
+
+		if (request->lba + request->sector_count == queued->lba)
+		{
+			request->merged_next = queued;
+			request->deadline_ms = BAN::Math::min(queued->deadline_ms, request->deadline_ms);
+			queued = request;
+			return true;
+		}
+
+		return false;
+	}
+
+	BAN::ErrorOr<void> FIFOBlockIOScheduler::add_request(BlockRequest* request)
+	{
+		if (!m_requests.empty() && try_merge(m_requests.back(), request, m_sector_size))
+			return {};
+		TRY(m_requests.push_back(request));
+		return {};
+	}
+
+	BlockRequest* FIFOBlockIOScheduler::next_request()
+	{
+		if (m_requests.empty())
+			return nullptr;
+		auto* request = m_requests.front();
+		m_requests.remove(0);
+		return request;
+	}
+
+	BAN::ErrorOr<void> DeadlineBlockIOScheduler::add_request(BlockRequest* request)
+	{
+		size_t index = 0;
+		while (index < m_requests.size() && m_requests[index]->lba < request->lba)
+			index++;
+
+		if (index > 0 && try_merge(m_requests[index - 1], request, m_sector_size))
+			return {};
+		if (index < m_requests.size() && try_merge(m_requests[index], request, m_sector_size))
+			return {};
+
+		TRY(m_requests.insert(index, request));
+		return {};
+	}
+
+	BlockRequest* DeadlineBlockIOScheduler::next_request()
+	{
+		if (m_requests.empty())
+			return nullptr;
+
+		const uint64_t current_ms = SystemTimer::get().ms_since_boot();
+
+		// Serve expired requests first, oldest deadline first
+		size_t index = m_requests.size();
+		for (size_t i = 0; i < m_requests.size(); i++)
+		{
+			if (m_requests[i]->deadline_ms > current_ms)
+				continue;
+			if (index == m_requests.size() || m_requests[i]->deadline_ms < m_requests[index]->deadline_ms)
+				index = i;
+		}
+
+		// Otherwise continue sweeping upwards from the last dispatched lba
+		if (index == m_requests.size())
+		{
+			index = 0;
+			while (index < m_requests.size() && m_requests[index]->lba < m_next_lba)
+				index++;
+			if (index == m_requests.size())
+				index = 0;
+		}
+
+		auto* request = m_requests[index];
+		m_requests.remove(index);
+		m_next_lba = request->lba + request->merged_sector_count();
+		return request;
+	}
+
+	BAN::ErrorOr<BAN::UniqPtr<BlockRequestQueue>> BlockRequestQueue::create(StorageDevice& device, SchedulerType scheduler_type, size_t worker_count)
+	{
+		ASSERT(worker_count > 0);
+
+		auto* queue_ptr = new BlockRequestQueue(device);
+		if (queue_ptr == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		auto queue = BAN::UniqPtr<BlockRequestQueue>::adopt(queue_ptr);
+
+		switch (scheduler_type)
+		{
+			case SchedulerType::FIFO:
+				queue->m_scheduler = TRY(BAN::UniqPtr<FIFOBlockIOScheduler>::create(device.sector_size()));
+				break;
+			case SchedulerType::Deadline:
+				queue->m_scheduler = TRY(BAN::UniqPtr<DeadlineBlockIOScheduler>::create(device.sector_size()));
+				break;
+			default:
+				ASSERT_NOT_REACHED();
+		}
+
+		auto* process = Process::create_kernel();
+		for (size_t i = 0; i < worker_count; i++)
+		{
+			auto thread = Thread::create_kernel(
+				[](void* queue_ptr)
+				{
+					static_cast<BlockRequestQueue*>(queue_ptr)->worker_task();
+				}, queue.ptr(), process
+			);
+			if (thread.is_error())
+			{
+				if (i == 0)
+					return thread.release_error();
+				dwarnln("could only start {}/{} block request workers", i, worker_count);
+				break;
+			}
+			process->add_thread(thread.release_value());
+		}
+		process->register_to_scheduler();
+
+		return queue;
+	}
+
+	BAN::ErrorOr<void> BlockRequestQueue::submit(BlockRequest::Type type, uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer, BlockRequest::Callback callback)
+	{
+		ASSERT(sector_count > 0);
+		ASSERT(buffer.size() >= sector_count * m_device.sector_size());
+		// Requests are executed by worker threads that do not have the caller's address space
+		ASSERT(reinterpret_cast<vaddr_t>(buffer.data()) >= KERNEL_OFFSET);
+
+		auto* request = new BlockRequest;
+		if (request == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		request->type = type;
+		request->lba = lba;
+		request->sector_count = sector_count;
+		request->buffer = buffer.data();
+		request->callback = callback;
+		request->deadline_ms = SystemTimer::get().ms_since_boot() + (type == BlockRequest::Type::Read ? s_read_deadline_ms : s_write_deadline_ms);
+
+		{
+			LockGuard _(m_mutex);
+
+			// Requests conflicting with earlier ones wait until those have completed,
+			// so the scheduler is free to reorder everything it is given.
+			const bool conflicts = conflicts_with_outstanding(*request, m_deferred.size());
+			auto& target = conflicts ? m_deferred : m_outstanding;
+			if (auto ret = target.push_back(request); ret.is_error())
+			{
+				delete request;
+				return ret.release_error();
+			}
+
+			if (conflicts)
+				return {};
+
+			if (auto ret = m_scheduler->add_request(request); ret.is_error())
+			{
+				m_outstanding.pop_back();
+				delete request;
+				return ret.release_error();
+			}
+		}
+
+		m_semaphore.unblock();
+
+		return {};
+	}
+
+	BAN::ErrorOr<void> BlockRequestQueue::transfer(BlockRequest::Type type, uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= sector_count * m_device.sector_size());
+
+		if (reinterpret_cast<vaddr_t>(buffer.data()) >= KERNEL_OFFSET)
+			return transfer_kernel_buffer(type, lba, sector_count, buffer);
+
+		// User buffers are not mapped in the workers' address space, stage them
+		// through a kernel buffer. Copies are done here in the caller's context.
+		const uint64_t sector_size = m_device.sector_size();
+		const uint64_t max_sectors = BAN::Math::max<uint64_t>(s_max_merged_bytes / sector_size, 1);
+		const uint64_t bounce_sectors = BAN::Math::min(sector_count, max_sectors);
+
+		auto* bounce_buffer = static_cast<uint8_t*>(kmalloc(bounce_sectors * sector_size));
+		if (bounce_buffer == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		BAN::ScopeGuard _([bounce_buffer] { kfree(bounce_buffer); });
+
+		for (uint64_t done = 0; done < sector_count;)
+		{
+			const uint64_t count = BAN::Math::min(sector_count - done, bounce_sectors);
+			auto user_span = buffer.slice(done * sector_size, count * sector_size);
+			auto bounce_span = BAN::ByteSpan(bounce_buffer, count * sector_size);
+
+			if (type == BlockRequest::Type::Write)
+				memcpy(bounce_span.data(), user_span.data(), bounce_span.size());
+			TRY(transfer_kernel_buffer(type, lba + done, count, bounce_span));
+			if (type == BlockRequest::Type::Read)
+				memcpy(user_span.data(), bounce_span.data(), bounce_span.size());
+
+			done += count;
+		}
+
+		return {};
+	}
+
+	BAN::ErrorOr<void> BlockRequestQueue::transfer_kernel_buffer(BlockRequest::Type type, uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer)
+	{
+		struct Completion
+		{
+			BAN::ErrorOr<void> result { BAN::Error::from_errno(EIO) };
+			BAN::Atomic<bool> done { false };
+		};
+		Completion completion;
+
+		TRY(submit(type, lba, sector_count, buffer,
+			[this, &completion](BAN::ErrorOr<void> result)
+			{
+				completion.result = BAN::move(result);
+				completion.done = true;
+				// NOTE: completion may be gone once done is set
+				m_completion_semaphore.unblock();
+			}
+		));
+
+		for (;;)
+		{
+			const uint32_t wake_count = m_completion_semaphore.wake_count();
+			if (completion.done)
+				break;
+			m_completion_semaphore.block_with_wake_time(BAN::numeric_limits<uint64_t>::max(), wake_count);
+		}
+
+		return BAN::move(completion.result);
+	}
+
+	bool BlockRequestQueue::conflicts_with_outstanding(const BlockRequest& request, size_t deferred_count) const
+	{
+		ASSERT(m_mutex.is_locked());
+
+		const auto conflicts =
+			[&request](const BlockRequest* other)
+			{
+				if (request.type == BlockRequest::Type::Read && other->type == BlockRequest::Type::Read)
+					return false;
+				return request.lba < other->lba + other->sector_count && other->lba < request.lba + request.sector_count;
+			};
+
+		for (const auto* other : m_outstanding)
+			if (conflicts(other))
+				return true;
+		for (size_t i = 0; i < deferred_count; i++)
+			if (conflicts(m_deferred[i]))
+				return true;
+		return false;
+	}
+
+	bool BlockRequestQueue::schedule_deferred_requests()
+	{
+		ASSERT(m_mutex.is_locked());
+
+		bool scheduled = false;
+		for (size_t i = 0; i < m_deferred.size();)
+		{
+			auto* request = m_deferred[i];
+			if (conflicts_with_outstanding(*request, i))
+			{
+				i++;
+				continue;
+			}
+
+			// NOTE: on allocation failure the request stays deferred and is retried later
+			if (m_outstanding.push_back(request).is_error())
+				break;
+			if (m_scheduler->add_request(request).is_error())
+			{
+				m_outstanding.pop_back();
+				break;
+			}
+
+			m_deferred.remove(i);
+			scheduled = true;
+		}
+		return scheduled;
+	}
+
+	void BlockRequestQueue::remove_outstanding(BlockRequest* request)
+	{
+		ASSERT(m_mutex.is_locked());
+
+		for (size_t i = 0; i < m_outstanding.size(); i++)
+		{
+			if (m_outstanding[i] != request)
+				continue;
+			m_outstanding.remove(i);
+			return;
+		}
+		ASSERT_NOT_REACHED();
+	}
+
+	void BlockRequestQueue::worker_task()
+	{
+		for (;;)
+		{
+			BlockRequest* request;
+			uint32_t wake_count;
+
+			{
+				LockGuard _(m_mutex);
+				wake_count = m_semaphore.wake_count();
+				schedule_deferred_requests();
+				request = m_scheduler->next_request();
+			}
+
+			if (request == nullptr)
+			{
+				m_semaphore.block_with_wake_time(BAN::numeric_limits<uint64_t>::max(), wake_count);
+				continue;
+			}
+
+			dispatch(request);
+		}
+	}
+
+	BAN::ErrorOr<void> BlockRequestQueue::execute(BlockRequest::Type type, uint64_t lba, uint64_t sector_count, uint8_t* buffer)
+	{
+		BAN::ByteSpan buffer_span(buffer, sector_count * m_device.sector_size());
+		switch (type)
+		{
+			case BlockRequest::Type::Read:
+				return m_device.read_sectors(lba, sector_count, buffer_span);
+			case BlockRequest::Type::Write:
+				return m_device.write_sectors(lba, sector_count, buffer_span);
+		}
+		ASSERT_NOT_REACHED();
+	}
+
+	void BlockRequestQueue::dispatch(BlockRequest* request)
+	{
+		const uint64_t sector_size = m_device.sector_size();
+
+		const auto complete_chain =
+			[this](BlockRequest* request, BAN::ErrorOr<void> result)
+			{
+				while (request)
+				{
+					auto* next = request->merged_next;
+					if (request->callback)
+						request->callback(result);
+
+					bool scheduled;
+					{
+						LockGuard _(m_mutex);
+						remove_outstanding(request);
+						scheduled = schedule_deferred_requests();
+					}
+					if (scheduled)
+						m_semaphore.unblock();
+
+					delete request;
+					request = next;
+				}
+			};
+
+		if (request->merged_next == nullptr)
+			return complete_chain(request, execute(request->type, request->lba, request->sector_count, request->buffer));
+
+		bool is_contiguous = true;
+		for (auto* current = request; current->merged_next && is_contiguous; current = current->merged_next)
+			if (current->buffer + current->sector_count * sector_size != current->merged_next->buffer)
+				is_contiguous = false;
+
+		const uint64_t total_sectors = request->merged_sector_count();
+		if (is_contiguous)
+			return complete_chain(request, execute(request->type, request->lba, total_sectors, request->buffer));
+
+		// Merged requests use separate buffers, do the transfer through a bounce buffer
+		// so the device still sees a single command.
+		auto* bounce_buffer = static_cast<uint8_t*>(kmalloc(total_sectors * sector_size));
+		if (bounce_buffer == nullptr)
+		{
+			while (request)
+			{
+				auto* next = request->merged_next;
+				request->merged_next = nullptr;
+				complete_chain(request, execute(request->type, request->lba, request->sector_count, request->buffer));
+				request = next;
+			}
+			return;
+		}
+
+		if (request->type == BlockRequest::Type::Write)
+			for (auto* current = request; current; current = current->merged_next)
+				memcpy(bounce_buffer + (current->lba - request->lba) * sector_size, current->buffer, current->sector_count * sector_size);
+
+		auto result = execute(request->type, request->lba, total_sectors, bounce_buffer);
+
+		if (!result.is_error() && request->type == BlockRequest::Type::Read)
+			for (auto* current = request; current; current = current->merged_next)
+				memcpy(current->buffer, bounce_buffer + (current->lba - request->lba) * sector_size, current->sector_count * sector_size);
+
+		kfree(bounce_buffer);
+
+		complete_chain(request, result);
+	}
+
+}
@@ -23,60 +23,81 @@ namespace Kernel
 		release_all_pages();
 	}
 
-	bool DiskCache::read_from_cache(uint64_t sector, BAN::ByteSpan buffer)
+	size_t DiskCache::find_page_index(uint64_t page_first_sector) const
 	{
-		ASSERT(buffer.size() >= m_sector_size);
+		size_t l = 0;
+		size_t r = m_cache.size();
+		while (l < r)
+		{
+			const size_t mid = (l + r) / 2;
+			if (m_cache[mid].first_sector < page_first_sector)
+				l = mid + 1;
+			else
+				r = mid;
+		}
+		return l;
+	}
 
-		uint64_t sectors_per_page = PAGE_SIZE / m_sector_size;
-		uint64_t page_cache_offset = sector % sectors_per_page;
-		uint64_t page_cache_start = sector - page_cache_offset;
+	uint8_t DiskCache::read_from_cache(uint64_t first_sector, size_t sector_count, BAN::ByteSpan buffer)
+	{
+		const uint64_t page_cache_offset = first_sector % sectors_per_page();
+		const uint64_t page_cache_start = first_sector - page_cache_offset;
 
-		for (auto& cache : m_cache)
-		{
-			if (cache.first_sector < page_cache_start)
-				continue;
-			if (cache.first_sector > page_cache_start)
-				break;
+		ASSERT(sector_count > 0 && page_cache_offset + sector_count <= sectors_per_page());
+		ASSERT(buffer.size() >= sector_count * m_sector_size);
 
-			if (!(cache.sector_mask & (1 << page_cache_offset)))
-				continue;
+		const size_t index = find_page_index(page_cache_start);
+		if (index >= m_cache.size() || m_cache[index].first_sector != page_cache_start)
+			return 0;
 
-			PageTable::with_fast_page(cache.paddr, [&] {
-				memcpy(buffer.data(), PageTable::fast_page_as_ptr(page_cache_offset * m_sector_size), m_sector_size);
-			});
+		auto& cache = m_cache[index];
 
-			return true;
-		}
+		const uint8_t found_mask = (cache.sector_mask >> page_cache_offset) & ((1u << sector_count) - 1);
+		if (found_mask == 0)
+			return 0;
 
-		return false;
+		PageTable::with_fast_page(cache.paddr, [&] {
+			for (size_t i = 0; i < sector_count; i++)
+				if (found_mask & (1u << i))
+					memcpy(buffer.data() + i * m_sector_size, PageTable::fast_page_as_ptr((page_cache_offset + i) * m_sector_size), m_sector_size);
+		});
+
+		return found_mask;
 	};
 
-	BAN::ErrorOr<void> DiskCache::write_to_cache(uint64_t sector, BAN::ConstByteSpan buffer, bool dirty)
+	BAN::ErrorOr<void> DiskCache::write_to_cache(uint64_t first_sector, size_t sector_count, BAN::ConstByteSpan buffer, bool dirty)
 	{
-		ASSERT(buffer.size() >= m_sector_size);
-		uint64_t sectors_per_page = PAGE_SIZE / m_sector_size;
-		uint64_t page_cache_offset = sector % sectors_per_page;
-		uint64_t page_cache_start = sector - page_cache_offset;
+		const uint64_t page_cache_offset = first_sector % sectors_per_page();
+		const uint64_t page_cache_start = first_sector - page_cache_offset;
+
+		ASSERT(sector_count > 0 && page_cache_offset + sector_count <= sectors_per_page());
+		ASSERT(buffer.size() >= sector_count * m_sector_size);
+
+		uint8_t write_mask = ((1u << sector_count) - 1) << page_cache_offset;
 
-		size_t index = 0;
+		const size_t index = find_page_index(page_cache_start);
 
-		// Search the cache if the have this sector in memory
-		for (; index < m_cache.size(); index++)
+		// Update the page if we already have it in memory
+		if (index < m_cache.size() && m_cache[index].first_sector == page_cache_start)
 		{
 			auto& cache = m_cache[index];
 
-			if (cache.first_sector < page_cache_start)
-				continue;
-			if (cache.first_sector > page_cache_start)
-				break;
+			// Data read from the disk must not replace data that is already
+			// cached, it may have been written while the read was in progress.
+			if (!dirty)
+				write_mask &= ~cache.sector_mask;
+			if (write_mask == 0)
+				return {};
 
 			PageTable::with_fast_page(cache.paddr, [&] {
-				memcpy(PageTable::fast_page_as_ptr(page_cache_offset * m_sector_size), buffer.data(), m_sector_size);
+				for (size_t i = 0; i < sector_count; i++)
+					if (write_mask & (1u << (page_cache_offset + i)))
+						memcpy(PageTable::fast_page_as_ptr((page_cache_offset + i) * m_sector_size), buffer.data() + i * m_sector_size, m_sector_size);
 			});
 
-			cache.sector_mask |= 1 << page_cache_offset;
+			cache.sector_mask |= write_mask;
 			if (dirty)
-				cache.dirty_mask |= 1 << page_cache_offset;
+				cache.dirty_mask |= write_mask;
 
 			return {};
 		}
@@ -89,8 +110,8 @@ namespace Kernel
 		PageCache cache;
 		cache.paddr			= paddr;
 		cache.first_sector	= page_cache_start;
-		cache.sector_mask	= 1 << page_cache_offset;
-		cache.dirty_mask	= dirty ? cache.sector_mask : 0;
+		cache.sector_mask	= write_mask;
+		cache.dirty_mask	= dirty ? write_mask : 0;
 
 		if (auto ret = m_cache.insert(index, cache); ret.is_error())
 		{
@@ -99,55 +120,108 @@ namespace Kernel
 		}
 
 		PageTable::with_fast_page(cache.paddr, [&] {
-			memcpy(PageTable::fast_page_as_ptr(page_cache_offset * m_sector_size), buffer.data(), m_sector_size);
+			memcpy(PageTable::fast_page_as_ptr(page_cache_offset * m_sector_size), buffer.data(), sector_count * m_sector_size);
 		});
 
 		return {};
 	}
 
-	BAN::ErrorOr<void> DiskCache::sync()
+	BAN::ErrorOr<void> DiskCache::sync(uint64_t first_sector, uint64_t sector_count)
 	{
-		for (auto& cache : m_cache)
-		{
-			if (cache.dirty_mask == 0)
-				continue;
+		// Dirty sectors are collected into m_sync_cache so that
+		// runs spanning multiple pages are written with one command.
 
-			PageTable::with_fast_page(cache.paddr, [&] {
-				memcpy(m_sync_cache.data(), PageTable::fast_page_as_ptr(), PAGE_SIZE);
-			});
+		const uint64_t end_sector = (sector_count > UINT64_MAX - first_sector) ? UINT64_MAX : first_sector + sector_count;
+
+		const uint64_t max_run_sectors = m_sync_cache.size() / m_sector_size;
 
-			uint8_t sector_start = 0;
-			uint8_t sector_count = 0;
+		size_t run_first_index = 0;
+		uint64_t run_first_sector = 0;
+		uint64_t run_sector_count = 0;
 
-			while (sector_start + sector_count <= PAGE_SIZE / m_sector_size)
+		const auto flush_run =
+			[&]() -> BAN::ErrorOr<void>
 			{
-				if (cache.dirty_mask & (1 << (sector_start + sector_count)))
-					sector_count++;
-				else if (sector_count == 0)
-					sector_start++;
-				else
+				if (run_sector_count == 0)
+					return {};
+
+				dprintln_if(DEBUG_SYNC, "syncing {}->{}", run_first_sector, run_first_sector + run_sector_count);
+				TRY(m_device.write_sectors_impl(run_first_sector, run_sector_count, m_sync_cache.span().slice(0, run_sector_count * m_sector_size)));
+
+				const uint64_t run_end_sector = run_first_sector + run_sector_count;
+				for (size_t i = run_first_index; i < m_cache.size() && m_cache[i].first_sector < run_end_sector; i++)
 				{
-					dprintln_if(DEBUG_SYNC, "syncing {}->{}", cache.first_sector + sector_start, cache.first_sector + sector_start + sector_count);
-					auto data_slice = m_sync_cache.span().slice(sector_start * m_sector_size, sector_count * m_sector_size);
-					TRY(m_device.write_sectors_impl(cache.first_sector + sector_start, sector_count, data_slice));
-					sector_start += sector_count + 1;
-					sector_count = 0;
+					auto& cache = m_cache[i];
+					for (size_t j = 0; j < sectors_per_page(); j++)
+						if (cache.first_sector + j >= run_first_sector && cache.first_sector + j < run_end_sector)
+							cache.dirty_mask &= ~(1u << j);
 				}
-			}
 
-			if (sector_count > 0)
+				run_sector_count = 0;
+				return {};
+			};
+
+		for (size_t i = find_page_index(first_sector - first_sector % sectors_per_page()); i < m_cache.size() && m_cache[i].first_sector < end_sector; i++)
+		{
+			auto& cache = m_cache[i];
+
+			uint8_t dirty_mask = cache.dirty_mask;
+			for (size_t j = 0; j < sectors_per_page(); j++)
+				if (cache.first_sector + j < first_sector || cache.first_sector + j >= end_sector)
+					dirty_mask &= ~(1u << j);
+
+			for (size_t j = 0; j < sectors_per_page();)
 			{
-				dprintln_if(DEBUG_SYNC, "syncing {}->{}", cache.first_sector + sector_start, cache.first_sector + sector_start + sector_count);
-				auto data_slice = m_sync_cache.span().slice(sector_start * m_sector_size, sector_count * m_sector_size);
-				TRY(m_device.write_sectors_impl(cache.first_sector + sector_start, sector_count, data_slice));
-			}
+				if (!(dirty_mask & (1u << j)))
+				{
+					j++;
+					continue;
+				}
+
+				size_t length = 1;
+				while (j + length < sectors_per_page() && (dirty_mask & (1u << (j + length))))
+					length++;
 
-			cache.dirty_mask = 0;
+				const uint64_t sector = cache.first_sector + j;
+				if (run_sector_count > 0 && (run_first_sector + run_sector_count != sector || run_sector_count + length > max_run_sectors))
+					TRY(flush_run());
+
+				if (run_sector_count == 0)
+				{
+					run_first_index = i;
+					run_first_sector = sector;
+				}
+
+				PageTable::with_fast_page(cache.paddr, [&] {
+					memcpy(m_sync_cache.data() + run_sector_count * m_sector_size, PageTable::fast_page_as_ptr(j * m_sector_size), length * m_sector_size);
+				});
+
+				run_sector_count += length;
+				j += length;
+			}
 		}
 
+		TRY(flush_run());
+
 		return {};
 	}
 
+	void DiskCache::invalidate(uint64_t first_sector, uint64_t sector_count)
+	{
+		const uint64_t end_sector = first_sector + sector_count;
+		for (size_t i = find_page_index(first_sector - first_sector % sectors_per_page()); i < m_cache.size() && m_cache[i].first_sector < end_sector; i++)
+		{
+			auto& cache = m_cache[i];
+			for (size_t j = 0; j < sectors_per_page(); j++)
+			{
+				if (cache.first_sector + j < first_sector || cache.first_sector + j >= end_sector)
+					continue;
+				cache.sector_mask &= ~(1u << j);
+				cache.dirty_mask &= ~(1u << j);
+			}
+		}
+	}
+
 	size_t DiskCache::release_clean_pages(size_t page_count)
 	{
 		// NOTE: There might not actually be page_count pages after this
@@ -1,5 +1,6 @@
 #include <kernel/Device/DeviceNumbers.h>
 #include <kernel/FS/DevFS/FileSystem.h>
+#include <kernel/Lock/LockGuard.h>
 #include <kernel/Storage/NVMe/Controller.h>
 #include <kernel/Storage/NVMe/Namespace.h>
 
@@ -61,6 +62,8 @@ namespace Kernel
 	{
 		ASSERT(buffer.size() >= sector_count * m_block_size);
 
+		LockGuard _(m_dma_mutex);
+
 		for (uint64_t i = 0; i < sector_count;)
 		{
 			uint16_t count = BAN::Math::min<uint64_t>(sector_count - i, m_dma_region->size() / m_block_size);
@@ -88,6 +91,8 @@ namespace Kernel
 	{
 		ASSERT(buffer.size() >= sector_count * m_block_size);
 
+		LockGuard _(m_dma_mutex);
+
 		for (uint64_t i = 0; i < sector_count;)
 		{
 			uint16_t count = BAN::Math::min<uint16_t>(sector_count - i, m_dma_region->size() / m_block_size);
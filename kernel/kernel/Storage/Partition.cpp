@@ -47,6 +47,55 @@ namespace Kernel
 		return {};
 	}
 
+	BAN::ErrorOr<void> Partition::submit_read_blocks(uint64_t first_block, size_t block_count, BAN::ByteSpan buffer, completion_callback_t callback)
+	{
+		ASSERT(buffer.size() >= block_count * m_device->blksize());
+		const uint32_t blocks_in_partition = m_last_block - m_first_block + 1;
+		if (first_block + block_count > blocks_in_partition)
+			return BAN::Error::from_error_code(ErrorCode::Storage_Boundaries);
+		TRY(m_device->submit_read_blocks(m_first_block + first_block, block_count, buffer, callback));
+		return {};
+	}
+
+	BAN::ErrorOr<void> Partition::submit_write_blocks(uint64_t first_block, size_t block_count, BAN::ConstByteSpan buffer, completion_callback_t callback)
+	{
+		ASSERT(buffer.size() >= block_count * m_device->blksize());
+		const uint32_t blocks_in_partition = m_last_block - m_first_block + 1;
+		if (first_block + block_count > blocks_in_partition)
+			return BAN::Error::from_error_code(ErrorCode::Storage_Boundaries);
+		TRY(m_device->submit_write_blocks(m_first_block + first_block, block_count, buffer, callback));
+		return {};
+	}
+
+	BAN::ErrorOr<void> Partition::read_blocks_direct(uint64_t first_block, size_t block_count, BAN::ByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= block_count * m_device->blksize());
+		const uint32_t blocks_in_partition = m_last_block - m_first_block + 1;
+		if (first_block + block_count > blocks_in_partition)
+			return BAN::Error::from_error_code(ErrorCode::Storage_Boundaries);
+		TRY(m_device->read_blocks_direct(m_first_block + first_block, block_count, buffer));
+		return {};
+	}
+
+	BAN::ErrorOr<void> Partition::write_blocks_direct(uint64_t first_block, size_t block_count, BAN::ConstByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= block_count * m_device->blksize());
+		const uint32_t blocks_in_partition = m_last_block - m_first_block + 1;
+		if (first_block + block_count > blocks_in_partition)
+			return BAN::Error::from_error_code(ErrorCode::Storage_Boundaries);
+		TRY(m_device->write_blocks_direct(m_first_block + first_block, block_count, buffer));
+		return {};
+	}
+
+	BAN::ErrorOr<void> Partition::sync_blocks(uint64_t first_block, size_t block_count)
+	{
+		const uint32_t blocks_in_partition = m_last_block - m_first_block + 1;
+		if (first_block + block_count > blocks_in_partition)
+			return BAN::Error::from_error_code(ErrorCode::Storage_Boundaries);
+		TRY(m_device->sync_blocks(m_first_block + first_block, block_count));
+		return {};
+	}
+
 	BAN::ErrorOr<size_t> Partition::read_impl(off_t offset, BAN::ByteSpan buffer)
 	{
 		ASSERT(offset >= 0);
@@ -67,4 +116,44 @@ namespace Kernel
 		return block_count * m_device->blksize();
 	}
 
+	BAN::ErrorOr<size_t> Partition::read_direct_impl(off_t offset, BAN::ByteSpan buffer)
+	{
+		ASSERT(offset >= 0);
+
+		if (offset % m_device->blksize() || buffer.size() % m_device->blksize())
+			return BAN::Error::from_errno(EINVAL);
+
+		const uint64_t blocks_in_partition = m_last_block - m_first_block + 1;
+		const uint64_t first_block = offset / m_device->blksize();
+		uint64_t block_count = buffer.size() / m_device->blksize();
+
+		if (first_block >= blocks_in_partition)
+			return 0;
+		if (first_block + block_count > blocks_in_partition)
+			block_count = blocks_in_partition - first_block;
+
+		TRY(m_device->read_direct(offset + m_first_block * m_device->blksize(), buffer.slice(0, block_count * m_device->blksize())));
+		return block_count * m_device->blksize();
+	}
+
+	BAN::ErrorOr<size_t> Partition::write_direct_impl(off_t offset, BAN::ConstByteSpan buffer)
+	{
+		ASSERT(offset >= 0);
+
+		if (offset % m_device->blksize() || buffer.size() % m_device->blksize())
+			return BAN::Error::from_errno(EINVAL);
+
+		const uint64_t blocks_in_partition = m_last_block - m_first_block + 1;
+		const uint64_t first_block = offset / m_device->blksize();
+		uint64_t block_count = buffer.size() / m_device->blksize();
+
+		if (first_block >= blocks_in_partition)
+			return BAN::Error::from_errno(ENOSPC);
+		if (first_block + block_count > blocks_in_partition)
+			block_count = blocks_in_partition - first_block;
+
+		TRY(m_device->write_direct(offset + m_first_block * m_device->blksize(), buffer.slice(0, block_count * m_device->blksize())));
+		return block_count * m_device->blksize();
+	}
+
 }
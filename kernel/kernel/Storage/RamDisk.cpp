@@ -0,0 +1,247 @@
+#include <kernel/Device/DeviceNumbers.h>
+#include <kernel/FS/DevFS/FileSystem.h>
+#include <kernel/FS/VirtualFileSystem.h>
+#include <kernel/Lock/LockGuard.h>
+#include <kernel/Memory/Heap.h>
+#include <kernel/Memory/PageTable.h>
+#include <kernel/Storage/RamDisk.h>
+
+#include <sys/banan-os.h>
+#include <sys/sysmacros.h>
+
+namespace Kernel
+{
+
+	static constexpr dev_t s_max_ram_disks = 100;
+
+	static BAN::Optional<uint64_t> parse_size(BAN::StringView string)
+	{
+		if (string.empty())
+			return {};
+
+		uint64_t multiplier = 1;
+		switch (string.back())
+		{
+			case 'K': case 'k': multiplier = 1024; break;
+			case 'M': case 'm': multiplier = 1024 * 1024; break;
+			case 'G': case 'g': multiplier = 1024 * 1024 * 1024; break;
+		}
+		if (multiplier != 1)
+			string = string.substring(0, string.size() - 1);
+		if (string.empty())
+			return {};
+
+		uint64_t value = 0;
+		for (char c : string)
+		{
+			if (c < '0' || c > '9')
+				return {};
+			if (BAN::Math::will_multiplication_overflow<uint64_t>(value, 10))
+				return {};
+			value *= 10;
+			if (BAN::Math::will_addition_overflow<uint64_t>(value, c - '0'))
+				return {};
+			value += c - '0';
+		}
+		if (BAN::Math::will_multiplication_overflow<uint64_t>(value, multiplier))
+			return {};
+		return value * multiplier;
+	}
+
+	void RamDiskDevice::initialize_devices(BAN::StringView sizes)
+	{
+		if (sizes.empty())
+		{
+			if (auto res = RamDiskDevice::create(0); res.is_error())
+				dwarnln("Could not create ram disk: {}", res.error());
+			return;
+		}
+
+		auto size_strings = MUST(sizes.split(','));
+		for (auto size_string : size_strings)
+		{
+			auto size = parse_size(size_string);
+			if (!size.has_value() || size.value() % s_sector_size)
+			{
+				dwarnln("Invalid ram disk size '{}'", size_string);
+				continue;
+			}
+			if (auto res = RamDiskDevice::create(size.value()); res.is_error())
+				dwarnln("Could not create ram disk: {}", res.error());
+		}
+	}
+
+	BAN::ErrorOr<BAN::RefPtr<RamDiskDevice>> RamDiskDevice::create(uint64_t size)
+	{
+		static dev_t next_minor = 0;
+		if (next_minor >= s_max_ram_disks)
+			return BAN::Error::from_errno(ENOSPC);
+
+		auto* ram_disk_ptr = new RamDiskDevice(next_minor);
+		if (ram_disk_ptr == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		auto ram_disk = BAN::RefPtr<RamDiskDevice>::adopt(ram_disk_ptr);
+		TRY(ram_disk->resize(size));
+		next_minor++;
+
+		// Pages are already in memory, so there is no disk cache. A new disk is
+		// all zeros, so there are no partitions to look for either.
+		DevFileSystem::get().add_device(ram_disk);
+
+		dprintln("Created ram disk {} ({} bytes)", ram_disk->name(), size);
+
+		return ram_disk;
+	}
+
+	RamDiskDevice::RamDiskDevice(dev_t minor)
+		: m_rdev(makedev(DeviceNumber::RamDisk, minor))
+	{
+		static_assert(s_max_ram_disks <= 100);
+		strcpy(m_name, "ram");
+		size_t len = 3;
+		if (minor >= 10)
+			m_name[len++] = '0' + minor / 10;
+		m_name[len++] = '0' + minor % 10;
+		m_name[len] = '\0';
+	}
+
+	RamDiskDevice::~RamDiskDevice()
+	{
+		for (paddr_t paddr : m_pages)
+			if (paddr)
+				Heap::get().release_page(paddr);
+	}
+
+	BAN::ErrorOr<void> RamDiskDevice::resize(uint64_t size)
+	{
+		if (size % s_sector_size)
+			return BAN::Error::from_errno(EINVAL);
+		if (BAN::Math::div_round_up<uint64_t>(size, PAGE_SIZE) > BAN::numeric_limits<size_t>::max() / sizeof(paddr_t))
+			return BAN::Error::from_errno(EOVERFLOW);
+
+		LockGuard _(m_mutex);
+
+		const size_t page_count = BAN::Math::div_round_up<uint64_t>(size, PAGE_SIZE);
+		for (size_t i = page_count; i < m_pages.size(); i++)
+		{
+			if (m_pages[i] == 0)
+				continue;
+			Heap::get().release_page(m_pages[i]);
+			m_pages[i] = 0;
+		}
+
+		// Zero the tail of the last page, so growing the disk later exposes zeros
+		if (page_count > 0 && page_count <= m_pages.size() && m_pages[page_count - 1] && size % PAGE_SIZE)
+		{
+			PageTable::with_fast_page(m_pages[page_count - 1], [&] {
+				memset(PageTable::fast_page_as_ptr(size % PAGE_SIZE), 0, PAGE_SIZE - size % PAGE_SIZE);
+			});
+		}
+
+		TRY(m_pages.resize(page_count, 0));
+		m_size = size;
+
+		return {};
+	}
+
+	BAN::ErrorOr<long> RamDiskDevice::ioctl_impl(int request, void* arg)
+	{
+		if (arg == nullptr)
+			return BAN::Error::from_errno(EINVAL);
+
+		switch (request)
+		{
+			case RAMDISK_GET_SIZE:
+			{
+				LockGuard _(m_mutex);
+				if (m_size > BAN::numeric_limits<size_t>::max())
+					return BAN::Error::from_errno(EOVERFLOW);
+				*static_cast<size_t*>(arg) = m_size;
+				return 0;
+			}
+			case RAMDISK_SET_SIZE:
+			{
+				// Resizing under a mounted file system would corrupt it
+				if (VirtualFileSystem::get().is_mounted(rdev()))
+					return BAN::Error::from_errno(EBUSY);
+				TRY(resize(*static_cast<const size_t*>(arg)));
+				return 0;
+			}
+			default:
+				return BAN::Error::from_errno(ENOTSUP);
+		}
+	}
+
+	BAN::ErrorOr<void> RamDiskDevice::read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= sector_count * s_sector_size);
+
+		LockGuard _(m_mutex);
+
+		const uint64_t total_sectors = m_size / s_sector_size;
+		if (lba > total_sectors || sector_count > total_sectors - lba)
+			return BAN::Error::from_errno(EIO);
+
+		const uint64_t offset = lba * s_sector_size;
+		const uint64_t bytes = sector_count * s_sector_size;
+		for (uint64_t done = 0; done < bytes;)
+		{
+			const size_t page_index = (offset + done) / PAGE_SIZE;
+			const size_t page_offset = (offset + done) % PAGE_SIZE;
+			const size_t to_copy = BAN::Math::min<uint64_t>(PAGE_SIZE - page_offset, bytes - done);
+
+			if (m_pages[page_index] == 0)
+				memset(buffer.data() + done, 0, to_copy);
+			else
+			{
+				PageTable::with_fast_page(m_pages[page_index], [&] {
+					memcpy(buffer.data() + done, PageTable::fast_page_as_ptr(page_offset), to_copy);
+				});
+			}
+
+			done += to_copy;
+		}
+
+		return {};
+	}
+
+	BAN::ErrorOr<void> RamDiskDevice::write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= sector_count * s_sector_size);
+
+		LockGuard _(m_mutex);
+
+		const uint64_t total_sectors = m_size / s_sector_size;
+		if (lba > total_sectors || sector_count > total_sectors - lba)
+			return BAN::Error::from_errno(EIO);
+
+		const uint64_t offset = lba * s_sector_size;
+		const uint64_t bytes = sector_count * s_sector_size;
+		for (uint64_t done = 0; done < bytes;)
+		{
+			const size_t page_index = (offset + done) / PAGE_SIZE;
+			const size_t page_offset = (offset + done) % PAGE_SIZE;
+			const size_t to_copy = BAN::Math::min<uint64_t>(PAGE_SIZE - page_offset, bytes - done);
+
+			if (m_pages[page_index] == 0)
+			{
+				const paddr_t paddr = Heap::get().take_free_page();
+				if (paddr == 0)
+					return BAN::Error::from_errno(ENOSPC);
+				PageTable::with_fast_page(paddr, [] {
+					memset(PageTable::fast_page_as_ptr(), 0, PAGE_SIZE);
+				});
+				m_pages[page_index] = paddr;
+			}
+
+			PageTable::with_fast_page(m_pages[page_index], [&] {
+				memcpy(PageTable::fast_page_as_ptr(page_offset), buffer.data() + done, to_copy);
+			});
+
+			done += to_copy;
+		}
+
+		return {};
+	}
+
+}
@@ -220,42 +220,113 @@ namespace Kernel
 		return {};
 	}
 
+	BAN::ErrorOr<BlockRequestQueue&> StorageDevice::request_queue()
+	{
+		LockGuard _(m_mutex);
+		if (!m_request_queue)
+			m_request_queue = TRY(BlockRequestQueue::create(*this, request_scheduler_type(), max_concurrent_requests()));
+		return *m_request_queue;
+	}
+
+	BAN::ErrorOr<void> StorageDevice::read_blocks(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer)
+	{
+		// NOTE: block reads go through the request queue so that concurrent
+		//       readers get merged and scheduled together
+		auto queue = request_queue();
+		if (queue.is_error())
+			return read_sectors(lba, sector_count, buffer);
+		return queue.value().transfer(BlockRequest::Type::Read, lba, sector_count, buffer);
+	}
+
+	BAN::ErrorOr<void> StorageDevice::write_blocks(uint64_t lba, size_t sector_count, BAN::ConstByteSpan buffer)
+	{
+		auto queue = request_queue();
+		if (queue.is_error())
+			return write_sectors(lba, sector_count, buffer);
+		// NOTE: write requests never write to the buffer
+		BAN::ByteSpan buffer_span(const_cast<uint8_t*>(buffer.data()), buffer.size());
+		return queue.value().transfer(BlockRequest::Type::Write, lba, sector_count, buffer_span);
+	}
+
+	BAN::ErrorOr<void> StorageDevice::submit_read_sectors(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer, completion_callback_t callback)
+	{
+		auto& queue = TRY_REF(request_queue());
+		return queue.submit(BlockRequest::Type::Read, lba, sector_count, buffer, callback);
+	}
+
+	BAN::ErrorOr<void> StorageDevice::submit_write_sectors(uint64_t lba, size_t sector_count, BAN::ConstByteSpan buffer, completion_callback_t callback)
+	{
+		auto& queue = TRY_REF(request_queue());
+		// NOTE: write requests never write to the buffer
+		BAN::ByteSpan buffer_span(const_cast<uint8_t*>(buffer.data()), buffer.size());
+		return queue.submit(BlockRequest::Type::Write, lba, sector_count, buffer_span, callback);
+	}
+
 	BAN::ErrorOr<void> StorageDevice::read_sectors(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer)
 	{
 		ASSERT(buffer.size() >= sector_count * sector_size());
 
-		LockGuard _(m_mutex);
+		// NOTE: m_mutex only protects the disk cache. Drivers are called without
+		//       holding it so devices can execute multiple requests concurrently.
 
 		if (!m_disk_cache.has_value())
 			return read_sectors_impl(lba, sector_count, buffer);
 
-		uint64_t sectors_done = 0;
-		while (sectors_done < sector_count)
+		const size_t sectors_per_page = m_disk_cache->sectors_per_page();
+
+		// Sectors not found from the cache are collected into runs
+		// that are read from the device with a single command.
+		uint64_t missing_first_sector = 0;
+		uint64_t missing_sector_count = 0;
+
+		const auto read_missing =
+			[&]() -> BAN::ErrorOr<void>
+			{
+				if (missing_sector_count == 0)
+					return {};
+
+				auto missing_buffer = buffer.slice((missing_first_sector - lba) * sector_size(), missing_sector_count * sector_size());
+				TRY(read_sectors_impl(missing_first_sector, missing_sector_count, missing_buffer));
+
+				LockGuard _(m_mutex);
+				for (uint64_t sector = missing_first_sector; sector < missing_first_sector + missing_sector_count;)
+				{
+					const uint64_t count = BAN::Math::min<uint64_t>(sectors_per_page - sector % sectors_per_page, missing_first_sector + missing_sector_count - sector);
+					(void)m_disk_cache->write_to_cache(sector, count, missing_buffer.slice((sector - missing_first_sector) * sector_size(), count * sector_size()), false);
+					sector += count;
+				}
+
+				missing_sector_count = 0;
+				return {};
+			};
+
+		for (uint64_t sector = lba; sector < lba + sector_count;)
 		{
-			const uint32_t segment_sector_count = BAN::Math::min<uint32_t>(sector_count - sectors_done, 64);
-			uint64_t needed_sector_bitmask = (static_cast<uint64_t>(1) << segment_sector_count) - 1;
-			for (uint32_t i = 0; i < segment_sector_count; i++)
-				if (m_disk_cache->read_from_cache(lba + sectors_done + i, buffer.slice((sectors_done + i) * sector_size(), sector_size())))
-					needed_sector_bitmask &= ~(static_cast<uint64_t>(1) << i);
+			const uint64_t count = BAN::Math::min<uint64_t>(sectors_per_page - sector % sectors_per_page, lba + sector_count - sector);
+
+			uint8_t cached_mask;
+			{
+				LockGuard _(m_mutex);
+				cached_mask = m_disk_cache->read_from_cache(sector, count, buffer.slice((sector - lba) * sector_size(), count * sector_size()));
+			}
 
-			for (uint32_t i = 0; i < segment_sector_count && needed_sector_bitmask; i++)
+			for (uint64_t i = 0; i < count; i++)
 			{
-				if (!(needed_sector_bitmask & (static_cast<uint64_t>(1) << i)))
+				if (cached_mask & (1u << i))
+				{
+					TRY(read_missing());
 					continue;
-				uint32_t len = 1;
-				while (needed_sector_bitmask & (static_cast<uint64_t>(1) << (i + len)))
-					len++;
-				auto segment_buffer = buffer.slice((sectors_done + i) * sector_size(), len * sector_size());
-				TRY(read_sectors_impl(lba + sectors_done + i, len, segment_buffer));
-				for (uint32_t j = 0; j < len; j++)
-					(void)m_disk_cache->write_to_cache(lba + sectors_done + i + j, segment_buffer.slice(j * sector_size(), sector_size()), false);
-				needed_sector_bitmask &= ~(((static_cast<uint64_t>(1) << len) - 1) << i);
-				i += len;
+				}
+				if (missing_sector_count == 0)
+					missing_first_sector = sector + i;
+				missing_sector_count++;
 			}
 
-			sectors_done += segment_sector_count;
+			sector += count;
 		}
 
+		TRY(read_missing());
+
 		return {};
 	}
 
@@ -263,18 +334,72 @@ namespace Kernel
 	{
 		ASSERT(buffer.size() >= sector_count * sector_size());
 
-		LockGuard _(m_mutex);
-
 		if (!m_disk_cache.has_value())
 			return write_sectors_impl(lba, sector_count, buffer);
 
-		for (uint8_t offset = 0; offset < sector_count; offset++)
+		const size_t sectors_per_page = m_disk_cache->sectors_per_page();
+
+		LockGuard _(m_mutex);
+
+		// Pages that could not be cached are written straight to the
+		// device, merging adjacent ones into a single command.
+		uint64_t uncached_first_sector = 0;
+		uint64_t uncached_sector_count = 0;
+
+		for (uint64_t sector = lba; sector < lba + sector_count;)
 		{
-			auto sector_buffer = buffer.slice(offset * sector_size(), sector_size());
-			if (m_disk_cache->write_to_cache(lba + offset, sector_buffer, true).is_error())
-				TRY(write_sectors_impl(lba + offset, 1, sector_buffer));
+			const uint64_t count = BAN::Math::min<uint64_t>(sectors_per_page - sector % sectors_per_page, lba + sector_count - sector);
+
+			if (m_disk_cache->write_to_cache(sector, count, buffer.slice((sector - lba) * sector_size(), count * sector_size()), true).is_error())
+			{
+				if (uncached_sector_count == 0)
+					uncached_first_sector = sector;
+				uncached_sector_count += count;
+			}
+			else if (uncached_sector_count > 0)
+			{
+				TRY(write_sectors_impl(uncached_first_sector, uncached_sector_count, buffer.slice((uncached_first_sector - lba) * sector_size(), uncached_sector_count * sector_size())));
+				uncached_sector_count = 0;
+			}
+
+			sector += count;
 		}
 
+		if (uncached_sector_count > 0)
+			TRY(write_sectors_impl(uncached_first_sector, uncached_sector_count, buffer.slice((uncached_first_sector - lba) * sector_size(), uncached_sector_count * sector_size())));
+
+		return {};
+	}
+
+	BAN::ErrorOr<void> StorageDevice::read_sectors_direct(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= sector_count * sector_size());
+
+		// Dirty cached sectors are newer than the device's contents
+		TRY(sync_sectors(lba, sector_count));
+
+		return read_sectors_impl(lba, sector_count, buffer);
+	}
+
+	BAN::ErrorOr<void> StorageDevice::write_sectors_direct(uint64_t lba, size_t sector_count, BAN::ConstByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= sector_count * sector_size());
+
+		if (!m_disk_cache.has_value())
+			return write_sectors_impl(lba, sector_count, buffer);
+
+		// Cached copies are dropped with m_mutex held, so a concurrent
+		// sync can not write them over the new contents
+		LockGuard _(m_mutex);
+		m_disk_cache->invalidate(lba, sector_count);
+		return write_sectors_impl(lba, sector_count, buffer);
+	}
+
+	BAN::ErrorOr<void> StorageDevice::sync_sectors(uint64_t lba, size_t sector_count)
+	{
+		LockGuard _(m_mutex);
+		if (m_disk_cache.has_value())
+			TRY(m_disk_cache->sync(lba, sector_count));
 		return {};
 	}
 
@@ -298,4 +423,24 @@ namespace Kernel
 		return buffer.size();
 	}
 
+	BAN::ErrorOr<size_t> StorageDevice::read_direct_impl(off_t offset, BAN::ByteSpan buffer)
+	{
+		if (offset % sector_size())
+			return BAN::Error::from_errno(EINVAL);
+		if (buffer.size() % sector_size())
+			return BAN::Error::from_errno(EINVAL);
+		TRY(read_sectors_direct(offset / sector_size(), buffer.size() / sector_size(), buffer));
+		return buffer.size();
+	}
+
+	BAN::ErrorOr<size_t> StorageDevice::write_direct_impl(off_t offset, BAN::ConstByteSpan buffer)
+	{
+		if (offset % sector_size())
+			return BAN::Error::from_errno(EINVAL);
+		if (buffer.size() % sector_size())
+			return BAN::Error::from_errno(EINVAL);
+		TRY(write_sectors_direct(offset / sector_size(), buffer.size() / sector_size(), buffer));
+		return buffer.size();
+	}
+
 }
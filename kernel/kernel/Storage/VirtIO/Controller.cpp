@@ -0,0 +1,324 @@
+#include <BAN/ScopeGuard.h>
+#include <kernel/Lock/LockGuard.h>
+#include <kernel/Processor.h>
+#include <kernel/Storage/VirtIO/Controller.h>
+#include <kernel/Timer/Timer.h>
+
+#define DEBUG_VIRTIO_BLK 1
+
+namespace Kernel
+{
+
+	static constexpr uint8_t PCI_REG_STATUS			= 0x06;
+	static constexpr uint8_t PCI_REG_CAPABILITIES	= 0x34;
+
+	static constexpr uint16_t s_max_queue_count = 16;
+	static constexpr uint16_t s_max_queue_size = 128;
+	static constexpr uint64_t s_reset_timeout_ms = 500;
+
+	BAN::ErrorOr<BAN::RefPtr<StorageController>> VirtIOBlockController::create(PCI::Device& pci_device)
+	{
+		if (pci_device.vendor_id() != VirtIO::PCI_VENDOR_ID)
+			return BAN::Error::from_errno(ENOTSUP);
+		if (pci_device.device_id() != VirtIO::PCI_DEVICE_ID_BLOCK && pci_device.device_id() != VirtIO::PCI_DEVICE_ID_BLOCK_TRANSITIONAL)
+			return BAN::Error::from_errno(ENOTSUP);
+
+		auto* controller_ptr = new VirtIOBlockController(pci_device);
+		if (controller_ptr == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		auto controller = BAN::RefPtr<StorageController>::adopt(controller_ptr);
+		TRY(controller->initialize());
+		return controller;
+	}
+
+	BAN::ErrorOr<void> VirtIOBlockController::initialize()
+	{
+		// See virtio specification section 3.1.1
+		m_pci_device.enable_bus_mastering();
+		m_pci_device.enable_memory_space();
+
+		TRY(find_capabilities());
+		if (!m_common_config || !m_notify_base || !m_isr || !m_device_config)
+		{
+			dwarnln("VirtIO device does not have modern PCI capabilities");
+			return BAN::Error::from_errno(ENOTSUP);
+		}
+
+		TRY(reset_device());
+
+		BAN::ScopeGuard fail_guard([this] { set_status_bit(VirtIO::STATUS_FAILED); });
+
+		set_status_bit(VirtIO::STATUS_ACKNOWLEDGE);
+		set_status_bit(VirtIO::STATUS_DRIVER);
+
+		TRY(negotiate_features());
+
+		VirtIO::BlockConfig config;
+		TRY(read_block_config(config));
+
+		const uint16_t max_queue_count = (m_features & VirtIO::BLK_FEATURE_MQ) ? config.num_queues : 1;
+		TRY(create_queues(BAN::Math::max<uint16_t>(max_queue_count, 1)));
+
+		set_status_bit(VirtIO::STATUS_DRIVER_OK);
+
+		const uint64_t capacity = (static_cast<uint64_t>(config.capacity_hi) << 32) | config.capacity_lo;
+
+		uint32_t block_size = VirtIO::BLK_SECTOR_SIZE;
+		if (m_features & VirtIO::BLK_FEATURE_BLK_SIZE)
+		{
+			const uint32_t reported = config.blk_size;
+			if (reported >= VirtIO::BLK_SECTOR_SIZE && reported <= PAGE_SIZE && BAN::Math::is_power_of_two(reported))
+				block_size = reported;
+			else
+				dwarnln("VirtIO block device reported invalid block size {}, using {}", reported, block_size);
+		}
+
+		dprintln_if(DEBUG_VIRTIO_BLK, "VirtIO block device");
+		dprintln_if(DEBUG_VIRTIO_BLK, "  capacity:   {} sectors", capacity);
+		dprintln_if(DEBUG_VIRTIO_BLK, "  block size: {} bytes", block_size);
+		dprintln_if(DEBUG_VIRTIO_BLK, "  queues:     {}{}", m_queues.size(), m_has_msi_x ? " (MSI-X)" : "");
+
+		m_device = TRY(VirtIOBlockDevice::create(*this, capacity, block_size));
+
+		fail_guard.disable();
+
+		StorageController::ref();
+
+		return {};
+	}
+
+	BAN::ErrorOr<void> VirtIOBlockController::find_capabilities()
+	{
+		if (!(m_pci_device.read_word(PCI_REG_STATUS) & (1 << 4)))
+			return {};
+
+		uint8_t capability_offset = m_pci_device.read_byte(PCI_REG_CAPABILITIES) & 0xFC;
+		while (capability_offset)
+		{
+			const uint8_t capability_id = m_pci_device.read_byte(capability_offset + offsetof(VirtIO::PCICapability, cap_vndr));
+
+			if (capability_id == VirtIO::PCI_CAPABILITY_MSI_X)
+				m_has_msi_x = true;
+			else if (capability_id == VirtIO::PCI_CAPABILITY_VENDOR)
+			{
+				// Only the first capability of each type is used
+				switch (m_pci_device.read_byte(capability_offset + offsetof(VirtIO::PCICapability, cfg_type)))
+				{
+					case VirtIO::PCI_CAP_COMMON_CFG:
+						if (!m_common_config)
+							m_common_config = reinterpret_cast<volatile VirtIO::CommonConfig*>(TRY(map_capability(capability_offset)));
+						break;
+					case VirtIO::PCI_CAP_NOTIFY_CFG:
+						if (!m_notify_base)
+						{
+							m_notify_base = TRY(map_capability(capability_offset));
+							m_notify_off_multiplier = m_pci_device.read_dword(capability_offset + VirtIO::PCI_NOTIFY_CAP_MULTIPLIER);
+						}
+						break;
+					case VirtIO::PCI_CAP_ISR_CFG:
+						if (!m_isr)
+							m_isr = reinterpret_cast<volatile uint8_t*>(TRY(map_capability(capability_offset)));
+						break;
+					case VirtIO::PCI_CAP_DEVICE_CFG:
+						if (!m_device_config)
+							m_device_config = TRY(map_capability(capability_offset));
+						break;
+					default:
+						break;
+				}
+			}
+
+			capability_offset = m_pci_device.read_byte(capability_offset + offsetof(VirtIO::PCICapability, cap_next)) & 0xFC;
+		}
+
+		return {};
+	}
+
+	BAN::ErrorOr<vaddr_t> VirtIOBlockController::map_capability(uint8_t capability_offset)
+	{
+		const uint8_t bar = m_pci_device.read_byte(capability_offset + offsetof(VirtIO::PCICapability, bar));
+		const uint32_t offset = m_pci_device.read_dword(capability_offset + offsetof(VirtIO::PCICapability, offset));
+		const uint32_t length = m_pci_device.read_dword(capability_offset + offsetof(VirtIO::PCICapability, length));
+
+		if (bar >= m_bars.size())
+		{
+			dwarnln("VirtIO capability uses invalid BAR{}", bar);
+			return BAN::Error::from_errno(EINVAL);
+		}
+
+		if (!m_bars[bar])
+			m_bars[bar] = TRY(m_pci_device.allocate_bar_region(bar));
+
+		if (m_bars[bar]->type() != PCI::BarType::MEM)
+		{
+			dwarnln("VirtIO capability BAR{} is not MEM", bar);
+			return BAN::Error::from_errno(ENOTSUP);
+		}
+
+		if (static_cast<uint64_t>(offset) + length > m_bars[bar]->size())
+		{
+			dwarnln("VirtIO capability does not fit in BAR{}", bar);
+			return BAN::Error::from_errno(EINVAL);
+		}
+
+		return m_bars[bar]->vaddr() + offset;
+	}
+
+	BAN::ErrorOr<void> VirtIOBlockController::reset_device()
+	{
+		m_common_config->device_status = 0;
+		const uint64_t timeout = SystemTimer::get().ms_since_boot() + s_reset_timeout_ms;
+		while (m_common_config->device_status != 0)
+		{
+			if (SystemTimer::get().ms_since_boot() >= timeout)
+			{
+				dwarnln("VirtIO device reset timedout");
+				return BAN::Error::from_errno(ETIMEDOUT);
+			}
+		}
+		return {};
+	}
+
+	void VirtIOBlockController::reset_after_timeout()
+	{
+		LockGuard _(m_reset_mutex);
+		if (m_failed)
+			return;
+		m_failed = true;
+
+		dwarnln("VirtIO block device stopped responding, resetting it");
+
+		// After a reset the device no longer accesses the queues or buffers, see virtio specification section 2.4.
+		// If even the reset does not complete, memory access is cut off from the device instead.
+		if (reset_device().is_error())
+			m_pci_device.disable_bus_mastering();
+
+		for (auto& queue : m_queues)
+			queue->mark_dead();
+	}
+
+	void VirtIOBlockController::set_status_bit(uint8_t bit)
+	{
+		m_common_config->device_status = m_common_config->device_status | bit;
+	}
+
+	BAN::ErrorOr<void> VirtIOBlockController::negotiate_features()
+	{
+		m_common_config->device_feature_select = 0;
+		uint64_t device_features = m_common_config->device_feature;
+		m_common_config->device_feature_select = 1;
+		device_features |= static_cast<uint64_t>(m_common_config->device_feature) << 32;
+
+		if (!(device_features & VirtIO::FEATURE_VERSION_1))
+		{
+			dwarnln("VirtIO device does not support version 1");
+			return BAN::Error::from_errno(ENOTSUP);
+		}
+
+		// Flush is not negotiated, which keeps the device in write through mode
+		m_features = device_features & (VirtIO::FEATURE_VERSION_1 | VirtIO::BLK_FEATURE_BLK_SIZE | VirtIO::BLK_FEATURE_MQ);
+
+		m_common_config->driver_feature_select = 0;
+		m_common_config->driver_feature = m_features & 0xFFFFFFFF;
+		m_common_config->driver_feature_select = 1;
+		m_common_config->driver_feature = m_features >> 32;
+
+		set_status_bit(VirtIO::STATUS_FEATURES_OK);
+		if (!(m_common_config->device_status & VirtIO::STATUS_FEATURES_OK))
+		{
+			dwarnln("VirtIO device did not accept features {16H}", m_features);
+			return BAN::Error::from_errno(ENOTSUP);
+		}
+
+		return {};
+	}
+
+	BAN::ErrorOr<void> VirtIOBlockController::read_block_config(VirtIO::BlockConfig& config)
+	{
+		const auto& device_config = *reinterpret_cast<volatile VirtIO::BlockConfig*>(m_device_config);
+
+		// Configuration may change while it is being read, see virtio specification section 2.5.1
+		uint8_t generation;
+		do
+		{
+			generation = m_common_config->config_generation;
+			config.capacity_lo = device_config.capacity_lo;
+			config.capacity_hi = device_config.capacity_hi;
+			config.blk_size = device_config.blk_size;
+			config.num_queues = device_config.num_queues;
+		} while (generation != m_common_config->config_generation);
+
+		return {};
+	}
+
+	BAN::ErrorOr<void> VirtIOBlockController::create_queues(uint16_t max_queue_count)
+	{
+		uint16_t queue_count = BAN::Math::min<uint16_t>(max_queue_count, m_common_config->num_queues);
+		queue_count = BAN::Math::min<uint16_t>(queue_count, Processor::count());
+		queue_count = BAN::Math::min<uint16_t>(queue_count, s_max_queue_count);
+
+		// Every queue gets its own MSI-X vector, without MSI-X only a single queue is used.
+		// Configuration change interrupts are not used.
+		bool irqs_reserved = false;
+		if (m_has_msi_x && queue_count > 1)
+			irqs_reserved = !m_pci_device.reserve_irqs(queue_count).is_error();
+		if (!irqs_reserved)
+		{
+			queue_count = 1;
+			TRY(m_pci_device.reserve_irqs(1));
+		}
+
+		if (m_has_msi_x)
+			m_common_config->config_msix_vector = VirtIO::NO_VECTOR;
+
+		TRY(m_queues.reserve(queue_count));
+		for (uint16_t i = 0; i < queue_count; i++)
+		{
+			m_common_config->queue_select = i;
+
+			const uint16_t max_queue_size = m_common_config->queue_size;
+			if (max_queue_size == 0)
+			{
+				dwarnln("VirtIO queue {} is not available", i);
+				return BAN::Error::from_errno(EINVAL);
+			}
+
+			const uint16_t queue_size = BAN::Math::min(max_queue_size, s_max_queue_size);
+			auto queue = TRY(VirtIOQueue::create(queue_size));
+
+			m_common_config->queue_size = queue_size;
+			m_common_config->queue_desc_lo   = queue->descriptor_area_paddr() & 0xFFFFFFFF;
+			m_common_config->queue_desc_hi   = static_cast<uint64_t>(queue->descriptor_area_paddr()) >> 32;
+			m_common_config->queue_driver_lo = queue->driver_area_paddr() & 0xFFFFFFFF;
+			m_common_config->queue_driver_hi = static_cast<uint64_t>(queue->driver_area_paddr()) >> 32;
+			m_common_config->queue_device_lo = queue->device_area_paddr() & 0xFFFFFFFF;
+			m_common_config->queue_device_hi = static_cast<uint64_t>(queue->device_area_paddr()) >> 32;
+
+			if (m_has_msi_x)
+			{
+				m_common_config->queue_msix_vector = i;
+				if (m_common_config->queue_msix_vector != i)
+				{
+					dwarnln("VirtIO device could not assign MSI-X vector to queue {}", i);
+					return BAN::Error::from_errno(EFAULT);
+				}
+			}
+
+			auto* notify = reinterpret_cast<volatile uint16_t*>(m_notify_base + m_common_config->queue_notify_off * m_notify_off_multiplier);
+			queue->initialize(notify, i, m_pci_device.get_irq(i), m_has_msi_x ? nullptr : m_isr);
+
+			m_common_config->queue_enable = 1;
+
+			MUST(m_queues.push_back(BAN::move(queue)));
+		}
+
+		return {};
+	}
+
+	VirtIOQueue& VirtIOBlockController::queue_for_current_processor()
+	{
+		ASSERT(!m_queues.empty());
+		return *m_queues[Processor::current_id() % m_queues.size()];
+	}
+
+}
@@ -0,0 +1,214 @@
+#include <BAN/ScopeGuard.h>
+#include <kernel/Device/DeviceNumbers.h>
+#include <kernel/FS/DevFS/FileSystem.h>
+#include <kernel/Memory/kmalloc.h>
+#include <kernel/Storage/VirtIO/Controller.h>
+#include <kernel/Storage/VirtIO/Device.h>
+
+#include <sys/sysmacros.h>
+
+namespace Kernel
+{
+
+	// Data descriptors per request, header and status take two more
+	static constexpr size_t s_max_data_segments = 32;
+	static constexpr uint64_t s_max_request_bytes = 1024 * 1024;
+	static constexpr uint64_t s_bounce_buffer_bytes = 64 * 1024;
+
+	static dev_t get_vd_dev_minor()
+	{
+		static dev_t minor = 0;
+		return minor++;
+	}
+
+	BAN::ErrorOr<BAN::RefPtr<VirtIOBlockDevice>> VirtIOBlockDevice::create(VirtIOBlockController& controller, uint64_t capacity, uint32_t block_size)
+	{
+		auto* device_ptr = new VirtIOBlockDevice(controller, capacity, block_size);
+		if (device_ptr == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		auto device = BAN::RefPtr<VirtIOBlockDevice>::adopt(device_ptr);
+		TRY(device->initialize());
+		return device;
+	}
+
+	VirtIOBlockDevice::VirtIOBlockDevice(VirtIOBlockController& controller, uint64_t capacity, uint32_t block_size)
+		: m_controller(controller)
+		, m_capacity(capacity)
+		, m_block_size(block_size)
+		, m_rdev(makedev(DeviceNumber::VirtIOBlock, get_vd_dev_minor()))
+	{
+		ASSERT(minor(m_rdev) < 26);
+		strcpy(m_name, "vda");
+		m_name[2] += minor(m_rdev);
+	}
+
+	BAN::ErrorOr<void> VirtIOBlockDevice::initialize()
+	{
+		add_disk_cache();
+
+		DevFileSystem::get().add_device(this);
+
+		if (auto res = initialize_partitions(name()); res.is_error())
+			dprintln("{}", res.error());
+
+		return {};
+	}
+
+	size_t VirtIOBlockDevice::max_concurrent_requests() const
+	{
+		return m_controller.queue_count();
+	}
+
+	BAN::ErrorOr<void> VirtIOBlockDevice::read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= sector_count * m_block_size);
+		return transfer_sectors(VirtIO::BLK_T_IN, lba, sector_count, buffer.data());
+	}
+
+	BAN::ErrorOr<void> VirtIOBlockDevice::write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= sector_count * m_block_size);
+		// buffer is only read from, the device is never given write access to it
+		return transfer_sectors(VirtIO::BLK_T_OUT, lba, sector_count, const_cast<uint8_t*>(buffer.data()));
+	}
+
+	uint64_t VirtIOBlockDevice::prepare_data_buffers(BAN::Vector<VirtIOQueue::Buffer>& buffers, vaddr_t buffer, uint64_t sector_count, bool device_writable)
+	{
+		// Only kernel memory is guaranteed to stay mapped during the transfer
+		if (buffer < KERNEL_OFFSET)
+			return 0;
+
+		const size_t first_buffer = buffers.size();
+		const uint64_t total_bytes = BAN::Math::min<uint64_t>(sector_count, s_max_request_bytes / m_block_size) * m_block_size;
+
+		uint64_t bytes = 0;
+		paddr_t buffer_end = 0;
+		while (bytes < total_bytes)
+		{
+			const vaddr_t vaddr = buffer + bytes;
+			const paddr_t page_paddr = PageTable::kernel().physical_address_of(vaddr & PAGE_ADDR_MASK);
+			if (page_paddr == 0)
+				break;
+
+			const paddr_t paddr = page_paddr + vaddr % PAGE_SIZE;
+			const uint64_t length = BAN::Math::min<uint64_t>(PAGE_SIZE - vaddr % PAGE_SIZE, total_bytes - bytes);
+
+			if (buffers.size() > first_buffer && paddr == buffer_end)
+				buffers.back().size += length;
+			else
+			{
+				if (buffers.size() - first_buffer >= s_max_data_segments)
+					break;
+				MUST(buffers.push_back({
+					.paddr = paddr,
+					.size = static_cast<uint32_t>(length),
+					.device_writable = device_writable,
+				}));
+			}
+
+			buffer_end = paddr + length;
+			bytes += length;
+		}
+
+		// Drop partial sector from the end of the list
+		uint64_t excess = bytes % m_block_size;
+		while (excess > 0)
+		{
+			auto& last = buffers.back();
+			if (last.size > excess)
+			{
+				last.size -= excess;
+				break;
+			}
+			excess -= last.size;
+			buffers.pop_back();
+		}
+
+		return bytes / m_block_size;
+	}
+
+	BAN::ErrorOr<void> VirtIOBlockDevice::transfer_sectors(VirtIO::BlockRequestType type, uint64_t lba, uint64_t sector_count, uint8_t* buffer)
+	{
+		const bool device_writable = (type == VirtIO::BLK_T_IN);
+		const uint64_t sectors_per_block = m_block_size / VirtIO::BLK_SECTOR_SIZE;
+
+		BAN::Vector<VirtIOQueue::Buffer> buffers;
+		TRY(buffers.reserve(s_max_data_segments + 2));
+
+		for (uint64_t i = 0; i < sector_count;)
+		{
+			uint8_t* const data = buffer + i * m_block_size;
+
+			buffers.clear();
+			MUST(buffers.push_back({}));
+
+			uint8_t* bounce_buffer = nullptr;
+			BAN::ScopeGuard bounce_guard([&bounce_buffer] { if (bounce_buffer) kfree(bounce_buffer); });
+
+			uint64_t count = prepare_data_buffers(buffers, reinterpret_cast<vaddr_t>(data), sector_count - i, device_writable);
+			if (count == 0)
+			{
+				// Transfer through a temporary kernel buffer
+				const uint64_t bounce_count = BAN::Math::max<uint64_t>(1, BAN::Math::min<uint64_t>(sector_count - i, s_bounce_buffer_bytes / m_block_size));
+				bounce_buffer = static_cast<uint8_t*>(kmalloc(bounce_count * m_block_size));
+				if (bounce_buffer == nullptr)
+					return BAN::Error::from_errno(ENOMEM);
+				count = prepare_data_buffers(buffers, reinterpret_cast<vaddr_t>(bounce_buffer), bounce_count, device_writable);
+				ASSERT(count > 0);
+				if (type == VirtIO::BLK_T_OUT)
+					memcpy(bounce_buffer, data, count * m_block_size);
+			}
+
+			auto& queue = m_controller.queue_for_current_processor();
+			const uint16_t head = TRY(queue.reserve_chain(buffers.size() + 1));
+
+			const vaddr_t scratch_vaddr = queue.chain_scratch_vaddr(head);
+			const paddr_t scratch_paddr = queue.chain_scratch_paddr(head);
+
+			auto& header = *reinterpret_cast<volatile VirtIO::BlockRequestHeader*>(scratch_vaddr);
+			header.type = type;
+			header.reserved = 0;
+			header.sector = (lba + i) * sectors_per_block;
+
+			auto& status = *reinterpret_cast<volatile uint8_t*>(scratch_vaddr + sizeof(VirtIO::BlockRequestHeader));
+			status = 0xFF;
+
+			buffers[0] = {
+				.paddr = scratch_paddr,
+				.size = sizeof(VirtIO::BlockRequestHeader),
+				.device_writable = false,
+			};
+			MUST(buffers.push_back({
+				.paddr = scratch_paddr + sizeof(VirtIO::BlockRequestHeader),
+				.size = 1,
+				.device_writable = true,
+			}));
+
+			if (auto result = queue.submit_chain(head, buffers.span()); result.is_error())
+			{
+				// Device may still write to the buffers, they can only be released after a reset
+				if (result.error().get_error_code() == ETIMEDOUT)
+					m_controller.reset_after_timeout();
+				queue.release_chain(head);
+				return result.release_error();
+			}
+
+			const uint8_t request_status = status;
+			queue.release_chain(head);
+
+			if (request_status != VirtIO::BLK_S_OK)
+			{
+				dwarnln("VirtIO block {} failed (status {})", type == VirtIO::BLK_T_IN ? "read" : "write", request_status);
+				return BAN::Error::from_errno(EIO);
+			}
+
+			if (bounce_buffer && type == VirtIO::BLK_T_IN)
+				memcpy(data, bounce_buffer, count * m_block_size);
+
+			i += count;
+		}
+
+		return {};
+	}
+
+}
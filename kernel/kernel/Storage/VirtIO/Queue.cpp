@@ -0,0 +1,234 @@
+#include <BAN/Limits.h>
+#include <kernel/Storage/VirtIO/Queue.h>
+#include <kernel/Timer/Timer.h>
+
+namespace Kernel
+{
+
+	static constexpr uint64_t s_virtio_command_timeout_ms = 5000;
+	static constexpr uint64_t s_virtio_command_poll_timeout_ms = 1;
+
+	static constexpr uint16_t VIRTQ_USED_F_NO_NOTIFY = 1;
+
+	BAN::ErrorOr<BAN::UniqPtr<VirtIOQueue>> VirtIOQueue::create(uint16_t queue_size)
+	{
+		ASSERT(queue_size > 0);
+		auto* queue_ptr = new VirtIOQueue(queue_size);
+		if (queue_ptr == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		auto queue = BAN::UniqPtr<VirtIOQueue>::adopt(queue_ptr);
+		TRY(queue->initialize_rings());
+		return queue;
+	}
+
+	BAN::ErrorOr<void> VirtIOQueue::initialize_rings()
+	{
+		// descriptor table is 16 byte, driver area 2 byte and device area 4 byte aligned
+		m_driver_area_offset = m_size * sizeof(VirtIO::VirtqDescriptor);
+		const size_t driver_area_size = sizeof(VirtIO::VirtqAvail) + m_size * sizeof(uint16_t) + sizeof(uint16_t);
+		m_device_area_offset = BAN::Math::div_round_up<size_t>(m_driver_area_offset + driver_area_size, 4) * 4;
+		const size_t device_area_size = sizeof(VirtIO::VirtqUsed) + m_size * sizeof(VirtIO::VirtqUsedElement) + sizeof(uint16_t);
+
+		m_ring_region = TRY(DMARegion::create(m_device_area_offset + device_area_size));
+		memset(reinterpret_cast<void*>(m_ring_region->vaddr()), 0, m_ring_region->size());
+
+		m_scratch_region = TRY(DMARegion::create(m_size * chain_scratch_size));
+		memset(reinterpret_cast<void*>(m_scratch_region->vaddr()), 0, m_scratch_region->size());
+
+		TRY(m_chain_lengths.resize(m_size, 0));
+		TRY(m_chain_done.resize(m_size, 0));
+
+		// free descriptors are linked through their next field
+		for (uint16_t i = 0; i < m_size; i++)
+			descriptor(i).next = i + 1;
+		m_free_head = 0;
+		m_free_count = m_size;
+
+		return {};
+	}
+
+	void VirtIOQueue::initialize(volatile uint16_t* notify, uint16_t queue_index, uint8_t irq, volatile uint8_t* isr)
+	{
+		m_notify = notify;
+		m_queue_index = queue_index;
+		m_isr = isr;
+		set_irq(irq);
+		enable_interrupt();
+	}
+
+	volatile VirtIO::VirtqDescriptor& VirtIOQueue::descriptor(uint16_t index)
+	{
+		ASSERT(index < m_size);
+		return reinterpret_cast<volatile VirtIO::VirtqDescriptor*>(m_ring_region->vaddr())[index];
+	}
+
+	volatile VirtIO::VirtqAvail& VirtIOQueue::avail()
+	{
+		return *reinterpret_cast<volatile VirtIO::VirtqAvail*>(m_ring_region->vaddr() + m_driver_area_offset);
+	}
+
+	volatile VirtIO::VirtqUsed& VirtIOQueue::used()
+	{
+		return *reinterpret_cast<volatile VirtIO::VirtqUsed*>(m_ring_region->vaddr() + m_device_area_offset);
+	}
+
+	void VirtIOQueue::handle_irq()
+	{
+		// reading isr acknowledges pin based interrupts
+		if (m_isr)
+			(void)*m_isr;
+
+		{
+			SpinLockGuard _(m_lock);
+			update_used_ring();
+		}
+
+		m_semaphore.unblock();
+	}
+
+	void VirtIOQueue::update_used_ring()
+	{
+		ASSERT(m_lock.current_processor_has_lock());
+
+		const uint16_t used_idx = used().idx;
+		while (m_last_used_idx != used_idx)
+		{
+			const uint32_t head = used().ring[m_last_used_idx % m_size].id;
+			if (head < m_size)
+				m_chain_done[head] = 1;
+			else
+				dwarnln("VirtIO device used invalid descriptor {}", head);
+			m_last_used_idx++;
+		}
+	}
+
+	void VirtIOQueue::mark_dead()
+	{
+		{
+			SpinLockGuard _(m_lock);
+			m_dead = true;
+		}
+
+		m_semaphore.unblock();
+	}
+
+	BAN::ErrorOr<uint16_t> VirtIOQueue::reserve_chain(uint16_t descriptor_count)
+	{
+		ASSERT(descriptor_count > 0 && descriptor_count <= m_size);
+
+		auto state = m_lock.lock();
+		while (!m_dead && m_free_count < descriptor_count)
+		{
+			const uint32_t wake_count = m_semaphore.wake_count();
+			m_lock.unlock(state);
+			m_semaphore.block_with_wake_time(BAN::numeric_limits<uint64_t>::max(), wake_count);
+			state = m_lock.lock();
+		}
+
+		if (m_dead)
+		{
+			m_lock.unlock(state);
+			return BAN::Error::from_errno(EIO);
+		}
+
+		const uint16_t head = m_free_head;
+		uint16_t last = head;
+		for (uint16_t i = 1; i < descriptor_count; i++)
+			last = descriptor(last).next;
+
+		m_free_head = descriptor(last).next;
+		m_free_count -= descriptor_count;
+
+		m_chain_lengths[head] = descriptor_count;
+		m_chain_done[head] = 0;
+
+		m_lock.unlock(state);
+		return head;
+	}
+
+	void VirtIOQueue::release_chain(uint16_t head)
+	{
+		{
+			SpinLockGuard _(m_lock);
+
+			const uint16_t length = m_chain_lengths[head];
+			ASSERT(length > 0);
+
+			uint16_t last = head;
+			for (uint16_t i = 1; i < length; i++)
+				last = descriptor(last).next;
+
+			descriptor(last).next = m_free_head;
+			m_free_head = head;
+			m_free_count += length;
+
+			m_chain_lengths[head] = 0;
+		}
+
+		m_semaphore.unblock();
+	}
+
+	BAN::ErrorOr<void> VirtIOQueue::submit_chain(uint16_t head, BAN::Span<const Buffer> buffers)
+	{
+		ASSERT(buffers.size() == m_chain_lengths[head]);
+
+		uint16_t index = head;
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			auto& desc = descriptor(index);
+			desc.addr = buffers[i].paddr;
+			desc.len = buffers[i].size;
+			desc.flags = (buffers[i].device_writable ? VirtIO::VIRTQ_DESC_F_WRITE : 0)
+					   | (i + 1 < buffers.size() ? VirtIO::VIRTQ_DESC_F_NEXT : 0);
+			index = desc.next;
+		}
+
+		{
+			SpinLockGuard _(m_lock);
+
+			if (m_dead)
+				return BAN::Error::from_errno(EIO);
+
+			avail().ring[m_avail_idx % m_size] = head;
+			// descriptors and the ring entry have to be visible before the index
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			avail().idx = ++m_avail_idx;
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+			if (!(used().flags & VIRTQ_USED_F_NO_NOTIFY))
+				*m_notify = m_queue_index;
+		}
+
+		// Returns true once the device has used the chain, error if the device was reset before that
+		const auto is_done =
+			[this, head]() -> BAN::ErrorOr<bool>
+			{
+				SpinLockGuard _(m_lock);
+				update_used_ring();
+				if (m_chain_done[head])
+					return true;
+				if (m_dead)
+					return BAN::Error::from_errno(EIO);
+				return false;
+			};
+
+		const uint64_t start_time = SystemTimer::get().ms_since_boot();
+		while (!TRY(is_done()) && SystemTimer::get().ms_since_boot() < start_time + s_virtio_command_poll_timeout_ms)
+			continue;
+
+		const uint64_t timeout_time = start_time + s_virtio_command_timeout_ms;
+		for (;;)
+		{
+			const uint32_t wake_count = m_semaphore.wake_count();
+			if (TRY(is_done()))
+				return {};
+			if (SystemTimer::get().ms_since_boot() >= timeout_time)
+			{
+				dwarnln("VirtIO request timed out");
+				return BAN::Error::from_errno(ETIMEDOUT);
+			}
+			m_semaphore.block_with_wake_time(timeout_time, wake_count);
+		}
+	}
+
+}
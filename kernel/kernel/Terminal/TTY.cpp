@@ -221,6 +221,7 @@ namespace Kernel
 		{
 			m_output.flush = true;
 			m_output.semaphore.unblock();
+			notify_waiters();
 			return;
 		}
 
@@ -263,6 +264,7 @@ namespace Kernel
 		{
 			m_output.flush = true;
 			m_output.semaphore.unblock();
+			notify_waiters();
 		}
 	}
 
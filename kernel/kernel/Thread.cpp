@@ -220,12 +220,13 @@ namespace Kernel
 			write_to_stack(sp, userspace_info.argc);
 			write_to_stack(sp, userspace_info.argv);
 			write_to_stack(sp, userspace_info.envp);
+			write_to_stack(sp, SystemTimer::get().user_clock_page());
 		});
 
 		m_interrupt_stack.ip = reinterpret_cast<vaddr_t>(start_userspace_thread);;
 		m_interrupt_stack.cs = 0x08;
 		m_interrupt_stack.flags = 0x002;
-		m_interrupt_stack.sp = kernel_stack_top() - 4 * sizeof(uintptr_t);
+		m_interrupt_stack.sp = kernel_stack_top() - 5 * sizeof(uintptr_t);
 		m_interrupt_stack.ss = 0x10;
 
 		memset(&m_interrupt_registers, 0, sizeof(InterruptRegisters));
@@ -455,6 +456,18 @@ namespace Kernel
 		return {};
 	}
 
+	BAN::ErrorOr<void> Thread::block_or_eintr_or_waketime(Semaphore& semaphore, uint64_t wake_time_ms, bool etimedout, uint32_t wake_count)
+	{
+		if (is_interrupted_by_signal())
+			return BAN::Error::from_errno(EINTR);
+		semaphore.block_with_wake_time(wake_time_ms, wake_count);
+		if (is_interrupted_by_signal())
+			return BAN::Error::from_errno(EINTR);
+		if (etimedout && SystemTimer::get().ms_since_boot() >= wake_time_ms)
+			return BAN::Error::from_errno(ETIMEDOUT);
+		return {};
+	}
+
 	void Thread::on_exit_trampoline(Thread* thread)
 	{
 		thread->on_exit();
@@ -6,6 +6,7 @@
 #include <kernel/MMIO.h>
 #include <kernel/Scheduler.h>
 #include <kernel/Timer/HPET.h>
+#include <kernel/Timer/Timer.h>
 
 #define HPET_PERIOD_MAX 0x05F5E100
 
@@ -272,6 +273,9 @@ namespace Kernel
 			m_last_ticks = current_ticks;
 		}
 
+		if (SystemTimer::is_initialized())
+			SystemTimer::get().update_clock_page();
+
 		Scheduler::get().timer_reschedule();
 	}
 
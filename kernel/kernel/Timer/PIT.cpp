@@ -3,6 +3,7 @@
 #include <kernel/IO.h>
 #include <kernel/Scheduler.h>
 #include <kernel/Timer/PIT.h>
+#include <kernel/Timer/Timer.h>
 
 #define PIT_IRQ 0
 
@@ -55,6 +56,9 @@ namespace Kernel
 	void PIT::handle_irq()
 	{
 		m_system_time = m_system_time + 1;
+		if (SystemTimer::is_initialized())
+			SystemTimer::get().update_clock_page();
+
 		Kernel::Scheduler::get().timer_reschedule();
 	}
 
@@ -1,3 +1,7 @@
+#include <kernel/CPUID.h>
+#include <kernel/Memory/Heap.h>
+#include <kernel/Memory/PageTable.h>
+#include <kernel/Processor.h>
 #include <kernel/Scheduler.h>
 #include <kernel/Timer/HPET.h>
 #include <kernel/Timer/PIT.h>
@@ -14,6 +18,7 @@ namespace Kernel
 		auto* temp = new SystemTimer;
 		ASSERT(temp);
 		temp->initialize_timers(force_pic);
+		temp->initialize_clock_page();
 		s_instance = temp;
 	}
 
@@ -54,6 +59,108 @@ namespace Kernel
 		Kernel::panic("Could not initialize any timer");
 	}
 
+	void SystemTimer::initialize_clock_page()
+	{
+		const paddr_t paddr = Heap::get().take_free_page();
+		ASSERT(paddr);
+
+		// Kernel writes through its own mapping, userspace only gets a read only one
+		const vaddr_t kernel_vaddr = PageTable::kernel().reserve_free_page(KERNEL_OFFSET);
+		ASSERT(kernel_vaddr);
+		PageTable::kernel().map_page_at(paddr, kernel_vaddr, PageTable::Flags::ReadWrite | PageTable::Flags::Present);
+
+		const vaddr_t user_vaddr = PageTable::kernel().reserve_free_page(KERNEL_OFFSET);
+		ASSERT(user_vaddr);
+		PageTable::kernel().map_page_at(paddr, user_vaddr, PageTable::Flags::UserSupervisor | PageTable::Flags::Present);
+
+		m_clock_page = reinterpret_cast<clock_page_t*>(kernel_vaddr);
+		m_user_clock_page = reinterpret_cast<const clock_page_t*>(user_vaddr);
+
+		memset(m_clock_page, 0, PAGE_SIZE);
+		m_clock_page->boot_time = m_boot_time;
+	}
+
+	static uint64_t read_tsc()
+	{
+		uint32_t low, high;
+		asm volatile("rdtsc" : "=a"(low), "=d"(high));
+		return (static_cast<uint64_t>(high) << 32) | low;
+	}
+
+	static uint64_t clock_page_tsc_to_ns(const clock_page_t& clock_page, uint64_t tsc)
+	{
+		const uint64_t delta = tsc - clock_page.tsc_base;
+		const uint64_t high = (delta >> 32) * clock_page.tsc_mult;
+		const uint64_t low = (delta & 0xFFFFFFFF) * clock_page.tsc_mult;
+		return clock_page.ns_base + (high << (32 - clock_page.tsc_shift)) + (low >> clock_page.tsc_shift);
+	}
+
+	void SystemTimer::update_clock_page()
+	{
+		constexpr uint64_t update_interval_ns = 1'000'000'000;
+		constexpr uint64_t max_step_ns = 10'000'000;
+
+		if (m_tsc_unusable)
+			return;
+
+		const uint64_t ns = ns_since_boot();
+		if (m_last_update_ns && ns - m_last_update_ns < update_interval_ns)
+			return;
+
+		if (m_last_update_ns == 0)
+		{
+			// Userspace may read TSC on any processor, so it has to run at constant rate on all of them
+			uint32_t ecx, edx;
+			CPUID::get_features(ecx, edx);
+			if (!(edx & CPUID::Features::EDX_TSC) || (!CPUID::has_invariant_tsc() && Processor::count() > 1))
+			{
+				dwarnln("TSC not usable, clock_gettime uses syscalls");
+				m_tsc_unusable = true;
+				return;
+			}
+		}
+
+		const uint64_t tsc = read_tsc();
+		const uint64_t elapsed_tsc = tsc - m_last_update_tsc;
+		const uint64_t elapsed_ns = ns - m_last_update_ns;
+		const bool has_previous_sample = (m_last_update_ns != 0);
+		m_last_update_tsc = tsc;
+		m_last_update_ns = ns;
+
+		// Interrupts were delayed for too long, start calibrating from this sample
+		if (!has_previous_sample || elapsed_tsc == 0 || elapsed_ns >= 2 * update_interval_ns)
+			return;
+
+		// Continue the published clock from its current value, and slew it towards the
+		// system timer during the next interval. Only step forward on large errors.
+		uint64_t clock_ns = ns;
+		uint64_t target_ns = elapsed_ns;
+		if (m_clock_page->flags & CLOCK_PAGE_FLAG_TSC)
+		{
+			clock_ns = clock_page_tsc_to_ns(*m_clock_page, tsc);
+			if (ns > clock_ns + max_step_ns)
+				clock_ns = ns;
+			else if (ns >= clock_ns)
+				target_ns += BAN::Math::min(ns - clock_ns, elapsed_ns / 2);
+			else
+				target_ns -= BAN::Math::min(clock_ns - ns, elapsed_ns / 2);
+		}
+
+		uint32_t shift = 32;
+		while (shift > 0 && (target_ns >> (64 - shift) || (target_ns << shift) / elapsed_tsc > 0xFFFFFFFF))
+			shift--;
+		const uint32_t mult = (target_ns << shift) / elapsed_tsc;
+
+		const uint32_t seq = m_clock_page->seq;
+		m_clock_page->seq = seq + 1;
+		m_clock_page->tsc_base = tsc;
+		m_clock_page->ns_base = clock_ns;
+		m_clock_page->tsc_mult = mult;
+		m_clock_page->tsc_shift = shift;
+		m_clock_page->flags = m_clock_page->flags | CLOCK_PAGE_FLAG_TSC;
+		m_clock_page->seq = seq + 2;
+	}
+
 	uint64_t SystemTimer::ms_since_boot() const
 	{
 		return m_timer->ms_since_boot();
@@ -22,6 +22,7 @@
 #include <kernel/Processor.h>
 #include <kernel/Random.h>
 #include <kernel/Scheduler.h>
+#include <kernel/Storage/RamDisk.h>
 #include <kernel/Syscall.h>
 #include <kernel/Terminal/FramebufferTerminal.h>
 #include <kernel/Terminal/Serial.h>
@@ -36,6 +37,7 @@ struct ParsedCommandLine
 	bool disable_serial	= false;
 	BAN::StringView console = "tty0"_sv;
 	BAN::StringView root;
+	BAN::StringView ramdisk;
 };
 
 static bool should_disable_serial(BAN::StringView full_command_line)
@@ -74,6 +76,8 @@ static void parse_command_line()
 			cmdline.root = argument.substring(5);
 		else if (argument.size() > 8 && argument.substring(0, 8) == "console=")
 			cmdline.console = argument.substring(8);
+		else if (argument.size() > 8 && argument.substring(0, 8) == "ramdisk=")
+			cmdline.ramdisk = argument.substring(8);
 	}
 }
 
@@ -210,6 +214,9 @@ static void init2(void*)
 	PCI::PCIManager::get().initialize_devices();
 	dprintln("PCI devices initialized");
 
+	RamDiskDevice::initialize_devices(cmdline.ramdisk);
+	dprintln("ram disks initialized");
+
 	VirtualFileSystem::initialize(cmdline.root);
 	dprintln("VFS initialized");
 
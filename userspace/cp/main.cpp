@@ -1,10 +1,12 @@
 #include <BAN/String.h>
 #include <BAN/Vector.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #define STR_STARTS_WITH(str, arg) (strncmp(str, arg, sizeof(arg) - 1) == 0)
 #define STR_EQUAL(str, arg) (strcmp(str, arg) == 0)
@@ -48,9 +50,34 @@ bool copy_file(const BAN::String& source, BAN::String destination)
 	}
 
 	bool ret = true;
+
+	// Regular files are copied inside the kernel, anything it refuses falls back to read and write
+	bool use_read_write = false;
+	for (;;)
+	{
+		const ssize_t ncopied = copy_file_range(src_fd, nullptr, dest_fd, nullptr, 1024 * 1024, 0);
+		if (ncopied > 0)
+			continue;
+		if (ncopied < 0)
+		{
+			if (errno == EINVAL || errno == EXDEV || errno == ENOTSUP || errno == ENOSYS)
+				use_read_write = true;
+			else
+			{
+				fprintf(stderr, "%s: ", source.data());
+				perror("copy_file_range");
+				ret = false;
+			}
+		}
+		break;
+	}
+
 	char buffer[1024];
-	while (ssize_t nread = read(src_fd, buffer, sizeof(buffer)))
+	while (use_read_write)
 	{
+		const ssize_t nread = read(src_fd, buffer, sizeof(buffer));
+		if (nread == 0)
+			break;
 		if (nread < 0)
 		{
 			fprintf(stderr, "%s: ", source.data());
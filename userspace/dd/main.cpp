@@ -1,9 +1,11 @@
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #define CURRENT_NS() ({ timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); ts.tv_sec * 1'000'000'000 + ts.tv_nsec; })
@@ -136,6 +138,14 @@ int main(int argc, char** argv)
 		}
 	}
 
+	// Regular files are copied inside the kernel, without going through our buffer
+	bool use_copy_file_range = false;
+	{
+		struct stat ist, ost;
+		if (fstat(ifd, &ist) == 0 && fstat(ofd, &ost) == 0)
+			use_copy_file_range = S_ISREG(ist.st_mode) && S_ISREG(ost.st_mode);
+	}
+
 	uint8_t* buffer = (uint8_t*)malloc(bs);
 	if (buffer == nullptr)
 	{
@@ -149,18 +159,38 @@ int main(int argc, char** argv)
 
 	for (uint64_t i = 0; i != count; i++)
 	{
-		ssize_t nread = read(ifd, buffer, bs);
-		if (nread == -1)
+		ssize_t nread;
+		ssize_t nwrite;
+
+		if (use_copy_file_range)
 		{
-			perror("read");
-			return 1;
+			nread = nwrite = copy_file_range(ifd, nullptr, ofd, nullptr, bs, 0);
+			if (nread == -1)
+			{
+				if (errno != EINVAL && errno != EXDEV && errno != ENOTSUP && errno != ENOSYS)
+				{
+					perror("copy_file_range");
+					return 1;
+				}
+				use_copy_file_range = false;
+			}
 		}
 
-		ssize_t nwrite = write(ofd, buffer, nread);
-		if (nwrite == -1)
+		if (!use_copy_file_range)
 		{
-			perror("write");
-			return 1;
+			nread = read(ifd, buffer, bs);
+			if (nread == -1)
+			{
+				perror("read");
+				return 1;
+			}
+
+			nwrite = write(ofd, buffer, nread);
+			if (nwrite == -1)
+			{
+				perror("write");
+				return 1;
+			}
 		}
 
 		total_transfered += nwrite;
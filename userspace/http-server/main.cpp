@@ -1,15 +1,148 @@
 #include <BAN/Vector.h>
 
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <netinet/in.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/select.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
-int main()
+static const char* s_root = ".";
+static bool s_use_sendfile = true;
+
+static bool send_all(int socket, const void* data, size_t size)
+{
+	const auto* bytes = static_cast<const uint8_t*>(data);
+	while (size > 0)
+	{
+		ssize_t nsend = send(socket, bytes, size, 0);
+		if (nsend <= 0)
+		{
+			if (nsend < 0)
+				perror("send");
+			return false;
+		}
+		bytes += nsend;
+		size -= nsend;
+	}
+	return true;
+}
+
+static void send_status(int client, const char* status)
+{
+	char buffer[256];
+	const int len = snprintf(buffer, sizeof(buffer),
+		"HTTP/1.1 %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s",
+		status, strlen(status), status
+	);
+	send_all(client, buffer, len);
+}
+
+static bool send_file_contents(int client, int fd, size_t size)
+{
+	if (s_use_sendfile)
+	{
+		off_t offset = 0;
+		while (static_cast<size_t>(offset) < size)
+		{
+			ssize_t nsent = sendfile(client, fd, &offset, size - offset);
+			if (nsent <= 0)
+			{
+				if (nsent < 0)
+					perror("sendfile");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	char buffer[4096];
+	for (;;)
+	{
+		ssize_t nread = read(fd, buffer, sizeof(buffer));
+		if (nread < 0)
+			perror("read");
+		if (nread <= 0)
+			return nread == 0;
+		if (!send_all(client, buffer, nread))
+			return false;
+	}
+}
+
+static void handle_request(int client, char* request)
+{
+	char* line_end = strstr(request, "\r\n");
+	if (line_end == nullptr)
+		return send_status(client, "400 Bad Request");
+	*line_end = '\0';
+
+	printf("%d: %s\n", client, request);
+
+	char* method = strtok(request, " ");
+	char* target = strtok(nullptr, " ");
+	if (method == nullptr || target == nullptr)
+		return send_status(client, "400 Bad Request");
+	if (strcmp(method, "GET") != 0)
+		return send_status(client, "405 Method Not Allowed");
+	if (target[0] != '/' || strstr(target, "..") != nullptr)
+		return send_status(client, "403 Forbidden");
+
+	if (char* query = strchr(target, '?'))
+		*query = '\0';
+
+	char path[PATH_MAX];
+	if (snprintf(path, sizeof(path), "%s%s%s", s_root, target, strcmp(target, "/") == 0 ? "index.html" : "") >= (int)sizeof(path))
+		return send_status(client, "414 URI Too Long");
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return send_status(client, "404 Not Found");
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+	{
+		close(fd);
+		return send_status(client, "404 Not Found");
+	}
+
+	char header[128];
+	const int header_len = snprintf(header, sizeof(header),
+		"HTTP/1.1 200 OK\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+		static_cast<size_t>(st.st_size)
+	);
+	if (send_all(client, header, header_len))
+		send_file_contents(client, fd, st.st_size);
+
+	close(fd);
+}
+
+int usage(const char* argv0)
+{
+	fprintf(stderr, "usage: %s [-r ROOT] [-p PORT] [--no-sendfile]\n", argv0);
+	return 1;
+}
+
+int main(int argc, char** argv)
 {
+	uint16_t port = 8080;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			s_root = argv[++i];
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+			port = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--no-sendfile") == 0)
+			s_use_sendfile = false;
+		else
+			return usage(argv[0]);
+	}
+
 	int socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 	if (socket == -1)
 	{
@@ -19,7 +152,7 @@ int main()
 
 	sockaddr_in addr;
 	addr.sin_family = AF_INET;
-	addr.sin_port = htons(8080);
+	addr.sin_port = htons(port);
 	addr.sin_addr.s_addr = INADDR_ANY;
 	if (bind(socket, (sockaddr*)&addr, sizeof(addr)) == -1)
 	{
@@ -33,7 +166,7 @@ int main()
 		return 1;
 	}
 
-	printf("server started\n");
+	printf("server started, serving %s\n", s_root);
 
 	BAN::Vector<int> clients;
 
@@ -79,32 +212,19 @@ int main()
 				continue;
 			}
 
-			ssize_t nrecv = recv(clients[i], buffer, sizeof(buffer), 0);
+			ssize_t nrecv = recv(clients[i], buffer, sizeof(buffer) - 1, 0);
 			if (nrecv < 0)
 				perror("recv");
-			if (nrecv <= 0)
+			if (nrecv > 0)
 			{
-				printf("%d disconnected\n", clients[i]);
-				close(clients[i]);
-				clients.remove(i);
-				continue;
-			}
-
-			write(STDOUT_FILENO, buffer, nrecv);
-
-			strcpy(buffer, "HTTP/1.1 200 OK\r\nContent-Length: 13\r\nConnection: close\r\n\r\nHello, world!");
-			ssize_t nsend = send(clients[i], buffer, strlen(buffer), 0);
-			if (nsend < 0)
-				perror("send");
-			if (nsend <= 0)
-			{
-				printf("%d disconnected\n", clients[i]);
-				close(clients[i]);
-				clients.remove(i);
-				continue;
+				buffer[nrecv] = '\0';
+				handle_request(clients[i], buffer);
 			}
 
-			i++;
+			// Every response is sent with "Connection: close"
+			printf("%d disconnected\n", clients[i]);
+			close(clients[i]);
+			clients.remove(i);
 		}
 	}
 }
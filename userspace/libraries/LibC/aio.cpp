@@ -0,0 +1,425 @@
+#include <aio.h>
+#include <errno.h>
+#include <sys/ioring.h>
+#include <unistd.h>
+
+// All requests of the process share one lazily created ring. Submitted
+// control blocks are kept in a list until their completion is reaped.
+// Completion notification through aio_sigevent is not supported.
+//
+// Every public function holds s_lock while touching the ring or the list.
+// There is no pthread mutex to use yet, so it is a spin lock. It is released
+// while blocking in the kernel for completions.
+
+static constexpr unsigned s_ring_entries = 256;
+
+static struct ioring s_ring;
+static int s_ring_fd = -1;
+static pid_t s_ring_pid = -1;
+static aiocb* s_in_flight = nullptr;
+
+static int s_lock = 0;
+
+static void lock()
+{
+	while (__atomic_exchange_n(&s_lock, 1, __ATOMIC_ACQUIRE))
+		__builtin_ia32_pause();
+}
+
+static void unlock()
+{
+	__atomic_store_n(&s_lock, 0, __ATOMIC_RELEASE);
+}
+
+// A forked child inherits the ring, but it belongs to the parent and none
+// of the parent's requests complete in the child
+static void drop_inherited_ring()
+{
+	if (s_ring_fd == -1 || s_ring_pid == getpid())
+		return;
+
+	for (aiocb* aiocbp = s_in_flight; aiocbp; aiocbp = aiocbp->__next)
+	{
+		aiocbp->__error = ECANCELED;
+		aiocbp->__return = -1;
+	}
+	s_in_flight = nullptr;
+
+	ioring_queue_exit(s_ring_fd, &s_ring);
+	s_ring_fd = -1;
+}
+
+struct RingLockGuard
+{
+	RingLockGuard()
+	{
+		lock();
+		drop_inherited_ring();
+	}
+
+	~RingLockGuard()
+	{
+		unlock();
+	}
+};
+
+static bool ensure_ring()
+{
+	if (s_ring_fd != -1)
+		return true;
+	s_ring_fd = ioring_queue_init(s_ring_entries, &s_ring);
+	s_ring_pid = getpid();
+	return s_ring_fd != -1;
+}
+
+static unsigned pending_submissions()
+{
+	return s_ring.sq_tail - s_ring.sq_head;
+}
+
+static void reap_completions()
+{
+	while (s_ring.cq_head != s_ring.cq_tail)
+	{
+		const auto& cqe = s_ring.cqes[s_ring.cq_head & (s_ring.cq_entries - 1)];
+		if (auto* aiocbp = reinterpret_cast<aiocb*>(cqe.user_data))
+		{
+			aiocbp->__error = (cqe.res < 0) ? -cqe.res : 0;
+			aiocbp->__return = (cqe.res < 0) ? -1 : cqe.res;
+
+			if (aiocbp->__prev)
+				aiocbp->__prev->__next = aiocbp->__next;
+			else
+				s_in_flight = aiocbp->__next;
+			if (aiocbp->__next)
+				aiocbp->__next->__prev = aiocbp->__prev;
+		}
+		s_ring.cq_head = s_ring.cq_head + 1;
+	}
+}
+
+// Submits queued entries and reaps completions, optionally waiting for one
+static int enter_ring(unsigned min_complete, const timespec* timeout)
+{
+	if (ioring_enter(s_ring_fd, pending_submissions(), min_complete, timeout) == -1)
+		return -1;
+	reap_completions();
+	return 0;
+}
+
+// Submits queued entries and waits for a completion. The lock is released while waiting.
+static int wait_for_completion(const timespec* timeout)
+{
+	if (enter_ring(0, nullptr) == -1)
+		return -1;
+
+	const int ring_fd = s_ring_fd;
+	unlock();
+	const int ret = ioring_enter(ring_fd, 0, 1, timeout);
+	lock();
+
+	if (ret == -1)
+		return -1;
+	reap_completions();
+	return 0;
+}
+
+static ioring_sqe* get_sqe()
+{
+	if (!ensure_ring())
+	{
+		errno = EAGAIN;
+		return nullptr;
+	}
+	if (pending_submissions() >= s_ring.sq_entries && enter_ring(0, nullptr) == -1)
+		return nullptr;
+	if (pending_submissions() >= s_ring.sq_entries)
+	{
+		errno = EAGAIN;
+		return nullptr;
+	}
+
+	auto& sqe = s_ring.sqes[s_ring.sq_tail & (s_ring.sq_entries - 1)];
+	sqe = {};
+	return &sqe;
+}
+
+static int queue_request(aiocb* aiocbp, uint8_t opcode, uint32_t op_flags = 0)
+{
+	auto* sqe = get_sqe();
+	if (sqe == nullptr)
+		return -1;
+
+	sqe->opcode = opcode;
+	sqe->fd = aiocbp->aio_fildes;
+	sqe->off = aiocbp->aio_offset;
+	sqe->addr = reinterpret_cast<uint64_t>(aiocbp->aio_buf);
+	sqe->len = aiocbp->aio_nbytes;
+	sqe->op_flags = op_flags;
+	sqe->user_data = reinterpret_cast<uint64_t>(aiocbp);
+
+	aiocbp->__error = EINPROGRESS;
+	aiocbp->__return = -1;
+	aiocbp->__prev = nullptr;
+	aiocbp->__next = s_in_flight;
+	if (s_in_flight)
+		s_in_flight->__prev = aiocbp;
+	s_in_flight = aiocbp;
+
+	s_ring.sq_tail = s_ring.sq_tail + 1;
+	return 0;
+}
+
+static int submit_request(aiocb* aiocbp, uint8_t opcode, uint32_t op_flags = 0)
+{
+	if (queue_request(aiocbp, opcode, op_flags) == -1)
+		return -1;
+	// Request is queued even if submitting fails, it is retried on the next entry
+	enter_ring(0, nullptr);
+	return 0;
+}
+
+int aio_read(struct aiocb* aiocbp)
+{
+	RingLockGuard _;
+
+	if (aiocbp->aio_offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return submit_request(aiocbp, IORING_OP_READ);
+}
+
+int aio_write(struct aiocb* aiocbp)
+{
+	RingLockGuard _;
+
+	if (aiocbp->aio_offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return submit_request(aiocbp, IORING_OP_WRITE);
+}
+
+int aio_fsync(int op, struct aiocb* aiocbp)
+{
+	RingLockGuard _;
+
+	if (op != O_SYNC && op != O_DSYNC)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return submit_request(aiocbp, IORING_OP_FSYNC, (op == O_DSYNC) ? IORING_FSYNC_DATASYNC : 0);
+}
+
+int aio_error(const struct aiocb* aiocbp)
+{
+	RingLockGuard _;
+
+	if (aiocbp->__error == EINPROGRESS)
+		enter_ring(0, nullptr);
+	return aiocbp->__error;
+}
+
+ssize_t aio_return(struct aiocb* aiocbp)
+{
+	RingLockGuard _;
+
+	if (aiocbp->__error == EINPROGRESS)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return aiocbp->__return;
+}
+
+int aio_suspend(const struct aiocb* const list[], int nent, const struct timespec* timeout)
+{
+	RingLockGuard _;
+
+	const auto any_done =
+		[&]
+		{
+			for (int i = 0; i < nent; i++)
+				if (list[i] && list[i]->__error != EINPROGRESS)
+					return true;
+			return false;
+		};
+
+	if (any_done())
+		return 0;
+
+	timespec deadline {};
+	if (timeout)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += timeout->tv_sec;
+		deadline.tv_nsec += timeout->tv_nsec;
+		if (deadline.tv_nsec >= 1'000'000'000)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1'000'000'000;
+		}
+	}
+
+	for (;;)
+	{
+		timespec remaining {};
+		if (timeout)
+		{
+			timespec current;
+			clock_gettime(CLOCK_MONOTONIC, &current);
+			if (current.tv_sec > deadline.tv_sec || (current.tv_sec == deadline.tv_sec && current.tv_nsec >= deadline.tv_nsec))
+			{
+				errno = EAGAIN;
+				return -1;
+			}
+			remaining.tv_sec = deadline.tv_sec - current.tv_sec;
+			remaining.tv_nsec = deadline.tv_nsec - current.tv_nsec;
+			if (remaining.tv_nsec < 0)
+			{
+				remaining.tv_sec--;
+				remaining.tv_nsec += 1'000'000'000;
+			}
+		}
+
+		if (wait_for_completion(timeout ? &remaining : nullptr) == -1)
+			return -1;
+		if (any_done())
+			return 0;
+	}
+}
+
+static int cancel_request(aiocb* aiocbp)
+{
+	if (aiocbp->__error != EINPROGRESS)
+		return AIO_ALLDONE;
+
+	auto* sqe = get_sqe();
+	if (sqe == nullptr)
+		return -1;
+	sqe->opcode = IORING_OP_CANCEL;
+	sqe->addr = reinterpret_cast<uint64_t>(aiocbp);
+	s_ring.sq_tail = s_ring.sq_tail + 1;
+
+	if (enter_ring(0, nullptr) == -1)
+		return -1;
+
+	if (aiocbp->__error == ECANCELED)
+		return AIO_CANCELLED;
+	if (aiocbp->__error == EINPROGRESS)
+		return AIO_NOTCANCELLED;
+	return AIO_ALLDONE;
+}
+
+int aio_cancel(int fildes, struct aiocb* aiocbp)
+{
+	RingLockGuard _;
+
+	if (aiocbp)
+	{
+		if (aiocbp->aio_fildes != fildes)
+		{
+			errno = EINVAL;
+			return -1;
+		}
+		return cancel_request(aiocbp);
+	}
+
+	int result = AIO_ALLDONE;
+	for (aiocb* current = s_in_flight; current;)
+	{
+		// Cancelling removes the request from the list
+		aiocb* next = current->__next;
+		if (current->aio_fildes == fildes)
+		{
+			const int ret = cancel_request(current);
+			if (ret == -1)
+				return -1;
+			if (ret == AIO_NOTCANCELLED || result == AIO_ALLDONE)
+				result = ret;
+		}
+		current = next;
+	}
+	return result;
+}
+
+int lio_listio(int mode, struct aiocb* __restrict const* __restrict list, int nent, struct sigevent* __restrict sig)
+{
+	RingLockGuard _;
+
+	(void)sig;
+
+	if (mode != LIO_WAIT && mode != LIO_NOWAIT)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	bool failed = false;
+	for (int i = 0; i < nent; i++)
+	{
+		if (list[i] == nullptr)
+			continue;
+
+		int ret = 0;
+		switch (list[i]->aio_lio_opcode)
+		{
+			case LIO_READ:
+				ret = queue_request(list[i], IORING_OP_READ);
+				break;
+			case LIO_WRITE:
+				ret = queue_request(list[i], IORING_OP_WRITE);
+				break;
+			case LIO_NOP:
+				continue;
+			default:
+				list[i]->__error = EINVAL;
+				list[i]->__return = -1;
+				failed = true;
+				continue;
+		}
+
+		if (ret == -1)
+		{
+			list[i]->__error = EAGAIN;
+			list[i]->__return = -1;
+			failed = true;
+		}
+	}
+
+	// The whole batch is submitted with one entry to the kernel
+	if (enter_ring(0, nullptr) == -1)
+		return -1;
+
+	if (mode == LIO_WAIT)
+	{
+		const auto all_done =
+			[&]
+			{
+				for (int i = 0; i < nent; i++)
+					if (list[i] && list[i]->__error == EINPROGRESS)
+						return false;
+				return true;
+			};
+
+		while (!all_done())
+			if (wait_for_completion(nullptr) == -1)
+				return -1;
+
+		for (int i = 0; i < nent; i++)
+			if (list[i] && list[i]->aio_lio_opcode != LIO_NOP && list[i]->__error != 0)
+				failed = true;
+	}
+
+	if (failed)
+	{
+		errno = (mode == LIO_WAIT) ? EIO : EAGAIN;
+		return -1;
+	}
+
+	return 0;
+}
@@ -10,8 +10,8 @@ struct __DIR
 	int fd { -1 };
 	size_t entry_count { 0 };
 	size_t entry_index { 0 };
-	// FIXME: we should probably allocate entries dynamically
-	//        based if syscall returns ENOBUFS
+	// SYS_READ_DIR fills as many entries as fit and continues from
+	// where it stopped, so this only limits the batch size
 	dirent entries[128];
 };
 
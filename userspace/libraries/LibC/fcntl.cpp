@@ -38,3 +38,13 @@ int fcntl(int fildes, int cmd, ...)
 
 	return syscall(SYS_FCNTL, fildes, cmd, extra);
 }
+
+ssize_t splice(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t len, unsigned int flags)
+{
+	if (flags & ~(SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE | SPLICE_F_GIFT))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return syscall(SYS_SPLICE, fd_in, off_in, fd_out, off_out, len);
+}
@@ -26,6 +26,12 @@ struct aiocb
 	int				aio_reqprio;	/* Request priority offset. */
 	struct sigevent	aio_sigevent;	/* Signal number and value. */
 	int				aio_lio_opcode;	/* Operation to be performed. */
+
+	/* implementation private, tracks in flight requests */
+	int				__error;
+	ssize_t			__return;
+	struct aiocb*	__prev;
+	struct aiocb*	__next;
 };
 
 #define AIO_ALLDONE			1
@@ -44,7 +50,7 @@ int		aio_read(struct aiocb* aiocbp);
 ssize_t	aio_return(struct aiocb* aiocbp);
 int		aio_suspend(const struct aiocb* const list[], int nent, const struct timespec* timeout);
 int		aio_write(struct aiocb* aiocbp);
-int		lio_listio(int mode, struct aiocb* __restrict const list[__restrict], int nent, struct sigevent* __restrict sig);
+int		lio_listio(int mode, struct aiocb* __restrict const* __restrict list, int nent, struct sigevent* __restrict sig);
 
 __END_DECLS
 
@@ -86,6 +86,15 @@ __BEGIN_DECLS
 #define POSIX_FADV_SEQUENTIAL	0x4000000
 #define POSIX_FADV_WILLNEED		0x8000000
 
+/* bit 28, transfer directly between the buffer and storage, not part of POSIX */
+#define O_DIRECT	0x10000000
+
+/* Linux compatible splice flags, accepted but ignored */
+#define SPLICE_F_MOVE		0x01
+#define SPLICE_F_NONBLOCK	0x02
+#define SPLICE_F_MORE		0x04
+#define SPLICE_F_GIFT		0x08
+
 struct flock
 {
 	short l_type;	/* Type of lock; F_RDLCK, F_WRLCK, F_UNLCK. */
@@ -102,6 +111,9 @@ int openat(int fd, const char* path, int oflag, ...);
 int posix_fadvise(int fd, off_t offset, off_t len, int advice);
 int posix_fallocate(int fd, off_t offset, off_t len);
 
+/* moves up to len bytes between any two file descriptors inside the kernel, not part of POSIX */
+ssize_t splice(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t len, unsigned int flags);
+
 __END_DECLS
 
 #endif
@@ -57,7 +57,8 @@ __BEGIN_DECLS
 #define _XOPEN_NAME_MAX 255
 #define _XOPEN_PATH_MAX 1024
 
-#define OPEN_MAX 64
+#define OPEN_MAX 16384
+#define IOV_MAX 1024
 #define NAME_MAX 255
 #define PATH_MAX 256
 #define LOGIN_NAME_MAX 256
@@ -5,8 +5,9 @@
 
 __BEGIN_DECLS
 
-#define __need_size_t 1
+#define __need_size_t
 #include <stddef.h>
+#include <stdint.h>
 
 #define TTY_CMD_SET		0x01
 #define TTY_CMD_UNSET	0x02
@@ -14,6 +15,10 @@ __BEGIN_DECLS
 #define TTY_FLAG_ENABLE_OUTPUT	1
 #define TTY_FLAG_ENABLE_INPUT	2
 
+/* ioctl requests for /dev/ramN, argument is a pointer to size_t holding the size in bytes */
+#define RAMDISK_GET_SIZE	0x101
+#define RAMDISK_SET_SIZE	0x102
+
 #define POWEROFF_SHUTDOWN 0
 #define POWEROFF_REBOOT 1
 
@@ -24,6 +29,26 @@ struct proc_meminfo_t
 	size_t phys_pages;
 };
 
+#define CLOCK_PAGE_FLAG_TSC 1
+
+/*
+Read only page the kernel maps to every process, passed to the program entry with
+argc, argv and envp. LibC reads time from it without a syscall. Fields are written
+under a sequence lock, seq is odd while an update is in progress.
+
+monotonic time in ns = ns_base + ((tsc - tsc_base) * tsc_mult >> tsc_shift)
+*/
+struct clock_page_t
+{
+	volatile uint32_t seq;
+	volatile uint32_t flags;		/* CLOCK_PAGE_FLAG_TSC if tsc fields are valid */
+	volatile uint64_t boot_time;	/* seconds since epoch at boot */
+	volatile uint64_t tsc_base;
+	volatile uint64_t ns_base;
+	volatile uint32_t tsc_mult;
+	volatile uint32_t tsc_shift;
+};
+
 /*
 fildes:		refers to valid tty device
 command:	one of TTY_CMD_* definitions
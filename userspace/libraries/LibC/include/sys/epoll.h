@@ -0,0 +1,52 @@
+#ifndef _SYS_EPOLL_H
+#define _SYS_EPOLL_H 1
+
+// Linux compatible epoll interface, not part of POSIX
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+#include <signal.h>
+#include <stdint.h>
+
+#define EPOLL_CLOEXEC	0x01
+
+#define EPOLL_CTL_ADD	1
+#define EPOLL_CTL_DEL	2
+#define EPOLL_CTL_MOD	3
+
+#define EPOLLIN			0x001
+#define EPOLLPRI		0x002
+#define EPOLLOUT		0x004
+#define EPOLLERR		0x008
+#define EPOLLHUP		0x010
+#define EPOLLRDNORM		0x040
+#define EPOLLWRNORM		0x100
+
+#define EPOLLONESHOT	(1u << 30)
+#define EPOLLET			(1u << 31)
+
+typedef union epoll_data
+{
+	void*		ptr;
+	int			fd;
+	uint32_t	u32;
+	uint64_t	u64;
+} epoll_data_t;
+
+struct epoll_event
+{
+	uint32_t		events;
+	epoll_data_t	data;
+};
+
+int epoll_create(int size);
+int epoll_create1(int flags);
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event);
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout);
+int epoll_pwait(int epfd, struct epoll_event* events, int maxevents, int timeout, const sigset_t* sigmask);
+
+__END_DECLS
+
+#endif
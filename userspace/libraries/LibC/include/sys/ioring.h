@@ -0,0 +1,88 @@
+#ifndef _SYS_IORING_H
+#define _SYS_IORING_H 1
+
+// banan-os specific submission/completion ring interface, modeled after io_uring
+//
+// User space fills submission queue entries and advances sq_tail, then calls
+// ioring_enter() to submit all of them with a single syscall. The kernel
+// advances sq_head as it consumes entries and posts a completion queue entry
+// for every operation. Operations that would block (reading an empty socket,
+// writing a full pipe, waiting for a connection) stay in flight and complete
+// during later ioring_enter() calls, once their file becomes ready.
+// Reads and writes of regular files and block devices at an explicit offset
+// run in the background and complete during later ioring_enter() calls too.
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <time.h>
+
+#define IORING_OP_NOP		0
+#define IORING_OP_READ		1	/* read len bytes from fd to addr at off, off -1 uses the file offset */
+#define IORING_OP_WRITE		2	/* write len bytes from addr to fd at off, off -1 uses the file offset */
+#define IORING_OP_SEND		3	/* send len bytes from addr to socket fd */
+#define IORING_OP_RECV		4	/* receive up to len bytes from socket fd to addr */
+#define IORING_OP_ACCEPT	5	/* accept from socket fd, addr is sockaddr*, addr2 is socklen_t* */
+#define IORING_OP_FSYNC		6	/* synchronize fd to its storage, as fdatasync if op_flags has IORING_FSYNC_DATASYNC */
+#define IORING_OP_TIMEOUT	7	/* completes with -ETIME after the relative timespec in addr */
+#define IORING_OP_CANCEL	8	/* cancels the in flight operation with user_data addr, -EALREADY if it is already running */
+
+#define IORING_FSYNC_DATASYNC	0x01
+
+struct ioring_sqe
+{
+	uint8_t		opcode;
+	uint8_t		__reserved[3];
+	int32_t		fd;
+	uint64_t	off;
+	uint64_t	addr;
+	uint64_t	addr2;
+	uint32_t	len;
+	uint32_t	op_flags;
+	uint64_t	user_data;
+};
+
+struct ioring_cqe
+{
+	uint64_t	user_data;
+	int32_t		res;		/* result of the operation or negative errno */
+	uint32_t	flags;
+};
+
+struct ioring
+{
+	/* written by user space */
+	volatile uint32_t	sq_tail;
+	volatile uint32_t	cq_head;
+
+	/* written by the kernel */
+	volatile uint32_t	sq_head;
+	volatile uint32_t	cq_tail;
+
+	/* set up before ioring_setup(), entry counts must be powers of two */
+	uint32_t			sq_entries;
+	uint32_t			cq_entries;
+	struct ioring_sqe*	sqes;
+	struct ioring_cqe*	cqes;
+};
+
+/* registers ring with the kernel, returns a file descriptor referring to it */
+int ioring_setup(struct ioring* ring);
+
+/*
+submits up to to_submit entries and waits until at least min_complete completions are
+available in the completion queue, or until timeout expires if it is not null
+
+return value: number of entries submitted, -1 on failure and errno set to the error
+*/
+int ioring_enter(int fd, unsigned to_submit, unsigned min_complete, const struct timespec* timeout);
+
+/* allocates queues with entries submission and 2 * entries completion entries and sets up the ring */
+int ioring_queue_init(unsigned entries, struct ioring* ring);
+void ioring_queue_exit(int fd, struct ioring* ring);
+
+__END_DECLS
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _SYS_SENDFILE_H
+#define _SYS_SENDFILE_H 1
+
+// Linux compatible sendfile, not part of POSIX
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+#define __need_off_t
+#define __need_size_t
+#define __need_ssize_t
+#include <sys/types.h>
+
+/*
+copies up to count bytes from in_fd to out_fd without going through user space
+
+if offset is not null, reading starts from *offset and *offset is updated to point
+past the last byte read, file offset of in_fd is not modified
+*/
+ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
+
+__END_DECLS
+
+#endif
@@ -81,6 +81,22 @@ __BEGIN_DECLS
 	O(SYS_GETSOCKNAME,		getsockname)	\
 	O(SYS_GETSOCKOPT,		getsockopt)		\
 	O(SYS_SETSOCKOPT,		setsockopt)		\
+	O(SYS_POLL,				poll)			\
+	O(SYS_EPOLL_CREATE1,	epoll_create1)	\
+	O(SYS_EPOLL_CTL,		epoll_ctl)		\
+	O(SYS_EPOLL_PWAIT,		epoll_pwait)	\
+	O(SYS_IORING_SETUP,		ioring_setup)	\
+	O(SYS_IORING_ENTER,		ioring_enter)	\
+	O(SYS_SENDFILE,			sendfile)		\
+	O(SYS_SPLICE,			splice)			\
+	O(SYS_READV,			readv)			\
+	O(SYS_WRITEV,			writev)			\
+	O(SYS_PREADV,			preadv)			\
+	O(SYS_PWRITEV,			pwritev)		\
+	O(SYS_SENDMSG,			sendmsg)		\
+	O(SYS_RECVMSG,			recvmsg)		\
+	O(SYS_FSYNC,			fsync)			\
+	O(SYS_COPY_FILE_RANGE,	copy_file_range)	\
 
 enum Syscall
 {
@@ -213,6 +213,9 @@ extern int		opterr, optind, optopt;
 
 long syscall(long syscall, ...);
 
+/* copies up to len bytes between two regular files inside the kernel, not part of POSIX */
+ssize_t copy_file_range(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t len, unsigned int flags);
+
 __END_DECLS
 
 #endif
@@ -0,0 +1,57 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioring.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int ioring_setup(struct ioring* ring)
+{
+	return syscall(SYS_IORING_SETUP, ring);
+}
+
+int ioring_enter(int fd, unsigned to_submit, unsigned min_complete, const struct timespec* timeout)
+{
+	return syscall(SYS_IORING_ENTER, fd, to_submit, min_complete, timeout);
+}
+
+int ioring_queue_init(unsigned entries, struct ioring* ring)
+{
+	if (entries == 0 || (entries & (entries - 1)))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(ring, 0, sizeof(struct ioring));
+	ring->sq_entries = entries;
+	ring->cq_entries = entries * 2;
+	ring->sqes = static_cast<ioring_sqe*>(malloc(ring->sq_entries * sizeof(ioring_sqe)));
+	ring->cqes = static_cast<ioring_cqe*>(malloc(ring->cq_entries * sizeof(ioring_cqe)));
+	if (ring->sqes == nullptr || ring->cqes == nullptr)
+	{
+		free(ring->sqes);
+		free(ring->cqes);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	int fd = ioring_setup(ring);
+	if (fd == -1)
+	{
+		free(ring->sqes);
+		free(ring->cqes);
+		return -1;
+	}
+
+	return fd;
+}
+
+void ioring_queue_exit(int fd, struct ioring* ring)
+{
+	close(fd);
+	free(ring->sqes);
+	free(ring->cqes);
+	ring->sqes = nullptr;
+	ring->cqes = nullptr;
+}
@@ -40,11 +40,21 @@ ssize_t recvfrom(int socket, void* __restrict buffer, size_t length, int flags,
 	return syscall(SYS_RECVFROM, &arguments);
 }
 
+ssize_t recvmsg(int socket, struct msghdr* message, int flags)
+{
+	return syscall(SYS_RECVMSG, socket, message, flags);
+}
+
 ssize_t send(int socket, const void* message, size_t length, int flags)
 {
 	return sendto(socket, message, length, flags, nullptr, 0);
 }
 
+ssize_t sendmsg(int socket, const struct msghdr* message, int flags)
+{
+	return syscall(SYS_SENDMSG, socket, message, flags);
+}
+
 ssize_t sendto(int socket, const void* message, size_t length, int flags, const struct sockaddr* dest_addr, socklen_t dest_len)
 {
 	sys_sendto_t arguments {
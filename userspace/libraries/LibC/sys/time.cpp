@@ -0,0 +1,15 @@
+#include <sys/time.h>
+#include <time.h>
+
+int gettimeofday(struct timeval* __restrict tp, void* __restrict tzp)
+{
+	(void)tzp;
+
+	timespec ts;
+	if (clock_gettime(CLOCK_REALTIME, &ts) == -1)
+		return -1;
+
+	tp->tv_sec = ts.tv_sec;
+	tp->tv_usec = ts.tv_nsec / 1000;
+	return 0;
+}
@@ -0,0 +1,23 @@
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+ssize_t readv(int fildes, const struct iovec* iov, int iovcnt)
+{
+	return syscall(SYS_READV, fildes, iov, iovcnt);
+}
+
+ssize_t writev(int fildes, const struct iovec* iov, int iovcnt)
+{
+	return syscall(SYS_WRITEV, fildes, iov, iovcnt);
+}
+
+ssize_t preadv(int fildes, const struct iovec* iov, int iovcnt, off_t offset)
+{
+	return syscall(SYS_PREADV, fildes, iov, iovcnt, offset);
+}
+
+ssize_t pwritev(int fildes, const struct iovec* iov, int iovcnt, off_t offset)
+{
+	return syscall(SYS_PWRITEV, fildes, iov, iovcnt, offset);
+}
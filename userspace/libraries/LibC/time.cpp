@@ -1,12 +1,67 @@
 #include <BAN/Assert.h>
 #include <BAN/Debug.h>
 
+#include <sys/banan-os.h>
 #include <sys/syscall.h>
 #include <time.h>
 #include <unistd.h>
 
+static const clock_page_t* s_clock_page = nullptr;
+
+void init_clock(const clock_page_t* clock_page)
+{
+	s_clock_page = clock_page;
+}
+
+static uint64_t read_tsc()
+{
+	uint32_t low, high;
+	asm volatile("rdtsc" : "=a"(low), "=d"(high));
+	return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+// Returns false if the kernel has not published a TSC based clock
+static bool read_clock_page(uint64_t& monotonic_ns, uint64_t& boot_time)
+{
+	if (s_clock_page == nullptr)
+		return false;
+
+	for (;;)
+	{
+		const uint32_t seq = s_clock_page->seq;
+		if (seq & 1)
+			continue;
+		if (!(s_clock_page->flags & CLOCK_PAGE_FLAG_TSC))
+			return false;
+
+		const uint64_t delta = read_tsc() - s_clock_page->tsc_base;
+		const uint32_t mult = s_clock_page->tsc_mult;
+		const uint32_t shift = s_clock_page->tsc_shift;
+		monotonic_ns = s_clock_page->ns_base
+			+ (((delta >> 32) * mult) << (32 - shift))
+			+ (((delta & 0xFFFFFFFF) * mult) >> shift);
+		boot_time = s_clock_page->boot_time;
+
+		if (s_clock_page->seq == seq)
+			return true;
+	}
+}
+
 int clock_gettime(clockid_t clock_id, struct timespec* tp)
 {
+	if (clock_id == CLOCK_MONOTONIC || clock_id == CLOCK_REALTIME)
+	{
+		uint64_t monotonic_ns, boot_time;
+		if (read_clock_page(monotonic_ns, boot_time))
+		{
+			tp->tv_sec = monotonic_ns / 1'000'000'000;
+			tp->tv_nsec = monotonic_ns % 1'000'000'000;
+			if (clock_id == CLOCK_REALTIME)
+				tp->tv_sec += boot_time;
+			return 0;
+		}
+	}
+
 	return syscall(SYS_CLOCK_GETTIME, clock_id, tp);
 }
 
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/banan-os.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <unistd.h>
@@ -13,9 +14,11 @@
 char** environ;
 
 extern void init_malloc();
-extern "C" void _init_libc(char** _environ)
+extern void init_clock(const clock_page_t*);
+extern "C" void _init_libc(char** _environ, const clock_page_t* clock_page)
 {
 	init_malloc();
+	init_clock(clock_page);
 
 	if (!_environ)
 		return;
@@ -301,6 +304,26 @@ void syncsync(int should_block)
 	syscall(SYS_SYNC, should_block);
 }
 
+int fsync(int fildes)
+{
+	return syscall(SYS_FSYNC, fildes, false);
+}
+
+int fdatasync(int fildes)
+{
+	return syscall(SYS_FSYNC, fildes, true);
+}
+
+ssize_t copy_file_range(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t len, unsigned int flags)
+{
+	if (flags != 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return syscall(SYS_COPY_FILE_RANGE, fd_in, off_in, fd_out, off_out, len);
+}
+
 int unlink(const char* path)
 {
 	return syscall(SYS_UNLINK, path);
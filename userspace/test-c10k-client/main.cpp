@@ -0,0 +1,183 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SOCK_PATH "/tmp/c10k.sock"
+
+#define CURRENT_NS() ({ timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); ts.tv_sec * 1'000'000'000 + ts.tv_nsec; })
+
+static constexpr size_t message_size = 64;
+
+int usage(const char* argv0)
+{
+	fprintf(stderr, "usage: %s [-c CONNECTIONS] [-r ROUNDS] [-p SOCKET_PATH]\n", argv0);
+	return 1;
+}
+
+static void print_duration(const char* what, uint64_t ns)
+{
+	printf("%s %llu.%03llu s\n", what,
+		(unsigned long long)(ns / 1'000'000'000),
+		(unsigned long long)(ns % 1'000'000'000 / 1'000'000)
+	);
+}
+
+int main(int argc, char** argv)
+{
+	const char* argv0 = argv[0];
+
+	size_t connection_count = 1000;
+	size_t round_count = 10;
+	const char* sock_path = DEFAULT_SOCK_PATH;
+
+	for (int i = 1; i < argc; i += 2)
+	{
+		if (i + 1 >= argc)
+			return usage(argv0);
+		if (strcmp(argv[i], "-c") == 0)
+			connection_count = strtoul(argv[i + 1], nullptr, 10);
+		else if (strcmp(argv[i], "-r") == 0)
+			round_count = strtoul(argv[i + 1], nullptr, 10);
+		else if (strcmp(argv[i], "-p") == 0)
+			sock_path = argv[i + 1];
+		else
+			return usage(argv0);
+	}
+	if (connection_count == 0 || round_count == 0)
+		return usage(argv0);
+
+	sockaddr_un addr;
+	addr.sun_family = AF_UNIX;
+	if (strlen(sock_path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "%s: path too long\n", sock_path);
+		return 1;
+	}
+	strcpy(addr.sun_path, sock_path);
+
+	int* sockets = (int*)malloc(connection_count * sizeof(int));
+	size_t* received = (size_t*)malloc(connection_count * sizeof(size_t));
+	epoll_event* events = (epoll_event*)malloc(connection_count * sizeof(epoll_event));
+	if (sockets == nullptr || received == nullptr || events == nullptr)
+	{
+		perror("malloc");
+		return 1;
+	}
+
+	int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1)
+	{
+		perror("epoll_create1");
+		return 1;
+	}
+
+	const uint64_t connect_start_ns = CURRENT_NS();
+
+	for (size_t i = 0; i < connection_count; i++)
+	{
+		sockets[i] = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (sockets[i] == -1)
+		{
+			fprintf(stderr, "socket %zu: %s\n", i, strerror(errno));
+			return 1;
+		}
+
+		if (connect(sockets[i], (sockaddr*)&addr, sizeof(addr)) == -1)
+		{
+			fprintf(stderr, "connect %zu: %s\n", i, strerror(errno));
+			return 1;
+		}
+
+		epoll_event event;
+		event.events = EPOLLIN;
+		event.data.u64 = i;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockets[i], &event) == -1)
+		{
+			perror("epoll_ctl");
+			return 1;
+		}
+	}
+
+	print_duration("connected in", CURRENT_NS() - connect_start_ns);
+
+	char message[message_size];
+	memset(message, 'x', sizeof(message));
+
+	char buffer[message_size];
+
+	const uint64_t start_ns = CURRENT_NS();
+	uint64_t max_round_ns = 0;
+
+	for (size_t round = 0; round < round_count; round++)
+	{
+		const uint64_t round_start_ns = CURRENT_NS();
+
+		for (size_t i = 0; i < connection_count; i++)
+		{
+			received[i] = 0;
+			if (send(sockets[i], message, sizeof(message), 0) == -1)
+			{
+				perror("send");
+				return 1;
+			}
+		}
+
+		size_t pending = connection_count;
+		while (pending > 0)
+		{
+			int nevents = epoll_wait(epoll_fd, events, connection_count, -1);
+			if (nevents == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				perror("epoll_wait");
+				return 1;
+			}
+
+			for (int j = 0; j < nevents; j++)
+			{
+				const size_t i = events[j].data.u64;
+
+				ssize_t nrecv = recv(sockets[i], buffer, message_size - received[i], 0);
+				if (nrecv <= 0)
+				{
+					fprintf(stderr, "connection %zu closed\n", i);
+					return 1;
+				}
+
+				received[i] += nrecv;
+				if (received[i] == message_size)
+					pending--;
+			}
+		}
+
+		const uint64_t round_ns = CURRENT_NS() - round_start_ns;
+		if (round_ns > max_round_ns)
+			max_round_ns = round_ns;
+	}
+
+	const uint64_t total_ns = CURRENT_NS() - start_ns;
+	const uint64_t messages = connection_count * round_count;
+
+	printf("%zu connections, %zu rounds\n", connection_count, round_count);
+	print_duration("total", total_ns);
+	print_duration("slowest round", max_round_ns);
+	printf("%llu round trips/s\n", (unsigned long long)(total_ns ? messages * 1'000'000'000 / total_ns : 0));
+
+	for (size_t i = 0; i < connection_count; i++)
+		close(sockets[i]);
+	close(epoll_fd);
+
+	free(sockets);
+	free(received);
+	free(events);
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define DEFAULT_SOCK_PATH "/tmp/c10k.sock"
+
+int usage(const char* argv0)
+{
+	fprintf(stderr, "usage: %s [-p SOCKET_PATH]\n", argv0);
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	const char* sock_path = DEFAULT_SOCK_PATH;
+	if (argc == 3 && strcmp(argv[1], "-p") == 0)
+		sock_path = argv[2];
+	else if (argc != 1)
+		return usage(argv[0]);
+
+	sockaddr_un addr;
+	addr.sun_family = AF_UNIX;
+	if (strlen(sock_path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "%s: path too long\n", sock_path);
+		return 1;
+	}
+	strcpy(addr.sun_path, sock_path);
+
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server == -1)
+	{
+		perror("socket");
+		return 1;
+	}
+
+	unlink(sock_path);
+	if (bind(server, (sockaddr*)&addr, sizeof(addr)) == -1)
+	{
+		perror("bind");
+		return 1;
+	}
+
+	if (listen(server, SOMAXCONN) == -1)
+	{
+		perror("listen");
+		return 1;
+	}
+
+	int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1)
+	{
+		perror("epoll_create1");
+		return 1;
+	}
+
+	epoll_event event;
+	event.events = EPOLLIN;
+	event.data.fd = server;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server, &event) == -1)
+	{
+		perror("epoll_ctl");
+		return 1;
+	}
+
+	printf("listening on %s\n", sock_path);
+
+	size_t connections = 0;
+
+	epoll_event events[256];
+	char buffer[1024];
+	for (;;)
+	{
+		int nevents = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(*events), -1);
+		if (nevents == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			break;
+		}
+
+		for (int i = 0; i < nevents; i++)
+		{
+			const int fd = events[i].data.fd;
+
+			if (fd == server)
+			{
+				int client = accept(server, nullptr, nullptr);
+				if (client == -1)
+				{
+					perror("accept");
+					continue;
+				}
+
+				event.events = EPOLLIN;
+				event.data.fd = client;
+				if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &event) == -1)
+				{
+					perror("epoll_ctl");
+					close(client);
+					continue;
+				}
+
+				if (++connections % 1000 == 0)
+					printf("%zu connections\n", connections);
+				continue;
+			}
+
+			ssize_t nrecv = recv(fd, buffer, sizeof(buffer), 0);
+			if (nrecv <= 0)
+			{
+				if (nrecv == -1)
+					perror("recv");
+				epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+				close(fd);
+				if (--connections == 0)
+					printf("all connections closed\n");
+				continue;
+			}
+
+			if (send(fd, buffer, nrecv, 0) == -1)
+				perror("send");
+		}
+	}
+
+	close(epoll_fd);
+	close(server);
+	return 1;
+}
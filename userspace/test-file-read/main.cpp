@@ -0,0 +1,86 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CURRENT_NS() ({ timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); ts.tv_sec * 1'000'000'000 + ts.tv_nsec; })
+
+int usage(const char* argv0)
+{
+	fprintf(stderr, "usage: %s [-c CHUNK_KIB] FILE...\n", argv0);
+	return 1;
+}
+
+static int benchmark_file(const char* path, char* buffer, size_t chunk_bytes)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+	{
+		perror(path);
+		return 1;
+	}
+
+	const uint64_t start_ns = CURRENT_NS();
+
+	size_t total = 0;
+	for (;;)
+	{
+		ssize_t nread = read(fd, buffer, chunk_bytes);
+		if (nread == -1)
+		{
+			perror("read");
+			close(fd);
+			return 1;
+		}
+		if (nread == 0)
+			break;
+		total += nread;
+	}
+
+	const uint64_t ns = CURRENT_NS() - start_ns;
+	close(fd);
+
+	const uint64_t kib_per_s = ns ? (uint64_t)total * 1'000'000'000 / 1024 / ns : 0;
+	printf("%s: read %zu MiB in %llu.%03llu s, %llu.%03llu MiB/s\n",
+		path,
+		total / 1024 / 1024,
+		(unsigned long long)(ns / 1'000'000'000), (unsigned long long)(ns % 1'000'000'000 / 1'000'000),
+		(unsigned long long)(kib_per_s / 1024), (unsigned long long)(kib_per_s % 1024 * 1000 / 1024)
+	);
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	const char* argv0 = argv[0];
+
+	size_t chunk_kib = 1024;
+	if (argc >= 3 && strcmp(argv[1], "-c") == 0)
+	{
+		if ((chunk_kib = strtoul(argv[2], nullptr, 10)) == 0)
+			return usage(argv0);
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc < 2)
+		return usage(argv0);
+
+	const size_t chunk_bytes = chunk_kib * 1024;
+	char* buffer = (char*)malloc(chunk_bytes);
+	if (buffer == nullptr)
+	{
+		perror("malloc");
+		return 1;
+	}
+
+	int ret = 0;
+	for (int i = 1; i < argc; i++)
+		ret |= benchmark_file(argv[i], buffer, chunk_bytes);
+
+	free(buffer);
+	return ret;
+}
@@ -0,0 +1,87 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CURRENT_NS() ({ timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); ts.tv_sec * 1'000'000'000 + ts.tv_nsec; })
+
+int usage(const char* argv0)
+{
+	fprintf(stderr, "usage: %s FILE [SIZE_MIB [CHUNK_KIB]]\n", argv0);
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 4)
+		return usage(argv[0]);
+
+	size_t total_mib = 64;
+	size_t chunk_kib = 64;
+	if (argc >= 3 && (total_mib = strtoul(argv[2], nullptr, 10)) == 0)
+		return usage(argv[0]);
+	if (argc >= 4 && (chunk_kib = strtoul(argv[3], nullptr, 10)) == 0)
+		return usage(argv[0]);
+
+	const size_t total_bytes = total_mib * 1024 * 1024;
+	const size_t chunk_bytes = chunk_kib * 1024;
+
+	char* buffer = (char*)malloc(chunk_bytes);
+	if (buffer == nullptr)
+	{
+		perror("malloc");
+		return 1;
+	}
+	for (size_t i = 0; i < chunk_bytes; i++)
+		buffer[i] = 'a' + i % 26;
+
+	int fd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	const uint64_t start_ns = CURRENT_NS();
+
+	size_t written = 0;
+	while (written < total_bytes)
+	{
+		const size_t to_write = (total_bytes - written < chunk_bytes) ? total_bytes - written : chunk_bytes;
+		ssize_t nwrite = write(fd, buffer, to_write);
+		if (nwrite <= 0)
+		{
+			perror("write");
+			return 1;
+		}
+		written += nwrite;
+	}
+
+	const uint64_t write_ns = CURRENT_NS() - start_ns;
+
+	close(fd);
+	sync();
+
+	const uint64_t total_ns = CURRENT_NS() - start_ns;
+
+	auto print_result =
+		[written](const char* name, uint64_t ns)
+		{
+			const uint64_t kib_per_s = ns ? (uint64_t)written * 1'000'000'000 / 1024 / ns : 0;
+			printf("%s: %llu.%03llu s, %llu.%03llu MiB/s\n",
+				name,
+				(unsigned long long)(ns / 1'000'000'000), (unsigned long long)(ns % 1'000'000'000 / 1'000'000),
+				(unsigned long long)(kib_per_s / 1024), (unsigned long long)(kib_per_s % 1024 * 1000 / 1024)
+			);
+		};
+
+	printf("wrote %zu MiB in %zu KiB chunks\n", written / 1024 / 1024, chunk_bytes / 1024);
+	print_result("write", write_ns);
+	print_result("write + sync", total_ns);
+
+	free(buffer);
+	return 0;
+}
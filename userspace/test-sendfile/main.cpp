@@ -0,0 +1,222 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SOCK_PATH "/tmp/test-sendfile.sock"
+#define FILE_PATH "/tmp/test-sendfile.bin"
+
+static uint64_t get_ns()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1'000'000'000 + ts.tv_nsec;
+}
+
+static bool create_file(size_t size)
+{
+	int fd = open(FILE_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+	{
+		perror("open");
+		return false;
+	}
+
+	char buffer[4096];
+	for (size_t i = 0; i < sizeof(buffer); i++)
+		buffer[i] = 'a' + i % 26;
+
+	for (size_t written = 0; written < size;)
+	{
+		const size_t to_write = (size - written < sizeof(buffer)) ? size - written : sizeof(buffer);
+		ssize_t nwrite = write(fd, buffer, to_write);
+		if (nwrite <= 0)
+		{
+			perror("write");
+			close(fd);
+			return false;
+		}
+		written += nwrite;
+	}
+
+	close(fd);
+	return true;
+}
+
+// Connects to the server and reads until end of file, returns the number of bytes read
+static size_t drain_connection()
+{
+	sockaddr_un addr;
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, SOCK_PATH);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock == -1 || connect(sock, (sockaddr*)&addr, sizeof(addr)) == -1)
+	{
+		perror("connect");
+		exit(1);
+	}
+
+	size_t total = 0;
+	char buffer[16384];
+	for (;;)
+	{
+		ssize_t nrecv = recv(sock, buffer, sizeof(buffer), 0);
+		if (nrecv <= 0)
+			break;
+		total += nrecv;
+	}
+
+	close(sock);
+	return total;
+}
+
+static bool transfer(int client, int fd, size_t size, bool use_sendfile)
+{
+	if (use_sendfile)
+	{
+		off_t offset = 0;
+		while ((size_t)offset < size)
+		{
+			if (sendfile(client, fd, &offset, size - offset) <= 0)
+			{
+				perror("sendfile");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	char buffer[4096];
+	for (size_t total = 0; total < size;)
+	{
+		ssize_t nread = read(fd, buffer, sizeof(buffer));
+		if (nread <= 0)
+		{
+			perror("read");
+			return false;
+		}
+		for (ssize_t nsent = 0; nsent < nread;)
+		{
+			ssize_t ret = send(client, buffer + nsent, nread - nsent, 0);
+			if (ret <= 0)
+			{
+				perror("send");
+				return false;
+			}
+			nsent += ret;
+		}
+		total += nread;
+	}
+	return true;
+}
+
+static bool run_benchmark(int server, size_t size, bool use_sendfile)
+{
+	pid_t pid = fork();
+	if (pid == -1)
+	{
+		perror("fork");
+		return false;
+	}
+	if (pid == 0)
+	{
+		const size_t received = drain_connection();
+		exit(received == size ? 0 : 1);
+	}
+
+	int client = accept(server, nullptr, nullptr);
+	if (client == -1)
+	{
+		perror("accept");
+		return false;
+	}
+
+	int fd = open(FILE_PATH, O_RDONLY);
+	if (fd == -1)
+	{
+		perror("open");
+		return false;
+	}
+
+	const uint64_t start_ns = get_ns();
+	const bool success = transfer(client, fd, size, use_sendfile);
+	close(client);
+
+	int status;
+	waitpid(pid, &status, 0);
+	const uint64_t duration_ns = get_ns() - start_ns;
+
+	close(fd);
+
+	if (!success || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		fprintf(stderr, "%s: transfer failed\n", use_sendfile ? "sendfile" : "read/send");
+		return false;
+	}
+
+	const uint64_t duration_ms = (duration_ns / 1'000'000) ? duration_ns / 1'000'000 : 1;
+	printf("%-10s %zu bytes in %llu ms, %llu KiB/s\n",
+		use_sendfile ? "sendfile" : "read/send",
+		size,
+		(unsigned long long)duration_ms,
+		(unsigned long long)(size / 1024 * 1000 / duration_ms)
+	);
+	return true;
+}
+
+int usage(const char* argv0)
+{
+	fprintf(stderr, "usage: %s [-s SIZE_MIB]\n", argv0);
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	size_t size_mib = 16;
+	if (argc == 3 && strcmp(argv[1], "-s") == 0)
+		size_mib = atoi(argv[2]);
+	else if (argc != 1)
+		return usage(argv[0]);
+	if (size_mib == 0)
+		return usage(argv[0]);
+
+	const size_t size = size_mib * 1024 * 1024;
+	if (!create_file(size))
+		return 1;
+
+	sockaddr_un addr;
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, SOCK_PATH);
+
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server == -1)
+	{
+		perror("socket");
+		return 1;
+	}
+
+	unlink(SOCK_PATH);
+	if (bind(server, (sockaddr*)&addr, sizeof(addr)) == -1 || listen(server, 1) == -1)
+	{
+		perror("bind");
+		return 1;
+	}
+
+	// First pass warms the page cache for both methods
+	bool success = run_benchmark(server, size, false);
+	success = success && run_benchmark(server, size, false);
+	success = success && run_benchmark(server, size, true);
+
+	close(server);
+	unlink(SOCK_PATH);
+	unlink(FILE_PATH);
+
+	return success ? 0 : 1;
+}
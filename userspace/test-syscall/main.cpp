@@ -0,0 +1,60 @@
+#include <kernel/Syscall.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t get_ns()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1'000'000'000 + ts.tv_nsec;
+}
+
+template<typename F>
+static void benchmark(const char* name, size_t iterations, F function)
+{
+	const uint64_t start_ns = get_ns();
+	for (size_t i = 0; i < iterations; i++)
+		function();
+	const uint64_t elapsed_ns = get_ns() - start_ns;
+
+	printf("%-18s %zu calls in %llu ms, %llu ns per call\n",
+		name, iterations,
+		(unsigned long long)(elapsed_ns / 1'000'000),
+		(unsigned long long)(elapsed_ns / iterations)
+	);
+}
+
+int main(int argc, char** argv)
+{
+	size_t iterations = 1'000'000;
+	if (argc >= 2)
+		iterations = strtoul(argv[1], nullptr, 0);
+	if (iterations == 0)
+	{
+		fprintf(stderr, "usage: %s [ITERATIONS]\n", argv[0]);
+		return 1;
+	}
+
+	const pid_t pid = getpid();
+	if (Kernel::syscall_int80(SYS_GET_PID) != pid || Kernel::syscall(SYS_GET_PID) != pid)
+	{
+		fprintf(stderr, "syscall entries disagree on getpid\n");
+		return 1;
+	}
+
+	benchmark("int 0x80", iterations, [] { Kernel::syscall_int80(SYS_GET_PID); });
+#if defined(__x86_64__)
+	benchmark("syscall", iterations, [] { Kernel::syscall(SYS_GET_PID); });
+#else
+	benchmark("sysenter", iterations, [] { Kernel::syscall(SYS_GET_PID); });
+#endif
+	benchmark("getpid()", iterations, [] { getpid(); });
+
+	benchmark("SYS_CLOCK_GETTIME", iterations, [] { timespec ts; Kernel::syscall(SYS_CLOCK_GETTIME, CLOCK_MONOTONIC, (uintptr_t)&ts); });
+	benchmark("clock_gettime()", iterations, [] { timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); });
+
+	return 0;
+}